@@ -182,6 +182,18 @@ public:
     /// \param[out] report [optional] collision report to be filled with data about the collision. If a body was hit, CollisionReport::plink1 contains the hit link pointer.
     virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
+    /// \brief Check collision of a batch of rays with the environment or with a single body.
+    ///
+    /// Equivalent to calling \ref CheckCollision(const RAY&, CollisionReportPtr) for every ray, except that the checker can prepare its internal state once for the entire batch. Sensors that cast hundreds of rays per scan should use this call. Hit distances are always computed regardless of the CO_Distance option.
+    /// The default implementation loops over the single ray checks.
+    /// \param vrays holds the origin and direction of every ray. The length of each ray is the length of its direction.
+    /// \param pbody if not empty, only the body is checked (CO_ActiveDOFs is respected). Otherwise the rays are checked with the entire environment.
+    /// \param[out] vhitdistances for every ray, the distance from the origin to the closest hit, or -1 if nothing was hit
+    /// \param[out] vhitlinks for every ray, the link that was hit or an empty pointer
+    /// \param[out] vhitcontacts for every ray, the position and surface normal of the hit. If the checker hit something but could not compute the contact, the contact is left with a zero normal.
+    /// \return the number of rays that hit something
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, KinBodyConstPtr pbody, std::vector<dReal>& vhitdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks, std::vector<CollisionReport::CONTACT>& vhitcontacts);
+
     /// \brief Checks self collision only with the links of the passed in body.
     ///
     /// Only checks KinBody::GetNonAdjacentLinks(), Links that are joined together are ignored.
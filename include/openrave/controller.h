@@ -74,6 +74,14 @@ public:
     /// \param fTimeElapsed - time elapsed in simulation environment since last frame
     virtual void SimulationStep(dReal fTimeElapsed) = 0;
 
+    /// \brief Return true if \ref SimulationStep only modifies the controlled robot and does not use the collision checker, the physics engine, or lock the environment.
+    ///
+    /// When the environment steps bodies in parallel (see \ref EnvironmentBase::SetSimulationStepThreads), the robots whose controllers return true are stepped at the same time.
+    /// Physics engines can share their state between bodies, so a controller returning true cannot call functions like KinBody::SetDOFVelocities that reach the physics engine.
+    virtual bool SupportsParallelSimulationStep() const {
+        return false;
+    }
+
     /// \brief Return true when goal reached.
     ///
     /// If a trajectory was set, return only when
@@ -181,6 +181,64 @@ public:
     ///
     /// See \ref arch_simulation for more about the simulation thread.
     virtual uint64_t GetSimulationTime() = 0;
+
+    /// \brief How the internal simulation thread schedules its steps when simulating in real time
+    enum SimulationSchedulerMode
+    {
+        SSM_Adaptive = 0, ///< sleeps for a fraction of the remaining time and shifts the simulation start time when the simulation falls behind (default)
+        SSM_FixedStep = 1, ///< starts every step at an absolute deadline spaced by the simulation delta time. The environment lock is acquired at each deadline and is not held while waiting, the time to acquire it is counted in the jitter. Threads that call \ref YieldToSimulationStep before locking leave the lock free for a pending step, but a thread already holding the lock at the deadline still delays the step. When a step finishes after the next deadline, the next step starts immediately and the deadlines that already passed are dropped.
+    };
+
+    /// \brief Timing statistics of the internal simulation thread, all times are in microseconds
+    struct SimulationStatistics
+    {
+        SimulationStatistics() : numsteps(0), numoverruns(0), numskippedsteps(0), numlockfailures(0), laststeptime(0), maxsteptime(0), meansteptime(0), lastjitter(0), maxjitter(0), meanjitter(0), maxlockwaittime(0), meanlockwaittime(0) {
+        }
+        uint64_t numsteps; ///< number of steps taken by the simulation thread
+        uint64_t numoverruns; ///< number of steps that finished after the deadline of the next step
+        uint64_t numskippedsteps; ///< number of deadlines that were dropped because the simulation fell behind (SSM_FixedStep only)
+        uint64_t numlockfailures; ///< number of times the environment lock could not be acquired within 0.1s
+        uint64_t laststeptime, maxsteptime; ///< time spent in StepSimulation
+        double meansteptime;
+        int64_t lastjitter; ///< start time of the step minus its deadline, only computed when simulating in real time
+        uint64_t maxjitter; ///< maximum absolute jitter
+        double meanjitter; ///< mean absolute jitter
+        uint64_t maxlockwaittime; ///< time spent waiting for the environment lock before a step
+        double meanlockwaittime;
+    };
+
+    /// \brief Sets how the internal simulation thread schedules its steps when simulating in real time. <b>[multi-thread safe]</b>
+    ///
+    /// Changing the mode restarts the schedule from the current time.
+    virtual void SetSimulationSchedulerMode(SimulationSchedulerMode mode) = 0;
+
+    virtual SimulationSchedulerMode GetSimulationSchedulerMode() const = 0;
+
+    /** \brief Waits while a SSM_FixedStep simulation step is about to acquire the environment lock. <b>[multi-thread safe]</b>
+
+        The environment mutex has no priorities. Threads that lock the environment often should call this right before
+        locking it so that a step due within the next 0.5ms goes first. Returns immediately when no step is pending.
+        \param timeout maximum time to wait in microseconds
+     */
+    virtual void YieldToSimulationStep(uint64_t timeout=2000) = 0;
+
+    /// \brief Returns the timing statistics of the internal simulation thread. <b>[multi-thread safe]</b>
+    ///
+    /// \param reset if true, resets the statistics after returning them
+    virtual void GetSimulationStatistics(SimulationStatistics& stats, bool reset=false) = 0;
+
+    /** \brief Sets the number of threads \ref StepSimulation uses to step bodies and sensors. <b>[multi-thread safe]</b>
+
+        A step is divided into phases separated by barriers:
+        -# the physics engine
+        -# the bodies whose \ref KinBody::SupportsParallelSimulationStep returns true, in parallel
+        -# the remaining bodies and the modules, serially in order
+        -# \ref SensorBase::SimulationStepPrepare for all sensors serially, then \ref SensorBase::SimulationStepParallel in parallel
+        \param numthreads the number of threads including the stepping thread. If 1 or less, everything is stepped serially (default).
+     */
+    virtual void SetSimulationStepThreads(int numthreads) = 0;
+
+    virtual int GetSimulationStepThreads() const = 0;
     //@}
 
     /// \name File Loading and Parsing
@@ -427,16 +485,28 @@ public:
 
     /// \brief Retrieve published bodies, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// A separate **published bodies mutex** is locked for reading the published bodies.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBodies returns.
     /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout=0) = 0;
 
+    /** \brief Retrieve the published bodies that changed since a previous call, completes even if environment is locked. <b>[multi-thread safe]</b>
+
+        Only a separate **published bodies mutex** is locked, which \ref UpdatePublishedBodies holds only while swapping in the new states.
+        \param[in,out] version the version returned by the previous call or 0 to retrieve all bodies. Set to the current version of the published bodies.
+        \param[out] vchangedbodies the states of the bodies that were added or changed since version
+        \param[out] vremovedbodyids the environment ids of the bodies that were removed since version
+        \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
+        \return true if vchangedbodies contains all the published bodies and the bodies not in it should be removed. This happens if version is 0 or too old.
+        \throw openrave_exception with ORE_Timeout error code
+     */
+    virtual bool GetPublishedBodiesDelta(uint64_t& version, std::vector<KinBody::BodyState>& vchangedbodies, std::vector<int>& vremovedbodyids, uint64_t timeout=0) = 0;
+
     /// \brief Updates the published bodies that viewers and other programs listening in on the environment see.
     ///
     /// For example, calling this function inside a planning loop allows the viewer to update the environment
-    /// reflecting the status of the planner.
+    /// reflecting the status of the planner. Only the bodies whose update stamp changed are published again.
     /// Assumes that the physics are locked.
     /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
     /// \throw openrave_exception with ORE_Timeout error code
@@ -1535,6 +1535,11 @@ private:
     /// Updates the bounding box and any other parameters that could have changed by a simulation step
     virtual void SimulationStep(dReal fElapsedTime);
 
+    /// \brief Return true if \ref SimulationStep only modifies this body and does not use the collision checker, the physics engine, or lock the environment.
+    ///
+    /// Returns false by default, classes that can be stepped in parallel have to override it.
+    virtual bool SupportsParallelSimulationStep() const;
+
     /// \brief get the transformations of all the links at once
     virtual void GetLinkTransformations(std::vector<Transform>& transforms) const;
 
@@ -438,7 +438,7 @@ typedef boost::shared_ptr<GraspParameters const> GraspParametersConstPtr;
 class OPENRAVE_API TrajectoryTimingParameters : public PlannerBase::PlannerParameters
 {
 public:
-    TrajectoryTimingParameters() : _interpolation(""), _pointtolerance(0.2), _hastimestamps(false), _hasvelocities(false), _outputaccelchanges(true), _multidofinterp(0), verifyinitialpath(1), _bProcessing(false) {
+    TrajectoryTimingParameters() : _interpolation(""), _pointtolerance(0.2), _hastimestamps(false), _hasvelocities(false), _outputaccelchanges(true), _multidofinterp(0), verifyinitialpath(1), _windowstart(0), _windowend(0), _bProcessing(false) {
         _fStepLength = 0; // reset to 0 since it is being used
         _vXMLParameters.push_back("interpolation");
         _vXMLParameters.push_back("hastimestamps");
@@ -447,6 +447,7 @@ public:
         _vXMLParameters.push_back("outputaccelchanges");
         _vXMLParameters.push_back("multidofinterp");
         _vXMLParameters.push_back("verifyinitialpath");
+        _vXMLParameters.push_back("retimewindow");
     }
 
     std::string _interpolation;
@@ -456,6 +457,11 @@ public:
     int _multidofinterp; ///< if 1, will always force the max acceleration of the robot when retiming rather than using lesser acceleration whenever possible. if 0, will compute minimum acceleration. If 2, will match acceleration ramps of all dofs.
     int verifyinitialpath; ///< if 0 then does not verify whether the path given as input is in collision
 
+    /// \brief if _windowend > _windowstart, only the waypoints in [_windowstart, _windowend] of an already timed trajectory are retimed.
+    ///
+    /// The trajectory needs timestamps and velocities. The velocities at the window boundaries and the time of _windowstart are kept so the rest of the trajectory stays valid. The XML tag is <retimewindow>start end</retimewindow>.
+    int _windowstart, _windowend;
+
 protected:
     bool _bProcessing;
     virtual bool serialize(std::ostream& O, int options=0) const
@@ -470,6 +476,7 @@ protected:
         O << "<outputaccelchanges>" << _outputaccelchanges << "</outputaccelchanges>" << std::endl;
         O << "<multidofinterp>" << _multidofinterp << "</multidofinterp>" << std::endl;
         O << "<verifyinitialpath>" << verifyinitialpath  << "</verifyinitialpath>" << std::endl;
+        O << "<retimewindow>" << _windowstart << " " << _windowend << "</retimewindow>" << std::endl;
         if( !(options & 1) ) {
             O << _sExtraParameters << std::endl;
         }
@@ -488,7 +495,7 @@ protected:
         case PE_Ignore: return PE_Ignore;
         }
 
-        _bProcessing = name=="interpolation" || name=="hastimestamps" || name=="hasvelocities" || name=="pointtolerance" || name=="outputaccelchanges" || name=="multidofinterp"||name=="verifyinitialpath";
+        _bProcessing = name=="interpolation" || name=="hastimestamps" || name=="hasvelocities" || name=="pointtolerance" || name=="outputaccelchanges" || name=="multidofinterp"||name=="verifyinitialpath"||name=="retimewindow";
         return _bProcessing ? PE_Support : PE_Pass;
     }
 
@@ -516,6 +523,9 @@ protected:
             else if( name == "verifyinitialpath") {
                 _ss >> verifyinitialpath;
             }
+            else if( name == "retimewindow") {
+                _ss >> _windowstart >> _windowend;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
             }
@@ -24,6 +24,7 @@
 #define OPENRAVE_PLANNINGUTILS_H
 
 #include <openrave/openrave.h>
+#include <boost/thread/condition.hpp>
 
 namespace OpenRAVE {
 
@@ -254,9 +255,22 @@ typedef boost::shared_ptr<AffineTrajectoryRetimer> AffineTrajectoryRetimerPtr;
  */
 OPENRAVE_API PlannerStatus RetimeTrajectory(TrajectoryBasePtr traj, bool hastimestamps=false, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", const std::string& plannerparameters="");
 
+/** \brief Retimes many trajectories with a pool of threads using all the positional data of each trajectory. <b>[multi-thread safe]</b>
+
+    Every trajectory is retimed the same way as \ref RetimeTrajectory. Each thread owns its own retiming planner, which is only re-initialized when the configuration specification of the next trajectory changes, so the environment is locked only while initializing and the retiming itself runs in parallel.
+    The calling thread should not hold the environment lock, otherwise the other threads cannot initialize their planners.
+    The statuses are stored by trajectory index, so the results do not depend on the number of threads or on the order the threads pick up the trajectories.
+    \param vtrajectories the trajectories to retime, each is modified to contain its new re-timed data. They should not be shared with other threads while retiming.
+    \param[out] vstatuses the status of the retiming planner for every trajectory. If retiming throws an exception, the status of that trajectory is PS_Failed.
+    \param numthreads the number of threads to use including the calling thread. If <= 0, uses the number of hardware threads.
+    \return the number of trajectories that were successfully retimed
+ */
+OPENRAVE_API int RetimeTrajectories(const std::vector<TrajectoryBasePtr>& vtrajectories, std::vector<PlannerStatus>& vstatuses, bool hastimestamps=false, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", const std::string& plannerparameters="", int numthreads=0);
+
 /** \brief Inserts a waypoint into a trajectory at the index specified, and retimes the segment before and after the trajectory. This will \b not change the previous trajectory. <b>[multi-thread safe]</b>
 
     Collision is not checked on the modified segments of the trajectory.
+    If index is in the middle of the trajectory, the trajectory has to be timed with velocities. Only the segments between the neighbors of the new waypoint are retimed (see TrajectoryTimingParameters::_windowstart), so the cost does not depend on the length of the trajectory.
     \param index The index where to start modifying the trajectory.
     \param dofvalues the configuration to insert into the trajectcory (active dof values of the robot)
     \param dofvelocities the velocities that the inserted point should start with
@@ -273,7 +287,7 @@ OPENRAVE_API void InsertActiveDOFWaypointWithRetiming(int index, const std::vect
     \param dofvalues the configuration to insert into the trajectcory (active dof values of the robot)
     \param dofvelocities the velocities that the inserted point should start with
     \param traj the trajectory that initially contains the input points, it is modified to contain the new re-timed data.
-    \param planner initialized planner that will do the retiming. \ref PlannerBase::InitPlan should already be called.
+    \param planner initialized planner that will do the retiming. \ref PlannerBase::InitPlan should already be called. Inserting in the middle of the trajectory retimes a window around the new waypoint, which needs a planner using TrajectoryTimingParameters. The planner is re-initialized with its original parameters afterwards.
  */
 OPENRAVE_API void InsertWaypointWithRetiming(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, PlannerBasePtr planner);
 
@@ -403,6 +417,27 @@ public:
     /// \param bCallAfterCheckCollision if set, function will be called after check collision functions.
     virtual void SetUserCheckFunction(const boost::function<bool() >& usercheckfn, bool bCallAfterCheckCollision=false);
 
+    /// \brief how \ref Check validates the configurations between the end points of an interval
+    enum IntervalCheckMode {
+        ICM_Discretized=0, ///< check configurations spaced by the DOF resolutions (default)
+        ICM_ContinuousCollision=1, ///< certify the interval with conservative advancement on the minimum distance
+        ICM_VanDerCorput=2, ///< check the same configurations as ICM_Discretized in van der Corput (bisection) order, so collisions anywhere on the interval are found early
+    };
+
+    /// \brief sets how the interior of intervals is checked
+    ///
+    /// ICM_ContinuousCollision queries the minimum distance of the checked bodies with CO_Distance, bounds how far any point of the bodies can
+    /// move along the linear interpolation, and advances by the largest step that cannot close that distance. A collision free segment is certified
+    /// in a few distance queries regardless of its length, and thin obstacles cannot be jumped over.
+    /// It requires a checker that computes distances (like pqp) and a linear neighbor function. Intervals that cannot be certified this way are discretized:
+    /// quadratic interpolation, time-based or user constraints, neighbor functions that do not add the delta linearly, moving circular joints or mimic joints,
+    /// affine rotations, and checkers without distance support.
+    /// ICM_VanDerCorput only reorders linearly interpolated intervals whose neighbor function adds the delta linearly. Intervals that are quadratically
+    /// interpolated, have a nonlinear neighbor function (closed chains, constraint projections, wrapping circular values), or have to fill
+    /// \ref ConstraintFilterReturn::_configurations in order (CFO_FillCheckedConfiguration) are checked sequentially.
+    /// \param fsafetydistance configurations closer than this to a collision are treated as colliding. Has to be positive for the advancement to terminate.
+    virtual void SetIntervalCheckMode(IntervalCheckMode mode, dReal fsafetydistance=0.001);
+
     /// \brief checks line collision. Uses the constructor's self-collisions
     virtual int Check(const std::vector<dReal>& q0, const std::vector<dReal>& q1, const std::vector<dReal>& dq0, const std::vector<dReal>& dq1, dReal timeelapsed, IntervalType interval, int options = 0xffff, ConstraintFilterReturnPtr filterreturn = ConstraintFilterReturnPtr());
 
@@ -410,6 +445,11 @@ public:
         return _report;
     }
 
+    /// \brief returns the number of configurations (or distance queries) checked by the last call to \ref Check
+    int GetNumCheckedSamples() const {
+        return _nCheckedSamples;
+    }
+
 protected:
     /// \brief checks an already set state
     ///
@@ -422,14 +462,48 @@ protected:
     virtual int _SetAndCheckState(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn);
     virtual void _PrintOnFailure(const std::string& prefix);
 
+    /// \brief checks the linear interval q0 + t*dq, t in [0,1] with conservative advancement
+    ///
+    /// \param bCheckStart if false, q0 is not part of the interval
+    /// \param timeelapsed the time of the interval, the checked configurations are filled with the times t*timeelapsed
+    /// \return 0 if the interval is collision free, the failed \ref ConstraintFilterOptions, or -1 if the interval cannot be certified and has to be discretized
+    /// \brief returns true if params->_neighstatefn adds fractions of dq to q0 linearly
+    virtual bool _IsNeighStateFnLinear(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq);
+    virtual int _CheckContinuousCollision(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq, dReal timeelapsed, bool bCheckStart, int options, int maskoptions, ConstraintFilterReturnPtr filterreturn);
+
+    /// \brief computes the minimum distance of the checked bodies to the environment and to themselves at the current state
+    ///
+    /// \param[out] nclosestconstraint the constraint that the minimum distance belongs to
+    /// \return 0 if there are no collisions, otherwise the failed \ref ConstraintFilterOptions
+    virtual int _ComputeMinDistance(int options, dReal& fmindist, int& nclosestconstraint);
+
+    /// \brief computes fA and fS such that no point of the checked bodies moves more than fstep*fA/(1-fstep*fS) over a step fstep of the interval starting at the current state.
+    virtual void _ComputeContinuousMotionBound(dReal& fA, dReal& fS);
+
+    /// \brief motion of a checked body over the interval being checked with ICM_ContinuousCollision
+    struct ContinuousBodyMotion
+    {
+        std::vector<dReal> vdofvalues, vdofdelta; ///< DOF values at the start of the interval and their change over it
+        Transform tstart;
+        dReal ftransdelta, frotdelta; ///< distance and angle the base moves over the interval
+    };
+
     PlannerBase::PlannerParametersWeakPtr _parameters;
-    std::vector<dReal> _vtempconfig, _vtempvelconfig, dQ, _vtempveldelta, _vtempaccelconfig, _vperturbedvalues, _vcoeff2, _vcoeff1; ///< in configuration space
+    std::vector<dReal> _vtempconfig, _vtempvelconfig, dQ, _vtempveldelta, _vtempaccelconfig, _vperturbedvalues, _vcoeff2, _vcoeff1, _vtempstepdelta; ///< in configuration space
     CollisionReportPtr _report;
     std::list<KinBodyPtr> _listCheckBodies;
     int _filtermask;
     dReal _perturbation;
+    int _nCheckedSamples;
     boost::array< boost::function<bool() >, 2> _usercheckfns;
 
+    // for continuous collisions
+    IntervalCheckMode _intervalcheckmode;
+    dReal _fsafetydistance;
+    std::vector<ContinuousBodyMotion> _vcontinuousmotion;
+    std::vector<dReal> _vlinkmotionbound;
+    std::vector< std::vector<AABB> > _vlinkaabbs; ///< for every link, the aabbs of the link and the bodies grabbed by it
+
     // for dynamics
     ConfigurationSpecification _specvel;
     std::vector< std::pair<int, dReal> > _vtorquevalues;
@@ -590,6 +664,179 @@ protected:
 
 typedef boost::shared_ptr<ManipulatorIKGoalSampler> ManipulatorIKGoalSamplerPtr;
 
+/** \brief kd-tree for nearest neighbor queries of configurations.
+
+    The distance metric is the weighted euclidean distance \f$\sqrt{\sum_i w_i^2 (q_{0,i}-q_{1,i})^2}\f$, the same as \ref SimpleDistanceMetric. Circular dimensions are wrapped to \f$[-\pi,\pi)\f$ and their differences are always the shortest angle, so neighbors are correctly found across the \f$\pm\pi\f$ boundary.
+
+    Points can be inserted incrementally at any time, the tree is rebuilt if it becomes unbalanced. All queries are const and can be called from multiple threads as long as no points are inserted or removed at the same time.
+ */
+class OPENRAVE_API NearestNeighborTree
+{
+public:
+    /// \param vweights the weight of every dimension, the size determines the dimension of the space.
+    /// \param vcircular if not empty, for every dimension 1 if circular
+    NearestNeighborTree(const std::vector<dReal>& vweights, const std::vector<uint8_t>& vcircular=std::vector<uint8_t>());
+
+    /// \brief initializes the weights and circular dimensions from the active DOFs of the robot
+    NearestNeighborTree(RobotBaseConstPtr probot);
+
+    virtual ~NearestNeighborTree() {
+    }
+
+    /// \brief removes all the points
+    virtual void Reset();
+
+    /// \brief adds a point to the tree, returns its index
+    virtual int Insert(const std::vector<dReal>& q);
+
+    /// \brief adds many points at once and rebuilds a balanced tree, faster than calling \ref Insert for every point.
+    ///
+    /// \param vpoints the points stored consecutively, the size has to be a multiple of the dimension. The points get consecutive indices starting at \ref GetSize.
+    virtual void InsertPoints(const std::vector<dReal>& vpoints);
+
+    /// \brief removes a point from the tree, it will not be returned from any further queries. The indices of other points do not change.
+    virtual void Remove(int index);
+
+    /// \brief rebuilds a balanced tree from all the points that have not been removed
+    virtual void Rebuild();
+
+    /// \brief returns the point at index. Circular dimensions are normalized.
+    virtual void GetPoint(int index, std::vector<dReal>& q) const;
+
+    /// \brief number of points that were inserted including removed points
+    virtual int GetSize() const {
+        return (int)_vnodes.size();
+    }
+
+    virtual int GetDOF() const {
+        return (int)_vweights.size();
+    }
+
+    /// \brief returns the distance between two configurations using the tree's metric
+    virtual dReal ComputeDistance(const std::vector<dReal>& q0, const std::vector<dReal>& q1) const;
+
+    /// \brief returns the index of the nearest point or -1 if the tree is empty
+    ///
+    /// \param fdist filled with the distance to the nearest point
+    virtual int FindNearest(const std::vector<dReal>& q, dReal& fdist) const;
+
+    /// \brief finds the k nearest points sorted by increasing distance
+    ///
+    /// \param eps approximate search, the returned distances are at most (1+eps) times the true distances
+    /// \return the number of points found
+    virtual int FindNearestK(const std::vector<dReal>& q, int k, std::vector<int>& vindices, std::vector<dReal>& vdists, dReal eps=0) const;
+
+    /// \brief finds all the points within fradius sorted by increasing distance
+    ///
+    /// \return the number of points found
+    virtual int FindRadius(const std::vector<dReal>& q, dReal fradius, std::vector<int>& vindices, std::vector<dReal>& vdists) const;
+
+protected:
+    struct Node
+    {
+        Node() : splitdim(0), left(-1), right(-1), size(1), removed(false) {
+        }
+        int splitdim; ///< split dimension, the split value is the coordinate of the node point
+        int left, right; ///< children, left contains all the values <= split, right >= split
+        int size; ///< number of nodes in the subtree including this node
+        bool removed;
+    };
+
+    struct SearchState;
+
+    void _Init();
+    void _NormalizePoint(const dReal* pin, dReal* pout) const;
+    dReal _ComputeDistance2(const dReal* q0, const dReal* q1) const;
+    dReal _ComputeOffset2(int idim, dReal q, dReal flower, dReal fupper) const;
+    int _Build(std::vector<int>::iterator itbegin, std::vector<int>::iterator itend);
+    void _Search(int inode, const dReal* q, dReal rd, std::vector<dReal>& vlower, std::vector<dReal>& vupper, SearchState& state) const;
+
+    std::vector<dReal> _vweights;
+    std::vector<dReal> _vweights2; ///< squared weights
+    std::vector<uint8_t> _vcircular;
+    std::vector<dReal> _vpoints; ///< _vpoints[GetDOF()*i+j] is the jth coordinate of the ith point
+    std::vector<Node> _vnodes;
+    int _root;
+    int _ntreesize; ///< number of nodes reachable from _root
+    int _nremoved; ///< number of removed nodes that are still in the tree
+    std::vector<int> _vinsertpath; ///< cache
+};
+
+typedef boost::shared_ptr<NearestNeighborTree> NearestNeighborTreePtr;
+typedef boost::shared_ptr<NearestNeighborTree const> NearestNeighborTreeConstPtr;
+
+/** \brief Plans in a separate thread on a clone of the environment so that the calling thread is not blocked. <b>[multi-thread safe]</b>
+
+    \ref Start clones the environment of the robot and the planner parameters, so the original environment can be modified while planning. Only the serializable parameters and the functions set by PlannerBase::PlannerParameters::SetConfigurationSpecification are used, custom functions like PlannerBase::PlannerParameters::_checkpathvelocityconstraintsfn are not copied since they point to the original environment.
+
+    Cancelling and the deadline are checked in the planner callbacks, so planners that never call their callbacks run until they finish.
+ */
+class OPENRAVE_API AsyncPlanner
+{
+public:
+    /// \param plannername the planner to create in the cloned environment
+    /// \param cloneoptions the CloningOptions the environment is cloned with
+    AsyncPlanner(const std::string& plannername, int cloneoptions=Clone_Bodies);
+
+    /// \brief cancels the planning and waits for the thread to finish
+    virtual ~AsyncPlanner();
+
+    /** \brief clones the environment and starts planning. The environment of the robot is locked while cloning.
+
+        \param robot the robot to plan for, the robot with the same name in the cloned environment is used
+        \param parameters the planner parameters for robot
+        \param fdeadline if > 0, the planning is interrupted after this many seconds
+        \return false if the previous planning has not finished. If the planner cannot be initialized, the planning finishes with PS_Failed.
+        \throw openrave_exception if the robot is not cloned or the planner cannot be created
+     */
+    virtual bool Start(RobotBasePtr robot, PlannerBase::PlannerParametersConstPtr parameters, dReal fdeadline=0);
+
+    /// \brief requests to interrupt the planning, \ref GetStatus returns PS_Interrupted when the planner stops.
+    virtual void Cancel();
+
+    /// \brief waits for the planning to finish
+    ///
+    /// \param ftimeout if > 0, the maximum time in seconds to wait
+    /// \return true if the planning is finished
+    virtual bool Wait(dReal ftimeout=0);
+
+    /// \brief true if the planning finished
+    virtual bool IsDone() const;
+
+    /// \brief the status of the last finished planning, PS_Failed if it is still running
+    virtual PlannerStatus GetStatus() const;
+
+    /// \brief the trajectory of the last finished planning created in the environment of the robot passed to \ref Start
+    virtual TrajectoryBasePtr GetTrajectory() const;
+
+    /// \brief the last progress reported by the planner
+    virtual PlannerBase::PlannerProgress GetProgress() const;
+
+    /// \brief sets a function that receives all the progress updates of the planner. It is called from the planning thread without the original environment locked.
+    ///
+    /// If the function returns PA_Interrupt, the planning is interrupted.
+    virtual void SetProgressCallback(const PlannerBase::PlanCallbackFn& progressfn);
+
+protected:
+    virtual void _PlanThread(EnvironmentBasePtr penv, RobotBasePtr probot, PlannerBasePtr planner, PlannerBase::PlannerParametersPtr params, TrajectoryBasePtr ptrajout);
+    virtual PlannerAction _PlanCallback(const PlannerBase::PlannerProgress& progress);
+
+    std::string _plannername;
+    int _cloneoptions;
+    boost::mutex _mutexthread; ///< protects _thread, held while starting and joining the planning thread
+    boost::shared_ptr<boost::thread> _thread;
+    mutable boost::mutex _mutex; ///< protects the state below
+    boost::condition _condDone; ///< notified when _bDone is set
+    PlannerBase::PlanCallbackFn _progressfn;
+    PlannerBase::PlannerProgress _progress;
+    PlannerStatus _status;
+    TrajectoryBasePtr _traj;
+    uint64_t _deadline; ///< in microseconds, 0 if there is no deadline
+    bool _bCancel, _bDone;
+};
+
+typedef boost::shared_ptr<AsyncPlanner> AsyncPlannerPtr;
+
 } // planningutils
 } // OpenRAVE
 
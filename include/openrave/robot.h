@@ -850,6 +850,9 @@ private:
      */
     virtual void SimulationStep(dReal fElapsedTime);
 
+    /// \brief Return true if the controller supports parallel simulation steps, see \ref ControllerBase::SupportsParallelSimulationStep
+    virtual bool SupportsParallelSimulationStep() const;
+
     /** \brief Check if body is self colliding with its links or its grabbed bodies.
 
         Links that are joined together are ignored.
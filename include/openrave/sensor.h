@@ -41,7 +41,8 @@ public:
         ST_Odometry=6,
         ST_Tactile=7,
         ST_Actuator=8,
-        ST_NumberofSensorTypes=8
+        ST_Depth=9,
+        ST_NumberofSensorTypes=9
     };
 
     typedef geometry::RaveCameraIntrinsics<dReal> CameraIntrinsics;
@@ -91,6 +92,17 @@ public:
         virtual bool serialize(std::ostream& O) const;
     };
 
+    /// \brief Depth image and organized point cloud of a camera, the camera parameters are stored in \ref CameraGeomData.
+    class OPENRAVE_API DepthSensorData : public SensorData
+    {
+public:
+        virtual SensorType GetType() {
+            return ST_Depth;
+        }
+        std::vector<float> vdepthdata;         ///< width*height depth values along the camera z-axis in row-major order. 0 means nothing was hit.
+        std::vector<float> vpointcloud;         ///< organized point cloud, (x,y,z) for every pixel of vdepthdata in the camera coordinate system. Pixels without a hit are 0.
+    };
+
     /// \brief Stores joint angles and EE position.
     class OPENRAVE_API JointEncoderSensorData : public SensorData
     {
@@ -322,6 +334,23 @@ public:
     /// Only valid if this sensor is simulation based. A sensor hooked up to a real device can ignore this call
     virtual bool SimulationStep(dReal fTimeElapsed) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /** \brief Starts a simulation step whose expensive part can run in parallel with other sensors. <b>[environment locked]</b>
+
+        Called instead of \ref SimulationStep when the environment steps sensors in parallel, see \ref EnvironmentBase::SetSimulationStepThreads.
+        The sensor should copy everything it needs from the environment since the bodies can change once the step is over.
+        \return true if \ref SimulationStepParallel has to be called to finish the step, false if the step is done.
+     */
+    virtual bool SimulationStepPrepare(dReal fTimeElapsed) {
+        SimulationStep(fTimeElapsed);
+        return false;
+    }
+
+    /// \brief Finishes a step started with \ref SimulationStepPrepare.
+    ///
+    /// Called from a worker thread at the same time as other sensors and while the environment is locked by the stepping thread, so it cannot access the environment.
+    virtual void SimulationStepParallel(dReal fTimeElapsed) {
+    }
+
     /// \brief Returns the sensor geometry. This method is thread safe.
     ///
     /// \param type the requested sensor type to create. A sensor can support many types. If type is ST_Invalid, then returns a data structure
@@ -18,6 +18,7 @@
 ControllerBasePtr CreateIdealController(EnvironmentBasePtr penv, std::istream& sinput);
 ControllerBasePtr CreateIdealVelocityController(EnvironmentBasePtr penv, std::istream& sinput);
 ControllerBasePtr CreateRedirectController(EnvironmentBasePtr penv, std::istream& sinput);
+ControllerBasePtr CreateTrajectoryStreamController(EnvironmentBasePtr penv, std::istream& sinput);
 
 InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string& interfacename, std::istream& sinput, EnvironmentBasePtr penv)
 {
@@ -32,6 +33,9 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
         else if( interfacename == "redirectcontroller" ) {
             return CreateRedirectController(penv,sinput);
         }
+        else if( interfacename == "trajectorystreamcontroller" ) {
+            return CreateTrajectoryStreamController(penv,sinput);
+        }
         break;
     default:
         break;
@@ -44,6 +48,7 @@ void GetPluginAttributesValidated(PLUGININFO& info)
     info.interfacenames[PT_Controller].push_back("IdealController");
     info.interfacenames[PT_Controller].push_back("IdealVelocityController");
     info.interfacenames[PT_Controller].push_back("RedirectController");
+    info.interfacenames[PT_Controller].push_back("TrajectoryStreamController");
 }
 
 OPENRAVE_PLUGIN_API void DestroyPlugin()
@@ -371,6 +371,13 @@ If SetDesired is called, only joint values will be set at every timestep leaving
         }
     }
 
+    virtual bool SupportsParallelSimulationStep() const
+    {
+        // grabbing and collision checking use the collision checker, _SetDOFValues sets the velocities in the physics engine
+        boost::mutex::scoped_lock lock(_mutex);
+        return !_bCheckCollision && _vgrablinks.size() == 0 && _vgrabbodylinks.size() == 0 && IsPhysicsEngineVelocityLocal(GetEnv());
+    }
+
     virtual bool IsDone() {
         return _bIsDone;
     }
@@ -544,7 +551,7 @@ private:
     UserDataPtr _cblimits;
     ConfigurationSpecification _samplespec;
     boost::shared_ptr<ConfigurationSpecification::Group> _gjointvalues, _gtransform;
-    boost::mutex _mutex;
+    mutable boost::mutex _mutex;
 };
 
 ControllerBasePtr CreateIdealController(EnvironmentBasePtr penv, std::istream& sinput)
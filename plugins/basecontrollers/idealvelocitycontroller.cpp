@@ -87,6 +87,10 @@ public:
             _probot->SetDOFVelocities(vallvelocities); // set after SetDOFValues in order to get correct link velocities
         }
     }
+    virtual bool SupportsParallelSimulationStep() const {
+        // SimulationStep sets the velocities in the physics engine
+        return IsPhysicsEngineVelocityLocal(GetEnv());
+    }
     virtual bool IsDone() {
         return !_bVelocityMode;
     }
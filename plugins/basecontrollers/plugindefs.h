@@ -55,6 +55,7 @@
 #include <stdint.h>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 using namespace OpenRAVE;
@@ -69,4 +70,18 @@ inline dReal TransformDistanceFast(const Transform& t1, const Transform& t2, dRe
     return RaveSqrt((t1.trans-t2.trans).lengthsqr3() + frotweight*e);
 }
 
+/// \brief returns true if setting the velocities of a body only modifies the data of that body in the physics engine.
+///
+/// The generic physics engine stores the velocities in the user data of every body, engines like ode share their world between all bodies.
+inline bool IsPhysicsEngineVelocityLocal(EnvironmentBasePtr penv)
+{
+    PhysicsEngineBasePtr pphysics = penv->GetPhysicsEngine();
+    if( !pphysics ) {
+        return true;
+    }
+    std::string xmlid = pphysics->GetXMLId();
+    std::transform(xmlid.begin(), xmlid.end(), xmlid.begin(), ::tolower);
+    return xmlid == "genericphysicsengine";
+}
+
 #endif
@@ -0,0 +1,480 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2013 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "plugindefs.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+
+#if BOOST_VERSION >= 105300 // lockfree was introduced in 1.53
+#include <boost/lockfree/spsc_queue.hpp>
+#define OPENRAVE_HAS_LOCKFREE_QUEUE
+#endif
+
+class TrajectoryStreamController : public ControllerBase
+{
+    static const int s_nMaxQueuedChunks = 64; ///< chunks that can be added before the simulation thread picks them up
+
+    enum ChunkInterpolation
+    {
+        CI_Linear=0,
+        CI_Quadratic=1,
+        CI_Cubic=2,
+    };
+
+    /// \brief a piece of a trajectory converted to the controlled dofs, prepared by the thread adding it
+    struct TrajectoryChunk
+    {
+        TrajectoryChunk() : dof(0), interpolation(CI_Linear), bReplace(false) {
+        }
+        inline dReal GetDuration() const {
+            return vtimes.size() > 0 ? vtimes.back() : 0;
+        }
+        std::vector<dReal> vtimes; ///< time of every waypoint from the start of the chunk
+        std::vector<dReal> vvalues; ///< dof values of every waypoint
+        std::vector<dReal> vvelocities; ///< dof velocities of every waypoint, empty if interpolation is linear
+        int dof;
+        ChunkInterpolation interpolation;
+        bool bReplace; ///< if true, the chunk takes over immediately and all previous chunks are dropped. A replace chunk without waypoints stops the robot.
+    };
+    typedef boost::shared_ptr<TrajectoryChunk> TrajectoryChunkPtr;
+
+    /// \brief queue of chunks from one producer to the simulation thread. The simulation thread never waits on the producer.
+    class ChunkQueue
+    {
+public:
+        bool push(TrajectoryChunkPtr chunk) {
+#ifdef OPENRAVE_HAS_LOCKFREE_QUEUE
+            return _queue.push(chunk);
+#else
+            boost::mutex::scoped_lock lock(_mutex);
+            if( _queue.size() >= s_nMaxQueuedChunks ) {
+                return false;
+            }
+            _queue.push_back(chunk);
+            return true;
+#endif
+        }
+        bool pop(TrajectoryChunkPtr& chunk) {
+#ifdef OPENRAVE_HAS_LOCKFREE_QUEUE
+            return _queue.pop(chunk);
+#else
+            boost::mutex::scoped_lock lock(_mutex);
+            if( _queue.size() == 0 ) {
+                return false;
+            }
+            chunk = _queue.front();
+            _queue.pop_front();
+            return true;
+#endif
+        }
+private:
+#ifdef OPENRAVE_HAS_LOCKFREE_QUEUE
+        boost::lockfree::spsc_queue<TrajectoryChunkPtr, boost::lockfree::capacity<s_nMaxQueuedChunks> > _queue;
+#else
+        boost::mutex _mutex;
+        std::deque<TrajectoryChunkPtr> _queue;
+#endif
+    };
+
+public:
+    TrajectoryStreamController(EnvironmentBasePtr penv, std::istream& sinput) : ControllerBase(penv), _nPushStamp(0), _bPause(false), _bIsDone(true)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nStreams trajectory chunks to a robot for online re-planning. Forces exact joint values.\n\n\
+Chunks are added from any thread with \\ref ControllerBase::SetPath, which replaces everything that is still playing, or with the **AppendPath** command, which plays the chunk after the previously added ones. The chunks are converted to the controlled dofs when they are added and passed to the simulation thread through a lock-free queue, so adding chunks never blocks the simulation. \
+Only one thread should add chunks at a time.\n\n\
+When a chunk starts at different values than the robot is commanded at, the difference is blended out over the blend time so the motion stays continuous. Every simulation step samples the current segment from a cached cursor, so its cost does not depend on the length of the chunks.\n\n\
+Only joint values are controlled, the transformation and grab groups of the trajectories are ignored.\n";
+        RegisterCommand("Pause",boost::bind(&TrajectoryStreamController::_Pause,this,_1,_2),
+                        "pauses the controller from reacting to commands ");
+        RegisterCommand("AppendPath",boost::bind(&TrajectoryStreamController::_AppendPathCommand,this,_1,_2),
+                        "Appends a serialized trajectory to the stream. It is played once all previously added chunks finish.");
+        RegisterCommand("SetBlendTime",boost::bind(&TrajectoryStreamController::_SetBlendTimeCommand,this,_1,_2),
+                        "Sets the time in seconds used to blend out the difference between the commanded values and the start of a new chunk. Format is:\n\n  time");
+        _fBlendTime = 0.1;
+        _fCommandTime = 0;
+        _fChunkTime = 0;
+        _nSegment = 0;
+    }
+
+    virtual bool Init(RobotBasePtr robot, const std::vector<int>& dofindices, int nControlTransformation)
+    {
+        _probot = robot;
+        _dofindices = dofindices;
+        if( nControlTransformation ) {
+            RAVELOG_WARN("trajectory stream controller cannot control transformation\n");
+        }
+        _dofcircular.resize(0);
+        if( !!_probot ) {
+            FOREACH(it,_dofindices) {
+                KinBody::JointPtr pjoint = _probot->GetJointFromDOFIndex(*it);
+                _dofcircular.push_back(pjoint->IsCircular(*it-pjoint->GetDOFIndex()));
+            }
+        }
+        _pcurrent.reset();
+        _listpending.clear();
+        _vcommanded.resize(0);
+        boost::mutex::scoped_lock lock(_mutexstate);
+        _bPause = false;
+        _bIsDone = true;
+        return true;
+    }
+
+    virtual void Reset(int options)
+    {
+        _PushChunk(TrajectoryChunkPtr(new TrajectoryChunk()), true);
+    }
+
+    virtual const std::vector<int>& GetControlDOFIndices() const {
+        return _dofindices;
+    }
+    virtual int IsControlTransformation() const {
+        return 0;
+    }
+
+    virtual bool SetDesired(const std::vector<dReal>& values, TransformConstPtr trans)
+    {
+        if( values.size() != _dofindices.size() ) {
+            throw openrave_exception(str(boost::format("wrong desired dimensions %d!=%d")%values.size()%_dofindices.size()),ORE_InvalidArguments);
+        }
+        // a single waypoint chunk holds the values
+        TrajectoryChunkPtr chunk(new TrajectoryChunk());
+        chunk->dof = (int)_dofindices.size();
+        chunk->vtimes.push_back(0);
+        chunk->vvalues = values;
+        return _PushChunk(chunk, true);
+    }
+
+    virtual bool SetPath(TrajectoryBaseConstPtr ptraj)
+    {
+        OPENRAVE_ASSERT_FORMAT0(!ptraj || GetEnv()==ptraj->GetEnv(), "trajectory needs to come from the same environment as the controller", ORE_InvalidArguments);
+        if( _IsPaused() ) {
+            RAVELOG_DEBUG("TrajectoryStreamController cannot start trajectories when paused\n");
+            return false;
+        }
+        TrajectoryChunkPtr chunk = !!ptraj ? _ConvertTrajectory(ptraj) : TrajectoryChunkPtr(new TrajectoryChunk());
+        if( !chunk ) {
+            return false;
+        }
+        return _PushChunk(chunk, true);
+    }
+
+    virtual void SimulationStep(dReal fTimeElapsed)
+    {
+        if( _IsPaused() || !_probot ) {
+            return;
+        }
+        // the chunks pushed after reading the stamp might not be popped yet, so they keep the controller from being done
+        int nPushStamp;
+        {
+            boost::mutex::scoped_lock lock(_mutexstate);
+            nPushStamp = _nPushStamp;
+        }
+        TrajectoryChunkPtr chunk;
+        while(_queue.pop(chunk)) {
+            if( chunk->bReplace ) {
+                _listpending.clear();
+                _pcurrent.reset();
+                _fCommandTime = 0;
+            }
+            if( chunk->vtimes.size() > 0 ) {
+                _listpending.push_back(chunk);
+            }
+        }
+        if( !_pcurrent ) {
+            if( _listpending.size() == 0 ) {
+                _SetDone(nPushStamp);
+                return;
+            }
+            if( _vcommanded.size() != _dofindices.size() ) {
+                _probot->GetDOFValues(_vcommanded,_dofindices);
+            }
+            _StartNextChunk(0);
+        }
+
+        // switch to the following chunks while preserving the time that went past the end of the current one
+        while(_fChunkTime > _pcurrent->GetDuration() && _listpending.size() > 0 ) {
+            dReal fleftover = _fChunkTime - _pcurrent->GetDuration();
+            _Sample(_pcurrent->GetDuration(), _vcommanded);
+            _StartNextChunk(fleftover);
+        }
+
+        _Sample(_fChunkTime, _vcommanded);
+        _probot->SetDOFValues(_vcommanded,true,_dofindices);
+
+        if( _fChunkTime >= _pcurrent->GetDuration() && _listpending.size() == 0 ) {
+            // hold the final values until another chunk comes
+            _pcurrent.reset();
+            _SetDone(nPushStamp);
+        }
+        else {
+            _fChunkTime += fTimeElapsed;
+            _fCommandTime += fTimeElapsed;
+        }
+    }
+
+    virtual bool SupportsParallelSimulationStep() const
+    {
+        return true;
+    }
+
+    virtual bool IsDone() {
+        boost::mutex::scoped_lock lock(_mutexstate);
+        return _bIsDone;
+    }
+    virtual dReal GetTime() const {
+        return _fCommandTime;
+    }
+    virtual RobotBasePtr GetRobot() const {
+        return _probot;
+    }
+
+private:
+    virtual bool _Pause(std::ostream& os, std::istream& is)
+    {
+        bool bPause = false;
+        is >> bPause;
+        if( !is ) {
+            return false;
+        }
+        boost::mutex::scoped_lock lock(_mutexstate);
+        _bPause = bPause;
+        return true;
+    }
+
+    bool _IsPaused()
+    {
+        boost::mutex::scoped_lock lock(_mutexstate);
+        return _bPause;
+    }
+
+    /// \brief called by the simulation thread when nothing is playing, only sets the done flag if no chunk was pushed since nPushStamp was read
+    void _SetDone(int nPushStamp)
+    {
+        boost::mutex::scoped_lock lock(_mutexstate);
+        if( _nPushStamp == nPushStamp ) {
+            _bIsDone = true;
+        }
+    }
+
+    virtual bool _AppendPathCommand(std::ostream& os, std::istream& is)
+    {
+        if( _IsPaused() ) {
+            RAVELOG_DEBUG("TrajectoryStreamController cannot append trajectories when paused\n");
+            return false;
+        }
+        TrajectoryBasePtr ptraj = RaveCreateTrajectory(GetEnv(),"");
+        ptraj->deserialize(is);
+        TrajectoryChunkPtr chunk = _ConvertTrajectory(ptraj);
+        if( !chunk ) {
+            return false;
+        }
+        return _PushChunk(chunk, false);
+    }
+
+    virtual bool _SetBlendTimeCommand(std::ostream& os, std::istream& is)
+    {
+        dReal fBlendTime = 0;
+        is >> fBlendTime;
+        if( !is || fBlendTime < 0 ) {
+            return false;
+        }
+        _fBlendTime = fBlendTime;
+        return true;
+    }
+
+    /// \brief converts the trajectory to the controlled dofs. This is done by the thread adding the chunk so that the simulation thread only interpolates.
+    TrajectoryChunkPtr _ConvertTrajectory(TrajectoryBaseConstPtr ptraj)
+    {
+        if( !_probot ) {
+            return TrajectoryChunkPtr();
+        }
+        stringstream ss;
+        ss << "joint_values " << _probot->GetName();
+        FOREACHC(it, _dofindices) {
+            ss << " " << *it;
+        }
+        const ConfigurationSpecification& trajspec = ptraj->GetConfigurationSpecification();
+        std::vector<ConfigurationSpecification::Group>::const_iterator itvalues = trajspec.FindCompatibleGroup(ss.str(),false);
+        if( itvalues == trajspec._vgroups.end() ) {
+            RAVELOG_WARN(str(boost::format("trajectory does not have joint values of robot %s")%_probot->GetName()));
+            return TrajectoryChunkPtr();
+        }
+
+        TrajectoryChunkPtr chunk(new TrajectoryChunk());
+        chunk->dof = (int)_dofindices.size();
+        ConfigurationSpecification spec;
+        ConfigurationSpecification::Group gvalues;
+        gvalues.name = ss.str();
+        gvalues.offset = 0;
+        gvalues.dof = chunk->dof;
+        spec._vgroups.push_back(gvalues);
+        if( itvalues->interpolation == "quadratic" || itvalues->interpolation == "cubic" ) {
+            std::string velocitiesname = std::string("joint_velocities") + ss.str().substr(12);
+            if( trajspec.FindCompatibleGroup(velocitiesname,false) != trajspec._vgroups.end() ) {
+                ConfigurationSpecification::Group gvelocities = gvalues;
+                gvelocities.name = velocitiesname;
+                gvelocities.offset = chunk->dof;
+                spec._vgroups.push_back(gvelocities);
+                chunk->interpolation = itvalues->interpolation == "quadratic" ? CI_Quadratic : CI_Cubic;
+            }
+        }
+        spec.AddDeltaTimeGroup();
+
+        std::vector<dReal> vdata;
+        int numpoints = (int)ptraj->GetNumWaypoints();
+        ptraj->GetWaypoints(0,numpoints,vdata,spec);
+        int stride = spec.GetDOF();
+        int timeoffset = spec.GetGroupFromName("deltatime").offset;
+        chunk->vtimes.resize(numpoints);
+        chunk->vvalues.resize(numpoints*chunk->dof);
+        if( chunk->interpolation != CI_Linear ) {
+            chunk->vvelocities.resize(numpoints*chunk->dof);
+        }
+        for(int ipoint = 0; ipoint < numpoints; ++ipoint) {
+            std::vector<dReal>::const_iterator itpoint = vdata.begin()+ipoint*stride;
+            chunk->vtimes[ipoint] = ipoint > 0 ? chunk->vtimes[ipoint-1] + *(itpoint+timeoffset) : 0;
+            std::copy(itpoint, itpoint+chunk->dof, chunk->vvalues.begin()+ipoint*chunk->dof);
+            if( chunk->interpolation != CI_Linear ) {
+                std::copy(itpoint+chunk->dof, itpoint+2*chunk->dof, chunk->vvelocities.begin()+ipoint*chunk->dof);
+            }
+        }
+        return chunk;
+    }
+
+    bool _PushChunk(TrajectoryChunkPtr chunk, bool bReplace)
+    {
+        chunk->bReplace = bReplace;
+        boost::mutex::scoped_lock lock(_mutexproducer);
+        if( !_queue.push(chunk) ) {
+            RAVELOG_WARN(str(boost::format("robot %s has too many queued trajectory chunks")%(!!_probot ? _probot->GetName() : std::string())));
+            return false;
+        }
+        // after the push so that the simulation thread cannot read the new stamp before it can pop the chunk
+        boost::mutex::scoped_lock lockstate(_mutexstate);
+        _nPushStamp++;
+        if( chunk->vtimes.size() > 0 ) {
+            _bIsDone = false;
+        }
+        return true;
+    }
+
+    /// \brief starts the first pending chunk, the difference from the commanded values is blended out
+    void _StartNextChunk(dReal fStartTime)
+    {
+        _pcurrent = _listpending.front();
+        _listpending.pop_front();
+        _nSegment = 0;
+        _fChunkTime = 0;
+        _voffset.resize(0);
+        std::vector<dReal> vstart;
+        _Sample(0, vstart);
+        _voffset.resize(_dofindices.size());
+        for(size_t i = 0; i < _voffset.size(); ++i) {
+            _voffset[i] = _dofcircular.at(i) ? utils::SubtractCircularAngle(_vcommanded.at(i), vstart[i]) : _vcommanded.at(i) - vstart[i];
+        }
+        _fChunkTime = fStartTime;
+    }
+
+    /// \brief samples the current chunk at time, moves the segment cursor forward
+    void _Sample(dReal time, std::vector<dReal>& vvalues)
+    {
+        const TrajectoryChunk& chunk = *_pcurrent;
+        int dof = chunk.dof;
+        vvalues.resize(dof);
+        int numpoints = (int)chunk.vtimes.size();
+        if( time < chunk.vtimes.at(_nSegment) ) {
+            _nSegment = 0;
+        }
+        while(_nSegment+1 < numpoints && time > chunk.vtimes[_nSegment+1]) {
+            ++_nSegment;
+        }
+        std::vector<dReal>::const_iterator itp0 = chunk.vvalues.begin() + _nSegment*dof;
+        if( _nSegment+1 >= numpoints || time <= chunk.vtimes[_nSegment] ) {
+            std::copy(itp0, itp0+dof, vvalues.begin());
+        }
+        else {
+            std::vector<dReal>::const_iterator itp1 = itp0 + dof;
+            dReal deltatime = chunk.vtimes[_nSegment+1] - chunk.vtimes[_nSegment];
+            dReal t = time - chunk.vtimes[_nSegment];
+            if( chunk.interpolation == CI_Linear || deltatime <= g_fEpsilon ) {
+                dReal f = deltatime > g_fEpsilon ? t/deltatime : 1;
+                for(int i = 0; i < dof; ++i) {
+                    vvalues[i] = *(itp0+i) + f*(*(itp1+i) - *(itp0+i));
+                }
+            }
+            else {
+                std::vector<dReal>::const_iterator itv0 = chunk.vvelocities.begin() + _nSegment*dof, itv1 = itv0 + dof;
+                if( chunk.interpolation == CI_Quadratic ) {
+                    dReal ideltatime = 1/deltatime;
+                    for(int i = 0; i < dof; ++i) {
+                        dReal accel = (*(itv1+i) - *(itv0+i))*ideltatime;
+                        vvalues[i] = *(itp0+i) + t*(*(itv0+i) + 0.5*t*accel);
+                    }
+                }
+                else {
+                    // cubic hermite
+                    dReal s = t/deltatime, s2 = s*s, s3 = s2*s;
+                    dReal h00 = 2*s3-3*s2+1, h10 = s3-2*s2+s, h01 = -2*s3+3*s2, h11 = s3-s2;
+                    for(int i = 0; i < dof; ++i) {
+                        vvalues[i] = h00*(*(itp0+i)) + h10*deltatime*(*(itv0+i)) + h01*(*(itp1+i)) + h11*deltatime*(*(itv1+i));
+                    }
+                }
+            }
+        }
+
+        if( _voffset.size() > 0 ) {
+            dReal w = 0;
+            if( _fBlendTime > g_fEpsilon && time < _fBlendTime ) {
+                // smoothstep so that the blend starts and ends with zero velocity
+                dReal s = time/_fBlendTime;
+                w = 1-s*s*(3-2*s);
+            }
+            if( w > 0 ) {
+                for(int i = 0; i < dof; ++i) {
+                    vvalues[i] += w*_voffset[i];
+                }
+            }
+        }
+    }
+
+    RobotBasePtr _probot;               ///< controlled body
+    std::vector<int> _dofindices;
+    std::vector<uint8_t> _dofcircular;
+    ChunkQueue _queue;
+    boost::mutex _mutexproducer; ///< serializes the threads adding chunks, never held by the simulation thread
+
+    // only used by the simulation thread
+    TrajectoryChunkPtr _pcurrent; ///< chunk being played
+    std::list<TrajectoryChunkPtr> _listpending; ///< chunks popped from the queue that play after _pcurrent
+    std::vector<dReal> _vcommanded; ///< last commanded values
+    std::vector<dReal> _voffset; ///< difference between the commanded values and the start of _pcurrent, blended out over _fBlendTime
+    int _nSegment; ///< cursor into the waypoints of _pcurrent
+    dReal _fChunkTime; ///< time into _pcurrent
+    dReal _fCommandTime; ///< time since the last replacing chunk
+
+    dReal _fBlendTime;
+
+    boost::mutex _mutexstate; ///< protects the flags shared by all threads, only held while reading or writing them
+    int _nPushStamp; ///< incremented for every pushed chunk
+    bool _bPause, _bIsDone;
+};
+
+ControllerBasePtr CreateTrajectoryStreamController(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return ControllerBasePtr(new TrajectoryStreamController(penv,sinput));
+}
@@ -17,6 +17,7 @@
 #define OPENRAVE_BASECAMERA_H
 
 #include <boost/lexical_cast.hpp>
+#include "softwarerenderer.h"
 
 class BaseCameraSensor : public SensorBase
 {
@@ -35,7 +36,7 @@ public:
                 }
                 return PE_Ignore;
             }
-            static boost::array<string, 13> tags = { { "sensor", "kk", "width", "height", "framerate", "power", "color", "focal_length","image_dimensions","intrinsic","measurement_time", "format", "distortion_model"}};
+            static boost::array<string, 15> tags = { { "sensor", "kk", "width", "height", "framerate", "power", "color", "focal_length","image_dimensions","intrinsic","measurement_time", "format", "distortion_model", "software_render", "render_threads"}};
             if( find(tags.begin(),tags.end(),name) == tags.end() ) {
                 return PE_Pass;
             }
@@ -93,6 +94,12 @@ public:
             else if( name == "format" ) {
                 ss >> _psensor->_channelformat;
             }
+            else if( name == "software_render" ) {
+                ss >> _psensor->_bSoftwareRender;
+            }
+            else if( name == "render_threads" ) {
+                ss >> _psensor->_nRenderThreads;
+            }
             else if( name == "color" ) {
                 ss >> _psensor->_vColor.x >> _psensor->_vColor.y >> _psensor->_vColor.z;
                 // ok if not everything specified
@@ -132,7 +139,7 @@ public:
     }
 
     BaseCameraSensor(EnvironmentBasePtr penv) : SensorBase(penv) {
-        __description = ":Interface Author: Rosen Diankov\n\nProvides a simulated camera using the standard pinhole projection.";
+        __description = ":Interface Author: Rosen Diankov\n\nProvides a simulated camera using the standard pinhole projection.\n\nIf there is no viewer or **software_render** is set, the collision meshes are rasterized on the CPU with **render_threads** threads. This also produces depth images and organized point clouds (Depth sensor type).";
         RegisterCommand("power",boost::bind(&BaseCameraSensor::_Power,this,_1,_2), "deprecated");
         RegisterCommand("render",boost::bind(&BaseCameraSensor::_Render,this,_1,_2),"deprecated");
         RegisterCommand("setintrinsic",boost::bind(&BaseCameraSensor::_SetIntrinsic,this,_1,_2),
@@ -141,8 +148,13 @@ public:
                         "Set the dimensions of the image (width,height)");
         RegisterCommand("SaveImage",boost::bind(&BaseCameraSensor::_SaveImage,this,_1,_2),
                         "Saves the next camera image to the given filename");
+        RegisterCommand("SetSoftwareRender",boost::bind(&BaseCameraSensor::_SetSoftwareRender,this,_1,_2),
+                        "If 1, always render the images on the CPU even if a viewer is present. Optionally followed by the number of rendering threads.");
         _pgeom.reset(new CameraGeomData());
         _pdata.reset(new CameraSensorData());
+        _pdepthdata.reset(new DepthSensorData());
+        _bSoftwareRender = false;
+        _nRenderThreads = max(1,(int)boost::thread::hardware_concurrency());
         _bPower = false;
         _vColor = RaveVector<float>(0.5f,0.5f,1,1);
         framerate = 5;
@@ -210,6 +222,9 @@ public:
     {
         _pdata->vimagedata.resize(0);
         _pdata->__stamp = 0;
+        _pdepthdata->vdepthdata.resize(0);
+        _pdepthdata->vpointcloud.resize(0);
+        _pdepthdata->__stamp = 0;
         _vimagedata.resize(3*_pgeom->width*_pgeom->height);
         _fTimeToImage = 0;
         _graphgeometry.reset();
@@ -217,6 +232,15 @@ public:
     }
 
     virtual bool SimulationStep(dReal fTimeElapsed)
+    {
+        if( SimulationStepPrepare(fTimeElapsed) ) {
+            SimulationStepParallel(fTimeElapsed);
+        }
+        return true;
+    }
+
+    /// \brief copies the scene when an image has to be rendered in software, the rendering itself is done in SimulationStepParallel
+    virtual bool SimulationStepPrepare(dReal fTimeElapsed)
     {
         boost::shared_ptr<CameraSensorData> pdata = _pdata;
 
@@ -226,23 +250,35 @@ public:
             if( _fTimeToImage <= 0 ) {
                 _fTimeToImage = 1 / (float)framerate;
                 GetEnv()->UpdatePublishedBodies();
-                if( !!GetEnv()->GetViewer() ) {
+                bool bHasImage = false;
+                if( !_bSoftwareRender && !!GetEnv()->GetViewer() ) {
                     if( GetEnv()->GetViewer()->GetCameraImage(_vimagedata, _pgeom->width, _pgeom->height, _trans, _pgeom->KK) ) {
                         // copy the data
                         boost::mutex::scoped_lock lock(_mutexdata);
                         pdata->vimagedata = _vimagedata;
                         pdata->__stamp = GetEnv()->GetSimulationTime();
                         pdata->__trans = _trans;
+                        bHasImage = true;
                     }
                 }
+                if( !bHasImage ) {
+                    EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex());
+                    _renderer.SetScene(GetEnv(), _trans);
+                    return true;
+                }
             }
         }
-        return true;
+        return false;
+    }
+
+    virtual void SimulationStepParallel(dReal fTimeElapsed)
+    {
+        _SoftwareRender();
     }
 
     virtual SensorGeometryPtr GetSensorGeometry(SensorType type)
     {
-        if(( type == ST_Invalid) ||( type == ST_Camera) ) {
+        if(( type == ST_Invalid) ||( type == ST_Camera) ||( type == ST_Depth) ) {
             CameraGeomData* pgeom = new CameraGeomData();
             *pgeom = *_pgeom;
             return SensorGeometryPtr(pgeom);
@@ -255,6 +291,9 @@ public:
         if(( type == ST_Invalid) ||( type == ST_Camera) ) {
             return SensorDataPtr(new CameraSensorData());
         }
+        else if( type == ST_Depth ) {
+            return SensorDataPtr(new DepthSensorData());
+        }
         return SensorDataPtr();
     }
 
@@ -267,11 +306,18 @@ public:
                 return true;
             }
         }
+        else if( _bPower &&( psensordata->GetType() == ST_Depth) ) {
+            boost::mutex::scoped_lock lock(_mutexdata);
+            if( _pdepthdata->vdepthdata.size() > 0 ) {
+                *boost::dynamic_pointer_cast<DepthSensorData>(psensordata) = *_pdepthdata;
+                return true;
+            }
+        }
         return false;
     }
 
     virtual bool Supports(SensorType type) {
-        return type == ST_Camera;
+        return type == ST_Camera || type == ST_Depth;
     }
 
     bool _Power(ostream& sout, istream& sinput)
@@ -310,6 +356,19 @@ public:
         RAVELOG_WARN("SaveImage not implemented yet\n");
         return false;
     }
+    bool _SetSoftwareRender(ostream& sout, istream& sinput)
+    {
+        sinput >> _bSoftwareRender;
+        if( !sinput ) {
+            return false;
+        }
+        int numthreads = 0;
+        sinput >> numthreads;
+        if( !!sinput && numthreads > 0 ) {
+            _nRenderThreads = numthreads;
+        }
+        return true;
+    }
 
     virtual void SetTransform(const Transform& trans)
     {
@@ -332,6 +391,8 @@ public:
         _bRenderGeometry = r->_bRenderGeometry;
         _bRenderData = r->_bRenderData;
         _bPower = r->_bPower;
+        _bSoftwareRender = r->_bSoftwareRender;
+        _nRenderThreads = r->_nRenderThreads;
         _Reset();
     }
 
@@ -364,9 +425,28 @@ public:
         ss.str("");
         ss << _vColor.x << " " << _vColor.y << " " << _vColor.z;
         writer->AddChild("color",atts)->SetCharData(ss.str());
+        if( _bSoftwareRender ) {
+            writer->AddChild("software_render",atts)->SetCharData("1");
+        }
     }
 
 protected:
+    /// \brief rasterizes the collision meshes copied into _renderer into the color and depth data, does not access the environment
+    void _SoftwareRender()
+    {
+        _renderer.Render(_pgeom->width, _pgeom->height, _pgeom->KK, _nRenderThreads, _vimagedata, _vdepthdata, _vpointcloud);
+
+        boost::mutex::scoped_lock lock(_mutexdata);
+        uint64_t stamp = GetEnv()->GetSimulationTime();
+        _pdata->vimagedata = _vimagedata;
+        _pdata->__stamp = stamp;
+        _pdata->__trans = _trans;
+        _pdepthdata->vdepthdata.swap(_vdepthdata);
+        _pdepthdata->vpointcloud.swap(_vpointcloud);
+        _pdepthdata->__stamp = stamp;
+        _pdepthdata->__trans = _trans;
+    }
+
     void _RenderGeometry()
     {
         if( !_bRenderGeometry ) {
@@ -412,9 +492,12 @@ protected:
 
     boost::shared_ptr<CameraGeomData> _pgeom;
     boost::shared_ptr<CameraSensorData> _pdata;
+    boost::shared_ptr<DepthSensorData> _pdepthdata;
 
     // more geom stuff
     vector<uint8_t> _vimagedata;
+    vector<float> _vdepthdata, _vpointcloud;
+    SoftwareCameraRenderer _renderer;
     RaveVector<float> _vColor;
 
     Transform _trans;
@@ -429,6 +512,8 @@ protected:
 
     bool _bRenderGeometry, _bRenderData;
     bool _bPower;     ///< if true, gather data, otherwise don't
+    bool _bSoftwareRender; ///< if true, always rasterize the images on the CPU even if a viewer is present
+    int _nRenderThreads; ///< number of threads used by the software renderer
 
     friend class BaseCameraXMLReader;
 };
@@ -143,7 +143,6 @@ public:
 
         _pgeom.reset(new BaseFlashLidar3DGeom());
         _pdata.reset(new LaserSensorData());
-        _report.reset(new CollisionReport());
 
         _bRenderData = false;
         _bRenderGeometry = true;
@@ -205,9 +204,6 @@ public:
         if(( _fTimeToScan <= 0) && _bPower ) {
             _fTimeToScan = _pgeom->time_scan;
 
-            RAY r;
-
-            GetEnv()->GetCollisionChecker()->SetCollisionOptions(CO_Distance);
             Transform t;
 
             {
@@ -216,10 +212,10 @@ public:
                 t = GetTransform();
                 _pdata->__trans = t;
                 _pdata->__stamp = GetEnv()->GetSimulationTime();
-
-                r.pos = t.trans;
                 _pdata->positions.at(0) = t.trans;
 
+                _vrays.resize(_pgeom->width*_pgeom->height);
+                _vraydirs.resize(_vrays.size());
                 for(int w = 0; w < _pgeom->width; ++w) {
                     for(int h = 0; h < _pgeom->height; ++h) {
                         Vector vdir;
@@ -227,32 +223,31 @@ public:
                         vdir.y = (float)h*_iKK[1] + _iKK[3];
                         vdir.z = 1.0f;
                         vdir = t.rotate(vdir.normalize3());
-                        r.dir = _pgeom->max_range*vdir;
-
                         int index = w*_pgeom->height+h;
-
-                        if( GetEnv()->CheckCollision(r, _report)) {
-                            _pdata->ranges[index] = vdir*_report->minDistance;
-                            _pdata->intensity[index] = 1;
-                            // store the colliding bodies
-                            KinBody::LinkConstPtr plink = !!_report->plink1 ? _report->plink1 : _report->plink2;
-                            if( !!plink ) {
-                                _databodyids[index] = plink->GetParent()->GetEnvironmentId();
-                            }
-                        }
-                        else {
-                            _databodyids[index] = 0;
-                            _pdata->ranges[index] = vdir*_pgeom->max_range;
-                            _pdata->intensity[index] = 0;
-                        }
+                        _vrays[index].pos = t.trans;
+                        _vrays[index].dir = _pgeom->max_range*vdir;
+                        _vraydirs[index] = vdir;
                     }
                 }
 
-                _report->Reset();
+                // check all rays at once so the collision checker only has to update its state once per scan
+                GetEnv()->GetCollisionChecker()->CheckCollisionRays(_vrays, KinBodyConstPtr(), _vhitdistances, _vhitlinks, _vhitcontacts);
+                for(size_t index = 0; index < _vrays.size(); ++index) {
+                    const Vector& vdir = _vraydirs[index];
+                    if( _vhitdistances[index] >= 0 ) {
+                        _pdata->ranges[index] = vdir*_vhitdistances[index];
+                        _pdata->intensity[index] = 1;
+                        // store the colliding bodies
+                        _databodyids[index] = !!_vhitlinks[index] ? _vhitlinks[index]->GetParent()->GetEnvironmentId() : 0;
+                    }
+                    else {
+                        _databodyids[index] = 0;
+                        _pdata->ranges[index] = vdir*_pgeom->max_range;
+                        _pdata->intensity[index] = 0;
+                    }
+                }
             }
 
-            GetEnv()->GetCollisionChecker()->SetCollisionOptions(0);
-
             if( _bRenderData ) {
                 // If can render, check if some time passed before last update
                 list<GraphHandlePtr> listhandles;
@@ -425,7 +420,11 @@ protected:
     boost::shared_ptr<BaseFlashLidar3DGeom> _pgeom;
     boost::shared_ptr<LaserSensorData> _pdata;
     vector<int> _databodyids;     ///< if non 0, for each point in _data, specifies the body that was hit
-    CollisionReportPtr _report;
+    std::vector<RAY> _vrays; ///< cached rays of one scan
+    std::vector<Vector> _vraydirs; ///< normalized direction of every ray in _vrays
+    std::vector<dReal> _vhitdistances;
+    std::vector<KinBody::LinkConstPtr> _vhitlinks;
+    std::vector<CollisionReport::CONTACT> _vhitcontacts;
     // more geom stuff
     RaveVector<float> _vColor;
     dReal _iKK[4];     // inverse of KK
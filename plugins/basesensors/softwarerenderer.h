@@ -0,0 +1,335 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2013 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_SOFTWARE_RENDERER_H
+#define OPENRAVE_SOFTWARE_RENDERER_H
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition.hpp>
+
+/** \brief Rasterizes the collision meshes of the environment into color, depth, and point cloud images without a viewer.
+
+    The scene is first copied into camera coordinates with \ref SetScene while the environment is locked. \ref Render can then run without the environment lock.
+    The image is split into bands of rows that are rendered in parallel, each thread owns the pixels of its band so no z-buffer synchronization is necessary.
+    The render threads are started by the first \ref Render that needs them and wait for the next frame afterwards.
+    Lens distortion is ignored.
+ */
+class SoftwareCameraRenderer
+{
+    struct Triangle
+    {
+        Vector v[3]; ///< vertices in camera coordinates, z >= near plane
+        uint8_t color[3];
+    };
+
+    struct ScreenTriangle
+    {
+        dReal x[3], y[3], invz[3];
+        dReal invarea;
+        int minx, maxx, miny, maxy;
+        uint8_t color[3];
+    };
+
+public:
+    SoftwareCameraRenderer() : _fnear(0.01), _width(0), _height(0), _nexttile(0), _nrenderid(0), _numusedthreads(0), _numrunningthreads(0), _bCloseThreads(false) {
+    }
+
+    virtual ~SoftwareCameraRenderer()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutexthreads);
+            _bCloseThreads = true;
+            _condstart.notify_all();
+        }
+        FOREACH(itthread, _vthreads) {
+            (*itthread)->join();
+        }
+        _vthreads.clear();
+    }
+
+    /// \brief copies the visible geometry of the environment into the camera coordinate system. The environment should be locked.
+    ///
+    /// \param tcamera the camera transform, the camera looks down its +z axis
+    /// \param fnear the near clipping plane
+    void SetScene(EnvironmentBasePtr penv, const Transform& tcamera, dReal fnear=0.01)
+    {
+        _fnear = fnear;
+        _vtriangles.resize(0);
+        Transform tcamerainv = tcamera.inverse();
+        std::vector<KinBodyPtr> vbodies;
+        penv->GetBodies(vbodies);
+        Vector vclip[3];
+        FOREACHC(itbody, vbodies) {
+            if( !(*itbody)->IsVisible() ) {
+                continue;
+            }
+            FOREACHC(itlink, (*itbody)->GetLinks()) {
+                if( !(*itlink)->IsVisible() ) {
+                    continue;
+                }
+                FOREACHC(itgeom, (*itlink)->GetGeometries()) {
+                    KinBody::Link::GeometryPtr pgeom = *itgeom;
+                    if( !pgeom->IsVisible() || pgeom->GetTransparency() >= 1 ) {
+                        continue;
+                    }
+                    const TriMesh& mesh = pgeom->GetCollisionMesh();
+                    if( mesh.indices.size() == 0 ) {
+                        continue;
+                    }
+                    Transform t = tcamerainv * (*itlink)->GetTransform() * pgeom->GetTransform();
+                    const RaveVector<float>& diffuse = pgeom->GetDiffuseColor();
+                    for(size_t i = 0; i+2 < mesh.indices.size(); i += 3) {
+                        for(int j = 0; j < 3; ++j) {
+                            vclip[j] = t * mesh.vertices.at(mesh.indices[i+j]);
+                        }
+                        _AddTriangle(vclip, diffuse);
+                    }
+                }
+            }
+        }
+    }
+
+    /// \brief renders the scene set with \ref SetScene
+    ///
+    /// \param[out] vimagedata 3*width*height rgb values
+    /// \param[out] vdepthdata width*height depth values along the camera z-axis, 0 where nothing was hit
+    /// \param[out] vpointcloud 3*width*height camera coordinates of every pixel, 0 where nothing was hit
+    /// \param numthreads number of threads to render with, the calling thread is one of them
+    void Render(int width, int height, const SensorBase::CameraIntrinsics& KK, int numthreads, std::vector<uint8_t>& vimagedata, std::vector<float>& vdepthdata, std::vector<float>& vpointcloud)
+    {
+        _width = width;
+        _height = height;
+        _KK = KK;
+        vimagedata.resize(3*width*height);
+        vdepthdata.resize(width*height);
+        vpointcloud.resize(3*width*height);
+        std::fill(vimagedata.begin(),vimagedata.end(),0);
+        std::fill(vdepthdata.begin(),vdepthdata.end(),0);
+        std::fill(vpointcloud.begin(),vpointcloud.end(),0);
+        if( width <= 0 || height <= 0 ) {
+            return;
+        }
+
+        // project all the triangles once, they are shared by all threads
+        _vscreentriangles.resize(0);
+        _vscreentriangles.reserve(_vtriangles.size());
+        FOREACHC(ittri, _vtriangles) {
+            ScreenTriangle s;
+            for(int j = 0; j < 3; ++j) {
+                s.invz[j] = 1/ittri->v[j].z;
+                s.x[j] = KK.fx*ittri->v[j].x*s.invz[j] + KK.cx;
+                s.y[j] = KK.fy*ittri->v[j].y*s.invz[j] + KK.cy;
+            }
+            dReal area = (s.x[1]-s.x[0])*(s.y[2]-s.y[0]) - (s.y[1]-s.y[0])*(s.x[2]-s.x[0]);
+            if( RaveFabs(area) <= 1e-10 ) {
+                continue;
+            }
+            s.invarea = 1/area;
+            s.minx = max(0, (int)ceil(min(s.x[0],min(s.x[1],s.x[2]))));
+            s.maxx = min(width-1, (int)floor(max(s.x[0],max(s.x[1],s.x[2]))));
+            s.miny = max(0, (int)ceil(min(s.y[0],min(s.y[1],s.y[2]))));
+            s.maxy = min(height-1, (int)floor(max(s.y[0],max(s.y[1],s.y[2]))));
+            if( s.minx > s.maxx || s.miny > s.maxy ) {
+                continue;
+            }
+            s.color[0] = ittri->color[0]; s.color[1] = ittri->color[1]; s.color[2] = ittri->color[2];
+            _vscreentriangles.push_back(s);
+        }
+
+        _nexttile = 0;
+        _pimagedata = &vimagedata[0];
+        _pdepthdata = &vdepthdata[0];
+        _ppointcloud = &vpointcloud[0];
+        int numtiles = (height+s_tilerows-1)/s_tilerows;
+        numthreads = max(1,min(numthreads,numtiles));
+        {
+            boost::mutex::scoped_lock lock(_mutexthreads);
+            while((int)_vthreads.size() < numthreads-1) {
+                _vthreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&SoftwareCameraRenderer::_RenderThread, this, (int)_vthreads.size(), _nrenderid))));
+            }
+            _numusedthreads = numthreads-1;
+            _numrunningthreads = numthreads-1;
+            ++_nrenderid;
+            _condstart.notify_all();
+        }
+        _RenderTiles();
+        {
+            boost::mutex::scoped_lock lock(_mutexthreads);
+            while(_numrunningthreads > 0) {
+                _condfinished.wait(lock);
+            }
+        }
+    }
+
+protected:
+    void _AddTriangle(const Vector* v, const RaveVector<float>& diffuse)
+    {
+        // clip the triangle with the near plane, this can create up to two triangles
+        Vector vpoly[4];
+        int npoly = 0;
+        for(int i = 0; i < 3; ++i) {
+            const Vector& p0 = v[i], &p1 = v[(i+1)%3];
+            bool bin0 = p0.z >= _fnear, bin1 = p1.z >= _fnear;
+            if( bin0 ) {
+                vpoly[npoly++] = p0;
+            }
+            if( bin0 != bin1 ) {
+                vpoly[npoly++] = p0 + (p1-p0)*((_fnear-p0.z)/(p1.z-p0.z));
+            }
+        }
+        if( npoly < 3 ) {
+            return;
+        }
+
+        // flat shading with a light at the camera
+        Vector vnormal = (v[1]-v[0]).cross(v[2]-v[0]);
+        dReal flen = RaveSqrt(vnormal.lengthsqr3());
+        dReal fshade = 1;
+        if( flen > 0 ) {
+            Vector vcenter = (v[0]+v[1]+v[2])*(1.0/3.0);
+            dReal fcenterlen = RaveSqrt(vcenter.lengthsqr3());
+            fshade = fcenterlen > 0 ? RaveFabs(vnormal.dot3(vcenter))/(flen*fcenterlen) : 1;
+        }
+        fshade = 0.2 + 0.8*fshade;
+        Triangle tri;
+        tri.color[0] = (uint8_t)max(0,min(255,(int)(255*diffuse.x*fshade)));
+        tri.color[1] = (uint8_t)max(0,min(255,(int)(255*diffuse.y*fshade)));
+        tri.color[2] = (uint8_t)max(0,min(255,(int)(255*diffuse.z*fshade)));
+        for(int i = 1; i+1 < npoly; ++i) {
+            tri.v[0] = vpoly[0];
+            tri.v[1] = vpoly[i];
+            tri.v[2] = vpoly[i+1];
+            _vtriangles.push_back(tri);
+        }
+    }
+
+    /// \brief waits for every \ref Render and helps with its bands if its index is less than the number of threads requested
+    ///
+    /// \param renderid the id of the last render before the thread was created
+    void _RenderThread(int index, int renderid)
+    {
+        while(1) {
+            {
+                boost::mutex::scoped_lock lock(_mutexthreads);
+                while(_nrenderid == renderid && !_bCloseThreads) {
+                    _condstart.wait(lock);
+                }
+                if( _bCloseThreads ) {
+                    break;
+                }
+                renderid = _nrenderid;
+                if( index >= _numusedthreads ) {
+                    continue;
+                }
+            }
+            _RenderTiles();
+            {
+                boost::mutex::scoped_lock lock(_mutexthreads);
+                if( --_numrunningthreads == 0 ) {
+                    _condfinished.notify_all();
+                }
+            }
+        }
+    }
+
+    /// \brief renders bands of rows until no bands are left
+    void _RenderTiles()
+    {
+        while(1) {
+            int tile;
+            {
+                boost::mutex::scoped_lock lock(_mutextile);
+                tile = _nexttile++;
+            }
+            int rowstart = tile*s_tilerows;
+            if( rowstart >= _height ) {
+                break;
+            }
+            _RenderRows(rowstart, min(_height, rowstart+s_tilerows));
+        }
+    }
+
+    void _RenderRows(int rowstart, int rowend)
+    {
+        FOREACHC(its, _vscreentriangles) {
+            const ScreenTriangle& s = *its;
+            int miny = max(rowstart,s.miny), maxy = min(rowend-1,s.maxy);
+            for(int y = miny; y <= maxy; ++y) {
+                for(int x = s.minx; x <= s.maxx; ++x) {
+                    // barycentric coordinates from the edge functions, the signed area makes them independent of the winding
+                    dReal w0 = ((s.x[2]-s.x[1])*(y-s.y[1]) - (s.y[2]-s.y[1])*(x-s.x[1]))*s.invarea;
+                    dReal w1 = ((s.x[0]-s.x[2])*(y-s.y[2]) - (s.y[0]-s.y[2])*(x-s.x[2]))*s.invarea;
+                    dReal w2 = 1-w0-w1;
+                    if( w0 < 0 || w1 < 0 || w2 < 0 ) {
+                        continue;
+                    }
+                    // 1/z is linear in screen space
+                    dReal invz = w0*s.invz[0] + w1*s.invz[1] + w2*s.invz[2];
+                    if( invz <= 0 ) {
+                        continue;
+                    }
+                    float z = (float)(1/invz);
+                    int index = y*_width+x;
+                    if( _pdepthdata[index] > 0 && _pdepthdata[index] <= z ) {
+                        continue;
+                    }
+                    _pdepthdata[index] = z;
+                    _pimagedata[3*index+0] = s.color[0];
+                    _pimagedata[3*index+1] = s.color[1];
+                    _pimagedata[3*index+2] = s.color[2];
+                }
+            }
+        }
+
+        dReal ifx = 1/_KK.fx, ify = 1/_KK.fy;
+        for(int y = rowstart; y < rowend; ++y) {
+            for(int x = 0; x < _width; ++x) {
+                int index = y*_width+x;
+                float z = _pdepthdata[index];
+                if( z > 0 ) {
+                    _ppointcloud[3*index+0] = (float)((x-_KK.cx)*ifx*z);
+                    _ppointcloud[3*index+1] = (float)((y-_KK.cy)*ify*z);
+                    _ppointcloud[3*index+2] = z;
+                }
+            }
+        }
+    }
+
+    static const int s_tilerows = 16; ///< number of rows rendered by a thread at a time
+
+    std::vector<Triangle> _vtriangles;
+    std::vector<ScreenTriangle> _vscreentriangles;
+    dReal _fnear;
+    int _width, _height;
+    SensorBase::CameraIntrinsics _KK;
+
+    // only valid during Render
+    uint8_t* _pimagedata;
+    float* _pdepthdata;
+    float* _ppointcloud;
+    int _nexttile;
+    boost::mutex _mutextile;
+
+    // persistent render threads, the thread calling Render is not one of them
+    std::vector<boost::shared_ptr<boost::thread> > _vthreads;
+    boost::mutex _mutexthreads; ///< protects the members below
+    boost::condition _condstart, _condfinished;
+    int _nrenderid; ///< incremented by every Render to wake up the threads
+    int _numusedthreads; ///< threads that render the current frame
+    int _numrunningthreads; ///< threads that have not finished the current frame
+    bool _bCloseThreads;
+};
+
+#endif
@@ -17,6 +17,7 @@
 
 #include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
 
 #ifdef QHULL_FOUND
 
@@ -63,26 +64,30 @@ class GrasperModule : public ModuleBase
     };
 
 public:
-    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), errfile(NULL) {
+    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), _nGraspJobId(0), _bShutdownWorkers(false), errfile(NULL) {
         __description = ":Interface Author: Rosen Diankov\n\nUsed to simulate a hand grasping an object by closing its fingers until collision with all links. ";
         RegisterCommand("Grasp",boost::bind(&GrasperModule::_GraspCommand,this,_1,_2),
                         "Performs a grasp and returns contact points");
         RegisterCommand("GraspThreaded",boost::bind(&GrasperModule::_GraspThreadedCommand,this,_1,_2),
-                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'.");
+                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'. The worker threads and their cloned environments are kept between calls. If 'async 1' is specified, returns immediately and the results can be retrieved with GetGraspThreadedResults.");
+        RegisterCommand("GetGraspThreadedResults",boost::bind(&GrasperModule::_GetGraspThreadedResultsCommand,this,_1,_2),
+                        "Returns the grasps computed by the last GraspThreaded call since the last time this command was called. Returns the next grasp id, 1 if the computation finished, and the new grasps in the same format as GraspThreaded. If 'timeout' is specified, waits at most that many seconds for new results.");
         RegisterCommand("ComputeDistanceMap",boost::bind(&GrasperModule::_ComputeDistanceMapCommand,this,_1,_2),
-                        "Computes a distance map around a particular point in space");
+                        "Computes a distance map around a particular point in space. The rays can be checked in 'numthreads' cloned environments. If 'filename' is specified, the map is written there in binary and only the number of points is returned.");
         RegisterCommand("GetStableContacts",boost::bind(&GrasperModule::_GetStableContactsCommand,this,_1,_2),
                         "Returns the stable contacts as defined by the closing direction");
         RegisterCommand("ConvexHull",boost::bind(&GrasperModule::_ConvexHullCommand,this,_1,_2),
                         "Given a point cloud, returns information about its convex hull like normal planes, vertex indices, and triangle indices. Computed planes point outside the mesh, face indices are not ordered, triangles point outside the mesh (counter-clockwise)");
     }
     virtual ~GrasperModule() {
+        _StopGraspWorkers();
         if( !!errfile )
             fclose(errfile);
     }
 
     virtual void Destroy()
     {
+        _StopGraspWorkers();
         _planner.reset();
         _robot.reset();
     }
@@ -364,54 +369,139 @@ public:
 
     virtual bool _ComputeDistanceMapCommand(std::ostream& sout, std::istream& sinput)
     {
-        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
-
         dReal conewidth = 0.25f*PI;
         int nDistMapSamples = 60000;
-        string cmd;
+        int numthreads = 1;
+        string cmd, filename;
         KinBodyPtr targetbody;
         Vector vmapcenter;
-        while(!sinput.eof()) {
-            sinput >> cmd;
-            if( !sinput ) {
-                break;
-            }
-            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        vector<CollisionReport::CONTACT> vpoints;
+        std::vector<EnvironmentBasePtr> vcloneenvs;
+        {
+            EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+            while(!sinput.eof()) {
+                sinput >> cmd;
+                if( !sinput ) {
+                    break;
+                }
+                std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
 
-            if( cmd == "conewidth" ) {
-                sinput >> conewidth;
+                if( cmd == "conewidth" ) {
+                    sinput >> conewidth;
+                }
+                else if( cmd == "mapsamples" ) {
+                    sinput >> nDistMapSamples;
+                }
+                else if( cmd == "target" ) {
+                    string name; sinput >> name;
+                    targetbody = GetEnv()->GetKinBody(name);
+                }
+                else if( cmd == "center" ) {
+                    sinput >> vmapcenter.x >> vmapcenter.y >> vmapcenter.z;
+                }
+                else if( cmd == "numthreads" ) {
+                    sinput >> numthreads;
+                }
+                else if( cmd == "filename" ) {
+                    sinput >> filename;
+                }
+                else {
+                    RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                    break;
+                }
+
+                if( !sinput ) {
+                    RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                    return false;
+                }
             }
-            else if( cmd == "mapsamples" ) {
-                sinput >> nDistMapSamples;
+
+            if( !targetbody ) {
+                RAVELOG_WARN("ComputeDistanceMap: invalid target\n");
+                return false;
             }
-            else if( cmd == "target" ) {
-                string name; sinput >> name;
-                targetbody = GetEnv()->GetKinBody(name);
+
+            RobotBase::RobotStateSaver saver1(_robot);
+            KinBody::KinBodyStateSaver saver2(targetbody);
+            _robot->Enable(false);
+            targetbody->Enable(true);
+
+            BoxSample(targetbody,vpoints,nDistMapSamples,vmapcenter);
+            //DeterministicallySample(targetbody, vpoints, 4, vmapcenter);
+
+            targetbody->Enable(false);
+            numthreads = max(1,min(numthreads,(int)((vpoints.size()+s_nDistanceMapChunk-1)/s_nDistanceMapChunk)));
+            if( numthreads <= 1 ) {
+                SpaceSamplerBasePtr psampler = RaveCreateSpaceSampler(GetEnv(),"mt19937");
+                if( !psampler ) {
+                    throw openrave_exception("ComputeDistanceMap: failed to create mt19937 sampler");
+                }
+                psampler->SetSeed(RaveRandomInt());
+                // process in chunks so the ray buffers do not grow with the number of points
+                for(size_t istart = 0; istart < vpoints.size(); istart += s_nDistanceMapChunk) {
+                    _ComputeDistanceMap(GetEnv(), psampler, vpoints, istart, min(vpoints.size(), istart+s_nDistanceMapChunk), conewidth);
+                }
             }
-            else if( cmd == "center" )
-                sinput >> vmapcenter.x >> vmapcenter.y >> vmapcenter.z;
             else {
-                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
-                break;
+                // the robot and target are disabled in the clones, so the rays can be checked without the environment lock
+                for(int i = 0; i < numthreads; ++i) {
+                    vcloneenvs.push_back(GetEnv()->CloneSelf(Clone_Bodies));
+                }
             }
+        }
 
-            if( !sinput ) {
-                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
-                return false;
+        if( vcloneenvs.size() > 0 ) {
+            std::vector<SpaceSamplerBasePtr> vsamplers(vcloneenvs.size());
+            for(size_t i = 0; i < vcloneenvs.size(); ++i) {
+                vsamplers[i] = RaveCreateSpaceSampler(vcloneenvs[i],"mt19937");
+                if( !vsamplers[i] ) {
+                    FOREACH(itenv,vcloneenvs) {
+                        (*itenv)->Destroy();
+                    }
+                    throw openrave_exception("ComputeDistanceMap: failed to create mt19937 sampler for worker threads");
+                }
+                vsamplers[i]->SetSeed(RaveRandomInt());
+            }
+            size_t nextpoint = 0;
+            boost::mutex mutexpoint;
+            std::vector<boost::shared_ptr<boost::thread> > vthreads(vcloneenvs.size());
+            for(size_t i = 0; i < vthreads.size(); ++i) {
+                vthreads[i].reset(new boost::thread(boost::bind(&GrasperModule::_DistanceMapThread,this,vcloneenvs[i],vsamplers[i],boost::ref(vpoints),conewidth,boost::ref(nextpoint),boost::ref(mutexpoint))));
+            }
+            FOREACH(itthread,vthreads) {
+                (*itthread)->join();
+            }
+            FOREACH(itenv,vcloneenvs) {
+                (*itenv)->Destroy();
             }
         }
 
-        RobotBase::RobotStateSaver saver1(_robot);
-        KinBody::KinBodyStateSaver saver2(targetbody);
-        _robot->Enable(false);
-        targetbody->Enable(true);
-
-        vector<CollisionReport::CONTACT> vpoints;
-        BoxSample(targetbody,vpoints,nDistMapSamples,vmapcenter);
-        //DeterministicallySample(targetbody, vpoints, 4, vmapcenter);
+        if( filename.size() > 0 ) {
+            // binary format: int32 number of points, then (distance, normal, position relative to the center) as float64 for every point
+            ofstream f(filename.c_str(), ios_base::out|ios_base::binary|ios_base::trunc);
+            if( !f ) {
+                RAVELOG_WARN(str(boost::format("failed to open %s for writing\n")%filename));
+                return false;
+            }
+            int32_t numpoints = (int32_t)vpoints.size();
+            f.write((const char*)&numpoints, sizeof(numpoints));
+            std::vector<double> vdata(7*vpoints.size());
+            for(size_t i = 0; i < vpoints.size(); ++i) {
+                vdata[7*i+0] = vpoints[i].depth;
+                vdata[7*i+1] = vpoints[i].norm.x; vdata[7*i+2] = vpoints[i].norm.y; vdata[7*i+3] = vpoints[i].norm.z;
+                vdata[7*i+4] = vpoints[i].pos.x - vmapcenter.x; vdata[7*i+5] = vpoints[i].pos.y - vmapcenter.y; vdata[7*i+6] = vpoints[i].pos.z - vmapcenter.z;
+            }
+            if( vdata.size() > 0 ) {
+                f.write((const char*)&vdata[0], vdata.size()*sizeof(double));
+            }
+            if( !f ) {
+                RAVELOG_WARN(str(boost::format("failed to write %s\n")%filename));
+                return false;
+            }
+            sout << numpoints;
+            return true;
+        }
 
-        targetbody->Enable(false);
-        _ComputeDistanceMap(vpoints, conewidth);
         FOREACH(itpoint, vpoints) {
             sout << itpoint->depth << " " << itpoint->norm.x << " " << itpoint->norm.y << " " << itpoint->norm.z << " ";
             sout << itpoint->pos.x - vmapcenter.x << " " << itpoint->pos.y - vmapcenter.y << " " << itpoint->pos.z - vmapcenter.z << "\n";
@@ -604,6 +694,7 @@ public:
             forceclosurethreshold = 0;
             ffinestep = 0.001f;
             bCheckGraspIK = false;
+            collisionoptions = 0;
         }
 
         string targetname;
@@ -625,6 +716,7 @@ public:
         Vector affineaxis;
 
         bool bCheckGraspIK;
+        int collisionoptions; ///< collision options of the original environment
     };
 
     struct GraspParametersThread
@@ -647,20 +739,75 @@ public:
     typedef boost::shared_ptr<GraspParametersThread> GraspParametersThreadPtr;
     typedef boost::shared_ptr<WorkerParameters> WorkerParametersPtr;
 
-    virtual bool _GraspThreadedCommand(std::ostream& sout, std::istream& sinput)
+    /// \brief the grasps of one GraspThreaded call, workers take the next grasp id when they are done with their previous grasp
+    struct GraspJob
     {
-        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        GraspJob() : nextid(0), numgrasps(0), maxgrasps(0), numthreads(0), numrunning(0), numresults(0), bStop(false) {
+        }
 
-        WorkerParametersPtr worker_params(new WorkerParameters());
-        int numthreads = 2;
-        string cmd;
+        /// \brief initializes the grasp parameters of a grasp id
+        GraspParametersThreadPtr GetGraspParameters(size_t id) const
+        {
+            size_t istandoff = id % standoffs.size();
+            size_t ipreshape = (id / standoffs.size()) % preshapes.size();
+            size_t iroll = (id / (preshapes.size() * standoffs.size())) % rolls.size();
+            size_t iapproachray = (id / (rolls.size() * preshapes.size() * standoffs.size()))%approachrays.size();
+            size_t imanipulatordirection = (id / (rolls.size() * preshapes.size() * standoffs.size()*approachrays.size()));
+
+            GraspParametersThreadPtr grasp_params(new GraspParametersThread());
+            grasp_params->id = id;
+            grasp_params->vtargetposition = approachrays.at(iapproachray).first;
+            grasp_params->vtargetdirection = approachrays.at(iapproachray).second;
+            grasp_params->vmanipulatordirection = manipulatordirections.at(imanipulatordirection);
+            grasp_params->ftargetroll = rolls.at(iroll);
+            grasp_params->fstandoff = standoffs.at(istandoff);
+            grasp_params->preshape = preshapes.at(ipreshape);
+            return grasp_params;
+        }
+
+        WorkerParametersPtr worker_params;
         vector< pair<Vector, Vector> > approachrays;
         vector<dReal> rolls;
         vector< vector<dReal> > preshapes;
         vector<Vector> manipulatordirections;
         vector<dReal> standoffs;
+
+        size_t nextid; ///< the next grasp id to be processed, protected by _mutexGrasp
+        size_t numgrasps, maxgrasps;
+        int numthreads; ///< number of workers processing the job
+        int numrunning; ///< number of workers still processing the job, protected by _mutexGrasp
+        size_t numresults; ///< total number of successful grasps, protected by _mutexGrasp
+        list<GraspParametersThreadPtr> listresults; ///< results that have not been returned yet, protected by _mutexGrasp
+        bool bStop;
+    };
+    typedef boost::shared_ptr<GraspJob> GraspJobPtr;
+
+    /// \brief persistent worker thread with its own cloned environment
+    struct GraspWorker
+    {
+        EnvironmentBasePtr penv;
+        PlannerBasePtr planner;
+        boost::shared_ptr<boost::thread> pthread;
+    };
+    typedef boost::shared_ptr<GraspWorker> GraspWorkerPtr;
+
+    virtual bool _GraspThreadedCommand(std::ostream& sout, std::istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+
+        GraspJobPtr job(new GraspJob());
+        job->worker_params.reset(new WorkerParameters());
+        WorkerParametersPtr worker_params = job->worker_params;
+        int numthreads = 2;
+        string cmd;
+        vector< pair<Vector, Vector> >& approachrays = job->approachrays;
+        vector<dReal>& rolls = job->rolls;
+        vector< vector<dReal> >& preshapes = job->preshapes;
+        vector<Vector>& manipulatordirections = job->manipulatordirections;
+        vector<dReal>& standoffs = job->standoffs;
         size_t startindex = 0;
         size_t maxgrasps = 0;
+        bool bAsync = false;
 
         while(!sinput.eof()) {
             sinput >> cmd;
@@ -710,6 +857,9 @@ public:
             else if( cmd == "numthreads" ) {
                 sinput >> numthreads;
             }
+            else if( cmd == "async" ) {
+                sinput >> bAsync;
+            }
             // grasp specific
             else if( cmd == "approachrays" ) {
                 int numapproachrays = 0;
@@ -773,89 +923,208 @@ public:
         worker_params->vactiveindices = _robot->GetActiveDOFIndices();
         worker_params->affinedofs = _robot->GetAffineDOF();
         worker_params->affineaxis = _robot->GetAffineRotationAxis();
+        worker_params->collisionoptions = GetEnv()->GetCollisionChecker()->GetCollisionOptions();
 
-        EnvironmentBasePtr pcloneenv = GetEnv()->CloneSelf(Clone_Bodies|Clone_Simulation);
+        job->numgrasps = approachrays.size()*rolls.size()*preshapes.size()*standoffs.size()*manipulatordirections.size();
+        job->maxgrasps = maxgrasps == 0 ? job->numgrasps : maxgrasps;
+        job->nextid = startindex;
+        job->numthreads = max(1,numthreads);
+        RAVELOG_INFO(str(boost::format("number of grasps to test: %d\n")%job->numgrasps));
 
-        _bContinueWorker = true;
-        // start worker threads
-        vector<boost::shared_ptr<boost::thread> > listthreads(numthreads);
-        FOREACH(itthread,listthreads) {
-            itthread->reset(new boost::thread(boost::bind(&GrasperModule::_WorkerThread,this,worker_params,pcloneenv)));
+        // finish any previous asynchronous job before the worker environments are updated
+        _StopGraspJob();
+        _StartGraspWorkers(job->numthreads);
+        {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            job->numrunning = job->numthreads;
+            _graspjob = job;
+            _nGraspJobId++;
+            _condGraspHasWork.notify_all();
         }
-
-        _listGraspResults.clear();
-        size_t numgrasps = approachrays.size()*rolls.size()*preshapes.size()*standoffs.size()*manipulatordirections.size();
-        if( maxgrasps == 0 ) {
-            maxgrasps = numgrasps;
+        if( bAsync ) {
+            return true;
         }
-        RAVELOG_INFO(str(boost::format("number of grasps to test: %d\n")%numgrasps));
-        size_t id = startindex;
-        for(id=startindex; id < numgrasps; ++id) {
-            size_t istandoff = id % standoffs.size();
-            size_t ipreshape = (id / standoffs.size()) % preshapes.size();
-            size_t iroll = (id / (preshapes.size() * standoffs.size())) % rolls.size();
-            size_t iapproachray = (id / (rolls.size() * preshapes.size() * standoffs.size()))%approachrays.size();
-            size_t imanipulatordirection = (id / (rolls.size() * preshapes.size() * standoffs.size()*approachrays.size()));
 
+        list<GraspParametersThreadPtr> listresults;
+        size_t nextid = 0;
+        {
             boost::mutex::scoped_lock lock(_mutexGrasp);
-            if( _listGraspResults.size() >= maxgrasps ) {
+            while(job->numrunning > 0) {
+                _condGraspResults.wait(lock);
+            }
+            listresults.swap(job->listresults);
+            nextid = min(job->nextid,job->numgrasps);
+        }
+
+        // parse results to output
+        sout << nextid << " " << listresults.size() << " ";
+        _WriteGraspResults(sout, listresults);
+        return true;
+    }
+
+    virtual bool _GetGraspThreadedResultsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        dReal timeout = 0;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            if( cmd == "timeout" ) {
+                sinput >> timeout;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
             }
 
-            // initialize _graspParamsWork
-            BOOST_ASSERT(!_graspParamsWork);
-            _graspParamsWork.reset(new GraspParametersThread());
-            _graspParamsWork->id = id;
-            _graspParamsWork->vtargetposition = approachrays.at(iapproachray).first;
-            _graspParamsWork->vtargetdirection = approachrays.at(iapproachray).second;
-            _graspParamsWork->vmanipulatordirection = manipulatordirections.at(imanipulatordirection);
-            _graspParamsWork->ftargetroll = rolls.at(iroll);
-            _graspParamsWork->fstandoff = standoffs.at(istandoff);
-            _graspParamsWork->preshape = preshapes.at(ipreshape);
-            _condGraspHasWork.notify_one();     // notify there is work
-            _condGraspReceivedWork.wait(lock);     // wait for more work
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
         }
 
-        // wait for workers
-        _bContinueWorker = false;
-        FOREACH(itthread,listthreads) {
-            _condGraspHasWork.notify_all();     // signal
-            (*itthread)->join();
+        list<GraspParametersThreadPtr> listresults;
+        size_t nextid = 0;
+        bool bFinished = false;
+        {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            GraspJobPtr job = _graspjob;
+            if( !job ) {
+                return false;
+            }
+            if( timeout > 0 && job->listresults.size() == 0 && job->numrunning > 0 ) {
+                _condGraspResults.timed_wait(lock, boost::get_system_time() + boost::posix_time::microseconds(uint64_t(timeout*1000000)));
+            }
+            listresults.swap(job->listresults);
+            nextid = min(job->nextid,job->numgrasps);
+            bFinished = job->numrunning == 0;
         }
-        listthreads.clear();
+        sout << nextid << " " << bFinished << " " << listresults.size() << " ";
+        _WriteGraspResults(sout, listresults);
+        return true;
+    }
 
-        // parse results to output
-        sout << id << " " << _listGraspResults.size() << " ";
-        FOREACH(itresult, _listGraspResults) {
+    void _WriteGraspResults(std::ostream& sout, const list<GraspParametersThreadPtr>& listresults)
+    {
+        FOREACHC(itresult, listresults) {
             sout << (*itresult)->vtargetposition.x << " " << (*itresult)->vtargetposition.y << " " << (*itresult)->vtargetposition.z << " ";
             sout << (*itresult)->vtargetdirection.x << " " << (*itresult)->vtargetdirection.y << " " << (*itresult)->vtargetdirection.z << " ";
             sout << (*itresult)->ftargetroll << " " << (*itresult)->fstandoff << " ";
             sout << (*itresult)->vmanipulatordirection.x << " " << (*itresult)->vmanipulatordirection.y << " " << (*itresult)->vmanipulatordirection.z << " ";
             sout << (*itresult)->mindist << " " << (*itresult)->volume << " ";
-            FOREACH(itangle, (*itresult)->preshape) {
+            FOREACHC(itangle, (*itresult)->preshape) {
                 sout << (*itangle) << " ";
             }
             sout << (*itresult)->transfinal.rot.x << " " << (*itresult)->transfinal.rot.y << " " << (*itresult)->transfinal.rot.z << " " << (*itresult)->transfinal.rot.w << " " << (*itresult)->transfinal.trans.x << " " << (*itresult)->transfinal.trans.y << " " << (*itresult)->transfinal.trans.z << " ";
-            FOREACH(itangle, (*itresult)->finalshape) {
+            FOREACHC(itangle, (*itresult)->finalshape) {
                 sout << *itangle << " ";
             }
             sout << (*itresult)->contacts.size() << " ";
-            FOREACH(itc, (*itresult)->contacts) {
+            FOREACHC(itc, (*itresult)->contacts) {
                 const CollisionReport::CONTACT& c = itc->first;
                 sout << c.pos.x << " " << c.pos.y << " " << c.pos.z << " " << c.norm.x << " " << c.norm.y << " " << c.norm.z << " ";
             }
         }
-        return true;
     }
 
-    void _WorkerThread(const WorkerParametersPtr worker_params, EnvironmentBasePtr penv)
+    /// \brief makes sure there are at least numthreads workers and updates their environments to the current environment. Environment should be locked.
+    void _StartGraspWorkers(int numthreads)
+    {
+        for(size_t i = 0; i < _vgraspworkers.size() && (int)i < numthreads; ++i) {
+            // worker is idle, so safe to re-use the bodies of its environment
+            EnvironmentBasePtr pcloneenv = _vgraspworkers[i]->penv;
+            EnvironmentMutex::scoped_lock lockclone(pcloneenv->GetMutex());
+            pcloneenv->Clone(GetEnv(), Clone_Bodies|Clone_Simulation);
+        }
+        while((int)_vgraspworkers.size() < numthreads) {
+            GraspWorkerPtr worker(new GraspWorker());
+            worker->penv = GetEnv()->CloneSelf(Clone_Bodies|Clone_Simulation);
+            worker->pthread.reset(new boost::thread(boost::bind(&GrasperModule::_WorkerThread,this,worker,(int)_vgraspworkers.size())));
+            _vgraspworkers.push_back(worker);
+        }
+    }
+
+    /// \brief stops the current job and waits for all its workers to finish
+    void _StopGraspJob()
+    {
+        boost::mutex::scoped_lock lock(_mutexGrasp);
+        if( !!_graspjob ) {
+            _graspjob->bStop = true;
+            while(_graspjob->numrunning > 0) {
+                _condGraspResults.wait(lock);
+            }
+        }
+    }
+
+    void _StopGraspWorkers()
+    {
+        _StopGraspJob();
+        {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            _bShutdownWorkers = true;
+            _condGraspHasWork.notify_all();
+        }
+        FOREACH(itworker, _vgraspworkers) {
+            (*itworker)->pthread->join();
+            (*itworker)->planner.reset();
+            (*itworker)->penv->Destroy();
+        }
+        _vgraspworkers.clear();
+        _graspjob.reset();
+        _bShutdownWorkers = false;
+    }
+
+    void _WorkerThread(GraspWorkerPtr worker, int iworker)
+    {
+        int lastjobid = 0;
+        while(1) {
+            GraspJobPtr job;
+            {
+                boost::mutex::scoped_lock lock(_mutexGrasp);
+                while(!job) {
+                    if( _bShutdownWorkers ) {
+                        return;
+                    }
+                    if( _nGraspJobId != lastjobid ) {
+                        lastjobid = _nGraspJobId;
+                        // only the first numthreads workers are used
+                        if( !!_graspjob && iworker < _graspjob->numthreads ) {
+                            job = _graspjob;
+                            break;
+                        }
+                    }
+                    _condGraspHasWork.wait(lock);
+                }
+            }
+
+            try {
+                _RunGraspJob(worker, job);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN(str(boost::format("grasp worker %d failed: %s")%iworker%ex.what()));
+            }
+
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            job->numrunning--;
+            _condGraspResults.notify_all();
+        }
+    }
+
+    void _RunGraspJob(GraspWorkerPtr worker, GraspJobPtr job)
     {
-        // clone environment
-        EnvironmentBasePtr pcloneenv = penv->CloneSelf(Clone_Bodies|Clone_Simulation);
+        const WorkerParametersPtr worker_params = job->worker_params;
+        EnvironmentBasePtr pcloneenv = worker->penv;
         {
             EnvironmentMutex::scoped_lock lock(pcloneenv->GetMutex());
             boost::shared_ptr<CollisionCheckerMngr> pcheckermngr(new CollisionCheckerMngr(pcloneenv, worker_params->collisionchecker));
-            PlannerBasePtr planner = RaveCreatePlanner(pcloneenv,"Grasper");
+            if( !worker->planner ) {
+                worker->planner = RaveCreatePlanner(pcloneenv,"Grasper");
+            }
+            PlannerBasePtr planner = worker->planner;
             RobotBasePtr probot = pcloneenv->GetRobot(_robot->GetName());
             string strsavetraj;
 
@@ -884,24 +1153,18 @@ public:
             vector<dReal> vtrajpoint;
 
             // use CO_ActiveDOFs since might be calling FindIKSolution
-            int coloptions = GetEnv()->GetCollisionChecker()->GetCollisionOptions()|(worker_params->bCheckGraspIK ? CO_ActiveDOFs : 0);
+            int coloptions = worker_params->collisionoptions|(worker_params->bCheckGraspIK ? CO_ActiveDOFs : 0);
             coloptions &= ~CO_Contacts;
             pcloneenv->GetCollisionChecker()->SetCollisionOptions(coloptions|CO_Contacts);
 
-            while(_bContinueWorker) {
+            while(1) {
                 {
-                    // wait for work
+                    // take the next grasp
                     boost::mutex::scoped_lock lock(_mutexGrasp);
-                    if( !_graspParamsWork ) {
-                        _condGraspHasWork.wait(lock);
-                        // after signal
-                        if( !_graspParamsWork ) {
-                            continue;
-                        }
+                    if( job->bStop || job->nextid >= job->numgrasps || job->numresults >= job->maxgrasps ) {
+                        break;
                     }
-                    grasp_params = _graspParamsWork;
-                    _graspParamsWork.reset();
-                    _condGraspReceivedWork.notify_all();
+                    grasp_params = job->GetGraspParameters(job->nextid++);
                 }
 
                 RAVELOG_DEBUG(str(boost::format("grasp %d: start")%grasp_params->id));
@@ -1102,17 +1365,19 @@ public:
                 RAVELOG_DEBUG(str(boost::format("grasp %d: success")%grasp_params->id));
 
                 boost::mutex::scoped_lock lock(_mutexGrasp);
-                _listGraspResults.push_back(grasp_params);
+                job->listresults.push_back(grasp_params);
+                job->numresults++;
+                _condGraspResults.notify_all();
             }
         }
-        pcloneenv->Destroy();
     }
 
-    bool _bContinueWorker;
     boost::mutex _mutexGrasp;
-    GraspParametersThreadPtr _graspParamsWork;
-    list<GraspParametersThreadPtr> _listGraspResults;
-    boost::condition _condGraspHasWork, _condGraspReceivedWork;
+    GraspJobPtr _graspjob; ///< the current job of the workers
+    int _nGraspJobId; ///< incremented every time a new job is started
+    bool _bShutdownWorkers;
+    std::vector<GraspWorkerPtr> _vgraspworkers;
+    boost::condition _condGraspHasWork, _condGraspResults;
 
 protected:
     void _ComputeJointMaxLengths(vector<dReal>& vjointlengths)
@@ -1369,26 +1634,38 @@ protected:
 
     // computes a distance map. For every point, samples many vectors around the point's normal such that angle
     // between normal and sampled vector doesn't exceeed fTheta. Returns the minimum distance.
-    // vpoints needs to already be initialized
-    void _ComputeDistanceMap(vector<CollisionReport::CONTACT>& vpoints, dReal fTheta)
+    // vpoints needs to already be initialized, only the points in [istart,iend) are computed.
+    // All rays of the range are checked with one batched call to the collision checker of penv.
+    void _ComputeDistanceMap(EnvironmentBasePtr penv, SpaceSamplerBasePtr psampler, vector<CollisionReport::CONTACT>& vpoints, size_t istart, size_t iend, dReal fTheta)
     {
-        dReal fCosTheta = RaveCos(fTheta);
-        int N;
-        if(fTheta < 0.01f) {
-            N = 1;
+        if( istart >= iend ) {
+            return;
         }
-        RAY r;
-
-        GetEnv()->GetCollisionChecker()->SetCollisionOptions(CO_Distance);
-
+        dReal fCosTheta = RaveCos(fTheta);
         // set number of rays to randomly sample
+        int N;
         if( fTheta < 0.01f ) {
             N = 1;
         }
         else {
             N = (int)ceil(fTheta * (64.0f/(PI/12.0f)));     // sample 64 points when at pi/12
         }
-        for(int i = 0; i < (int)vpoints.size(); ++i) {
+
+        std::vector<dReal> vsamples;
+        if( !!psampler ) {
+            psampler->SampleSequence(vsamples, 2*N*(iend-istart), IT_Closed);
+        }
+        else {
+            vsamples.resize(2*N*(iend-istart));
+            FOREACH(it,vsamples) {
+                *it = RaveRandomFloat();
+            }
+        }
+
+        std::vector<RAY> vrays(N*(iend-istart));
+        std::vector<RAY>::iterator itray = vrays.begin();
+        std::vector<dReal>::const_iterator itsample = vsamples.begin();
+        for(size_t i = istart; i < iend; ++i) {
             Vector vright = Vector(1,0,0);
             if( RaveFabs(vpoints[i].norm.x) > 0.9 ) {
                 vright.y = 1;
@@ -1396,27 +1673,48 @@ protected:
             vright -= vpoints[i].norm * vright.dot3(vpoints[i].norm);
             vright.normalize3();
             Vector vup = vpoints[i].norm.cross(vright);
-
-            dReal fMinDist = 2;
-            for(int j = 0; j < N; ++j) {
+            for(int j = 0; j < N; ++j, ++itray) {
                 // sample around a cone
-                dReal fAng = fCosTheta + (1-fCosTheta)*RaveRandomFloat();
+                dReal fAng = fCosTheta + (1-fCosTheta)*(*itsample++);
                 dReal R = RaveSqrt(1 - fAng * fAng);
-                dReal U2 = 2 * PI * RaveRandomFloat();
-                r.dir = 1000.0f*(fAng * vpoints[i].norm + R * RaveCos(U2) * vright + R * RaveSin(U2) * vup);
-
-                r.pos = vpoints[i].pos;
+                dReal U2 = 2 * PI * (*itsample++);
+                itray->dir = 1000.0f*(fAng * vpoints[i].norm + R * RaveCos(U2) * vright + R * RaveSin(U2) * vup);
+                itray->pos = vpoints[i].pos;
+            }
+        }
 
-                if( GetEnv()->CheckCollision(r, _report) ) {
-                    if( _report->minDistance < fMinDist )
-                        fMinDist = _report->minDistance;
+        std::vector<dReal> vhitdistances;
+        std::vector<KinBody::LinkConstPtr> vhitlinks;
+        std::vector<CollisionReport::CONTACT> vhitcontacts;
+        penv->GetCollisionChecker()->CheckCollisionRays(vrays, KinBodyConstPtr(), vhitdistances, vhitlinks, vhitcontacts);
+        std::vector<dReal>::const_iterator itdist = vhitdistances.begin();
+        for(size_t i = istart; i < iend; ++i) {
+            dReal fMinDist = 2;
+            for(int j = 0; j < N; ++j, ++itdist) {
+                if( *itdist >= 0 && *itdist < fMinDist ) {
+                    fMinDist = *itdist;
                 }
             }
-
             vpoints[i].depth = fMinDist;
         }
+    }
 
-        GetEnv()->GetCollisionChecker()->SetCollisionOptions(0);
+    /// \brief computes the distance map of chunks of vpoints in a cloned environment until all points are processed
+    void _DistanceMapThread(EnvironmentBasePtr pcloneenv, SpaceSamplerBasePtr psampler, vector<CollisionReport::CONTACT>& vpoints, dReal fTheta, size_t& nextpoint, boost::mutex& mutexpoint)
+    {
+        while(1) {
+            size_t istart;
+            {
+                boost::mutex::scoped_lock lock(mutexpoint);
+                istart = nextpoint;
+                nextpoint += s_nDistanceMapChunk;
+            }
+            if( istart >= vpoints.size() ) {
+                break;
+            }
+            EnvironmentMutex::scoped_lock lock(pcloneenv->GetMutex());
+            _ComputeDistanceMap(pcloneenv, psampler, vpoints, istart, min(vpoints.size(), istart+s_nDistanceMapChunk), fTheta);
+        }
     }
 
     void _GetStableContacts(vector< pair<CollisionReport::CONTACT,int> >& contacts, const Vector& direction, dReal mu)
@@ -1671,6 +1969,8 @@ protected:
 #endif
     }
 
+    static const size_t s_nDistanceMapChunk = 1024; ///< number of points a distance map thread processes at a time
+
     PlannerBasePtr _planner;
     RobotBasePtr _robot;
     CollisionReportPtr _report;
@@ -69,6 +69,8 @@
 
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/lu.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "next_combination.h"
 
@@ -315,6 +317,19 @@ public:
                         "return the set of time measurements made in nano-seconds");
         RegisterCommand("IKTest",boost::bind(&IkFastModule::IKtest,this,_1,_2),
                         "Tests for an IK solution if active manipulation has an IK solver attached");
+        RegisterCommand("ComputeReachability",boost::bind(&IkFastModule::ComputeReachability,this,_1,_2),
+                        "Computes the 6D reachability of a manipulator by sampling end effector poses on a voxel grid and solving IK at every pose. The work is split across threads, each using its own cloned environment. The robot should already be set so that the manipulator base is at the origin. Input parameters are:\n\n\
+* string robot - name of the robot.\n\n\
+* string manipname - name of the manipulator, default is the active manipulator.\n\n\
+* float maxradius - max radius of the sampled sphere.\n\n\
+* float xyzdelta - discretization of the voxel grid (default is 0.04).\n\n\
+* float3 baseanchor - center of the sampled sphere.\n\n\
+* int N, float4*N rotations - quaternions to test at every voxel.\n\n\
+* int usefreespace - if true, will record the number of IK solutions at every pose instead of finding one (default is 0).\n\n\
+* int ikfilteroptions - filter options passed to FindIKSolution(s) (default is 0).\n\n\
+* int numthreads - number of worker threads (default is 1).\n\n\
+* string filename - binary file to write the results to.\n\n"
+                        "The file contains: int32 version, int32 shape[3], float64 pointscale[2], float64 xyzdelta, float64 density[prod(shape)], float64 reachability[prod(shape)], int32 numstats, float64 stats[numstats][8], where each stats row is the quaternion, translation, and number of IK solutions. Returns numstats.");
         RegisterCommand("DebugIK",boost::bind(&IkFastModule::DebugIK,this,_1,_2),
                         "Function used for debugging and testing an IK solver. Input parameters are:\n\n\
 * string readfile - file containing joint values to read, starts with number of entries.\n\n\
@@ -780,6 +795,289 @@ public:
         }
     }
 
+    /// \brief shared state of the ComputeReachability worker threads
+    struct ReachabilityWork
+    {
+        ReachabilityWork() : bUseFreeSpace(false), ikfilteroptions(0), nextindex(0), numprocessed(0), bFailed(false) {
+        }
+
+        /// \brief stops all workers and records why, called by a worker that cannot continue
+        void SetFailed(const std::string& error)
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if( !bFailed ) {
+                bFailed = true;
+                errormsg = error;
+            }
+            nextindex = vpoints.size();
+        }
+
+        string robotname, manipname;
+        bool bUseFreeSpace;
+        int ikfilteroptions;
+        std::vector<Vector> vrotations; ///< quaternions to test at every point
+        std::vector<Vector> vpoints; ///< end effector positions to test, one for every inside voxel
+        std::vector<dReal> vdensity, vreachability; ///< results for every entry in vpoints
+        std::vector< std::vector<dReal> > vstats; ///< for every entry in vpoints, the flattened (quat,trans,numsolutions) of each reachable pose
+
+        boost::mutex mutex;
+        size_t nextindex; ///< next entry in vpoints to hand out, protected by mutex
+        size_t numprocessed; ///< protected by mutex
+        bool bFailed; ///< true if a worker failed, protected by mutex
+        std::string errormsg; ///< protected by mutex
+    };
+    typedef boost::shared_ptr<ReachabilityWork> ReachabilityWorkPtr;
+
+    bool ComputeReachability(ostream& sout, istream& sinput)
+    {
+        ReachabilityWorkPtr work(new ReachabilityWork());
+        dReal maxradius = 0, xyzdelta = 0.04;
+        Vector baseanchor;
+        int numthreads = 1;
+        string filename, cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            if( cmd == "robot" ) {
+                sinput >> work->robotname;
+            }
+            else if( cmd == "manipname" ) {
+                sinput >> work->manipname;
+            }
+            else if( cmd == "maxradius" ) {
+                sinput >> maxradius;
+            }
+            else if( cmd == "xyzdelta" ) {
+                sinput >> xyzdelta;
+            }
+            else if( cmd == "baseanchor" ) {
+                sinput >> baseanchor.x >> baseanchor.y >> baseanchor.z;
+            }
+            else if( cmd == "rotations" ) {
+                int numrotations = 0;
+                sinput >> numrotations;
+                work->vrotations.resize(numrotations);
+                FOREACH(it,work->vrotations) {
+                    sinput >> it->x >> it->y >> it->z >> it->w;
+                }
+            }
+            else if( cmd == "usefreespace" ) {
+                sinput >> work->bUseFreeSpace;
+            }
+            else if( cmd == "ikfilteroptions" ) {
+                sinput >> work->ikfilteroptions;
+            }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "filename" ) {
+                sinput >> filename;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+
+        if( maxradius <= 0 || xyzdelta <= 0 || work->vrotations.size() == 0 || filename.size() == 0 ) {
+            RAVELOG_WARN("ComputeReachability needs maxradius, xyzdelta, rotations, and filename\n");
+            return false;
+        }
+        numthreads = max(1,numthreads);
+
+        // voxel grid has the same layout as numpy.mgrid[-nsteps:nsteps,-nsteps:nsteps,-nsteps:nsteps]
+        int nsteps = (int)floor(maxradius/xyzdelta);
+        int width = 2*nsteps;
+        std::vector<int> vinsideindices;
+        for(int ix = 0; ix < width; ++ix) {
+            for(int iy = 0; iy < width; ++iy) {
+                for(int iz = 0; iz < width; ++iz) {
+                    Vector v((ix-nsteps)*xyzdelta, (iy-nsteps)*xyzdelta, (iz-nsteps)*xyzdelta);
+                    if( v.lengthsqr3() < maxradius*maxradius ) {
+                        vinsideindices.push_back((ix*width+iy)*width+iz);
+                        work->vpoints.push_back(v+baseanchor);
+                    }
+                }
+            }
+        }
+        work->vdensity.resize(work->vpoints.size(),0);
+        work->vreachability.resize(work->vpoints.size(),0);
+        work->vstats.resize(work->vpoints.size());
+        RAVELOG_INFO(str(boost::format("radius: %f, xyzsamples: %d, rot samples: %d, freespace: %d, threads: %d")%maxradius%work->vpoints.size()%work->vrotations.size()%work->bUseFreeSpace%numthreads));
+
+        // clone all environments first so the workers never touch the original
+        std::vector<EnvironmentBasePtr> vcloneenvs(numthreads);
+        {
+            EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+            RobotBasePtr probot = GetEnv()->GetRobot(work->robotname);
+            if( !probot ) {
+                RAVELOG_WARN(str(boost::format("could not find robot %s\n")%work->robotname));
+                return false;
+            }
+            if( work->manipname.size() == 0 ) {
+                if( !probot->GetActiveManipulator() ) {
+                    return false;
+                }
+                work->manipname = probot->GetActiveManipulator()->GetName();
+            }
+            RobotBase::ManipulatorPtr pmanip = probot->GetManipulator(work->manipname);
+            if( !pmanip ) {
+                RAVELOG_WARN(str(boost::format("could not find manipulator %s\n")%work->manipname));
+                return false;
+            }
+            if( !pmanip->GetIkSolver() ) {
+                RAVELOG_WARN(str(boost::format("no ik solver set on manipulator %s\n")%work->manipname));
+                return false;
+            }
+            FOREACH(itenv,vcloneenvs) {
+                *itenv = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+        }
+
+        uint32_t starttime = utils::GetMilliTime();
+        std::vector<boost::shared_ptr<boost::thread> > vthreads(numthreads);
+        for(size_t i = 0; i < vthreads.size(); ++i) {
+            vthreads[i].reset(new boost::thread(boost::bind(&IkFastModule::_ReachabilityWorkerThread,this,work,vcloneenvs[i])));
+        }
+        FOREACH(itthread,vthreads) {
+            (*itthread)->join();
+        }
+        vthreads.clear();
+        FOREACH(itenv,vcloneenvs) {
+            (*itenv)->Destroy();
+        }
+        if( work->bFailed ) {
+            RAVELOG_WARN(str(boost::format("ComputeReachability failed: %s\n")%work->errormsg));
+            return false;
+        }
+        RAVELOG_INFO(str(boost::format("reachability finished in %fs")%(0.001*(utils::GetMilliTime()-starttime))));
+
+        // gather in the order of the voxels so that the results are independent of the thread scheduling
+        std::vector<double> vdensity3d(width*width*width,0), vreachability3d(width*width*width,0);
+        int32_t numstats = 0;
+        for(size_t i = 0; i < vinsideindices.size(); ++i) {
+            vdensity3d[vinsideindices[i]] = work->vdensity[i];
+            vreachability3d[vinsideindices[i]] = work->vreachability[i];
+            numstats += work->vstats[i].size()/8;
+        }
+
+        ofstream f(filename.c_str(), ios_base::out|ios_base::binary|ios_base::trunc);
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to open %s for writing\n")%filename));
+            return false;
+        }
+        int32_t version = 1, shape[3] = { width, width, width};
+        double pointscale[2] = { 1.0/xyzdelta, (double)nsteps}, fxyzdelta = xyzdelta;
+        f.write((const char*)&version, sizeof(version));
+        f.write((const char*)shape, sizeof(shape));
+        f.write((const char*)pointscale, sizeof(pointscale));
+        f.write((const char*)&fxyzdelta, sizeof(fxyzdelta));
+        f.write((const char*)&vdensity3d[0], vdensity3d.size()*sizeof(double));
+        f.write((const char*)&vreachability3d[0], vreachability3d.size()*sizeof(double));
+        f.write((const char*)&numstats, sizeof(numstats));
+        std::vector<double> vrow;
+        FOREACHC(itstats, work->vstats) {
+            if( itstats->size() > 0 ) {
+                vrow.resize(itstats->size());
+                std::copy(itstats->begin(),itstats->end(),vrow.begin());
+                f.write((const char*)&vrow[0], vrow.size()*sizeof(double));
+            }
+        }
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to write %s\n")%filename));
+            return false;
+        }
+        sout << numstats;
+        return true;
+    }
+
+    void _ReachabilityWorkerThread(ReachabilityWorkPtr work, EnvironmentBasePtr penv)
+    {
+        try {
+            _ComputeReachabilityWork(work, penv);
+        }
+        catch(const std::exception& ex) {
+            work->SetFailed(ex.what());
+        }
+    }
+
+    void _ComputeReachabilityWork(ReachabilityWorkPtr work, EnvironmentBasePtr penv)
+    {
+        const size_t chunksize = 16; // small enough to balance the load, large enough to not contend on the mutex
+        EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+        RobotBasePtr probot = penv->GetRobot(work->robotname);
+        if( !probot ) {
+            work->SetFailed(str(boost::format("could not find robot %s in the cloned environment")%work->robotname));
+            return;
+        }
+        RobotBase::ManipulatorPtr pmanip = probot->GetManipulator(work->manipname);
+        if( !pmanip ) {
+            work->SetFailed(str(boost::format("could not find manipulator %s in the cloned environment")%work->manipname));
+            return;
+        }
+        probot->SetActiveManipulator(pmanip);
+        if( !pmanip->GetIkSolver() ) {
+            work->SetFailed(str(boost::format("no ik solver set on manipulator %s in the cloned environment")%pmanip->GetName()));
+            return;
+        }
+        std::vector<dReal> vsolution;
+        std::vector< std::vector<dReal> > vsolutions;
+        Transform t;
+        while(1) {
+            size_t startindex, endindex;
+            {
+                boost::mutex::scoped_lock worklock(work->mutex);
+                if( work->nextindex >= work->vpoints.size() ) {
+                    break;
+                }
+                startindex = work->nextindex;
+                endindex = min(startindex+chunksize, work->vpoints.size());
+                work->nextindex = endindex;
+            }
+            for(size_t index = startindex; index < endindex; ++index) {
+                int numvalid = 0, numrotvalid = 0;
+                std::vector<dReal>& vstats = work->vstats[index];
+                t.trans = work->vpoints[index];
+                FOREACHC(itrot, work->vrotations) {
+                    t.rot = *itrot;
+                    int numsolutions = 0;
+                    if( work->bUseFreeSpace ) {
+                        if( pmanip->FindIKSolutions(IkParameterization(t), vsolutions, work->ikfilteroptions) ) {
+                            numsolutions = (int)vsolutions.size();
+                        }
+                    }
+                    else if( pmanip->FindIKSolution(IkParameterization(t), vsolution, work->ikfilteroptions) ) {
+                        numsolutions = 1;
+                    }
+                    if( numsolutions > 0 ) {
+                        vstats.push_back(t.rot.x); vstats.push_back(t.rot.y); vstats.push_back(t.rot.z); vstats.push_back(t.rot.w);
+                        vstats.push_back(t.trans.x); vstats.push_back(t.trans.y); vstats.push_back(t.trans.z);
+                        vstats.push_back(numsolutions);
+                        numvalid += numsolutions;
+                        numrotvalid += 1;
+                    }
+                }
+                work->vdensity[index] = numvalid/dReal(work->vrotations.size());
+                work->vreachability[index] = numrotvalid/dReal(work->vrotations.size());
+            }
+            boost::mutex::scoped_lock worklock(work->mutex);
+            size_t prevprocessed = work->numprocessed;
+            work->numprocessed += endindex-startindex;
+            if( prevprocessed/1000 != work->numprocessed/1000 ) {
+                RAVELOG_INFO(str(boost::format("%d/%d")%work->numprocessed%work->vpoints.size()));
+            }
+        }
+    }
+
     bool DebugIK(ostream& sout, istream& sinput)
     {
         using namespace boost::numeric;
@@ -115,9 +115,14 @@ public:
         geomray = NULL;
         _nMaxStartContacts = 32;
         _nMaxContacts = 255;     // this is a weird ODE threshold for the new tri-tri collision checker
+        _bSelfCollisionCache = false;
         __description = ":Interface Author: Rosen Diankov\n\nOpen Dynamics Engine collision checker (fast, but inaccurate for triangle meshes)";
         RegisterCommand("SetMaxContacts",boost::bind(&ODECollisionChecker::_SetMaxContactsCommand, this,_1,_2),
                         str(boost::format("sets the maximum contacts that can be returned by the checker (limit is %d)")%_nMaxContacts));
+        RegisterCommand("SetSelfCollisionCache",boost::bind(&ODECollisionChecker::_SetSelfCollisionCacheCommand, this,_1,_2),
+                        "If 1, self-collision checks skip the link pairs that were collision free and whose relative transform has not changed since. Off by default.");
+        RegisterCommand("GetSelfCollisionCacheStatistics",boost::bind(&ODECollisionChecker::_GetSelfCollisionCacheStatisticsCommand, this,_1,_2),
+                        "Given a body name, returns the number of checked self-collision pairs, skipped pairs, and currently cached pairs. If followed by 1, resets the counters.");
 #ifndef ODE_USE_MULTITHREAD
         if( !_bnotifiedmessage ) {
             RAVELOG_DEBUG("ode will be slow in multi-threaded environments\n");
@@ -662,7 +667,87 @@ public:
         return cb._bOneCollision;
     }
 
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, KinBodyConstPtr pbody, std::vector<OpenRAVE::dReal>& vhitdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks, std::vector<CollisionReport::CONTACT>& vhitcontacts)
+    {
+        vhitdistances.resize(vrays.size());
+        vhitlinks.resize(vrays.size());
+        vhitcontacts.resize(vrays.size());
+        std::fill(vhitdistances.begin(),vhitdistances.end(),OpenRAVE::dReal(-1));
+        FOREACH(itlink,vhitlinks) {
+            itlink->reset();
+        }
+        std::fill(vhitcontacts.begin(),vhitcontacts.end(),CollisionReport::CONTACT());
+        if( vrays.size() == 0 ) {
+            return 0;
+        }
+        if( !!pbody && (( pbody->GetLinks().size() == 0) || !pbody->IsEnabled()) ) {
+            return 0;
+        }
+
+        // the ray callback always fills the distance, so one report and one callback structure can be shared by all the rays
+        CollisionReportPtr report(new CollisionReport());
+        COLLISIONCALLBACK cb(shared_checker(),report,pbody,KinBody::LinkConstPtr());
+
+#ifndef ODE_USE_MULTITHREAD
+        boost::mutex::scoped_lock lock(_mutexode);
+#endif
+        _odespace->Synchronize();
+        dGeomID geomspace = !pbody ? (dGeomID)_odespace->GetSpace() : (dGeomID)_odespace->GetBodySpace(pbody);
+        dGeomRaySetClosestHit(geomray, !(_options&OpenRAVE::CO_RayAnyHit));
+        dGeomRaySetParams(geomray,0,0);
+        int nhits = 0;
+        for(size_t i = 0; i < vrays.size(); ++i) {
+            const RAY& ray = vrays[i];
+            cb.fraymaxdist = OpenRAVE::RaveSqrt(ray.dir.lengthsqr3());
+            if( cb.fraymaxdist <= 0 ) {
+                continue;
+            }
+            Vector vnormdir = ray.dir*(1/cb.fraymaxdist);
+            dGeomRaySet(geomray, ray.pos.x, ray.pos.y, ray.pos.z, vnormdir.x, vnormdir.y, vnormdir.z);
+            dGeomRaySetLength(geomray,cb.fraymaxdist);
+            cb._bCollision = false;
+            cb._bOneCollision = false;
+            report->Reset(_options);
+            dSpaceCollide2(geomspace, geomray, &cb, RayCollisionCallback);
+            if( cb._bOneCollision ) {
+                vhitdistances[i] = report->minDistance;
+                vhitlinks[i] = report->plink1;
+                if( report->contacts.size() > 0 ) {
+                    vhitcontacts[i] = report->contacts[0];
+                }
+                ++nhits;
+            }
+        }
+        return nhits;
+    }
+
     virtual bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report)
+    {
+        return _CheckStandaloneSelfCollision(pbody, KinBody::LinkConstPtr(), report);
+    }
+
+    virtual bool CheckStandaloneSelfCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report)
+    {
+        return _CheckStandaloneSelfCollision(plink->GetParent(), plink, report);
+    }
+
+    void SetGeometryGroup(const std::string& groupname)
+    {
+        _odespace->SetGeometryGroup(groupname);
+    }
+
+    const std::string& GetGeometryGroup()
+    {
+        return _odespace->GetGeometryGroup();
+    }
+
+private:
+    /// \brief checks the non-adjacent link pairs of pbody. If plink is set, only the pairs containing plink are checked.
+    ///
+    /// If the self-collision cache is enabled, pairs that were collision free the last time they were checked are skipped
+    /// as long as their relative transform did not change. When only the last joints of a chain move, this skips all the pairs
+    /// upstream of the moved joints.
+    bool _CheckStandaloneSelfCollision(KinBodyConstPtr pbody, KinBody::LinkConstPtr plink, CollisionReportPtr report)
     {
         if( _options & OpenRAVE::CO_Distance ) {
             RAVELOG_WARN("ode doesn't support CO_Distance\n");
@@ -686,9 +771,31 @@ public:
         boost::mutex::scoped_lock lock(_mutexode);
 #endif
         _odespace->Synchronize(); // call after GetNonAdjacentLinks since it can modify the body, even though it is const!
+
+        // collision callbacks can ignore collisions depending on outside state, so cannot trust the cache when they are present
+        ODESpace::KinBodyInfoPtr pinfo;
+        if( _bSelfCollisionCache && !GetEnv()->HasRegisteredCollisionCallbacks() ) {
+            pinfo = _odespace->GetInfo(pbody);
+        }
+        Transform trel;
         FOREACHC(itset, nonadjacent) {
             KinBody::LinkConstPtr plink1(pbody->GetLinks().at(*itset&0xffff)), plink2(pbody->GetLinks().at(*itset>>16));
+            if( !!plink && plink != plink1 && plink != plink2 ) {
+                continue;
+            }
+            if( !!pinfo ) {
+                trel = plink1->GetTransform().inverse() * plink2->GetTransform();
+                std::map<int, Transform>::const_iterator itfree = pinfo->_mapselfcollisionfree.find(*itset);
+                if( itfree != pinfo->_mapselfcollisionfree.end() && _IsSameRelativeTransform(itfree->second, trel) ) {
+                    ++pinfo->nSelfPairsSkipped;
+                    continue;
+                }
+                ++pinfo->nSelfPairsChecked;
+            }
             if( _CheckCollision(plink1,plink2, report) ) {
+                if( !!pinfo ) {
+                    pinfo->_mapselfcollisionfree.erase(*itset);
+                }
                 if( IS_DEBUGLEVEL(OpenRAVE::Level_Verbose) ) {
                     RAVELOG_VERBOSE(str(boost::format("selfcol %s, Links %s %s are colliding\n")%pbody->GetName()%plink1->GetName()%plink2->GetName()));
                     std::vector<OpenRAVE::dReal> v;
@@ -707,70 +814,65 @@ public:
                 }
                 return true;
             }
+            if( !!pinfo ) {
+                pinfo->_mapselfcollisionfree[*itset] = trel;
+            }
         }
         return false;
     }
 
-    virtual bool CheckStandaloneSelfCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report)
+    /// \brief true if the two relative link transforms are equal up to round-off
+    static bool _IsSameRelativeTransform(const Transform& t0, const Transform& t1)
     {
-        if( _options & OpenRAVE::CO_Distance ) {
-            RAVELOG_WARN("ode doesn't support CO_Distance\n");
-            return false;
-        }
-        if( !!report ) {
-            report->Reset(_options);
-        }
-        KinBodyPtr pbody = plink->GetParent();
-        if( pbody->GetLinks().size() <= 1 ) {
+        const OpenRAVE::dReal feps = 1e-10;
+        if( (t0.trans-t1.trans).lengthsqr3() > feps*feps ) {
             return false;
         }
+        // q and -q are the same rotation
+        return (t0.rot-t1.rot).lengthsqr4() <= feps*feps || (t0.rot+t1.rot).lengthsqr4() <= feps*feps;
+    }
 
-        int adjacentoptions = KinBody::AO_Enabled;
-        if( (_options&OpenRAVE::CO_ActiveDOFs) && pbody->IsRobot() ) {
-            adjacentoptions |= KinBody::AO_ActiveDOFs;
+    bool _SetSelfCollisionCacheCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _bSelfCollisionCache;
+        if( !sinput ) {
+            return false;
         }
-
-        const std::set<int>& nonadjacent = pbody->GetNonAdjacentLinks(adjacentoptions);
-
-#ifndef ODE_USE_MULTITHREAD
-        boost::mutex::scoped_lock lock(_mutexode);
-#endif
-        _odespace->Synchronize(); // call after GetNonAdjacentLinks since it can modify the body, even though it is const!
-        FOREACHC(itset, nonadjacent) {
-            KinBody::LinkConstPtr plink1(pbody->GetLinks().at(*itset&0xffff)), plink2(pbody->GetLinks().at(*itset>>16));
-            if( plink == plink1 || plink == plink2 ) {
-                if( _CheckCollision(plink1,plink2, report) ) {
-                    if( IS_DEBUGLEVEL(OpenRAVE::Level_Verbose) ) {
-                        RAVELOG_VERBOSE(str(boost::format("selfcol %s, Links %s %s are colliding\n")%pbody->GetName()%plink1->GetName()%plink2->GetName()));
-                        std::vector<OpenRAVE::dReal> v;
-                        pbody->GetDOFValues(v);
-                        stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
-                        for(size_t i = 0; i < v.size(); ++i ) {
-                            if( i > 0 ) {
-                                ss << "," << v[i];
-                            }
-                            else {
-                                ss << "colvalues=[" << v[i];
-                            }
-                        }
-                        ss << "]";
-                        RAVELOG_VERBOSE(ss.str());
-                    }
-                    return true;
+        if( !_bSelfCollisionCache ) {
+            std::vector<KinBodyPtr> vbodies;
+            GetEnv()->GetBodies(vbodies);
+            FOREACH(itbody, vbodies) {
+                ODESpace::KinBodyInfoPtr pinfo = boost::dynamic_pointer_cast<ODESpace::KinBodyInfo>((*itbody)->GetUserData(_userdatakey));
+                if( !!pinfo ) {
+                    pinfo->_mapselfcollisionfree.clear();
                 }
             }
         }
-        return false;
-    }
-
-    void SetGeometryGroup(const std::string& groupname)
-    {
-        _odespace->SetGeometryGroup(groupname);
+        return true;
     }
 
-    const std::string& GetGeometryGroup()
+    bool _GetSelfCollisionCacheStatisticsCommand(ostream& sout, istream& sinput)
     {
-        return _odespace->GetGeometryGroup();
+        string bodyname;
+        sinput >> bodyname;
+        KinBodyPtr pbody = GetEnv()->GetKinBody(bodyname);
+        if( !pbody ) {
+            RAVELOG_WARN(str(boost::format("GetSelfCollisionCacheStatistics: failed to find body %s\n")%bodyname));
+            return false;
+        }
+        ODESpace::KinBodyInfoPtr pinfo = boost::dynamic_pointer_cast<ODESpace::KinBodyInfo>(pbody->GetUserData(_userdatakey));
+        if( !pinfo ) {
+            sout << "0 0 0";
+            return true;
+        }
+        sout << pinfo->nSelfPairsChecked << " " << pinfo->nSelfPairsSkipped << " " << pinfo->_mapselfcollisionfree.size();
+        bool bReset = false;
+        sinput >> bReset;
+        if( !!sinput && bReset ) {
+            pinfo->nSelfPairsChecked = 0;
+            pinfo->nSelfPairsSkipped = 0;
+        }
+        return true;
     }
 
 private:
@@ -1205,6 +1307,7 @@ private:
     boost::shared_ptr<ODESpace> _odespace;
     size_t _nMaxStartContacts, _nMaxContacts;
     std::string _userdatakey;
+    bool _bSelfCollisionCache; ///< if true, skip self-collision pairs that did not move relative to each other since they were last found collision free
 };
 
 #endif
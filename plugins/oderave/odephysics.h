@@ -216,6 +216,21 @@ The possible properties that can be set are: ";
         _surface_mode = 0;
         _surfacelayer = 0.001;
         _options = OpenRAVE::PEO_SelfCollisions;
+        _nIslandThreads = 1;
+#ifdef ODE_HAVE_STEP_THREADING
+        _threading = NULL;
+        _threadpool = NULL;
+#endif
+        _bCacheContacts = false;
+        _fContactCacheLinearTolerance = 1e-5;
+        _fContactCacheAngularTolerance = 1e-5;
+        _nStepStamp = 0;
+        RegisterCommand("SetIslandThreads",boost::bind(&ODEPhysicsEngine::_SetIslandThreadsCommand,this,_1,_2),
+                        "Sets the number of threads that ode steps the independent islands of the world with. 1 steps everything on the simulation thread. Requires ode to be compiled with threading support.");
+        RegisterCommand("SetContactCache",boost::bind(&ODEPhysicsEngine::_SetContactCacheCommand,this,_1,_2),
+                        "Enables (1) or disables (0) reusing the contacts of a pair of geometries from the previous step when neither geometry moved. Optionally followed by the distance and the angle in radians that a geometry can move and still be considered at rest.");
+        RegisterCommand("GetStepStatistics",boost::bind(&ODEPhysicsEngine::_GetStepStatisticsCommand,this,_1,_2),
+                        "Returns the number of steps, the mean and max step time, the mean collision time, the mean solver time (all in microseconds), the mean number of contacts per step, the number of contact cache hits and misses, and the mean time synchronizing the bodies with ode in microseconds. If followed by 1, resets the statistics.");
 
         memset(_jointadd, 0, sizeof(_jointadd));
         _jointadd[dJointTypeBall] = DummyAddForce;
@@ -235,9 +250,15 @@ The possible properties that can be set are: ";
         _jointgetvel[dJointTypeHinge2].push_back(dJointGetHinge2Angle2Rate);
     }
 
+    virtual ~ODEPhysicsEngine()
+    {
+        _DestroyIslandThreading();
+    }
+
     virtual bool InitEnvironment()
     {
         _report.reset(new CollisionReport());
+        _mapcachedcontacts.clear();
 
         _odespace->SetSynchronizationCallback(boost::bind(&ODEPhysicsEngine::_SyncCallback, shared_physics(),_1));
         if( !_odespace->InitEnvironment() ) {
@@ -257,6 +278,7 @@ The possible properties that can be set are: ";
         dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
         dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
         dWorldSetContactSurfaceLayer(_odespace->GetWorld(), _surfacelayer);
+        _SetIslandThreads(_nIslandThreads);
         return true;
     }
 
@@ -264,6 +286,8 @@ The possible properties that can be set are: ";
     {
         _listcallbacks.clear();
         _report.reset();
+        _mapcachedcontacts.clear();
+        _DestroyIslandThreading();
         _odespace->DestroyEnvironment();
         vector<KinBodyPtr> vbodies;
         GetEnv()->GetBodies(vbodies);
@@ -277,6 +301,8 @@ The possible properties that can be set are: ";
         ODESpace::KinBodyInfoPtr pinfo = boost::dynamic_pointer_cast<ODESpace::KinBodyInfo>(pbody->GetUserData("odephysics"));
         // need the pbody check since kinbodies can be cloned and could have the wrong pointer
         if( !pinfo || pinfo->GetBody() != pbody ) {
+            // the geometries are recreated, so the cached pairs could refer to freed ids
+            _mapcachedcontacts.clear();
             pinfo = _odespace->InitKinBody(pbody);
             pbody->SetUserData("odephysics", pinfo);
         }
@@ -286,6 +312,7 @@ The possible properties that can be set are: ";
     virtual void RemoveKinBody(KinBodyPtr pbody)
     {
         if( !!pbody ) {
+            _mapcachedcontacts.clear();
             pbody->RemoveUserData("odephysics");
         }
     }
@@ -318,11 +345,16 @@ The possible properties that can be set are: ";
         _globalerp = r->_globalerp;
         _surface_mode = r->_surface_mode;
         _num_iterations = r->_num_iterations;
+        _bCacheContacts = r->_bCacheContacts;
+        _fContactCacheLinearTolerance = r->_fContactCacheLinearTolerance;
+        _fContactCacheAngularTolerance = r->_fContactCacheAngularTolerance;
+        _mapcachedcontacts.clear();
         if( !!_odespace && _odespace->IsInitialized() ) {
             dWorldSetERP(_odespace->GetWorld(),_globalerp);
             dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
             dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
         }
+        _SetIslandThreads(r->_nIslandThreads);
     }
 
     virtual bool SetLinkVelocity(KinBody::LinkPtr plink, const Vector& _linearvel, const Vector& angularvel)
@@ -488,7 +520,11 @@ The possible properties that can be set are: ";
 
     virtual void SimulateStep(OpenRAVE::dReal fTimeElapsed)
     {
+        uint64_t starttime = OpenRAVE::utils::GetNanoPerformanceTime();
         _odespace->Synchronize();
+        uint64_t synctime = OpenRAVE::utils::GetNanoPerformanceTime();
+        _nStepStamp++;
+        _nStepContacts = 0;
 
         bool bHasCallbacks = GetEnv()->HasRegisteredCollisionCallbacks();
         if( bHasCallbacks ) {
@@ -512,8 +548,23 @@ The possible properties that can be set are: ";
             }
         }
 
+        if( _bCacheContacts ) {
+            // the pairs that did not collide in this step are not touching anymore
+            std::map<std::pair<dGeomID, dGeomID>, CachedContacts>::iterator itcached = _mapcachedcontacts.begin();
+            while(itcached != _mapcachedcontacts.end()) {
+                if( itcached->second.stamp != _nStepStamp ) {
+                    _mapcachedcontacts.erase(itcached++);
+                }
+                else {
+                    ++itcached;
+                }
+            }
+        }
+
+        uint64_t collidetime = OpenRAVE::utils::GetNanoPerformanceTime();
         dWorldQuickStep(_odespace->GetWorld(), fTimeElapsed);
         dJointGroupEmpty (_odespace->GetContactGroup());
+        uint64_t solvetime = OpenRAVE::utils::GetNanoPerformanceTime();
 
         // synchronize all the objects from the ODE world to the OpenRAVE world
         Transform t;
@@ -536,6 +587,15 @@ The possible properties that can be set are: ";
         }
 
         _listcallbacks.clear();
+
+        uint64_t endtime = OpenRAVE::utils::GetNanoPerformanceTime();
+        _stepstatistics.numsteps++;
+        _stepstatistics.totalsteptime += endtime-starttime;
+        _stepstatistics.maxsteptime = max(_stepstatistics.maxsteptime, endtime-starttime);
+        _stepstatistics.totalsynctime += synctime-starttime;
+        _stepstatistics.totalcollidetime += collidetime-synctime;
+        _stepstatistics.totalsolvetime += solvetime-collidetime;
+        _stepstatistics.numcontacts += _nStepContacts;
     }
 
 
@@ -594,10 +654,11 @@ private:
 
         const int N = 16;
         dContact contact[N];
-        int n = dCollide (o1,o2,N,&contact[0].geom,sizeof(dContact));
+        int n = _bCacheContacts ? _CollideCached(o1,o2,N,contact) : dCollide (o1,o2,N,&contact[0].geom,sizeof(dContact));
         if( n <= 0 ) {
             return;
         }
+        _nStepContacts += n;
 
         if( _listcallbacks.size() > 0 ) {
             // fill the collision report
@@ -659,8 +720,154 @@ private:
         //        dJointAttach (c,b1,b2);
     }
 
+    /// \brief runs the narrow phase on two geometries, reuses the contacts of the previous step if neither geometry moved
+    int _CollideCached(dGeomID o1, dGeomID o2, int maxcontacts, dContact* contacts)
+    {
+        dBodyID b1 = dGeomGetBody(o1), b2 = dGeomGetBody(o2);
+        if( !b1 || !b2 ) {
+            return dCollide(o1,o2,maxcontacts,&contacts[0].geom,sizeof(dContact));
+        }
+        std::pair<dGeomID, dGeomID> key = o1 < o2 ? std::make_pair(o1,o2) : std::make_pair(o2,o1);
+        std::map<std::pair<dGeomID, dGeomID>, CachedContacts>::iterator itcached = _mapcachedcontacts.find(key);
+        // the contacts are only valid for the same order of geometries since the normals point from o1 to o2
+        if( itcached != _mapcachedcontacts.end() && itcached->second.geom1 == o1 && itcached->second.body1 == b1 && itcached->second.body2 == b2 && _IsBodyAtPose(b1, itcached->second.pose1) && _IsBodyAtPose(b2, itcached->second.pose2) ) {
+            itcached->second.stamp = _nStepStamp;
+            std::copy(itcached->second.vcontacts.begin(), itcached->second.vcontacts.end(), contacts);
+            _stepstatistics.numcachehits++;
+            return (int)itcached->second.vcontacts.size();
+        }
+
+        int n = dCollide(o1,o2,maxcontacts,&contacts[0].geom,sizeof(dContact));
+        CachedContacts& cached = _mapcachedcontacts[key];
+        cached.geom1 = o1;
+        cached.body1 = b1;
+        cached.body2 = b2;
+        _GetBodyPose(b1, cached.pose1);
+        _GetBodyPose(b2, cached.pose2);
+        cached.vcontacts.resize(0);
+        if( n > 0 ) {
+            cached.vcontacts.insert(cached.vcontacts.end(), contacts, contacts+n);
+        }
+        cached.stamp = _nStepStamp;
+        _stepstatistics.numcachemisses++;
+        return n;
+    }
+
+    static void _GetBodyPose(dBodyID body, dReal* pose)
+    {
+        const dReal* ppos = dBodyGetPosition(body);
+        const dReal* pquat = dBodyGetQuaternion(body);
+        std::copy(ppos, ppos+3, pose);
+        std::copy(pquat, pquat+4, pose+3);
+    }
+
+    bool _IsBodyAtPose(dBodyID body, const dReal* pose) const
+    {
+        const dReal* ppos = dBodyGetPosition(body);
+        const dReal* pquat = dBodyGetQuaternion(body);
+        for(int i = 0; i < 3; ++i) {
+            if( RaveFabs(ppos[i]-pose[i]) > _fContactCacheLinearTolerance ) {
+                return false;
+            }
+        }
+        // q and -q are the same rotation, |dot| is the cosine of half the angle between the rotations
+        dReal fdot = RaveFabs(pquat[0]*pose[3]+pquat[1]*pose[4]+pquat[2]*pose[5]+pquat[3]*pose[6]);
+        return fdot >= OpenRAVE::RaveCos(0.5*_fContactCacheAngularTolerance);
+    }
+
+    void _SetIslandThreads(int numthreads)
+    {
+        _DestroyIslandThreading();
+        _nIslandThreads = max(1,numthreads);
+#ifdef ODE_HAVE_STEP_THREADING
+        if( _nIslandThreads > 1 && !!_odespace && _odespace->IsInitialized() ) {
+            _threading = dThreadingAllocateMultiThreadedImplementation();
+            _threadpool = dThreadingAllocateThreadPool(_nIslandThreads, 0, dAllocateFlagBasicData, NULL);
+            dThreadingThreadPoolServeMultiThreadedImplementation(_threadpool, _threading);
+            dWorldSetStepIslandsProcessingMaxThreadCount(_odespace->GetWorld(), _nIslandThreads);
+            dWorldSetStepThreadingImplementation(_odespace->GetWorld(), dThreadingImplementationGetFunctions(_threading), _threading);
+        }
+#else
+        if( _nIslandThreads > 1 ) {
+            RAVELOG_WARN("ode was not compiled with threading support, so the islands are stepped on one thread\n");
+        }
+#endif
+    }
+
+    void _DestroyIslandThreading()
+    {
+#ifdef ODE_HAVE_STEP_THREADING
+        if( _threading != NULL ) {
+            dThreadingImplementationShutdownProcessing(_threading);
+            dThreadingFreeThreadPool(_threadpool);
+            if( !!_odespace && _odespace->IsInitialized() ) {
+                dWorldSetStepThreadingImplementation(_odespace->GetWorld(), NULL, NULL);
+            }
+            dThreadingFreeImplementation(_threading);
+            _threading = NULL;
+            _threadpool = NULL;
+        }
+#endif
+    }
+
+    bool _SetIslandThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput ) {
+            return false;
+        }
+        _SetIslandThreads(numthreads);
+        return true;
+    }
+
+    bool _SetContactCacheCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _bCacheContacts;
+        if( !sinput ) {
+            return false;
+        }
+        dReal flinear = 0, fangular = 0;
+        sinput >> flinear >> fangular;
+        if( !!sinput ) {
+            _fContactCacheLinearTolerance = flinear;
+            _fContactCacheAngularTolerance = fangular;
+        }
+        _mapcachedcontacts.clear();
+        return true;
+    }
+
+    bool _GetStepStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        const StepStatistics& stats = _stepstatistics;
+        dReal fnumsteps = stats.numsteps > 0 ? (dReal)stats.numsteps : 1;
+        sout << stats.numsteps << " " << 0.001*stats.totalsteptime/fnumsteps << " " << 0.001*stats.maxsteptime << " " << 0.001*stats.totalcollidetime/fnumsteps << " " << 0.001*stats.totalsolvetime/fnumsteps << " " << stats.numcontacts/fnumsteps << " " << stats.numcachehits << " " << stats.numcachemisses << " " << 0.001*stats.totalsynctime/fnumsteps;
+        bool bReset = false;
+        sinput >> bReset;
+        if( !!sinput && bReset ) {
+            _stepstatistics = StepStatistics();
+        }
+        return true;
+    }
+
     void _SyncCallback(ODESpace::KinBodyInfoConstPtr pinfo)
     {
+        if( _mapcachedcontacts.size() > 0 ) {
+            // the body was moved or reset outside of the physics, so its contacts have to be recomputed
+            std::set<dBodyID> setbodies;
+            FOREACHC(itlink, pinfo->vlinks) {
+                setbodies.insert((*itlink)->body);
+            }
+            std::map<std::pair<dGeomID, dGeomID>, CachedContacts>::iterator itcached = _mapcachedcontacts.begin();
+            while(itcached != _mapcachedcontacts.end()) {
+                if( setbodies.find(itcached->second.body1) != setbodies.end() || setbodies.find(itcached->second.body2) != setbodies.end() ) {
+                    _mapcachedcontacts.erase(itcached++);
+                }
+                else {
+                    ++itcached;
+                }
+            }
+        }
         // things very difficult when dynamics are not reset
 //        FOREACHC(itlink, pinfo->vlinks) {
 //            if( (*itlink)->body != NULL ) {
@@ -698,6 +905,38 @@ private:
     vector<JointGetFn> _jointgetvel[12];
     std::list<EnvironmentBase::CollisionCallbackFn> _listcallbacks;
     CollisionReportPtr _report;
+
+    /// \brief the contacts of a pair of geometries computed in a previous step
+    struct CachedContacts
+    {
+        dGeomID geom1; ///< the first geometry passed to dCollide
+        dBodyID body1, body2;
+        dReal pose1[7], pose2[7]; ///< position and quaternion of the bodies when the contacts were computed
+        std::vector<dContact> vcontacts;
+        int stamp; ///< the last step the pair was in contact
+    };
+
+    struct StepStatistics
+    {
+        StepStatistics() : numsteps(0), totalsteptime(0), maxsteptime(0), totalsynctime(0), totalcollidetime(0), totalsolvetime(0), numcontacts(0), numcachehits(0), numcachemisses(0) {
+        }
+        uint64_t numsteps;
+        uint64_t totalsteptime, maxsteptime, totalsynctime, totalcollidetime, totalsolvetime; ///< in nanoseconds
+        uint64_t numcontacts;
+        uint64_t numcachehits, numcachemisses;
+    };
+
+    int _nIslandThreads; ///< number of threads ode steps the islands with
+#ifdef ODE_HAVE_STEP_THREADING
+    dThreadingImplementationID _threading;
+    dThreadingThreadPoolID _threadpool;
+#endif
+    bool _bCacheContacts; ///< if true, reuse the contacts of geometries that did not move
+    dReal _fContactCacheLinearTolerance, _fContactCacheAngularTolerance;
+    std::map<std::pair<dGeomID, dGeomID>, CachedContacts> _mapcachedcontacts;
+    int _nStepStamp; ///< incremented every step
+    int _nStepContacts; ///< number of contacts created in the current step
+    StepStatistics _stepstatistics;
 };
 
 #endif
@@ -139,6 +139,8 @@ public:
             jointgroup = dJointGroupCreate(0);
             space = dHashSpaceCreate(_ode->space);
             nLastStamp = 0;
+            nSelfPairsChecked = 0;
+            nSelfPairsSkipped = 0;
         }
 
         virtual ~KinBodyInfo() {
@@ -197,6 +199,8 @@ public:
 
             _geometrycallback.reset();
             _staticcallback.reset();
+            // the geometry is re-created, so nothing is known about the self-collisions anymore
+            _mapselfcollisionfree.clear();
         }
 
         KinBodyPtr GetBody() {
@@ -218,6 +222,10 @@ public:
         dSpaceID space;                             ///< space that contanis all the collision objects of this chain
         dJointGroupID jointgroup;
 
+        /// \brief non-adjacent link pairs (same index as KinBody::GetNonAdjacentLinks) that were found to be collision free, with the relative transform of link2 in link1 at that time
+        std::map<int, Transform> _mapselfcollisionfree;
+        uint64_t nSelfPairsChecked, nSelfPairsSkipped; ///< self-collision cache statistics
+
 private:
         boost::shared_ptr<ODEResources> _ode;
     };
@@ -451,12 +451,20 @@ protected:
             params->vinitialconfig.swap(vinitialconfig);
         }
 
-        if( usedynamicsconstraints ) {
-            // use dynamics constraints, so remove the old path constraint function
-            params->_checkpathconstraintsfn.clear();
+        {
             std::list<KinBodyPtr> listCheckBodies;
             listCheckBodies.push_back(robot);
-            planningutils::DynamicsCollisionConstraintPtr dynamics(new planningutils::DynamicsCollisionConstraint(params, listCheckBodies, 0xffffffff));
+            int filtermask = 0xffffffff;
+            if( usedynamicsconstraints ) {
+                // use dynamics constraints, so remove the old path constraint function
+                params->_checkpathconstraintsfn.clear();
+            }
+            else {
+                filtermask &= ~CFO_CheckTimeBasedConstraints;
+            }
+            planningutils::DynamicsCollisionConstraintPtr dynamics(new planningutils::DynamicsCollisionConstraint(params, listCheckBodies, filtermask));
+            // most of the rrt extensions collide, van der Corput order rejects them with fewer checks
+            dynamics->SetIntervalCheckMode(planningutils::DynamicsCollisionConstraint::ICM_VanDerCorput);
             params->_checkpathvelocityconstraintsfn = boost::bind(&planningutils::DynamicsCollisionConstraint::Check,dynamics,_1,_2,_3,_4,_5,_6,_7,_8);
         }
         if( _sPostProcessingParameters.size() > 0 ) {
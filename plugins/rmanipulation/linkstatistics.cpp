@@ -0,0 +1,405 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2013 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "plugindefs.h"
+#include <boost/thread/thread.hpp>
+#include <set>
+
+/// \brief computes the swept volumes of the joints of a robot for the linkstatistics database.
+///
+/// Volumes are represented by points sampled at samplingdelta and are pruned the same way as the python implementation:
+/// a batch of new points is added except for the points that are within samplingdelta of a point already in the volume.
+/// Instead of building a kd-tree for every batch, the volume keeps a grid of cells of size samplingdelta so a query only
+/// looks at the 27 surrounding cells. The queries of a batch are split across threads and the points are appended in
+/// the order of the batch, so the results do not depend on the thread scheduling.
+class LinkStatisticsModule : public ModuleBase
+{
+    /// \brief set of points that can be queried for neighbors within the sampling distance
+    class PointVolume
+    {
+public:
+        PointVolume(dReal fdelta) : _fdelta2(fdelta*fdelta), _fidelta(1/fdelta) {
+        }
+
+        /// \brief returns true if a point of the volume is within the sampling distance of p
+        bool HasNeighbor(const Vector& p) const
+        {
+            int64_t ix = (int64_t)floor(p.x*_fidelta), iy = (int64_t)floor(p.y*_fidelta), iz = (int64_t)floor(p.z*_fidelta);
+            for(int64_t x = ix-1; x <= ix+1; ++x) {
+                for(int64_t y = iy-1; y <= iy+1; ++y) {
+                    for(int64_t z = iz-1; z <= iz+1; ++z) {
+                        std::map<uint64_t, std::vector<size_t> >::const_iterator itcell = _mapcells.find(_GetKey(x,y,z));
+                        if( itcell != _mapcells.end() ) {
+                            FOREACHC(itindex, itcell->second) {
+                                if( (_vpoints[*itindex]-p).lengthsqr3() < _fdelta2 ) {
+                                    return true;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        /// \brief appends the points that do not have a neighbor in the volume. The new points are not checked against each other.
+        ///
+        /// If the volume is empty, all the points are appended.
+        void AddPruned(const std::vector<Vector>& vnewpoints, int numthreads)
+        {
+            if( _vpoints.size() == 0 ) {
+                FOREACHC(itp, vnewpoints) {
+                    _Add(*itp);
+                }
+                return;
+            }
+            std::vector<uint8_t> vhasneighbor(vnewpoints.size(),0);
+            numthreads = max(1,min(numthreads, (int)vnewpoints.size()/s_minthreadpoints));
+            boost::thread_group threads;
+            for(int i = 1; i < numthreads; ++i) {
+                threads.create_thread(boost::bind(&PointVolume::_QueryNeighbors, this, boost::cref(vnewpoints), (i*vnewpoints.size())/numthreads, ((i+1)*vnewpoints.size())/numthreads, boost::ref(vhasneighbor)));
+            }
+            _QueryNeighbors(vnewpoints, 0, vnewpoints.size()/numthreads, vhasneighbor);
+            threads.join_all();
+            for(size_t i = 0; i < vnewpoints.size(); ++i) {
+                if( !vhasneighbor[i] ) {
+                    _Add(vnewpoints[i]);
+                }
+            }
+        }
+
+        std::vector<Vector> _vpoints;
+
+private:
+        inline void _Add(const Vector& p) {
+            _mapcells[_GetKey((int64_t)floor(p.x*_fidelta),(int64_t)floor(p.y*_fidelta),(int64_t)floor(p.z*_fidelta))].push_back(_vpoints.size());
+            _vpoints.push_back(p);
+        }
+
+        void _QueryNeighbors(const std::vector<Vector>& vnewpoints, size_t start, size_t end, std::vector<uint8_t>& vhasneighbor) const
+        {
+            for(size_t i = start; i < end; ++i) {
+                vhasneighbor[i] = HasNeighbor(vnewpoints[i]);
+            }
+        }
+
+        static inline uint64_t _GetKey(int64_t ix, int64_t iy, int64_t iz) {
+            // 21 bits per axis is enough for 2M cells in every direction
+            return ((uint64_t)(ix+(1<<20))&0x1fffff)<<42 | ((uint64_t)(iy+(1<<20))&0x1fffff)<<21 | ((uint64_t)(iz+(1<<20))&0x1fffff);
+        }
+
+        static const int s_minthreadpoints = 1024; ///< do not start a thread for fewer points than this
+
+        dReal _fdelta2, _fidelta;
+        std::map<uint64_t, std::vector<size_t> > _mapcells;
+    };
+
+public:
+    LinkStatisticsModule(EnvironmentBasePtr penv) : ModuleBase(penv)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nComputes the swept volumes of robot joints used by the linkstatistics database.";
+        RegisterCommand("ComputeSweptVolumes",boost::bind(&LinkStatisticsModule::ComputeSweptVolumes,this,_1,_2),
+                        "Computes the swept volumes of all 1-DOF joints of a robot given the volume points of every link. Input parameters are:\n\n\
+* robot string - name of the robot. The robot should already be set in its reference configuration.\n\n\
+* samplingdelta float - distance between the volume points (default is 0.02).\n\n\
+* numthreads int - number of worker threads (default is 1).\n\n\
+* linkpoints int linkindex int N float3*N - the keyword followed by the link index, the number of points, and the volume points of the link in the link coordinate system. Can be repeated for every link.\n\n\
+* filename string - binary file to write the results to.\n\n"
+                        "For every joint in joint index order, the file contains: int32 numswept, float64 sweptvolume[numswept][3], int32 numjointvolume, float64 jointvolume[numjointvolume][3], both rotated so that the negative joint axis is the z-axis. Afterwards, it contains the points of the entire robot volume in the robot coordinate system: int32 numrobotvolume, float64 robotvolume[numrobotvolume][3]. Joints whose volumes were not computed have 0 points.");
+    }
+
+    virtual ~LinkStatisticsModule() {
+    }
+
+    bool ComputeSweptVolumes(ostream& sout, istream& sinput)
+    {
+        string robotname, filename, cmd;
+        dReal samplingdelta = 0.02;
+        int numthreads = 1;
+        std::map<int, std::vector<Vector> > mapLinkPoints;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            if( cmd == "robot" ) {
+                sinput >> robotname;
+            }
+            else if( cmd == "samplingdelta" ) {
+                sinput >> samplingdelta;
+            }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "linkpoints" ) {
+                int linkindex = -1, numpoints = 0;
+                sinput >> linkindex >> numpoints;
+                std::vector<Vector>& vpoints = mapLinkPoints[linkindex];
+                vpoints.resize(numpoints);
+                FOREACH(it,vpoints) {
+                    sinput >> it->x >> it->y >> it->z;
+                }
+            }
+            else if( cmd == "filename" ) {
+                sinput >> filename;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        RobotBasePtr probot = GetEnv()->GetRobot(robotname);
+        if( !probot || filename.size() == 0 || samplingdelta <= 0 ) {
+            return false;
+        }
+        numthreads = max(1,numthreads);
+
+        // all the volumes are computed at the current configuration, so compute the link transforms once
+        std::vector<Transform> vlinktransforms;
+        probot->GetLinkTransformations(vlinktransforms);
+        const std::vector<KinBody::JointPtr>& vjoints = probot->GetJoints();
+        std::vector< std::vector<Vector> > vsweptvolumes(vjoints.size()), vjointvolumes(vjoints.size());
+        std::vector<bool> vsweptconsumed(vjoints.size(),false);
+
+        // go through all the joints in reverse hierarchical order so that child volumes are swept by their parents
+        std::vector<KinBody::JointPtr> vorderedjoints = probot->GetDependencyOrderedJoints();
+        for(std::vector<KinBody::JointPtr>::reverse_iterator itjoint = vorderedjoints.rbegin(); itjoint != vorderedjoints.rend(); ++itjoint) {
+            KinBody::JointPtr pjoint = *itjoint;
+            int jointindex = pjoint->GetJointIndex();
+            if( pjoint->GetDOF() > 1 ) {
+                RAVELOG_INFO(str(boost::format("joint %d has %d DOF, only sweeping the first axis")%jointindex%pjoint->GetDOF()));
+            }
+            RAVELOG_INFO(str(boost::format("joint %d")%jointindex));
+
+            // find all the directly connected links, including those of mimic joints
+            std::vector<KinBody::JointPtr> vconnectedjoints(1,pjoint);
+            std::vector<int> vmimicdofs;
+            for(int ipassive = 0; ipassive < 2; ++ipassive) {
+                FOREACHC(itmimic, ipassive ? probot->GetPassiveJoints() : vjoints) {
+                    if( (*itmimic)->IsMimic(0) ) {
+                        (*itmimic)->GetMimicDOFIndices(vmimicdofs,0);
+                        if( find(vmimicdofs.begin(),vmimicdofs.end(),pjoint->GetDOFIndex()) != vmimicdofs.end() ) {
+                            vconnectedjoints.push_back(*itmimic);
+                        }
+                    }
+                }
+            }
+            std::set<int> setconnectedlinks;
+            FOREACHC(itconnected, vconnectedjoints) {
+                for(int iattached = 0; iattached < 2; ++iattached) {
+                    KinBody::LinkPtr plink = iattached ? (*itconnected)->GetSecondAttached() : (*itconnected)->GetFirstAttached();
+                    if( !!plink && probot->DoesAffect(jointindex,plink->GetIndex()) ) {
+                        setconnectedlinks.insert(plink->GetIndex());
+                    }
+                }
+            }
+
+            // joint anchor should be at the center
+            Vector vanchor = pjoint->GetAnchor();
+            std::vector<Vector>& vjointvolume = vjointvolumes[jointindex];
+            FOREACHC(itlinkindex, setconnectedlinks) {
+                std::map<int, std::vector<Vector> >::const_iterator itpoints = mapLinkPoints.find(*itlinkindex);
+                if( itpoints != mapLinkPoints.end() ) {
+                    Transform tlink = vlinktransforms.at(*itlinkindex);
+                    tlink.trans -= vanchor;
+                    FOREACHC(itp, itpoints->second) {
+                        vjointvolume.push_back(tlink*(*itp));
+                    }
+                }
+            }
+            // gather the swept volumes of all child joints
+            FOREACHC(itchild, vjoints) {
+                int childindex = (*itchild)->GetJointIndex();
+                if( childindex == jointindex || vsweptconsumed[childindex] ) {
+                    continue;
+                }
+                for(int iattached = 0; iattached < 2; ++iattached) {
+                    KinBody::LinkPtr plink = iattached ? (*itchild)->GetSecondAttached() : (*itchild)->GetFirstAttached();
+                    if( !!plink && setconnectedlinks.find(plink->GetIndex()) != setconnectedlinks.end() ) {
+                        _TransformJointPoints(*itchild, vsweptvolumes[childindex], -vanchor, vjointvolume);
+                        vsweptconsumed[childindex] = true; // release since won't be needing it anymore
+                        break;
+                    }
+                }
+            }
+
+            std::vector<dReal> vlower, vupper;
+            pjoint->GetLimits(vlower,vupper);
+            Vector vaxis = -pjoint->GetAxis(0);
+            _ComputeSweptVolume(vjointvolume, vaxis, vlower.at(0), vupper.at(0), samplingdelta, numthreads, vsweptvolumes[jointindex]);
+
+            // rotate the volumes so that -axis matches with the z-axis
+            TransformMatrix R = matrixFromQuat(quatRotateDirection(vaxis,Vector(0,0,1)));
+            FOREACH(itp, vsweptvolumes[jointindex]) {
+                *itp = R.rotate(*itp);
+            }
+            FOREACH(itp, vjointvolume) {
+                *itp = R.rotate(*itp);
+            }
+        }
+
+        // compute the entire robot volume from the links and the joint volumes that were not consumed by parents
+        PointVolume robotvolume(samplingdelta);
+        Transform trobotinv = probot->GetTransform().inverse();
+        std::vector<Vector> vtransformed;
+        FOREACHC(itpoints, mapLinkPoints) {
+            Transform tlink = trobotinv * vlinktransforms.at(itpoints->first);
+            vtransformed.resize(itpoints->second.size());
+            for(size_t i = 0; i < vtransformed.size(); ++i) {
+                vtransformed[i] = tlink*itpoints->second[i];
+            }
+            robotvolume.AddPruned(vtransformed, numthreads);
+        }
+        FOREACHC(itjoint, vjoints) {
+            int jointindex = (*itjoint)->GetJointIndex();
+            // same as the python implementation, single points are not added
+            if( !vsweptconsumed[jointindex] && vsweptvolumes[jointindex].size() > 1 ) {
+                vtransformed.resize(0);
+                _TransformJointPoints(*itjoint, vsweptvolumes[jointindex], Vector(), vtransformed);
+                robotvolume.AddPruned(vtransformed, numthreads);
+            }
+        }
+
+        ofstream f(filename.c_str(), ios_base::out|ios_base::binary|ios_base::trunc);
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to open %s for writing\n")%filename));
+            return false;
+        }
+        for(size_t i = 0; i < vjoints.size(); ++i) {
+            _WritePoints(f, vsweptvolumes[i]);
+            _WritePoints(f, vjointvolumes[i]);
+        }
+        _WritePoints(f, robotvolume._vpoints);
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to write %s\n")%filename));
+            return false;
+        }
+        sout << robotvolume._vpoints.size();
+        return true;
+    }
+
+protected:
+    /// \brief rotates the points so that the z-axis matches the negative joint axis and translates them by the anchor + translation
+    static void _TransformJointPoints(KinBody::JointConstPtr pjoint, const std::vector<Vector>& vpoints, const Vector& translation, std::vector<Vector>& vtransformed)
+    {
+        TransformMatrix Rinv = matrixFromQuat(quatRotateDirection(Vector(0,0,1),-pjoint->GetAxis(0)));
+        Rinv.trans = pjoint->GetAnchor()+translation;
+        vtransformed.reserve(vtransformed.size()+vpoints.size());
+        FOREACHC(itp, vpoints) {
+            vtransformed.push_back(Rinv*(*itp));
+        }
+    }
+
+    /// \brief computes the points swept by rotating vpoints around vaxis from minangle to maxangle
+    ///
+    /// The rotations are sampled every samplingdelta/maxradius radians. The volume of 2^i rotations is computed from the volume of 2^(i-1) rotations,
+    /// and the volumes of the bits of the number of rotations are combined, this is the same pruning order as the python implementation.
+    static void _ComputeSweptVolume(const std::vector<Vector>& vpoints, const Vector& vaxis, dReal minangle, dReal maxangle, dReal samplingdelta, int numthreads, std::vector<Vector>& vsweptvolume)
+    {
+        vsweptvolume.resize(0);
+        if( vpoints.size() == 0 ) {
+            return;
+        }
+        dReal maxradius2 = 0;
+        FOREACHC(itp, vpoints) {
+            maxradius2 = max(maxradius2, itp->cross(vaxis).lengthsqr3());
+        }
+        dReal anglerange = maxangle-minangle;
+        dReal angledelta = 0;
+        int numangles = 0;
+        if( maxradius2 > 0 && anglerange > 0 ) {
+            angledelta = samplingdelta/RaveSqrt(maxradius2);
+            numangles = (int)ceil(anglerange/angledelta);
+        }
+
+        std::vector<Vector> vnewpoints;
+        if( numangles > 0 ) {
+            int maxbit = 0;
+            while( (2<<maxbit) <= numangles ) {
+                ++maxbit;
+            }
+            // vpowvolumes[i] is the volume of rotations [0,2^i)
+            std::vector< std::vector<Vector> > vpowvolumes(maxbit+1);
+            vpowvolumes[0] = vpoints;
+            for(int i = 0; i < maxbit; ++i) {
+                PointVolume volume(samplingdelta);
+                volume.AddPruned(vpowvolumes[i], numthreads);
+                _RotatePoints(vpowvolumes[i], vaxis, _GetSweepAngle((1<<i), numangles, angledelta, anglerange), vnewpoints);
+                volume.AddPruned(vnewpoints, numthreads);
+                vpowvolumes[i+1].swap(volume._vpoints);
+            }
+            PointVolume sweptvolume(samplingdelta);
+            dReal curangle = 0;
+            for(int i = 0; i <= maxbit; ++i) {
+                if( numangles&(1<<i) ) {
+                    _RotatePoints(vpowvolumes[i], vaxis, curangle, vnewpoints);
+                    sweptvolume.AddPruned(vnewpoints, numthreads);
+                    curangle += _GetSweepAngle((1<<i), numangles, angledelta, anglerange);
+                }
+                std::vector<Vector>().swap(vpowvolumes[i]); // free memory
+            }
+            vsweptvolume.swap(sweptvolume._vpoints);
+        }
+        else {
+            vsweptvolume = vpoints;
+        }
+        // everything was computed ignoring minangle
+        _RotatePoints(vsweptvolume, vaxis, minangle, vnewpoints);
+        vsweptvolume.swap(vnewpoints);
+    }
+
+    /// \brief the angle of the index-th rotation, the last index is the end of the range
+    static inline dReal _GetSweepAngle(int index, int numangles, dReal angledelta, dReal anglerange) {
+        return index < numangles ? index*angledelta : anglerange;
+    }
+
+    static void _RotatePoints(const std::vector<Vector>& vpoints, const Vector& vaxis, dReal angle, std::vector<Vector>& vrotated)
+    {
+        TransformMatrix R = matrixFromAxisAngle(vaxis, angle);
+        vrotated.resize(vpoints.size());
+        for(size_t i = 0; i < vpoints.size(); ++i) {
+            vrotated[i] = R.rotate(vpoints[i]);
+        }
+    }
+
+    static void _WritePoints(ostream& f, const std::vector<Vector>& vpoints)
+    {
+        int32_t numpoints = (int32_t)vpoints.size();
+        f.write((const char*)&numpoints, sizeof(numpoints));
+        std::vector<double> vdata(3*vpoints.size());
+        for(size_t i = 0; i < vpoints.size(); ++i) {
+            vdata[3*i+0] = vpoints[i].x;
+            vdata[3*i+1] = vpoints[i].y;
+            vdata[3*i+2] = vpoints[i].z;
+        }
+        if( vdata.size() > 0 ) {
+            f.write((const char*)&vdata[0], vdata.size()*sizeof(double));
+        }
+    }
+};
+
+ModuleBasePtr CreateLinkStatisticsModule(EnvironmentBasePtr penv)
+{
+    return ModuleBasePtr(new LinkStatisticsModule(penv));
+}
@@ -20,6 +20,7 @@ ModuleBasePtr CreateBaseManipulation(EnvironmentBasePtr penv);
 ModuleBasePtr CreateTaskCaging(EnvironmentBasePtr penv);
 ModuleBasePtr CreateTaskManipulation(EnvironmentBasePtr penv);
 ModuleBasePtr CreateVisualFeedback(EnvironmentBasePtr penv);
+ModuleBasePtr CreateLinkStatisticsModule(EnvironmentBasePtr penv);
 
 InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string& interfacename, std::istream& sinput, EnvironmentBasePtr penv)
 {
@@ -37,6 +38,9 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
         else if( interfacename == "visualfeedback") {
             return CreateVisualFeedback(penv);
         }
+        else if( interfacename == "linkstatistics") {
+            return CreateLinkStatisticsModule(penv);
+        }
         break;
     default:
         break;
@@ -50,6 +54,7 @@ void GetPluginAttributesValidated(PLUGININFO& info)
     info.interfacenames[PT_Module].push_back("TaskManipulation");
     info.interfacenames[PT_Module].push_back("TaskCaging");
     info.interfacenames[PT_Module].push_back("VisualFeedback");
+    info.interfacenames[PT_Module].push_back("LinkStatistics");
 }
 
 OPENRAVE_PLUGIN_API void DestroyPlugin()
@@ -101,6 +101,11 @@ public:
     {
         __description = ":Interface Author: Rosen Diankov\nConstraint-based smoothing with `Indiana University Intelligent Motion Laboratory <http://www.iu.edu/~motion/software.html>`_ parabolic smoothing library (Kris Hauser).\n\n**Note:** The original trajectory will not be preserved at all, don't use this if the robot has to hit all points of the trajectory.\n";
         _bCheckControllerTimeStep = true;
+        _bMergeCache = true;
+        RegisterCommand("GetMergeStatistics",boost::bind(&ConstraintParabolicSmoother::_GetMergeStatisticsCommand,this,_1,_2),
+                        "returns the time in seconds spent merging ramps, the number of ramp feasibility checks done by the merges, and the number of those checks answered from the ramp cache, for the last PlanPath call");
+        RegisterCommand("SetMergeCache",boost::bind(&ConstraintParabolicSmoother::_SetMergeCacheCommand,this,_1,_2),
+                        "Enables (1, default) or disables (0) caching the ramp feasibility checks of the merges. The results do not change, only the number of checks.");
         //_distancechecker = RaveCreateCollisionChecker(penv, "pqp");
         //OPENRAVE_ASSERT_FORMAT0(!!_distancechecker, "need pqp distance checker", ORE_Assert);
     }
@@ -250,6 +255,7 @@ public:
         }
 
         uint32_t basetime = utils::GetMilliTime();
+        _mergestatistics = MergeStatistics();
 
         ConfigurationSpecification posspec = _parameters->_configurationspecification;
         //_setstatefn = posspec.GetSetFn(GetEnv());
@@ -268,6 +274,12 @@ public:
             }
             ParabolicRamp::RampFeasibilityChecker checker(this,tol);
             checker.constraintsmask = CFO_CheckEnvCollisions|CFO_CheckSelfCollisions|CFO_CheckTimeBasedConstraints|CFO_CheckUserConstraints;
+            // the environment does not change during planning, so ramp feasibility can be reused by all the merges
+            mergewaypoints::RampFeasibilityCache mergecache(checker, 0xffff);
+            // merges done while shortcutting do not check collisions, they are checked later only for the modified ramps
+            mergewaypoints::RampFeasibilityCache shortcutmergecache(checker, 0xffff & (~CFO_CheckEnvCollisions) & (~CFO_CheckSelfCollisions));
+            mergecache.SetEnabled(_bMergeCache);
+            shortcutmergecache.SetEnabled(_bMergeCache);
             RAVELOG_VERBOSE_FORMAT("minswitchtime = %f, steplength=%f\n",_parameters->minswitchtime%_parameters->_fStepLength);
 
 
@@ -315,13 +327,16 @@ public:
                 }
                 mergewaypoints::PrintRamps(ramps,_parameters,false);
                 // Try first fixing trajectory ends (for traj comming from previous jittering operation)
+                // FixRampsEnds does not check through the cache, so it is not part of the merge statistics
                 bool res = mergewaypoints::FixRampsEnds(ramps,ramps2, _parameters,checker,options);
                 if(!res) {
                     RAVELOG_DEBUG("First or last two ramps could not be fixed, try something more general...\n");
                     // More general algorithm
                     dReal upperbound = 2;
                     dReal stepsize = 0.1;
-                    res = mergewaypoints::IterativeMergeRampsNoDichotomy(ramps,ramps2, _parameters, upperbound, stepsize, _bCheckControllerTimeStep, _uniformsampler,checker,options);
+                    uint64_t mergestarttime = utils::GetNanoPerformanceTime();
+                    res = mergewaypoints::IterativeMergeRampsNoDichotomy(ramps,ramps2, _parameters, upperbound, stepsize, _bCheckControllerTimeStep, _uniformsampler,mergecache);
+                    _AddMergeStatistics(mergestarttime, mergecache);
                 }
                 if(!res) {
                     throw OPENRAVE_EXCEPTION_FORMAT0("Could not obtain a feasible trajectory from initial quadratic trajectory",ORE_Assert);
@@ -430,7 +445,7 @@ public:
                 for(int rep=0; rep<_parameters->nshortcutcycles; rep++) {
                     ramps = initramps;
                     RAVELOG_VERBOSE_FORMAT("Start shortcut cycle %d\n",rep);
-                    numshortcuts = Shortcut(ramps, _parameters->_nMaxIterations,checker, this);
+                    numshortcuts = Shortcut(ramps, _parameters->_nMaxIterations,checker, this, shortcutmergecache);
                     totaltime = mergewaypoints::ComputeRampsDuration(ramps);
                     if(totaltime < besttime) {
                         bestramps = ramps;
@@ -458,10 +473,11 @@ public:
                 //////////////////////  Further merge if possible ////////////////////////
                 //////////////////////////////////////////////////////////////////////////
 
-                int options = 0xffff;
                 dReal upperbound = 1.05;
                 std::list<ParabolicRamp::ParabolicRampND> resramps;
-                bool resmerge = mergewaypoints::FurtherMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,checker,options);
+                uint64_t mergestarttime = utils::GetNanoPerformanceTime();
+                bool resmerge = mergewaypoints::FurtherMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,mergecache);
+                _AddMergeStatistics(mergestarttime, mergecache);
                 if(resmerge) {
                     RAVELOG_DEBUG("Great, could further merge ramps!!\n");
                     size_t nbrampsbefore = mergewaypoints::CountUnitaryRamps(ramps);
@@ -692,7 +708,7 @@ public:
 
 
     // Perform the shortcuts
-    int Shortcut(std::list<ParabolicRamp::ParabolicRampND>&ramps, int numIters, ParabolicRamp::RampFeasibilityChecker& check, ParabolicRamp::RandomNumberGeneratorBase* rng)
+    int Shortcut(std::list<ParabolicRamp::ParabolicRampND>&ramps, int numIters, ParabolicRamp::RampFeasibilityChecker& check, ParabolicRamp::RandomNumberGeneratorBase* rng, mergewaypoints::RampFeasibilityCache& mergecache)
     {
         ParabolicRamp::Vector qstart = ramps.begin()->x0;
         ParabolicRamp::Vector qgoal = ramps.back().x1;
@@ -848,10 +864,11 @@ public:
                 std::list<ParabolicRamp::ParabolicRampND> resramps;
                 dReal upperbound = (durationbeforeshortcut-fimprovetimethresh)/mergewaypoints::ComputeRampsDuration(ramps);
                 // Do not check collision during merge, check later
-                int options = 0xffff & (~CFO_CheckEnvCollisions) & (~CFO_CheckSelfCollisions);
-
+                int options = mergecache.GetOptions();
 
-                bool resmerge = mergewaypoints::IterativeMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,check,options);
+                uint64_t mergestarttime = utils::GetNanoPerformanceTime();
+                bool resmerge = mergewaypoints::IterativeMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,mergecache);
+                _AddMergeStatistics(mergestarttime, mergecache);
 
                 if(!resmerge) {
                     RAVELOG_VERBOSE("... Could not merge\n");
@@ -1087,6 +1104,41 @@ public:
 
 
 protected:
+    /// \brief time spent merging ramps and how well the ramp feasibility cache did during the last PlanPath
+    struct MergeStatistics
+    {
+        MergeStatistics() : mergetime(0), numchecks(0), numcachehits(0) {
+        }
+        uint64_t mergetime; ///< nanoseconds
+        size_t numchecks, numcachehits;
+    };
+
+    void _AddMergeStatistics(uint64_t mergestarttime, mergewaypoints::RampFeasibilityCache& cache)
+    {
+        _mergestatistics.mergetime += utils::GetNanoPerformanceTime()-mergestarttime;
+        _mergestatistics.numchecks += cache._numchecks;
+        _mergestatistics.numcachehits += cache._numcachehits;
+        cache._numchecks = 0;
+        cache._numcachehits = 0;
+    }
+
+    bool _GetMergeStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sout << (1e-9*_mergestatistics.mergetime) << " " << _mergestatistics.numchecks << " " << _mergestatistics.numcachehits;
+        return !!sout;
+    }
+
+    bool _SetMergeCacheCommand(std::ostream& sout, std::istream& sinput)
+    {
+        bool bMergeCache = true;
+        sinput >> bMergeCache;
+        if( !sinput ) {
+            return false;
+        }
+        _bMergeCache = bMergeCache;
+        return true;
+    }
+
     ConstraintTrajectoryTimingParametersPtr _parameters;
     SpaceSamplerBasePtr _uniformsampler;
     RobotBasePtr _probot;
@@ -1100,7 +1152,9 @@ protected:
     TrajectoryBasePtr _dummytraj,_inittraj;
     bool _bCheckControllerTimeStep; ///< if set to true (default), then constraints all switch points to be a multiple of _parameters->_fStepLength
     bool _bmanipconstraints; /// if true, check workspace manip constraints
+    bool _bMergeCache; ///< if true (default), the merges reuse the feasibility of ramps they already checked
     PlannerProgress _progress;
+    MergeStatistics _mergestatistics;
 
 private:
     std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> > __tempramps1d;
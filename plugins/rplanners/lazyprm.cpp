@@ -0,0 +1,999 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2013 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "rplanners.h"
+#include <openrave/planningutils.h>
+
+#include <queue>
+
+class LazyPRMPlanner : public PlannerBase
+{
+public:
+    class LazyPRMParameters : public PlannerBase::PlannerParameters
+    {
+public:
+        LazyPRMParameters() : _nNeighbors(10), _nBatchSize(100), _bProcessingLazyPRM(false) {
+            _vXMLParameters.push_back("neighbors");
+            _vXMLParameters.push_back("batchsize");
+        }
+
+        int _nNeighbors; ///< number of nearest neighbors every new node is connected to
+        int _nBatchSize; ///< number of nodes sampled every time the roadmap does not contain a path
+protected:
+        bool _bProcessingLazyPRM;
+        virtual bool serialize(std::ostream& O, int options=0) const
+        {
+            if( !PlannerParameters::serialize(O, options&~1) ) {
+                return false;
+            }
+            O << "<neighbors>" << _nNeighbors << "</neighbors>" << endl;
+            O << "<batchsize>" << _nBatchSize << "</batchsize>" << endl;
+            if( !(options & 1) ) {
+                O << _sExtraParameters << endl;
+            }
+            return !!O;
+        }
+
+        ProcessElement startElement(const std::string& name, const AttributesList& atts)
+        {
+            if( _bProcessingLazyPRM ) {
+                return PE_Ignore;
+            }
+            switch( PlannerBase::PlannerParameters::startElement(name,atts) ) {
+            case PE_Pass: break;
+            case PE_Support: return PE_Support;
+            case PE_Ignore: return PE_Ignore;
+            }
+            _bProcessingLazyPRM = name=="neighbors"||name=="batchsize";
+            return _bProcessingLazyPRM ? PE_Support : PE_Pass;
+        }
+
+        virtual bool endElement(const string& name)
+        {
+            if( _bProcessingLazyPRM ) {
+                if( name == "neighbors") {
+                    _ss >> _nNeighbors;
+                }
+                else if( name == "batchsize") {
+                    _ss >> _nBatchSize;
+                }
+                else {
+                    RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
+                }
+                _bProcessingLazyPRM = false;
+                return false;
+            }
+            // give a chance for the default parameters to get processed
+            return PlannerParameters::endElement(name);
+        }
+    };
+    typedef boost::shared_ptr<LazyPRMParameters> LazyPRMParametersPtr;
+
+    /// \brief validity of a roadmap node or edge, only computed when a candidate path goes through it
+    enum ValidityState {
+        VS_Unknown=0,
+        VS_Valid=1,
+        VS_Invalid=2,
+    };
+
+    struct RoadmapNode
+    {
+        RoadmapNode(const std::vector<dReal>& q) : q(q), state(VS_Unknown), cause(-1) {
+        }
+        std::vector<dReal> q;
+        int state;
+        int cause; ///< if invalid, the index into _vbodyrecords of the body that collided, -1 if the robot itself is the cause, -2 if the cause is not known
+        AABB ab; ///< if valid, the workspace bounding box of the robot
+        std::vector<int> vedges; ///< indices into _vedges
+    };
+
+    struct RoadmapEdge
+    {
+        RoadmapEdge(int node0, int node1, dReal fcost) : fcost(fcost), state(VS_Unknown), cause(-1) {
+            nodes[0] = node0;
+            nodes[1] = node1;
+        }
+        inline int GetOther(int node) const {
+            return nodes[0] == node ? nodes[1] : nodes[0];
+        }
+        int nodes[2];
+        dReal fcost;
+        int state;
+        int cause; ///< see RoadmapNode::cause
+        AABB ab; ///< if valid, the workspace bounding box swept by the robot along the edge
+    };
+
+    /// \brief an environment body the roadmap validity depends on
+    struct BodyRecord
+    {
+        BodyRecord() : environmentid(0), updatestamp(-1), bpresent(false) {
+        }
+        std::string name;
+        int environmentid, updatestamp; ///< when these match the body, it did not move
+        bool bpresent; ///< true if the body was in the environment when the validity was last updated
+        std::vector<Transform> vlinktransforms;
+        std::vector<uint8_t> vlinkenables;
+        std::string geometryhash; ///< KinBody::GetKinematicsGeometryHash
+        AABB ab;
+    };
+
+    LazyPRMPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\n\
+Lazy probabilistic roadmap. The roadmap is built without any collision checks, then the shortest candidate path is searched for and only its nodes and edges are validated. Invalid nodes and edges are removed and the search is repeated. When the roadmap does not contain a path, a new batch of nodes is sampled. See\n\n\
+- R. Bohlin and L.E. Kavraki. Path planning using lazy PRM. In Proc. IEEE Int'l Conf. on Robotics and Automation (ICRA'2000), pages 521-528, San Francisco, CA, April 2000.\n\n\
+The roadmap and the validity of its nodes and edges are kept across queries. When bodies are moved, added, removed, enabled, disabled, or change their geometry, only the valid nodes and edges whose swept robot bounding box overlaps the new body positions, and the invalid ones that collided with the changed bodies or with an unknown body, have to be checked again. Changing the inactive DOFs or the grabbed bodies of the robot resets all validity, and changing the configuration space resets the roadmap. If the constraints of the planner parameters change, call **ResetRoadmap**. The roadmap can be saved and loaded with **SaveRoadmap** and **LoadRoadmap** to be reused for the same workcell.\n\n\
+The extra parameters are **neighbors**, the number of nearest neighbors every node is connected to, and **batchsize**, the number of nodes sampled at a time.";
+        RegisterCommand("ResetRoadmap",boost::bind(&LazyPRMPlanner::_ResetRoadmapCommand,this,_1,_2),
+                        "removes all the nodes and edges of the roadmap");
+        RegisterCommand("GetStatistics",boost::bind(&LazyPRMPlanner::_GetStatisticsCommand,this,_1,_2),
+                        "returns the number of roadmap nodes, edges, valid edges, invalid edges, the number of node and edge checks done by the last query, and the number of nodes and edges whose validity the last InitPlan reset because the environment changed");
+        RegisterCommand("SaveRoadmap",boost::bind(&LazyPRMPlanner::_SaveRoadmapCommand,this,_1,_2),
+                        "saves the roadmap and the validity of its nodes and edges to a file");
+        RegisterCommand("LoadRoadmap",boost::bind(&LazyPRMPlanner::_LoadRoadmapCommand,this,_1,_2),
+                        "loads a roadmap saved with SaveRoadmap, its validity is updated against the environment at the next InitPlan");
+        _nNodeChecks = 0;
+        _nEdgeChecks = 0;
+        _nValidityResets = 0;
+        _bRebuildTree = false;
+        _filterreturn.reset(new ConstraintFilterReturn());
+        _report.reset(new CollisionReport());
+    }
+
+    virtual ~LazyPRMPlanner() {
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+    virtual bool InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _parameters.reset();
+        _robot = pbase;
+        LazyPRMParametersPtr parameters(new LazyPRMParameters());
+        parameters->copy(pparams);
+        parameters->Validate();
+        if( (int)parameters->vinitialconfig.size() % parameters->GetDOF() || parameters->vinitialconfig.size() == 0 ) {
+            RAVELOG_ERROR(str(boost::format("initial config wrong dim: %d %% %d != 0\n")%parameters->vinitialconfig.size()%parameters->GetDOF()));
+            return false;
+        }
+        if( (int)parameters->vgoalconfig.size() % parameters->GetDOF() || parameters->vgoalconfig.size() == 0 ) {
+            RAVELOG_ERROR(str(boost::format("goal config wrong dim: %d %% %d != 0\n")%parameters->vgoalconfig.size()%parameters->GetDOF()));
+            return false;
+        }
+        if( parameters->_nMaxIterations <= 0 ) {
+            parameters->_nMaxIterations = 10000;
+        }
+        if( parameters->_nNeighbors <= 0 ) {
+            parameters->_nNeighbors = 10;
+        }
+        if( parameters->_nBatchSize <= 0 ) {
+            parameters->_nBatchSize = 100;
+        }
+
+        FOREACH(it, parameters->_listInternalSamplers) {
+            (*it)->SetSeed(parameters->_nRandomGeneratorSeed);
+        }
+
+        // keep the roadmap if it was built for the same configuration space
+        if( _configurationspecification != parameters->_configurationspecification ) {
+            _ResetRoadmap();
+            _configurationspecification = parameters->_configurationspecification;
+        }
+        if( !_nntree ) {
+            if( (int)_robot->GetActiveDOF() == parameters->GetDOF() ) {
+                _nntree.reset(new planningutils::NearestNeighborTree(RobotBaseConstPtr(_robot)));
+            }
+            else {
+                _nntree.reset(new planningutils::NearestNeighborTree(std::vector<dReal>(parameters->GetDOF(),1.0)));
+            }
+            _bRebuildTree = true;
+        }
+        _UpdateValidity();
+        if( _bRebuildTree ) {
+            _nntree->Reset();
+            for(size_t inode = 0; inode < _vnodes.size(); ++inode) {
+                _nntree->Insert(_vnodes[inode].q);
+                if( _vnodes[inode].state == VS_Invalid ) {
+                    _nntree->Remove(inode);
+                }
+            }
+            _bRebuildTree = false;
+        }
+
+        _parameters = parameters;
+        RAVELOG_DEBUG_FORMAT("LazyPRM initialized, roadmap nodes=%d, edges=%d", _vnodes.size()%_vedges.size());
+        return true;
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
+    {
+        if(!_parameters) {
+            RAVELOG_ERROR("LazyPRMPlanner::PlanPath - Error, planner not initialized\n");
+            return PS_Failed;
+        }
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        uint32_t basetime = utils::GetMilliTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+        CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+        _nNodeChecks = 0;
+        _nEdgeChecks = 0;
+
+        int dof = _parameters->GetDOF();
+        std::vector<dReal> vconfig(dof);
+        _vstartnodes.resize(0);
+        for(size_t index = 0; index < _parameters->vinitialconfig.size(); index += dof) {
+            std::copy(_parameters->vinitialconfig.begin()+index,_parameters->vinitialconfig.begin()+index+dof,vconfig.begin());
+            int inode = _AddNode(vconfig);
+            if( _CheckNode(inode) ) {
+                _vstartnodes.push_back(inode);
+            }
+        }
+        _vgoalnodes.resize(0);
+        for(size_t index = 0; index < _parameters->vgoalconfig.size(); index += dof) {
+            std::copy(_parameters->vgoalconfig.begin()+index,_parameters->vgoalconfig.begin()+index+dof,vconfig.begin());
+            int inode = _AddNode(vconfig);
+            if( _CheckNode(inode) ) {
+                _vgoalnodes.push_back(inode);
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("goal %d fails constraints\n")%(index/dof)));
+            }
+        }
+        if( _vstartnodes.size() == 0 || _vgoalnodes.size() == 0 ) {
+            RAVELOG_WARN("no valid initial or goal configurations\n");
+            return PS_Failed;
+        }
+
+        std::list<int> listpath;
+        PlannerProgress progress;
+        int numsamples = 0;
+        while(1) {
+            if( _FindPath(listpath) ) {
+                if( _ValidatePath(listpath) ) {
+                    break;
+                }
+                // some nodes or edges were invalid, search again
+            }
+            else {
+                if( numsamples >= _parameters->_nMaxIterations ) {
+                    RAVELOG_WARN(str(boost::format("plan failed, %d samples, %fs\n")%numsamples%(0.001f*(float)(utils::GetMilliTime()-basetime))));
+                    return PS_Failed;
+                }
+                // the roadmap does not connect the start and goal, so add more nodes
+                for(int i = 0; i < _parameters->_nBatchSize && numsamples < _parameters->_nMaxIterations; ++i, ++numsamples) {
+                    if( _parameters->_samplefn(vconfig) ) {
+                        _AddNode(vconfig);
+                    }
+                }
+            }
+
+            progress._iteration = numsamples;
+            PlannerAction callbackaction = _CallCallbacks(progress);
+            if( callbackaction == PA_Interrupt ) {
+                return PS_Interrupted;
+            }
+        }
+
+        if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+            ptraj->Init(_parameters->_configurationspecification);
+        }
+        std::vector<dReal> vpath;
+        vpath.reserve(listpath.size()*dof);
+        FOREACHC(itnode, listpath) {
+            vpath.insert(vpath.end(), _vnodes[*itnode].q.begin(), _vnodes[*itnode].q.end());
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(),vpath,_parameters->_configurationspecification);
+        RAVELOG_DEBUG_FORMAT("plan success, path=%d points, roadmap nodes=%d, node checks=%d, edge checks=%d, computation time=%fs", listpath.size()%_vnodes.size()%_nNodeChecks%_nEdgeChecks%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+        return _ProcessPostPlanners(_robot,ptraj);
+    }
+
+protected:
+    /// \brief adds a node to the roadmap and connects it to its nearest neighbors without checking anything
+    ///
+    /// If the configuration is already in the roadmap, returns the existing node so that repeated queries do not grow the roadmap.
+    int _AddNode(const std::vector<dReal>& q)
+    {
+        int inode = (int)_vnodes.size();
+        _nntree->FindNearestK(q, _parameters->_nNeighbors, _vneighbors, _vneighbordists);
+        if( _vneighbors.size() > 0 && _vneighbordists[0] <= g_fEpsilonLinear ) {
+            return _vneighbors[0];
+        }
+        _vnodes.push_back(RoadmapNode(q));
+        int ninserted = _nntree->Insert(q);
+        BOOST_ASSERT(ninserted == inode);
+        FOREACHC(itneighbor, _vneighbors) {
+            if( _vnodes[*itneighbor].state == VS_Invalid ) {
+                continue;
+            }
+            int iedge = (int)_vedges.size();
+            _vedges.push_back(RoadmapEdge(inode, *itneighbor, _parameters->_distmetricfn(q, _vnodes[*itneighbor].q)));
+            _vnodes[inode].vedges.push_back(iedge);
+            _vnodes[*itneighbor].vedges.push_back(iedge);
+        }
+        return inode;
+    }
+
+    /// \brief checks the node if its validity is not known, invalid nodes are removed from the nearest neighbor tree
+    bool _CheckNode(int inode)
+    {
+        RoadmapNode& node = _vnodes.at(inode);
+        if( node.state == VS_Unknown ) {
+            ++_nNodeChecks;
+            _filterreturn->Clear();
+            if( _parameters->CheckPathAllConstraints(node.q,node.q,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart, 0xffff, _filterreturn) == 0 ) {
+                node.state = VS_Valid;
+                node.ab = _ComputeRobotAABB();
+            }
+            else {
+                node.state = VS_Invalid;
+                node.cause = _GetInvalidCause();
+                _nntree->Remove(inode);
+            }
+        }
+        return node.state == VS_Valid;
+    }
+
+    /// \brief checks the edge if its validity is not known, the nodes of the edge have to be valid
+    bool _CheckEdge(int iedge)
+    {
+        RoadmapEdge& edge = _vedges.at(iedge);
+        if( edge.state == VS_Unknown ) {
+            ++_nEdgeChecks;
+            // the end points are checked separately
+            _filterreturn->Clear();
+            if( _parameters->CheckPathAllConstraints(_vnodes[edge.nodes[0]].q, _vnodes[edge.nodes[1]].q, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open, 0xffff, _filterreturn) == 0 ) {
+                edge.state = VS_Valid;
+                edge.ab = _ComputeEdgeAABB(edge);
+            }
+            else {
+                edge.state = VS_Invalid;
+                edge.cause = _GetInvalidCause();
+            }
+        }
+        return edge.state == VS_Valid;
+    }
+
+    /// \brief bounding box swept by the robot along an edge whose nodes are valid
+    ///
+    /// The robot boxes are merged at the configurations interpolated from the edge end points with the DOF resolutions, then grown
+    /// by how far any point of the links can move between two consecutive configurations, so the box does not depend on
+    /// which configurations the constraints happened to check.
+    AABB _ComputeEdgeAABB(const RoadmapEdge& edge)
+    {
+        const std::vector<dReal>& q0 = _vnodes[edge.nodes[0]].q, &q1 = _vnodes[edge.nodes[1]].q;
+        AABB ab = _MergeAABB(_vnodes[edge.nodes[0]].ab, _vnodes[edge.nodes[1]].ab);
+        _vstepdelta = q1;
+        _parameters->_diffstatefn(_vstepdelta, q0);
+        int numsteps = 1;
+        for(size_t i = 0; i < _vstepdelta.size(); ++i) {
+            if( _parameters->_vConfigResolution.at(i) > 0 ) {
+                numsteps = max(numsteps, (int)RaveCeil(RaveFabs(_vstepdelta[i])/_parameters->_vConfigResolution[i]));
+            }
+        }
+        FOREACH(it, _vstepdelta) {
+            *it /= numsteps;
+        }
+        _vstepconfig = q0;
+        dReal fstepmotion = 0;
+        for(int istep = 0; istep <= numsteps; ++istep) {
+            if( istep > 0 && !_parameters->_neighstatefn(_vstepconfig, _vstepdelta, 0) ) {
+                break;
+            }
+            if( _parameters->SetStateValues(_vstepconfig, 0) != 0 ) {
+                break;
+            }
+            ab = _MergeAABB(ab, _ComputeRobotAABB());
+            _GetRobotLinkTransforms(_vlinktransforms);
+            if( istep == 0 ) {
+                _ComputeRobotLinkRadii(_vlinktransforms, _vlinkradii);
+            }
+            else if( _vlinktransforms.size() == _vprevlinktransforms.size() ) {
+                for(size_t i = 0; i < _vlinktransforms.size(); ++i) {
+                    const Transform& t0 = _vprevlinktransforms[i], &t1 = _vlinktransforms[i];
+                    dReal fangle = 2*RaveAcos(min(dReal(1),RaveFabs(t0.rot.dot(t1.rot))));
+                    fstepmotion = max(fstepmotion, RaveSqrt((t1.trans-t0.trans).lengthsqr3()) + fangle*_vlinkradii.at(i));
+                }
+            }
+            _vprevlinktransforms.swap(_vlinktransforms);
+        }
+        ab.extents += Vector(fstepmotion, fstepmotion, fstepmotion);
+        return ab;
+    }
+
+    /// \brief the transforms of the links of the robot followed by the links of the grabbed bodies
+    void _GetRobotLinkTransforms(std::vector<Transform>& vtransforms)
+    {
+        _robot->GetLinkTransformations(vtransforms);
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        std::vector<Transform> vgrabbedtransforms;
+        FOREACHC(itgrabbed, vgrabbed) {
+            (*itgrabbed)->GetLinkTransformations(vgrabbedtransforms);
+            vtransforms.insert(vtransforms.end(), vgrabbedtransforms.begin(), vgrabbedtransforms.end());
+        }
+    }
+
+    /// \brief for every link of _GetRobotLinkTransforms, the distance from the link origin to the farthest point of its geometry
+    void _ComputeRobotLinkRadii(const std::vector<Transform>& vtransforms, std::vector<dReal>& vradii)
+    {
+        std::vector<KinBody::LinkPtr> vlinks = _robot->GetLinks();
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            vlinks.insert(vlinks.end(), (*itgrabbed)->GetLinks().begin(), (*itgrabbed)->GetLinks().end());
+        }
+        vradii.resize(vlinks.size());
+        for(size_t i = 0; i < vlinks.size(); ++i) {
+            AABB ablink = vlinks[i]->ComputeAABB();
+            vradii[i] = RaveSqrt((ablink.pos-vtransforms.at(i).trans).lengthsqr3()) + RaveSqrt(ablink.extents.lengthsqr3());
+        }
+    }
+
+    /// \brief bounding box of the robot and the bodies it grabs at the current state
+    AABB _ComputeRobotAABB()
+    {
+        AABB ab = _robot->ComputeAABB();
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            ab = _MergeAABB(ab, (*itgrabbed)->ComputeAABB());
+        }
+        return ab;
+    }
+
+    static AABB _MergeAABB(const AABB& ab0, const AABB& ab1)
+    {
+        Vector vmin0 = ab0.pos - ab0.extents, vmax0 = ab0.pos + ab0.extents;
+        Vector vmin1 = ab1.pos - ab1.extents, vmax1 = ab1.pos + ab1.extents;
+        Vector vmin(min(vmin0.x,vmin1.x), min(vmin0.y,vmin1.y), min(vmin0.z,vmin1.z));
+        Vector vmax(max(vmax0.x,vmax1.x), max(vmax0.y,vmax1.y), max(vmax0.z,vmax1.z));
+        AABB ab;
+        ab.pos = 0.5*(vmin+vmax);
+        ab.extents = 0.5*(vmax-vmin);
+        return ab;
+    }
+
+    static bool _IntersectAABB(const AABB& ab0, const AABB& ab1)
+    {
+        return RaveFabs(ab0.pos.x-ab1.pos.x) <= ab0.extents.x+ab1.extents.x && RaveFabs(ab0.pos.y-ab1.pos.y) <= ab0.extents.y+ab1.extents.y && RaveFabs(ab0.pos.z-ab1.pos.z) <= ab0.extents.z+ab1.extents.z;
+    }
+
+    /// \brief after a failed check, finds the environment body that the robot collided with
+    ///
+    /// \return the index into _vbodyrecords, -1 if the failure only depends on the robot (self-collision, joint limits), or -2 if the failure depends on the environment but the body could not be found
+    int _GetInvalidCause()
+    {
+        if( !(_filterreturn->_returncode & (CFO_CheckEnvCollisions|CFO_CheckUserConstraints)) ) {
+            return -1;
+        }
+        if( !(_filterreturn->_returncode & CFO_CheckEnvCollisions) || _filterreturn->_invalidvalues.size() != (size_t)_parameters->GetDOF() ) {
+            return -2;
+        }
+        if( _parameters->SetStateValues(_filterreturn->_invalidvalues, 0) != 0 ) {
+            return -2;
+        }
+        if( !GetEnv()->CheckCollision(KinBodyConstPtr(_robot), _report) ) {
+            return -2;
+        }
+        KinBody::LinkConstPtr links[2] = { _report->plink1, _report->plink2 };
+        for(int i = 0; i < 2; ++i) {
+            if( !!links[i] ) {
+                KinBodyPtr pbody = links[i]->GetParent();
+                if( pbody != _robot && !_robot->IsGrabbing(pbody) ) {
+                    return _GetBodyRecordIndex(pbody->GetName());
+                }
+            }
+        }
+        return -2;
+    }
+
+    /// \brief A* search for the shortest path from any start to any goal over the nodes and edges that are not known to be invalid
+    bool _FindPath(std::list<int>& listpath)
+    {
+        listpath.clear();
+        size_t numnodes = _vnodes.size();
+        _vcost.resize(numnodes);
+        _vheuristic.resize(numnodes);
+        _vparentedge.resize(numnodes);
+        _vgoalflags.resize(numnodes);
+        std::fill(_vcost.begin(), _vcost.end(), std::numeric_limits<dReal>::infinity());
+        std::fill(_vheuristic.begin(), _vheuristic.end(), dReal(-1));
+        std::fill(_vparentedge.begin(), _vparentedge.end(), -1);
+        std::fill(_vgoalflags.begin(), _vgoalflags.end(), 0);
+        FOREACHC(itgoal, _vgoalnodes) {
+            _vgoalflags[*itgoal] = 1;
+        }
+
+        // min-heap of (cost+heuristic, node)
+        std::priority_queue< std::pair<dReal,int>, std::vector< std::pair<dReal,int> >, std::greater< std::pair<dReal,int> > > queue;
+        FOREACHC(itstart, _vstartnodes) {
+            _vcost[*itstart] = 0;
+            queue.push(make_pair(_GetHeuristic(*itstart), *itstart));
+        }
+        while(!queue.empty()) {
+            std::pair<dReal,int> top = queue.top();
+            queue.pop();
+            int inode = top.second;
+            if( top.first > _vcost[inode] + _GetHeuristic(inode) ) {
+                continue; // stale entry
+            }
+            if( _vgoalflags[inode] ) {
+                while(inode >= 0) {
+                    listpath.push_front(inode);
+                    int iedge = _vparentedge[inode];
+                    inode = iedge >= 0 ? _vedges[iedge].GetOther(inode) : -1;
+                }
+                return true;
+            }
+            FOREACHC(itedge, _vnodes[inode].vedges) {
+                const RoadmapEdge& edge = _vedges[*itedge];
+                if( edge.state == VS_Invalid ) {
+                    continue;
+                }
+                int inext = edge.GetOther(inode);
+                if( _vnodes[inext].state == VS_Invalid ) {
+                    continue;
+                }
+                dReal fcost = _vcost[inode] + edge.fcost;
+                if( fcost < _vcost[inext] ) {
+                    _vcost[inext] = fcost;
+                    _vparentedge[inext] = *itedge;
+                    queue.push(make_pair(fcost + _GetHeuristic(inext), inext));
+                }
+            }
+        }
+        return false;
+    }
+
+    /// \brief distance to the closest goal, computed on demand
+    dReal _GetHeuristic(int inode)
+    {
+        if( _vheuristic[inode] < 0 ) {
+            dReal fbest = std::numeric_limits<dReal>::infinity();
+            FOREACHC(itgoal, _vgoalnodes) {
+                fbest = min(fbest, _parameters->_distmetricfn(_vnodes[inode].q, _vnodes[*itgoal].q));
+            }
+            _vheuristic[inode] = fbest;
+        }
+        return _vheuristic[inode];
+    }
+
+    /// \brief validates the nodes and then the edges of the path, alternating from both ends since collisions are usually close to either the start or the goal
+    bool _ValidatePath(const std::list<int>& listpath)
+    {
+        bool bvalid = true;
+        FOREACHC(itnode, listpath) {
+            if( !_CheckNode(*itnode) ) {
+                bvalid = false;
+            }
+        }
+        if( !bvalid ) {
+            return false;
+        }
+        std::vector<int> vpathedges;
+        vpathedges.reserve(listpath.size());
+        std::list<int>::const_iterator itnode = listpath.begin();
+        ++itnode;
+        for(; itnode != listpath.end(); ++itnode) {
+            vpathedges.push_back(_vparentedge.at(*itnode));
+        }
+        int ifront = 0, iback = (int)vpathedges.size()-1;
+        while(ifront <= iback) {
+            if( !_CheckEdge(vpathedges[ifront++]) ) {
+                return false;
+            }
+            if( ifront <= iback && !_CheckEdge(vpathedges[iback--]) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int _GetBodyRecordIndex(const std::string& name)
+    {
+        std::map<std::string, int>::iterator it = _mapbodyrecords.find(name);
+        if( it != _mapbodyrecords.end() ) {
+            return it->second;
+        }
+        int index = (int)_vbodyrecords.size();
+        _vbodyrecords.push_back(BodyRecord());
+        _vbodyrecords.back().name = name;
+        _mapbodyrecords[name] = index;
+        return index;
+    }
+
+    /// \brief the state of the robot that stays fixed during planning: the inactive DOFs, the base if not active, and the grabbed bodies
+    void _GetRobotSignature(std::vector<dReal>& vrobotsignature, std::string& robotsignaturenames)
+    {
+        _robot->GetDOFValues(vrobotsignature);
+        FOREACHC(itindex, _robot->GetActiveDOFIndices()) {
+            vrobotsignature.at(*itindex) = 0;
+        }
+        if( _robot->GetAffineDOF() == 0 ) {
+            Transform t = _robot->GetTransform();
+            for(int i = 0; i < 4; ++i) {
+                vrobotsignature.push_back(t.rot[i]);
+            }
+            for(int i = 0; i < 3; ++i) {
+                vrobotsignature.push_back(t.trans[i]);
+            }
+        }
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        std::vector<std::string> vnames;
+        FOREACHC(itgrabbed, vgrabbed) {
+            vnames.push_back((*itgrabbed)->GetName());
+        }
+        std::sort(vnames.begin(), vnames.end());
+        robotsignaturenames = _robot->GetName();
+        FOREACHC(itname, vnames) {
+            robotsignaturenames += string(" ") + *itname;
+        }
+    }
+
+    /// \brief updates the roadmap validity with the bodies that changed since the last update
+    void _UpdateValidity()
+    {
+        std::vector<dReal> vrobotsignature;
+        std::string robotsignaturenames;
+        _GetRobotSignature(vrobotsignature, robotsignaturenames);
+        bool bresetall = robotsignaturenames != _robotsignaturenames || vrobotsignature.size() != _vrobotsignature.size();
+        for(size_t i = 0; i < vrobotsignature.size() && !bresetall; ++i) {
+            bresetall = RaveFabs(vrobotsignature[i]-_vrobotsignature[i]) > g_fEpsilonLinear;
+        }
+        _vrobotsignature.swap(vrobotsignature);
+        _robotsignaturenames.swap(robotsignaturenames);
+
+        // find the bodies that were moved, added, or removed. Their old positions invalidated some nodes and edges, and their new positions can invalidate valid ones.
+        std::vector<uint8_t> vmoved(_vbodyrecords.size(), 0), vseen(_vbodyrecords.size(), 0);
+        std::vector<AABB> vnewaabbs;
+        std::vector<KinBodyPtr> vbodies;
+        std::vector<Transform> vlinktransforms;
+        std::vector<uint8_t> vlinkenables;
+        GetEnv()->GetBodies(vbodies);
+        FOREACHC(itbody, vbodies) {
+            if( *itbody == _robot || !!_robot->IsGrabbing(*itbody) ) {
+                continue;
+            }
+            int index = _GetBodyRecordIndex((*itbody)->GetName());
+            vmoved.resize(_vbodyrecords.size(), 0);
+            vseen.resize(_vbodyrecords.size(), 0);
+            vseen[index] = 1;
+            BodyRecord& record = _vbodyrecords[index];
+            // enabling links and changing geometries does not always change the update stamp
+            (*itbody)->GetLinkEnableStates(vlinkenables);
+            const std::string& geometryhash = (*itbody)->GetKinematicsGeometryHash();
+            bool bsame = record.bpresent && record.vlinkenables == vlinkenables && record.geometryhash == geometryhash;
+            if( bsame && record.environmentid == (*itbody)->GetEnvironmentId() && record.updatestamp == (*itbody)->GetUpdateStamp() ) {
+                continue;
+            }
+            (*itbody)->GetLinkTransformations(vlinktransforms);
+            bsame = bsame && record.vlinktransforms.size() == vlinktransforms.size();
+            for(size_t i = 0; i < vlinktransforms.size() && bsame; ++i) {
+                bsame = TransformDistance2(vlinktransforms[i], record.vlinktransforms[i]) <= g_fEpsilonLinear*g_fEpsilonLinear;
+            }
+            record.environmentid = (*itbody)->GetEnvironmentId();
+            record.updatestamp = (*itbody)->GetUpdateStamp();
+            if( !bsame ) {
+                vmoved[index] = 1;
+                record.vlinktransforms = vlinktransforms;
+                record.vlinkenables = vlinkenables;
+                record.geometryhash = geometryhash;
+                record.ab = (*itbody)->ComputeAABB();
+                // disabled bodies cannot invalidate anything
+                if( (*itbody)->IsEnabled() ) {
+                    vnewaabbs.push_back(record.ab);
+                }
+            }
+            record.bpresent = true;
+        }
+        for(size_t index = 0; index < _vbodyrecords.size(); ++index) {
+            if( _vbodyrecords[index].bpresent && !vseen[index] ) {
+                _vbodyrecords[index].bpresent = false;
+                _vbodyrecords[index].vlinktransforms.resize(0);
+                _vbodyrecords[index].vlinkenables.resize(0);
+                _vbodyrecords[index].geometryhash.resize(0);
+                vmoved[index] = 1;
+            }
+        }
+        bool banymoved = std::find(vmoved.begin(), vmoved.end(), 1) != vmoved.end();
+
+        int numreset = 0;
+        _nValidityResets = 0;
+        FOREACH(itnode, _vnodes) {
+            if( _UpdateState(itnode->state, itnode->cause, itnode->ab, bresetall, banymoved, vmoved, vnewaabbs) ) {
+                ++numreset;
+                _bRebuildTree = true;
+            }
+        }
+        FOREACH(itedge, _vedges) {
+            if( _UpdateState(itedge->state, itedge->cause, itedge->ab, bresetall, banymoved, vmoved, vnewaabbs) ) {
+                ++numreset;
+            }
+        }
+        if( numreset > 0 ) {
+            RAVELOG_DEBUG_FORMAT("environment changed, %d roadmap nodes and edges have to be checked again", numreset);
+        }
+        _nValidityResets = numreset;
+    }
+
+    /// \brief returns true if the state was reset to VS_Unknown
+    ///
+    /// \param banymoved true if any body in vmoved changed, invalid states with an unknown cause are checked again
+    bool _UpdateState(int& state, int cause, const AABB& ab, bool bresetall, bool banymoved, const std::vector<uint8_t>& vmoved, const std::vector<AABB>& vnewaabbs)
+    {
+        if( state == VS_Unknown ) {
+            return false;
+        }
+        bool breset = bresetall;
+        if( !breset ) {
+            if( state == VS_Invalid ) {
+                breset = cause >= 0 ? vmoved.at(cause) != 0 : (cause == -2 && banymoved);
+            }
+            else {
+                FOREACHC(itab, vnewaabbs) {
+                    if( _IntersectAABB(ab, *itab) ) {
+                        breset = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if( breset ) {
+            state = VS_Unknown;
+        }
+        return breset;
+    }
+
+    void _ResetRoadmap()
+    {
+        _vnodes.clear();
+        _vedges.clear();
+        _nntree.reset();
+    }
+
+    bool _ResetRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _ResetRoadmap();
+        return true;
+    }
+
+    static void _WriteAABB(std::ostream& O, const AABB& ab)
+    {
+        O << ab.pos.x << " " << ab.pos.y << " " << ab.pos.z << " " << ab.extents.x << " " << ab.extents.y << " " << ab.extents.z;
+    }
+
+    static void _ReadAABB(std::istream& I, AABB& ab)
+    {
+        I >> ab.pos.x >> ab.pos.y >> ab.pos.z >> ab.extents.x >> ab.extents.y >> ab.extents.z;
+    }
+
+    /// \brief writes the length before the string so that names can contain spaces
+    static void _WriteString(std::ostream& O, const std::string& s)
+    {
+        O << s.size() << " " << s;
+    }
+
+    static void _ReadString(std::istream& I, std::string& s)
+    {
+        size_t length = 0;
+        I >> length;
+        s.resize(length);
+        if( !!I ) {
+            I.get(); // separator
+            if( length > 0 ) {
+                I.read(&s[0], length);
+            }
+        }
+    }
+
+    bool _SaveRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        std::string filename;
+        sinput >> filename;
+        if( !sinput ) {
+            return false;
+        }
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        ofstream f(filename.c_str());
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to open %s for writing\n")%filename));
+            return false;
+        }
+        f << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        f << "lazyprm 2" << endl;
+        f << _configurationspecification << endl;
+        f << _robotsignaturenames << endl;
+        f << _vrobotsignature.size();
+        FOREACHC(it, _vrobotsignature) {
+            f << " " << *it;
+        }
+        f << endl << _vbodyrecords.size() << endl;
+        FOREACHC(itrecord, _vbodyrecords) {
+            _WriteString(f, itrecord->name);
+            f << " " << (int)itrecord->bpresent << " ";
+            _WriteString(f, itrecord->geometryhash);
+            f << " " << itrecord->vlinktransforms.size();
+            FOREACHC(itt, itrecord->vlinktransforms) {
+                f << " " << itt->rot.x << " " << itt->rot.y << " " << itt->rot.z << " " << itt->rot.w << " " << itt->trans.x << " " << itt->trans.y << " " << itt->trans.z;
+            }
+            f << " " << itrecord->vlinkenables.size();
+            FOREACHC(itenable, itrecord->vlinkenables) {
+                f << " " << (int)*itenable;
+            }
+            f << " ";
+            _WriteAABB(f, itrecord->ab);
+            f << endl;
+        }
+        f << _vnodes.size() << endl;
+        FOREACHC(itnode, _vnodes) {
+            FOREACHC(it, itnode->q) {
+                f << *it << " ";
+            }
+            f << itnode->state << " " << itnode->cause << " ";
+            _WriteAABB(f, itnode->ab);
+            f << endl;
+        }
+        f << _vedges.size() << endl;
+        FOREACHC(itedge, _vedges) {
+            f << itedge->nodes[0] << " " << itedge->nodes[1] << " " << itedge->fcost << " " << itedge->state << " " << itedge->cause << " ";
+            _WriteAABB(f, itedge->ab);
+            f << endl;
+        }
+        return !!f;
+    }
+
+    bool _LoadRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        std::string filename;
+        sinput >> filename;
+        if( !sinput ) {
+            return false;
+        }
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        ifstream f(filename.c_str());
+        std::string header;
+        int version = 0;
+        f >> header >> version;
+        if( !f || header != "lazyprm" || version != 2 ) {
+            RAVELOG_WARN(str(boost::format("%s is not a roadmap file\n")%filename));
+            return false;
+        }
+        _ResetRoadmap();
+        _vbodyrecords.clear();
+        _mapbodyrecords.clear();
+        f >> _configurationspecification;
+        getline(f, _robotsignaturenames); // end of line
+        getline(f, _robotsignaturenames);
+        size_t num = 0;
+        f >> num;
+        _vrobotsignature.resize(num);
+        FOREACH(it, _vrobotsignature) {
+            f >> *it;
+        }
+        f >> num;
+        for(size_t i = 0; i < num && !!f; ++i) {
+            std::string name;
+            int bpresent = 0;
+            size_t numlinks = 0;
+            _ReadString(f, name);
+            f >> bpresent;
+            BodyRecord& record = _vbodyrecords.at(_GetBodyRecordIndex(name));
+            record.bpresent = bpresent != 0;
+            // the ids are different in every session, so compare the geometry, enable states, and link transforms on the next update
+            record.environmentid = 0;
+            record.updatestamp = -1;
+            _ReadString(f, record.geometryhash);
+            f >> numlinks;
+            record.vlinktransforms.resize(numlinks);
+            FOREACH(itt, record.vlinktransforms) {
+                f >> itt->rot.x >> itt->rot.y >> itt->rot.z >> itt->rot.w >> itt->trans.x >> itt->trans.y >> itt->trans.z;
+            }
+            f >> numlinks;
+            record.vlinkenables.resize(numlinks);
+            FOREACH(itenable, record.vlinkenables) {
+                int enable = 0;
+                f >> enable;
+                *itenable = enable != 0;
+            }
+            _ReadAABB(f, record.ab);
+        }
+        int dof = _configurationspecification.GetDOF();
+        f >> num;
+        std::vector<dReal> q(dof);
+        for(size_t i = 0; i < num && !!f; ++i) {
+            FOREACH(it, q) {
+                f >> *it;
+            }
+            _vnodes.push_back(RoadmapNode(q));
+            f >> _vnodes.back().state >> _vnodes.back().cause;
+            _ReadAABB(f, _vnodes.back().ab);
+        }
+        f >> num;
+        for(size_t i = 0; i < num && !!f; ++i) {
+            int node0 = 0, node1 = 0;
+            dReal fcost = 0;
+            f >> node0 >> node1 >> fcost;
+            if( node0 < 0 || node0 >= (int)_vnodes.size() || node1 < 0 || node1 >= (int)_vnodes.size() ) {
+                break;
+            }
+            int iedge = (int)_vedges.size();
+            _vedges.push_back(RoadmapEdge(node0, node1, fcost));
+            f >> _vedges.back().state >> _vedges.back().cause;
+            _ReadAABB(f, _vedges.back().ab);
+            _vnodes[node0].vedges.push_back(iedge);
+            _vnodes[node1].vedges.push_back(iedge);
+        }
+        if( !f ) {
+            RAVELOG_WARN(str(boost::format("failed to read roadmap %s\n")%filename));
+            _ResetRoadmap();
+            return false;
+        }
+        RAVELOG_DEBUG_FORMAT("loaded roadmap with %d nodes and %d edges", _vnodes.size()%_vedges.size());
+        return true;
+    }
+
+    bool _GetStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numvalid = 0, numinvalid = 0;
+        FOREACHC(itedge, _vedges) {
+            if( itedge->state == VS_Valid ) {
+                ++numvalid;
+            }
+            else if( itedge->state == VS_Invalid ) {
+                ++numinvalid;
+            }
+        }
+        sout << _vnodes.size() << " " << _vedges.size() << " " << numvalid << " " << numinvalid << " " << _nNodeChecks << " " << _nEdgeChecks << " " << _nValidityResets;
+        return true;
+    }
+
+    LazyPRMParametersPtr _parameters;
+    RobotBasePtr _robot;
+
+    std::vector<RoadmapNode> _vnodes;
+    std::vector<RoadmapEdge> _vedges;
+    planningutils::NearestNeighborTreePtr _nntree; ///< indices are the same as _vnodes
+    bool _bRebuildTree; ///< if true, the nodes have to be re-inserted in _nntree
+    ConfigurationSpecification _configurationspecification; ///< the configuration space of the roadmap
+    std::vector<BodyRecord> _vbodyrecords; ///< the environment that the roadmap validity was computed in
+    std::map<std::string, int> _mapbodyrecords; ///< body name to index into _vbodyrecords
+    std::vector<dReal> _vrobotsignature; ///< see _GetRobotSignature
+    std::string _robotsignaturenames;
+    ConstraintFilterReturnPtr _filterreturn;
+    CollisionReportPtr _report;
+    std::vector<int> _vstartnodes, _vgoalnodes;
+    int _nNodeChecks, _nEdgeChecks; ///< statistics of the last query
+    int _nValidityResets; ///< number of nodes and edges reset by the last _UpdateValidity
+
+    // cache
+    std::vector<int> _vneighbors;
+    std::vector<dReal> _vneighbordists;
+    std::vector<dReal> _vcost, _vheuristic;
+    std::vector<int> _vparentedge;
+    std::vector<uint8_t> _vgoalflags;
+    std::vector<dReal> _vstepconfig, _vstepdelta, _vlinkradii;
+    std::vector<Transform> _vlinktransforms, _vprevlinktransforms;
+};
+
+PlannerBasePtr CreateLazyPRMPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new LazyPRMPlanner(penv, sinput));
+}
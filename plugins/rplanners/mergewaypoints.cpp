@@ -377,32 +377,25 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
         itersi++;
         // Kill all ramps that are not the first or the last. For every three ramps where the middle ramp is smaller than minswitchtime, merge the ramp that is in the middle to form two new ramps.
         bool solved = false;
+        std::vector<int> invalidrampindices;
         while(true) {
-            solved = true;
+            // one pass finds all the short middle ramps, a merge only changes the ramps around it
+            invalidrampindices.resize(0);
             size_t i = 0;
             FOREACHC(itramp,ramps) {
                 if(itramp->endTime < params->minswitchtime && i>0 && i<ramps.size()-1) {
-                    solved = false;
-                    break;
+                    invalidrampindices.push_back(i);
                 }
                 i++;
             }
-            if (solved) {
+            if (invalidrampindices.size() == 0) {
+                solved = true;
                 break;
             }
             if(ramps.size()<=2) {
                 solved = false;
                 break;
             }
-            std::vector<int> invalidrampindices;
-            invalidrampindices.resize(0);
-            i = 0;
-            FOREACHC(itramp,ramps) {
-                if(itramp->endTime < params->minswitchtime && i>0 && i<ramps.size()-1) {
-                    invalidrampindices.push_back(i);
-                }
-                i++;
-            }
             int jramp = invalidrampindices[uniformsampler->SampleSequenceOneUInt32()%invalidrampindices.size()];
             std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.begin();
             std::advance(itlist,jramp+1);
@@ -565,6 +558,48 @@ bool ScaleRampsTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps,
     return true;
 }
 
+RampFeasibilityCache::RampFeasibilityCache(ParabolicRamp::RampFeasibilityChecker& check, int options) : _numchecks(0), _numcachehits(0), _check(check), _options(options), _bEnabled(true)
+{
+}
+
+bool RampFeasibilityCache::Check(const ParabolicRamp::ParabolicRampND& ramp, int options)
+{
+    if( !_bEnabled ) {
+        ++_numchecks;
+        return _check.Check(ramp,options);
+    }
+    // the switch times are part of the key since ramps with the same boundary conditions and duration can have different profiles
+    _vkey.resize(0);
+    _vkey.push_back(options);
+    _vkey.push_back(ramp.endTime);
+    _vkey.insert(_vkey.end(),ramp.x0.begin(),ramp.x0.end());
+    _vkey.insert(_vkey.end(),ramp.dx0.begin(),ramp.dx0.end());
+    _vkey.insert(_vkey.end(),ramp.x1.begin(),ramp.x1.end());
+    _vkey.insert(_vkey.end(),ramp.dx1.begin(),ramp.dx1.end());
+    FOREACHC(itramp1d,ramp.ramps) {
+        _vkey.push_back(itramp1d->tswitch1);
+        _vkey.push_back(itramp1d->tswitch2);
+        _vkey.push_back(itramp1d->ttotal);
+        _vkey.push_back(itramp1d->a1);
+        _vkey.push_back(itramp1d->v);
+        _vkey.push_back(itramp1d->a2);
+    }
+    std::map<std::vector<dReal>, bool>::iterator it = _mapfeasibility.find(_vkey);
+    if( it != _mapfeasibility.end() ) {
+        ++_numcachehits;
+        return it->second;
+    }
+    ++_numchecks;
+    bool bfeasible = _check.Check(ramp,options);
+    _mapfeasibility[_vkey] = bfeasible;
+    return bfeasible;
+}
+
+void RampFeasibilityCache::Clear()
+{
+    _mapfeasibility.clear();
+}
+
 // Check whether ramps satisfy constraints associated with checker
 bool CheckRamps(std::list<ParabolicRamp::ParabolicRampND>&ramps, ParabolicRamp::RampFeasibilityChecker& check,int options = 0xffff)
 {
@@ -576,6 +611,17 @@ bool CheckRamps(std::list<ParabolicRamp::ParabolicRampND>&ramps, ParabolicRamp::
     return true;
 }
 
+// Same as CheckRamps but only calls the checker on ramps that were not checked before
+bool CheckRamps(std::list<ParabolicRamp::ParabolicRampND>&ramps, RampFeasibilityCache& cache)
+{
+    FOREACHC(itramp,ramps) {
+        if(!itramp->IsValid() || !cache.Check(*itramp)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool SpecialCheckRamp(const ParabolicRamp::ParabolicRampND& ramp,const ParabolicRamp::Vector& qstart, const ParabolicRamp::Vector& qgoal, dReal radius, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
 
@@ -700,6 +746,12 @@ dReal ComputeRampQuality(const std::list<ParabolicRamp::ParabolicRampND>& ramps)
 }
 
 bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+{
+    RampFeasibilityCache cache(check,options);
+    return FurtherMergeRamps(origramps,resramps,params,upperbound,checkcontrollertime,uniformsampler,cache);
+}
+
+bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache)
 {
     //int nitersfurthermerge = params->nitersfurthermerge;
     int nitersfurthermerge = 0;
@@ -727,7 +779,7 @@ bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps
                 break;
             }
             bool resfix = FixRamps(resramp0,resramp1,resramp0x,resramp1x,t0,t1,params);
-            if(!resfix || !check.Check(resramp0x,options) || !check.Check(resramp1x,options)) {
+            if(!resfix || !cache.Check(resramp0x) || !cache.Check(resramp1x)) {
                 break;
             }
             bHasChanged = true;
@@ -750,13 +802,19 @@ bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps
 }
 
 bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+{
+    RampFeasibilityCache cache(check,options);
+    return IterativeMergeRamps(origramps,resramps,params,upperbound,checkcontrollertime,uniformsampler,cache);
+}
+
+bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache)
 {
     std::list<ParabolicRamp::ParabolicRampND> ramps,ramps2;
     dReal testcoef;
 
     //printf("Coef = 1\n");
     bool res = IterativeMergeRampsFixedTime(origramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res &&  CheckRamps(ramps2,check,options);
+    res = res &&  CheckRamps(ramps2,cache);
     if (res) {
         resramps.swap(ramps2);
         return true;
@@ -769,7 +827,7 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
         return false;
     }
     res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res && CheckRamps(ramps2,check,options);
+    res = res && CheckRamps(ramps2,cache);
     if (!res) {
         return false;
     }
@@ -786,7 +844,7 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
             continue;
         }
         res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-        res = res && CheckRamps(ramps2,check,options);
+        res = res && CheckRamps(ramps2,cache);
         if(res) {
             hi = testcoef;
             resramps.swap(ramps2);
@@ -800,6 +858,12 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
 
 
 bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+{
+    RampFeasibilityCache cache(check,options);
+    return IterativeMergeRampsNoDichotomy(origramps,resramps,params,upperbound,stepsize,checkcontrollertime,uniformsampler,cache);
+}
+
+bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache)
 {
     std::list<ParabolicRamp::ParabolicRampND> ramps;
     for(dReal testcoef=1; testcoef<=upperbound; testcoef+=stepsize) {
@@ -808,7 +872,7 @@ bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRamp
             continue;
         }
         bool res = IterativeMergeRampsFixedTime(ramps, resramps, params, checkcontrollertime, uniformsampler);
-        res = res && CheckRamps(resramps,check,options);
+        res = res && CheckRamps(resramps,cache);
         if(res) {
             RAVELOG_DEBUG_FORMAT("Timescale coefficient: %f succeeded\n",testcoef);
             return true;
@@ -21,6 +21,49 @@ namespace ParabolicRamp = ParabolicRampInternal;
 namespace mergewaypoints
 {
 
+/** Memoizes the feasibility checks of ramps.
+
+    Merging three ramps only changes the two ramps that replace them, and time scaling with trysmart only changes the modified ramps, so most of the ramps passed to the checker are copies of ramps that were already checked. Ramps are identified by their boundary conditions, duration, and switch times, so the cache should only be used while the environment and the constraints do not change.
+ */
+class RampFeasibilityCache
+{
+public:
+    RampFeasibilityCache(ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+
+    /// \brief returns the cached result of check.Check(ramp,options), checks the ramp if it has not been seen before
+    bool Check(const ParabolicRamp::ParabolicRampND& ramp, int options);
+
+    /// \brief checks with the default options of the cache
+    bool Check(const ParabolicRamp::ParabolicRampND& ramp) {
+        return Check(ramp, _options);
+    }
+
+    /// \brief removes all the cached results, has to be called when the environment changes
+    void Clear();
+
+    /// \brief if false, every check calls the checker and nothing is cached. Enabled by default.
+    void SetEnabled(bool bEnabled) {
+        _bEnabled = bEnabled;
+    }
+
+    ParabolicRamp::RampFeasibilityChecker& GetChecker() {
+        return _check;
+    }
+    int GetOptions() const {
+        return _options;
+    }
+
+    size_t _numchecks; ///< number of times the checker was called
+    size_t _numcachehits; ///< number of checks answered from the cache
+
+private:
+    ParabolicRamp::RampFeasibilityChecker& _check;
+    int _options;
+    bool _bEnabled;
+    std::map<std::vector<dReal>, bool> _mapfeasibility;
+    std::vector<dReal> _vkey;
+};
+
 /** Iteratively merge all ramps that are shorter than minswitchtime. Determine the optimal time duration that allows to do so
     \param origramps input ramps
     \param ramps result ramps
@@ -30,6 +73,10 @@ namespace mergewaypoints
  */
 bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
+/** Same as IterativeMergeRamps but checks the ramps through cache, so ramps left untouched by the merges and by the time scaling are not checked again
+ */
+bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache);
+
 /** Once the ramps are all OK, further merge ramps
     \param origramps input ramps
     \param ramps result ramps
@@ -39,10 +86,16 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>& origra
  */
 bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
+/** Same as FurtherMergeRamps but checks the ramps through cache
+ */
+bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache);
+
 /** Same as IterativeMergeRamps but run a straightforward line search on the trajectory duration instead of dichotomy search
 **/
 bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
+bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, RampFeasibilityCache& cache);
+
 /** If the beginning or the end of the ramps are linear segments then modify them to pass minswitchtime, controller timestep, and other constraints coming from the check object.
 **/
 bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
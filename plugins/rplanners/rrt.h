@@ -171,10 +171,17 @@ protected:
 class BirrtPlanner : public RrtPlanner<SimpleNode>
 {
 public:
-    BirrtPlanner(EnvironmentBasePtr penv) : RrtPlanner<SimpleNode>(penv), _treeBackward(1)
+    BirrtPlanner(EnvironmentBasePtr penv) : RrtPlanner<SimpleNode>(penv), _treeBackward(1), _nMaxCachedPaths(0), _fCacheRadius(0), _nCacheHits(0), _nCacheMisses(0)
     {
         __description += "Bi-directional RRTs. See\n\n\
-- J.J. Kuffner and S.M. LaValle. RRT-Connect: An efficient approach to single-query path planning. In Proc. IEEE Int'l Conf. on Robotics and Automation (ICRA'2000), pages 995-1001, San Francisco, CA, April 2000.";
+- J.J. Kuffner and S.M. LaValle. RRT-Connect: An efficient approach to single-query path planning. In Proc. IEEE Int'l Conf. on Robotics and Automation (ICRA'2000), pages 995-1001, San Francisco, CA, April 2000.\n\n\
+When the plan cache is enabled with **SetPlanCache**, the paths found by previous queries are stored before post-processing. A new query first tries the cached paths whose start and goal are close to its own, with the start and goal replaced and the current constraints checked. Segments that fail are bridged to a later waypoint of the cached path. The trees are only grown when no cached path can be used.";
+        RegisterCommand("SetPlanCache", boost::bind(&BirrtPlanner::_SetPlanCacheCommand,this,_1,_2),
+                        "sets the maximum number of cached paths and the maximum sum of start and goal distances a cached path is tried for. 0 paths disables the cache.");
+        RegisterCommand("ClearPlanCache", boost::bind(&BirrtPlanner::_ClearPlanCacheCommand,this,_1,_2),
+                        "removes all cached paths");
+        RegisterCommand("GetPlanCacheStatistics", boost::bind(&BirrtPlanner::_GetPlanCacheStatisticsCommand,this,_1,_2),
+                        "returns the number of queries solved from the cache, the number of queries that had to be planned, and the number of cached paths. If followed by 'reset', resets the counts.");
         RegisterCommand("DumpTree", boost::bind(&BirrtPlanner::_DumpTreeCommand,this,_1,_2),
                         "dumps the source and goal trees to $OPENRAVE_HOME/birrtdump.txt. The first N values are the DOF values, the last value is the parent index.\n\
 Some python code to display data::\n\
@@ -238,6 +245,11 @@ Some python code to display data::\n\
             _parameters->_nMaxIterations = 10000;
         }
 
+        if( _cachespec != _parameters->_configurationspecification ) {
+            _listcachedpaths.clear();
+            _cachespec = _parameters->_configurationspecification;
+        }
+
         RAVELOG_DEBUG_FORMAT("BiRRT Planner Initialized, initial=%d, goal=%d", _nNumInitialConfigurations%_vecGoals.size());
         return true;
     }
@@ -267,6 +279,22 @@ Some python code to display data::\n\
         PlannerParameters::StateSaver savestate(_parameters);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
 
+        if( _nMaxCachedPaths > 0 ) {
+            GOALPATH cachedpath;
+            if( _PlanFromCache(cachedpath) ) {
+                ++_nCacheHits;
+                _goalindex = cachedpath.goalindex;
+                _startindex = cachedpath.startindex;
+                if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+                    ptraj->Init(_parameters->_configurationspecification);
+                }
+                ptraj->Insert(ptraj->GetNumWaypoints(),cachedpath.qall,_parameters->_configurationspecification);
+                RAVELOG_DEBUG_FORMAT("plan success from cache, path=%d points, computation time=%fs\n", ptraj->GetNumWaypoints()%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+                return _ProcessPostPlanners(_robot,ptraj);
+            }
+            ++_nCacheMisses;
+        }
+
         SpatialTreeBase* TreeA = &_treeForward;
         SpatialTreeBase* TreeB = &_treeBackward;
         int iConnectedA=-1, iConnectedB=-1;
@@ -403,6 +431,12 @@ Some python code to display data::\n\
         }
         _goalindex = itbest->goalindex;
         _startindex = itbest->startindex;
+        if( _nMaxCachedPaths > 0 ) {
+            _listcachedpaths.push_front(itbest->qall);
+            if( _listcachedpaths.size() > _nMaxCachedPaths ) {
+                _listcachedpaths.pop_back();
+            }
+        }
         if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
             ptraj->Init(_parameters->_configurationspecification);
         }
@@ -472,10 +506,123 @@ Some python code to display data::\n\
         }
     }
 
+    /// \brief tries the cached paths closest to the initial and goal configurations with the current constraints
+    ///
+    /// The cached start and goal are replaced with the current ones. If a segment fails, it is bridged from its start to a later waypoint.
+    virtual bool _PlanFromCache(GOALPATH& goalpath)
+    {
+        int dof = _parameters->GetDOF();
+        // (distance, (cached path, (start index, goal index)))
+        std::vector< std::pair<dReal, std::pair<std::list< std::vector<dReal> >::iterator, std::pair<int, int> > > > vcandidates;
+        for(std::list< std::vector<dReal> >::iterator itpath = _listcachedpaths.begin(); itpath != _listcachedpaths.end(); ++itpath) {
+            if( (int)itpath->size() < 2*dof ) {
+                continue;
+            }
+            std::vector<dReal> qcachedstart(itpath->begin(), itpath->begin()+dof), qcachedgoal(itpath->end()-dof, itpath->end());
+            for(int istart = 0; istart < _nNumInitialConfigurations; ++istart) {
+                SimpleNode* pstart = _treeForward._nodes.at(istart);
+                if( pstart->parent != -istart-1 ) {
+                    continue;
+                }
+                dReal fstartdist = _parameters->_distmetricfn(pstart->q, qcachedstart);
+                if( fstartdist > _fCacheRadius ) {
+                    continue;
+                }
+                for(size_t igoal = 0; igoal < _vecGoals.size(); ++igoal) {
+                    if( _vecGoals[igoal].size() == 0 ) {
+                        continue;
+                    }
+                    dReal fdist = fstartdist + _parameters->_distmetricfn(_vecGoals[igoal], qcachedgoal);
+                    if( fdist <= _fCacheRadius ) {
+                        vcandidates.push_back(std::make_pair(fdist, std::make_pair(itpath, std::make_pair(istart, (int)igoal))));
+                    }
+                }
+            }
+        }
+        std::sort(vcandidates.begin(), vcandidates.end(), _CompareCandidates);
+
+        std::vector< std::vector<dReal> > vwaypoints;
+        FOREACH(itcandidate, vcandidates) {
+            const std::vector<dReal>& qall = *itcandidate->second.first;
+            size_t numpoints = qall.size()/dof;
+            vwaypoints.resize(numpoints);
+            vwaypoints.front() = _treeForward._nodes.at(itcandidate->second.second.first)->q;
+            for(size_t i = 1; i+1 < numpoints; ++i) {
+                vwaypoints[i].assign(qall.begin()+i*dof, qall.begin()+(i+1)*dof);
+            }
+            vwaypoints.back() = _vecGoals.at(itcandidate->second.second.second);
+
+            goalpath.qall.resize(0);
+            goalpath.qall.insert(goalpath.qall.end(), vwaypoints.front().begin(), vwaypoints.front().end());
+            size_t icurrent = 0;
+            while(icurrent+1 < numpoints) {
+                size_t inext = icurrent+1;
+                while(inext < numpoints && _parameters->CheckPathAllConstraints(vwaypoints[icurrent], vwaypoints[inext], std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+                    ++inext;
+                }
+                if( inext >= numpoints ) {
+                    break;
+                }
+                goalpath.qall.insert(goalpath.qall.end(), vwaypoints[inext].begin(), vwaypoints[inext].end());
+                icurrent = inext;
+            }
+            if( icurrent+1 == numpoints ) {
+                goalpath.startindex = itcandidate->second.second.first;
+                goalpath.goalindex = itcandidate->second.second.second;
+                // most recently used paths are kept the longest
+                _listcachedpaths.splice(_listcachedpaths.begin(), _listcachedpaths, itcandidate->second.first);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool _CompareCandidates(const std::pair<dReal, std::pair<std::list< std::vector<dReal> >::iterator, std::pair<int, int> > >& c0, const std::pair<dReal, std::pair<std::list< std::vector<dReal> >::iterator, std::pair<int, int> > >& c1)
+    {
+        return c0.first < c1.first;
+    }
+
     virtual PlannerParametersConstPtr GetParameters() const {
         return _parameters;
     }
 
+    virtual bool _SetPlanCacheCommand(std::ostream& os, std::istream& is)
+    {
+        size_t nmaxpaths = 0;
+        dReal fradius = 0;
+        is >> nmaxpaths >> fradius;
+        if( !is ) {
+            return false;
+        }
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _nMaxCachedPaths = nmaxpaths;
+        _fCacheRadius = fradius;
+        while(_listcachedpaths.size() > _nMaxCachedPaths) {
+            _listcachedpaths.pop_back();
+        }
+        return true;
+    }
+
+    virtual bool _ClearPlanCacheCommand(std::ostream& os, std::istream& is)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _listcachedpaths.clear();
+        return true;
+    }
+
+    virtual bool _GetPlanCacheStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        std::string cmd;
+        is >> cmd;
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        os << _nCacheHits << " " << _nCacheMisses << " " << _listcachedpaths.size();
+        if( cmd == "reset" ) {
+            _nCacheHits = 0;
+            _nCacheMisses = 0;
+        }
+        return true;
+    }
+
     virtual bool _DumpTreeCommand(std::ostream& os, std::istream& is) {
         std::string filename = RaveGetHomeDirectory() + string("/birrtdump.txt");
         getline(is, filename);
@@ -504,6 +651,12 @@ protected:
     SpatialTree< RrtPlanner<SimpleNode>, SimpleNode > _treeBackward;
     dReal _fGoalBiasProb;
     std::vector< std::vector<dReal> > _vecGoals;
+
+    std::list< std::vector<dReal> > _listcachedpaths; ///< waypoints of previous solutions before post-processing, most recently used first
+    ConfigurationSpecification _cachespec; ///< the configuration space of the cached paths
+    size_t _nMaxCachedPaths;
+    dReal _fCacheRadius;
+    int _nCacheHits, _nCacheMisses;
 };
 
 class BasicRrtPlanner : public RrtPlanner<SimpleNode>
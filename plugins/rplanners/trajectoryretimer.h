@@ -88,8 +88,73 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
-        // TODO there's a lot of info that is being recomputed which could be cached depending on the configurationspace of the incoming trajectory
         BOOST_ASSERT(!!_parameters && !!ptraj && ptraj->GetEnv()==GetEnv());
+        if( _parameters->_windowend > _parameters->_windowstart ) {
+            return _PlanPathWindow(ptraj);
+        }
+        return _PlanPath(ptraj, false);
+    }
+
+protected:
+    /// \brief retimes only the waypoints in the window of the parameters and stitches them back into ptraj
+    ///
+    /// The window is copied into its own trajectory and retimed with the velocities of the boundary waypoints fixed, so the timing of the waypoints outside of it does not change.
+    PlannerStatus _PlanPathWindow(TrajectoryBasePtr ptraj)
+    {
+        const ConfigurationSpecification& trajspec = ptraj->GetConfigurationSpecification();
+        int windowstart = _parameters->_windowstart, windowend = min(_parameters->_windowend, (int)ptraj->GetNumWaypoints()-1);
+        if( windowstart < 0 || windowend <= windowstart ) {
+            RAVELOG_WARN(str(boost::format("retime window [%d, %d] is not valid for trajectory with %d points")%_parameters->_windowstart%_parameters->_windowend%ptraj->GetNumWaypoints()));
+            return PS_Failed;
+        }
+        std::vector<ConfigurationSpecification::Group>::const_iterator itgrouptime = trajspec.FindCompatibleGroup("deltatime",true);
+        if( itgrouptime == trajspec._vgroups.end() ) {
+            RAVELOG_WARN("trajectory needs to be timed before a window can be retimed\n");
+            return PS_Failed;
+        }
+        ConfigurationSpecification velspec = _parameters->_configurationspecification.ConvertToVelocitySpecification();
+        FOREACH(itgroup,velspec._vgroups) {
+            if( trajspec.FindCompatibleGroup(*itgroup,true) == trajspec._vgroups.end() ) {
+                RAVELOG_WARN(str(boost::format("trajectory does not have velocity group '%s' needed for the window boundaries")%itgroup->name));
+                return PS_Failed;
+            }
+        }
+
+        int trajdof = trajspec.GetDOF();
+        std::vector<dReal> vwindowdata;
+        ptraj->GetWaypoints(windowstart,windowend+1,vwindowdata);
+        // the time and the extra data of the boundaries have to be preserved when stitching
+        std::vector<dReal> vstartpoint(vwindowdata.begin(), vwindowdata.begin()+trajdof), vendpoint(vwindowdata.end()-trajdof, vwindowdata.end());
+        TrajectoryBasePtr ptrajwindow = RaveCreateTrajectory(GetEnv(),ptraj->GetXMLId());
+        ptrajwindow->Init(trajspec);
+        ptrajwindow->Insert(0,vwindowdata);
+        PlannerStatus status = _PlanPath(ptrajwindow, true);
+        if( !(status & PS_HasSolution) ) {
+            return status;
+        }
+
+        size_t numwindowpoints = ptrajwindow->GetNumWaypoints();
+        vwindowdata.resize(numwindowpoints*trajdof);
+        for(size_t i = 0; i < numwindowpoints; ++i) {
+            // new points in the window have the extra data of the start
+            std::copy(vstartpoint.begin(), vstartpoint.end(), vwindowdata.begin()+i*trajdof);
+        }
+        std::copy(vendpoint.begin(), vendpoint.end(), vwindowdata.end()-trajdof);
+        ptrajwindow->GetWaypoints(0,numwindowpoints,_vtempdata0);
+        ConfigurationSpecification::ConvertData(vwindowdata.begin(), trajspec, _vtempdata0.begin(), ptrajwindow->GetConfigurationSpecification(), numwindowpoints, GetEnv(), false);
+        vwindowdata.at(itgrouptime->offset) = vstartpoint.at(itgrouptime->offset);
+        ptraj->Remove(windowstart,windowend+1);
+        ptraj->Insert(windowstart,vwindowdata);
+        RAVELOG_VERBOSE(str(boost::format("%s retimed window [%d, %d] into %d points")%GetXMLId()%windowstart%windowend%numwindowpoints));
+        return status;
+    }
+
+    /// \brief retimes all the waypoints of ptraj
+    ///
+    /// \param bKeepBoundaryVelocities if true, the velocities of the first and last waypoints are taken from ptraj instead of being set to 0
+    PlannerStatus _PlanPath(TrajectoryBasePtr ptraj, bool bKeepBoundaryVelocities)
+    {
+        // TODO there's a lot of info that is being recomputed which could be cached depending on the configurationspace of the incoming trajectory
         BOOST_ASSERT(_parameters->GetDOF() == _parameters->_configurationspecification.GetDOF());
         std::vector<ConfigurationSpecification::Group>::const_iterator itoldgrouptime = ptraj->GetConfigurationSpecification().FindCompatibleGroup("deltatime",false);
         if( _parameters->_hastimestamps && itoldgrouptime == ptraj->GetConfigurationSpecification()._vgroups.end() ) {
@@ -303,13 +368,21 @@ public:
                 ptraj->GetWaypoints(0,numpoints,_vtempdata0,velspec);
                 ConfigurationSpecification::ConvertData(_vdata.begin(),_cachednewspec,_vtempdata0.begin(),velspec,numpoints,GetEnv(),false);
             }
+            else if( bKeepBoundaryVelocities ) {
+                // the velocities at the ends are fixed by the rest of the trajectory
+                ptraj->GetWaypoint(0,_vtempdata0,velspec);
+                ConfigurationSpecification::ConvertData(_vdata.begin(),_cachednewspec,_vtempdata0.begin(),velspec,1,GetEnv(),false);
+                ptraj->GetWaypoint(numpoints-1,_vtempdata0,velspec);
+                ConfigurationSpecification::ConvertData(_vdata.end()-dof,_cachednewspec,_vtempdata0.begin(),velspec,1,GetEnv(),false);
+            }
             try {
                 std::vector<dReal>::iterator itorgdiff = _vdiffdata.begin()+_cachedoldspec.GetDOF();
                 std::vector<dReal>::iterator itdataprev = itdata;
                 itdata += dof;
                 for(size_t i = 1; i < numpoints; ++i, itdata += dof, itorgdiff += _cachedoldspec.GetDOF()) {
                     dReal mintime = 0;
-                    bool bUseEndVelocity = i+1==numpoints;
+                    // when retiming a window with given velocities, every waypoint has to reach its velocity
+                    bool bUseEndVelocity = i+1==numpoints || (bKeepBoundaryVelocities && _parameters->_hasvelocities);
                     FOREACH(itmin,_listmintimefns) {
                         dReal fgrouptime = (*itmin)(itorgdiff, itdataprev, itdata,bUseEndVelocity);
                         if( fgrouptime < 0 ) {
@@ -347,7 +420,7 @@ public:
                             }
                         }
                     }
-                    else {
+                    else if( !(bKeepBoundaryVelocities && i+1==numpoints) ) {
                         // given the mintime, fill the velocities
                         FOREACH(itfn,_listvelocityfns) {
                             (*itfn)(itorgdiff, itdataprev, itdata);
@@ -386,7 +459,6 @@ public:
         return PS_HasSolution;
     }
 
-protected:
     // method to be overriden by individual timing types
 
     /// \brief createa s group info
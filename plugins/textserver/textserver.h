@@ -18,12 +18,19 @@
 #define OPENRAVE_TEXTSERVER
 
 #include <openrave/planningutils.h>
+#include <openrave/utils.h>
 #include <cstdlib>
 
 #ifndef _WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <errno.h>
+#define OPENRAVE_TEXTSERVER_EPOLL
+#endif
 #else
 // for some reason there's a clash between winsock.h and winsock2.h, so don't include winsockX directly. Also cannot define WIN32_LEAN_AND_MEAN for vc100
 #undef WIN32_LEAN_AND_MEAN
@@ -41,7 +48,13 @@ typedef int socklen_t;
 #define CLOSESOCKET close
 #endif
 
-/// manages all connections. At the moment, server can handle only one connectino at a time
+/** \brief manages all connections.
+
+    On linux, one thread waits on all the sockets with epoll and splits the received data into lines. The lines are processed by a fixed number of pool threads, the lines of one connection are always processed in order by one thread at a time. On other systems, every connection gets its own thread.
+    The worker functions of all the commands are executed in order on a single worker thread.
+
+    Clients can pipeline requests without waiting for the replies, the replies of a connection are sent in the order of the requests. On linux, a client can switch its connection to binary frames by sending the binary_hello line, see \ref _ParseRequests and \ref _SendReply. Binary requests of commands that return numbers, like robot_getdofvalues, are answered with raw doubles instead of text. All binary values are in the byte order of the server.
+ */
 class SimpleTextServer : public ModuleBase
 {
     // socket just accepts connections
@@ -55,6 +68,7 @@ public:
 
         Socket() {
             bInit = false;
+            bFailed = false;
             client_sockfd = 0;
         }
         ~Socket() {
@@ -101,40 +115,66 @@ public:
             return bInit;
         }
 
+        /// \brief returns true if sending data failed.
+        ///
+        /// SendData is called from the pool threads while the epoll thread reads from the socket, so it never closes the socket. The thread that owns the connection checks the flag and closes it.
+        bool HasFailed() const {
+            boost::mutex::scoped_lock lock(_mutexFailed);
+            return bFailed;
+        }
+
+        int GetSocket() const {
+            return client_sockfd;
+        }
+
+#ifdef OPENRAVE_TEXTSERVER_EPOLL
+        /// \brief reads all the data available without blocking
+        ///
+        /// \return false if the connection was closed
+        bool ReceiveAvailable(string& s)
+        {
+            char buf[4096];
+            while(1) {
+                ssize_t nBytesReceived = recv(client_sockfd, buf, sizeof(buf), MSG_DONTWAIT);
+                if( nBytesReceived > 0 ) {
+                    s.append(buf, nBytesReceived);
+                }
+                else if( nBytesReceived == 0 ) {
+                    return false;
+                }
+                else {
+                    if( errno == EINTR ) {
+                        continue;
+                    }
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+            }
+        }
+#endif
+
+        /// \brief sends a uint32 size followed by the data. On errors, marks the socket as failed instead of closing it, see \ref HasFailed
         void SendData(const void* pdata, int size_to_write)
         {
-            if( client_sockfd == 0 )
+            if( client_sockfd == 0 || HasFailed() )
                 return;
 
             int nBytesReceived;
 
 #ifndef _WIN32
-            // check if closed, only for linux systems
-            struct timeval tv;
-            fd_set exfds, writefds;
-
-            tv.tv_sec = 0;
-            tv.tv_usec = 0;
-
-            FD_ZERO(&exfds);
-            FD_ZERO(&writefds);
-            FD_SET(client_sockfd, &exfds);
-
-            // don't care about writefds and exceptfds:
-            int num = select(client_sockfd+1, NULL, NULL, &exfds, &tv);
-
-            if (( num > 0) && FD_ISSET(client_sockfd, &exfds) ) {
+            // check if closed, only for linux systems. poll does not have the FD_SETSIZE limit of select
+            struct pollfd pfd;
+            pfd.fd = client_sockfd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            int num = poll(&pfd, 1, 0);
+
+            if( num > 0 && (pfd.revents & (POLLERR|POLLHUP|POLLNVAL)) ) {
                 RAVELOG_ERROR("socket exception detected\n");
-                Close();
+                _SetFailed();
                 return;
             }
 
-            FD_SET(client_sockfd, &writefds);
-
-            // don't care about writefds and exceptfds:
-            num = select(client_sockfd+1, NULL, &writefds, NULL, &tv);
-
-            if (( num == 0) || !FD_ISSET(client_sockfd, &writefds) ) {
+            if( num <= 0 || !(pfd.revents & POLLOUT) ) {
                 RAVELOG_WARN("no writable socket\n");
                 return;
             }
@@ -151,14 +191,17 @@ public:
 
             if( (nBytesReceived = send(client_sockfd, (char*)&size_to_write, 4, 0)) != 4 ) {
                 RAVELOG_ERROR("failed to send command: %d\n", nBytesReceived);
+                _SetFailed();
                 return;
             }
 
             while(size_to_write > 0 ) {
                 nBytesReceived = send(client_sockfd, pbuf, size_to_write, 0);
                 if( nBytesReceived <= 0 ) {
-                    if( nBytesReceived == -1 )
+                    if( nBytesReceived == -1 ) {
+                        _SetFailed();
                         return;
+                    }
 
                     //perror("failed to read line");
                     continue;
@@ -172,14 +215,32 @@ public:
 
         bool ReadLine(string& s)
         {
+            s.resize(0);
+
+#ifndef _WIN32
+            struct pollfd pfd;
+            pfd.fd = client_sockfd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int num = poll(&pfd, 1, 0);
+
+            if( num > 0 && (pfd.revents & (POLLERR|POLLNVAL)) ) {
+                RAVELOG_ERROR("socket exception detected\n");
+                Close();
+                return false;
+            }
+
+            // POLLHUP with pending data still has to be read, recv returns 0 afterwards
+            if( num <= 0 || !(pfd.revents & (POLLIN|POLLHUP)) ) {
+                return false;
+            }
+#else
             struct timeval tv;
             fd_set readfds, exfds;
-            s.resize(0);
 
             tv.tv_sec = 0;
             tv.tv_usec = 0;
 
-
             FD_ZERO(&exfds);
             FD_SET(client_sockfd, &exfds);
 
@@ -201,6 +262,7 @@ public:
             if (( num == 0) || !FD_ISSET(client_sockfd, &readfds) ) {
                 return false;
             }
+#endif
 
             // protocol: size1 size2 "size1 bytes" "size2 bytes"
             long nBytesReceived;
@@ -235,11 +297,18 @@ public:
         }
 
 private:
+        void _SetFailed() {
+            boost::mutex::scoped_lock lock(_mutexFailed);
+            bFailed = true;
+        }
+
         int client_sockfd;
         int client_len;
 
         struct sockaddr_in client_address;
         bool bInit;
+        bool bFailed; ///< protected by _mutexFailed
+        mutable boost::mutex _mutexFailed;
     };
     typedef boost::shared_ptr<Socket> SocketPtr;
     typedef boost::shared_ptr<Socket const> SocketConstPtr;
@@ -249,6 +318,9 @@ private:
     /// \param boost::shared_ptr<void> is a pointer to a void that willl be passed to the worker thread function
     typedef boost::function<bool (istream&, ostream&, boost::shared_ptr<void>&)> OpenRaveNetworkFn;
     typedef boost::function<bool (boost::shared_ptr<istream>, boost::shared_ptr<void>)> OpenRaveWorkerFn;
+    /// \param in is the data passed from the network
+    /// \param out is the return data that will be sent as raw doubles to binary clients
+    typedef boost::function<bool (istream&, std::vector<dReal>&)> OpenRaveBinaryFn;
 
     /// each network function has a function to intially processes the data on the socket function
     /// and one that is executed on the main worker thread to avoid multithreading data synchronization issues
@@ -261,9 +333,42 @@ private:
 
         OpenRaveNetworkFn fnSocketThread;
         OpenRaveWorkerFn fnWorker;
+        OpenRaveBinaryFn fnBinary; ///< optional, used instead of fnSocketThread for binary requests
         bool bReturnResult;     // if true, function is expected to return a result
     };
 
+    /// \brief one command received from a client
+    struct Request
+    {
+        Request() : receivetime(0), requestid(0), bBinary(false) {
+        }
+        string line; ///< the command and its arguments
+        uint64_t receivetime; ///< microseconds
+        uint32_t requestid; ///< for binary requests, returned with the reply
+        bool bBinary;
+    };
+
+    /// \brief the received requests of a client that have not been processed yet
+    struct Connection
+    {
+        Connection(SocketPtr psocket) : psocket(psocket), bProcessing(false), bBinary(false) {
+        }
+        SocketPtr psocket;
+        string sbuffer; ///< data after the last complete request
+        list<Request> listrequests;
+        bool bProcessing; ///< true if a pool thread is processing the requests or the connection is queued
+        bool bBinary; ///< true after binary_hello was received, only accessed by the epoll thread
+    };
+    typedef boost::shared_ptr<Connection> ConnectionPtr;
+
+    struct CommandStatistics
+    {
+        CommandStatistics() : count(0), totaltime(0), maxtime(0) {
+        }
+        uint64_t count;
+        uint64_t totaltime, maxtime; ///< microseconds from receiving the line to sending the result or finishing the worker function
+    };
+
 public:
     SimpleTextServer(EnvironmentBasePtr penv) : ModuleBase(penv) {
         _nIdIndex = 1;
@@ -316,6 +421,15 @@ public:
         mapNetworkFns["setoptions"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvSetOptions,this,_1,_2,_3), boost::bind(&SimpleTextServer::worSetOptions,this,_1,_2), false);
         mapNetworkFns["test"] = RAVENETWORKFN(OpenRaveNetworkFn(), OpenRaveWorkerFn(), false);
         mapNetworkFns["wait"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvWait,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["server_getstatistics"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orServerGetStatistics,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["binary_hello"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orServerBinaryHello,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["body_getjoints"].fnBinary = boost::bind(&SimpleTextServer::obBodyGetJointValues,this,_1,_2);
+        mapNetworkFns["body_getlinks"].fnBinary = boost::bind(&SimpleTextServer::obBodyGetLinks,this,_1,_2);
+        mapNetworkFns["robot_getdofvalues"].fnBinary = boost::bind(&SimpleTextServer::obRobotGetDOFValues,this,_1,_2);
+
+        RegisterCommand("GetStatistics",boost::bind(&SimpleTextServer::_GetStatisticsCommand,this,_1,_2),
+                        "returns a line for every command that was called with the command name, the number of calls, and the average and maximum latency in milliseconds. If followed by 'reset', resets the statistics.");
+        _nNumPoolThreads = 0;
 
         string logfilename = RaveGetHomeDirectory() + string("/textserver.log");
         flog.open(logfilename.c_str());
@@ -330,8 +444,10 @@ public:
     virtual int main(const std::string& cmd)
     {
         _nPort = 4765;
+        _nNumPoolThreads = max(2, (int)boost::thread::hardware_concurrency());
         stringstream ss(cmd);
-        ss >> _nPort;
+        ss >> _nPort >> _nNumPoolThreads;
+        _nNumPoolThreads = max(1, _nNumPoolThreads);
 
         Destroy();
 
@@ -401,7 +517,14 @@ public:
 #endif
 
         RAVELOG_INFO("text server listening on port %d\n",_nPort);
+#ifdef OPENRAVE_TEXTSERVER_EPOLL
+        _servthread.reset(new boost::thread(boost::bind(&SimpleTextServer::_epoll_threadcb,this)));
+        for(int i = 0; i < _nNumPoolThreads; ++i) {
+            _listReadThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&SimpleTextServer::_pool_threadcb,this))));
+        }
+#else
         _servthread.reset(new boost::thread(boost::bind(&SimpleTextServer::_listen_threadcb,this)));
+#endif
         _workerthread.reset(new boost::thread(boost::bind(&SimpleTextServer::_worker_threadcb,this)));
         bInitThread = true;
         return 0;
@@ -429,11 +552,17 @@ public:
             }
             _servthread.reset();
 
+            {
+                // pool threads check bCloseThread with the lock
+                boost::mutex::scoped_lock lock(_mutexConnections);
+                _condConnections.notify_all();
+            }
             FOREACH(it, _listReadThreads) {
                 _condWorker.notify_all();
                 (*it)->join();
             }
             _listReadThreads.clear();
+            _listReadyConnections.clear();
             _condHasWork.notify_all();
             if( !!_workerthread ) {
                 _workerthread->join();
@@ -556,95 +685,381 @@ private:
     void _read_threadcb(SocketPtr psocket)
     {
         RAVELOG_VERBOSE("started new server connection\n");
-        string cmd, line;
-        stringstream sout;
+        string line;
         while(!bCloseThread) {
             if( psocket->ReadLine(line) && line.length() ) {
+                Request request;
+                request.line = line;
+                request.receivetime = utils::GetMicroTime();
+                _ProcessRequest(psocket, request);
+            }
+            else if( !psocket->IsInit() || psocket->HasFailed() ) {
+                break;
+            }
+            usleep(1000);
+        }
 
-                if( !!flog &&( GetEnv()->GetDebugLevel()>0) ) {
-                    static int index=0;
-                    flog << index++ << ": " << line << endl;
-                }
+        RAVELOG_VERBOSE("Closing socket connection\n");
+    }
 
-                boost::shared_ptr<istream> is(new stringstream(line));
-                *is >> cmd;
-                if( !*is ) {
-                    RAVELOG_ERROR("Failed to get command\n");
-                    psocket->SendData("error\n",1);
-                    continue;
+#ifdef OPENRAVE_TEXTSERVER_EPOLL
+    /// \brief accepts new connections and reads the data of all connections
+    void _epoll_threadcb()
+    {
+        int epollfd = epoll_create(16);
+        if( epollfd < 0 ) {
+            RAVELOG_ERROR("failed to create epoll instance\n");
+            return;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = server_sockfd;
+        if( epoll_ctl(epollfd, EPOLL_CTL_ADD, server_sockfd, &ev) < 0 ) {
+            RAVELOG_ERROR("failed to add server socket to epoll\n");
+            CLOSESOCKET(epollfd);
+            return;
+        }
+
+        map<int, ConnectionPtr> mapconnections;
+        std::vector<struct epoll_event> vevents(64);
+        while(!bCloseThread) {
+            // time out to check bCloseThread
+            int numevents = epoll_wait(epollfd, &vevents[0], vevents.size(), 100);
+            // the pool threads only flag the connections they failed to send to, remove them here so that their sockets are closed once the pool threads release them
+            for(map<int, ConnectionPtr>::iterator itconnection = mapconnections.begin(); itconnection != mapconnections.end(); ) {
+                if( itconnection->second->psocket->HasFailed() ) {
+                    RAVELOG_VERBOSE("Closing failed socket connection\n");
+                    epoll_ctl(epollfd, EPOLL_CTL_DEL, itconnection->first, &ev);
+                    mapconnections.erase(itconnection++);
                 }
-                std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-                stringstream::streampos inputpos = is->tellg();
-
-                map<string, RAVENETWORKFN>::iterator itfn = mapNetworkFns.find(cmd);
-                if( itfn != mapNetworkFns.end() ) {
-                    bool bCallWorker = true;
-                    boost::shared_ptr<void> pdata;
-
-                    // need to set w.args before pcmdend is modified
-                    sout.str(""); sout.clear();
-                    if( !!itfn->second.fnSocketThread ) {
-                        bool bSuccess = false;
-                        try {
-                            bSuccess = itfn->second.fnSocketThread(*is, sout, pdata);
-                        }
-                        catch(const std::exception& ex) {
-                            RAVELOG_FATAL("server caught exception: %s\n",ex.what());
-                        }
-                        catch(...) {
-                            RAVELOG_FATAL("unknown exception!!\n");
-                        }
-
-                        if( bSuccess ) {
-                            if( itfn->second.bReturnResult ) {
-                                psocket->SendData(sout.str().c_str(), sout.str().size());
-                            }
-                            if( !itfn->second.fnWorker ) {
-                                bCallWorker = false;
-                            }
+                else {
+                    ++itconnection;
+                }
+            }
+            for(int ievent = 0; ievent < numevents; ++ievent) {
+                if( vevents[ievent].data.fd == server_sockfd ) {
+                    while(1) {
+                        SocketPtr psocket(new Socket());
+                        if( !psocket->Accept(server_sockfd) ) {
+                            break;
                         }
-                        else {
-                            bCallWorker = false;
-                            if( !!flog  ) {
-                                flog << " error" << endl;
-                            }
-                            if( itfn->second.bReturnResult ) {
-                                psocket->SendData("error\n", 6);
-                            }
+                        ev.events = EPOLLIN;
+                        ev.data.fd = psocket->GetSocket();
+                        if( epoll_ctl(epollfd, EPOLL_CTL_ADD, psocket->GetSocket(), &ev) < 0 ) {
+                            RAVELOG_WARN("failed to add connection to epoll\n");
+                            continue;
                         }
+                        RAVELOG_VERBOSE("started new server connection\n");
+                        mapconnections[psocket->GetSocket()].reset(new Connection(psocket));
                     }
-                    else {
-                        if( itfn->second.bReturnResult ) {
-                            psocket->SendData(sout.str().c_str(), sout.str().size());     // return dummy
-                        }
-                        bCallWorker = !!itfn->second.fnWorker;
+                    continue;
+                }
+
+                map<int, ConnectionPtr>::iterator itconnection = mapconnections.find(vevents[ievent].data.fd);
+                if( itconnection == mapconnections.end() ) {
+                    continue;
+                }
+                ConnectionPtr pconnection = itconnection->second;
+                bool bopen = !pconnection->psocket->HasFailed() && !(vevents[ievent].events & (EPOLLERR|EPOLLHUP)) && pconnection->psocket->ReceiveAvailable(pconnection->sbuffer);
+                list<Request> listrequests;
+                if( !_ParseRequests(pconnection, listrequests) ) {
+                    bopen = false;
+                }
+                if( listrequests.size() > 0 ) {
+                    boost::mutex::scoped_lock lock(_mutexConnections);
+                    pconnection->listrequests.splice(pconnection->listrequests.end(), listrequests);
+                    if( !pconnection->bProcessing ) {
+                        pconnection->bProcessing = true;
+                        _listReadyConnections.push_back(pconnection);
+                        _condConnections.notify_one();
                     }
+                }
+                if( !bopen ) {
+                    // the socket is closed when the pool threads release the connection
+                    RAVELOG_VERBOSE("Closing socket connection\n");
+                    epoll_ctl(epollfd, EPOLL_CTL_DEL, itconnection->first, &ev);
+                    mapconnections.erase(itconnection);
+                }
+            }
+        }
+        mapconnections.clear();
+        CLOSESOCKET(epollfd);
+        RAVELOG_DEBUG("**Server thread exiting\n");
+    }
+
+    /** \brief splits the received data of the connection into requests
+
+        Text requests are lines. After a binary_hello line, every request is a frame of a uint32 size followed by size bytes: a uint32 request id and the command line.
+        \return false if the data is invalid and the connection should be closed
+     */
+    bool _ParseRequests(ConnectionPtr pconnection, list<Request>& listrequests)
+    {
+        const string& sbuffer = pconnection->sbuffer;
+        uint64_t receivetime = utils::GetMicroTime();
+        size_t startpos = 0;
+        bool bvalid = true;
+        while(startpos < sbuffer.size()) {
+            if( pconnection->bBinary ) {
+                if( sbuffer.size()-startpos < 4 ) {
+                    break;
+                }
+                uint32_t size = 0;
+                memcpy(&size, &sbuffer[startpos], 4);
+                if( size < 4 || size > s_nMaxRequestSize ) {
+                    RAVELOG_WARN(str(boost::format("invalid binary request size %d\n")%size));
+                    bvalid = false;
+                    break;
+                }
+                if( sbuffer.size()-startpos < 4+(size_t)size ) {
+                    break;
+                }
+                Request request;
+                memcpy(&request.requestid, &sbuffer[startpos+4], 4);
+                request.line = sbuffer.substr(startpos+8, size-4);
+                request.receivetime = receivetime;
+                request.bBinary = true;
+                listrequests.push_back(request);
+                startpos += 4+size;
+            }
+            else {
+                size_t pos = sbuffer.find_first_of("\r\n", startpos);
+                if( pos == string::npos ) {
+                    break;
+                }
+                if( pos > startpos ) {
+                    Request request;
+                    request.line = sbuffer.substr(startpos, pos-startpos);
+                    request.receivetime = receivetime;
+                    listrequests.push_back(request);
+                    // the data after the hello can already be binary
+                    string cmd;
+                    stringstream ss(request.line);
+                    ss >> cmd;
+                    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+                    pconnection->bBinary = cmd == "binary_hello";
+                }
+                startpos = pos+1;
+            }
+        }
+        pconnection->sbuffer.erase(0, startpos);
+        return bvalid;
+    }
 
-                    if( bCallWorker ) {
-                        BOOST_ASSERT(!!itfn->second.fnWorker);
-                        is->clear();
-                        is->seekg(inputpos);
-                        ScheduleWorker(boost::bind(itfn->second.fnWorker,is,pdata));
+    /// \brief processes the requests of the connections that have received data
+    void _pool_threadcb()
+    {
+        while(1) {
+            ConnectionPtr pconnection;
+            Request request;
+            {
+                boost::mutex::scoped_lock lock(_mutexConnections);
+                while(_listReadyConnections.size() == 0 && !bCloseThread) {
+                    _condConnections.wait(lock);
+                }
+                if( bCloseThread ) {
+                    break;
+                }
+                pconnection = _listReadyConnections.front();
+                _listReadyConnections.pop_front();
+                request = pconnection->listrequests.front();
+                pconnection->listrequests.pop_front();
+            }
+
+            _ProcessRequest(pconnection->psocket, request);
+
+            {
+                boost::mutex::scoped_lock lock(_mutexConnections);
+                if( pconnection->listrequests.size() > 0 ) {
+                    // queue at the back so that busy connections do not starve the others
+                    _listReadyConnections.push_back(pconnection);
+                    _condConnections.notify_one();
+                }
+                else {
+                    pconnection->bProcessing = false;
+                }
+            }
+        }
+    }
+#endif
+
+    /// \brief sends the result of a request
+    ///
+    /// Text replies are sent as is. Binary replies are framed as a uint32 size followed by size bytes: the uint32 request id, a uint32 status that is 0 on success, and the data.
+    void _SendReply(SocketPtr psocket, const Request& request, const void* pdata, int size, bool bSuccess)
+    {
+        if( !request.bBinary ) {
+            psocket->SendData(pdata, size);
+            return;
+        }
+        if( !bSuccess ) {
+            size = 0;
+        }
+        std::vector<char> vframe(8+size);
+        uint32_t status = bSuccess ? 0 : 1;
+        memcpy(&vframe[0], &request.requestid, 4);
+        memcpy(&vframe[4], &status, 4);
+        if( size > 0 ) {
+            memcpy(&vframe[8], pdata, size);
+        }
+        psocket->SendData(&vframe[0], vframe.size());
+    }
+
+    /// \brief executes one command received from psocket
+    void _ProcessRequest(SocketPtr psocket, const Request& request)
+    {
+        const string& line = request.line;
+        uint64_t receivetime = request.receivetime;
+        string cmd;
+        stringstream sout;
+        if( !!flog &&( GetEnv()->GetDebugLevel()>0) ) {
+            static int index=0;
+            flog << index++ << ": " << line << endl;
+        }
+
+        boost::shared_ptr<istream> is(new stringstream(line));
+        *is >> cmd;
+        if( !*is ) {
+            RAVELOG_ERROR("Failed to get command\n");
+            _SendReply(psocket, request, "error\n", 1, false);
+            return;
+        }
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        stringstream::streampos inputpos = is->tellg();
+
+        map<string, RAVENETWORKFN>::iterator itfn = mapNetworkFns.find(cmd);
+        if( itfn != mapNetworkFns.end() ) {
+            bool bCallWorker = true;
+            boost::shared_ptr<void> pdata;
+
+            // need to set w.args before pcmdend is modified
+            sout.str(""); sout.clear();
+            if( request.bBinary && !!itfn->second.fnBinary ) {
+                // raw doubles instead of text
+                bool bSuccess = false;
+                std::vector<dReal> vvalues;
+                try {
+                    bSuccess = itfn->second.fnBinary(*is, vvalues);
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_FATAL("server caught exception: %s\n",ex.what());
+                }
+                std::vector<double> vdoubles(vvalues.begin(), vvalues.end());
+                _SendReply(psocket, request, vdoubles.size() > 0 ? &vdoubles[0] : NULL, vdoubles.size()*sizeof(double), bSuccess);
+                bCallWorker = false;
+            }
+            else if( !!itfn->second.fnSocketThread ) {
+                bool bSuccess = false;
+                try {
+                    bSuccess = itfn->second.fnSocketThread(*is, sout, pdata);
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_FATAL("server caught exception: %s\n",ex.what());
+                }
+                catch(...) {
+                    RAVELOG_FATAL("unknown exception!!\n");
+                }
+
+                if( bSuccess ) {
+                    if( itfn->second.bReturnResult ) {
+                        _SendReply(psocket, request, sout.str().c_str(), sout.str().size(), true);
+                    }
+                    if( !itfn->second.fnWorker ) {
+                        bCallWorker = false;
                     }
                 }
                 else {
-                    RAVELOG_ERROR("Failed to recognize command: %s\n", cmd.c_str());
-                    psocket->SendData("error\n",1);
+                    bCallWorker = false;
+                    if( !!flog  ) {
+                        flog << " error" << endl;
+                    }
+                    if( itfn->second.bReturnResult ) {
+                        _SendReply(psocket, request, "error\n", 6, false);
+                    }
                 }
             }
-            else if( !psocket->IsInit() ) {
-                break;
+            else {
+                if( itfn->second.bReturnResult ) {
+                    _SendReply(psocket, request, sout.str().c_str(), sout.str().size(), true);     // return dummy
+                }
+                bCallWorker = !!itfn->second.fnWorker;
             }
-            usleep(1000);
+
+            if( bCallWorker ) {
+                BOOST_ASSERT(!!itfn->second.fnWorker);
+                is->clear();
+                is->seekg(inputpos);
+                ScheduleWorker(boost::bind(&SimpleTextServer::_CallWorkerWithStatistics,this,itfn->second.fnWorker,is,pdata,cmd,receivetime));
+            }
+            else {
+                _RecordStatistics(cmd, receivetime);
+            }
+        }
+        else {
+            RAVELOG_ERROR("Failed to recognize command: %s\n", cmd.c_str());
+            _SendReply(psocket, request, "error\n", 1, false);
         }
+    }
 
-        RAVELOG_VERBOSE("Closing socket connection\n");
+    void _RecordStatistics(const string& cmd, uint64_t receivetime)
+    {
+        uint64_t elapsedtime = utils::GetMicroTime() - receivetime;
+        boost::mutex::scoped_lock lock(_mutexStatistics);
+        CommandStatistics& stats = _mapCommandStatistics[cmd];
+        stats.count++;
+        stats.totaltime += elapsedtime;
+        stats.maxtime = max(stats.maxtime, elapsedtime);
+    }
+
+    void _CallWorkerWithStatistics(const OpenRaveWorkerFn& fnWorker, boost::shared_ptr<istream> is, boost::shared_ptr<void> pdata, const string& cmd, uint64_t receivetime)
+    {
+        fnWorker(is, pdata);
+        _RecordStatistics(cmd, receivetime);
+    }
+
+    /// \param bsingleline if true, writes the number of commands followed by the statistics of all commands on one line, otherwise writes one line per command
+    void _WriteStatistics(ostream& os, bool breset, bool bsingleline)
+    {
+        boost::mutex::scoped_lock lock(_mutexStatistics);
+        if( bsingleline ) {
+            os << _mapCommandStatistics.size();
+        }
+        FOREACHC(it, _mapCommandStatistics) {
+            if( bsingleline ) {
+                os << " ";
+            }
+            os << it->first << " " << it->second.count << " " << (0.001*it->second.totaltime/max(uint64_t(1),it->second.count)) << " " << (0.001*it->second.maxtime);
+            if( !bsingleline ) {
+                os << endl;
+            }
+        }
+        if( breset ) {
+            _mapCommandStatistics.clear();
+        }
+    }
+
+    bool _GetStatisticsCommand(ostream& os, istream& is)
+    {
+        string cmd;
+        is >> cmd;
+        _WriteStatistics(os, cmd == "reset", false);
+        return true;
     }
 
     int _nPort;     ///< port used for listening to incoming connections
 
     boost::shared_ptr<boost::thread> _servthread, _workerthread;
-    list<boost::shared_ptr<boost::thread> > _listReadThreads;
+    list<boost::shared_ptr<boost::thread> > _listReadThreads; ///< connection threads, or the pool threads with epoll
+    int _nNumPoolThreads;
+
+    boost::mutex _mutexConnections; ///< protects _listReadyConnections and the lines of all connections
+    boost::condition _condConnections;
+    list<ConnectionPtr> _listReadyConnections; ///< connections with lines to process that no pool thread is processing
+
+    static const uint32_t s_nMaxRequestSize = 1<<26; ///< larger binary requests close the connection
+
+    boost::mutex _mutexStatistics;
+    map<string, CommandStatistics> _mapCommandStatistics;
 
     boost::mutex _mutexWorker;
     boost::condition _condWorker;
@@ -1113,6 +1528,19 @@ protected:
 
     /// values = orBodyGetLinks(body) - returns the dof values of a kinbody
     bool orBodyGetLinks(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        vector<dReal> values;
+        if( !obBodyGetLinks(is, values) ) {
+            return false;
+        }
+        FOREACHC(it, values) {
+            os << *it << " ";
+        }
+        return true;
+    }
+
+    /// link transforms as 3x4 matrices in column order
+    bool obBodyGetLinks(istream& is, vector<dReal>& values)
     {
         _SyncWithWorkerThread();
         EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
@@ -1122,8 +1550,12 @@ protected:
         }
         vector<Transform> trans;
         body->GetLinkTransformations(trans);
+        values.resize(0);
+        values.reserve(12*trans.size());
         FOREACHC(it, trans) {
-            os << TransformMatrix(*it) << " ";
+            TransformMatrix t(*it);
+            const dReal vmatrix[12] = { t.m[0], t.m[4], t.m[8], t.m[1], t.m[5], t.m[9], t.m[2], t.m[6], t.m[10], t.trans.x, t.trans.y, t.trans.z };
+            values.insert(values.end(), vmatrix, vmatrix+12);
         }
         return true;
     }
@@ -1599,6 +2031,18 @@ protected:
 
     /// values = orBodyGetDOFValues(body, indices) - returns the dof values of a kinbody
     bool orBodyGetJointValues(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        vector<dReal> values;
+        if( !obBodyGetJointValues(is, values) ) {
+            return false;
+        }
+        FOREACH(it,values) {
+            os << *it << " ";
+        }
+        return true;
+    }
+
+    bool obBodyGetJointValues(istream& is, vector<dReal>& values)
     {
         _SyncWithWorkerThread();
         EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
@@ -1606,32 +2050,37 @@ protected:
         if( !pbody ) {
             return false;
         }
-        vector<dReal> values;
         vector<int> ids = vector<int>((istream_iterator<int>(is)), istream_iterator<int>());
-
-        if( ids.size() == 0 ) {
-            pbody->GetDOFValues(values);
-            FOREACH(it,values) {
-                os << *it << " ";
-            }
-        }
-        else {
-            pbody->GetDOFValues(values);
+        pbody->GetDOFValues(values);
+        if( ids.size() > 0 ) {
+            vector<dReal> allvalues;
+            allvalues.swap(values);
             values.reserve(ids.size());
             FOREACH(it,ids) {
                 if(( *it < 0) ||( *it >= pbody->GetDOF()) ) {
                     RAVELOG_ERROR("orBodyGetJointValues bad index\n");
                     return false;
                 }
-                os << values[*it] << " ";
+                values.push_back(allvalues[*it]);
             }
         }
-
         return true;
     }
 
     /// values = orRobotGetDOFValues(body, indices) - returns the dof values of a kinbody
     bool orRobotGetDOFValues(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        vector<dReal> values;
+        if( !obRobotGetDOFValues(is, values) ) {
+            return false;
+        }
+        FOREACH(it,values) {
+            os << *it << " ";
+        }
+        return true;
+    }
+
+    bool obRobotGetDOFValues(istream& is, vector<dReal>& values)
     {
         _SyncWithWorkerThread();
         EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
@@ -1639,26 +2088,23 @@ protected:
         if( !probot ) {
             return false;
         }
-        vector<dReal> values;
         vector<int> ids = vector<int>((istream_iterator<int>(is)), istream_iterator<int>());
-
         if( ids.size() == 0 ) {
             probot->GetActiveDOFValues(values);
-            FOREACH(it,values)
-            os << *it << " ";
         }
         else {
-            probot->GetDOFValues(values);
+            vector<dReal> allvalues;
+            probot->GetDOFValues(allvalues);
+            values.resize(0);
             values.reserve(ids.size());
             FOREACH(it,ids) {
                 if(( *it < 0) ||( *it >= probot->GetDOF()) ) {
                     RAVELOG_ERROR("orBodyGetJointValues bad index\n");
                     return false;
                 }
-                os << values[*it] << " ";
+                values.push_back(allvalues[*it]);
             }
         }
-
         return true;
     }
 
@@ -2292,6 +2738,26 @@ protected:
         return true;
     }
 
+    /// switches the connection to the binary protocol, returns the protocol version
+    bool orServerBinaryHello(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+#ifdef OPENRAVE_TEXTSERVER_EPOLL
+        os << "1";
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// returns one line with the number of commands followed by the name, number of calls, average and maximum latency in milliseconds of every command
+    bool orServerGetStatistics(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        string cmd;
+        is >> cmd;
+        _WriteStatistics(os, cmd == "reset", true);
+        return true;
+    }
+
     /// sends a comment to the problem
     bool orEnvLoadPlugin(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
     {
@@ -105,9 +105,75 @@ public:
     boost::shared_ptr<void const> _handle;
 };
 
+#ifdef OPENRAVE_BININGS_PYARRAY
+
+template <typename T> struct select_npy_type
+{
+    static const int type = NPY_NOTYPE;
+};
+
+template <> struct select_npy_type<double>
+{
+    static const int type = NPY_DOUBLE;
+};
+
+template <> struct select_npy_type<float>
+{
+    static const int type = NPY_FLOAT;
+};
+
+template <> struct select_npy_type<int>
+{
+    static const int type = NPY_INT;
+};
+
+template <> struct select_npy_type<uint8_t>
+{
+    static const int type = NPY_UINT8;
+};
+
+template <> struct select_npy_type<uint32_t>
+{
+    static const int type = NPY_UINT32;
+};
+
+/// \brief copies the buffer of a 1D numpy array directly into v without going through python element access.
+///
+/// Only safe casts are performed, the array is made contiguous only if necessary.
+/// \return false if o is not a 1D numpy array compatible with T, in which case the caller should fall back to element-wise extraction.
+template <typename T>
+inline bool ExtractNumpyArray(const object& o, std::vector<T>& v)
+{
+    if( select_npy_type<T>::type == NPY_NOTYPE || !PyArray_Check(o.ptr()) || PyArray_NDIM((PyArrayObject*)o.ptr()) != 1 ) {
+        return false;
+    }
+    PyObject* pyarray = PyArray_FROMANY(o.ptr(), select_npy_type<T>::type, 1, 1, NPY_CARRAY);
+    if( pyarray == NULL ) {
+        PyErr_Clear();
+        return false;
+    }
+    handle<> harray(pyarray);
+    size_t N = PyArray_SIZE((PyArrayObject*)pyarray);
+    v.resize(N);
+    if( N > 0 ) {
+        memcpy(&v[0], PyArray_DATA((PyArrayObject*)pyarray), N*sizeof(T));
+    }
+    return true;
+}
+
+#endif
+
 template <typename T>
 inline std::vector<T> ExtractArray(const object& o)
 {
+#ifdef OPENRAVE_BININGS_PYARRAY
+    {
+        std::vector<T> v;
+        if( ExtractNumpyArray(o, v) ) {
+            return v;
+        }
+    }
+#endif
     std::vector<T> v(len(o));
     for(size_t i = 0; i < v.size(); ++i) {
         v[i] = extract<T>(o[i]);
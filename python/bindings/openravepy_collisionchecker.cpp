@@ -498,41 +498,44 @@ public:
         if( extract<int>(shape[1]) != 6 ) {
             throw openrave_exception("rays object needs to be a Nx6 vector\n");
         }
-        CollisionReport report;
-        CollisionReportPtr preport(&report,null_deleter());
+        std::vector<RAY> vrays(num);
+        for(int i = 0; i < num; ++i) {
+            vector<dReal> ray = ExtractArray<dReal>(rays[i]);
+            vrays[i].pos.x = ray[0];
+            vrays[i].pos.y = ray[1];
+            vrays[i].pos.z = ray[2];
+            vrays[i].dir.x = ray[3];
+            vrays[i].dir.y = ray[4];
+            vrays[i].dir.z = ray[5];
+        }
+
+        std::vector<dReal> vhitdistances;
+        std::vector<KinBody::LinkConstPtr> vhitlinks;
+        std::vector<CollisionReport::CONTACT> vhitcontacts;
+        {
+            openravepy::PythonThreadSaver statesaver;
+            _pCollisionChecker->CheckCollisionRays(vrays, KinBodyConstPtr(openravepy::GetKinBody(pbody)), vhitdistances, vhitlinks, vhitcontacts);
+        }
 
-        RAY r;
         npy_intp dims[] = { num,6};
         PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
         dReal* ppos = (dReal*)PyArray_DATA(pypos);
         PyObject* pycollision = PyArray_SimpleNew(1,&dims[0], PyArray_BOOL);
         bool* pcollision = (bool*)PyArray_DATA(pycollision);
         for(int i = 0; i < num; ++i, ppos += 6) {
-            vector<dReal> ray = ExtractArray<dReal>(rays[i]);
-            r.pos.x = ray[0];
-            r.pos.y = ray[1];
-            r.pos.z = ray[2];
-            r.dir.x = ray[3];
-            r.dir.y = ray[4];
-            r.dir.z = ray[5];
-            bool bCollision;
-            if( !pbody ) {
-                bCollision = _pCollisionChecker->CheckCollision(r, preport);
-            }
-            else {
-                bCollision = _pCollisionChecker->CheckCollision(r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), preport);
-            }
             pcollision[i] = false;
             ppos[0] = 0; ppos[1] = 0; ppos[2] = 0; ppos[3] = 0; ppos[4] = 0; ppos[5] = 0;
-            if( bCollision &&( report.contacts.size() > 0) ) {
-                if( !bFrontFacingOnly ||( report.contacts[0].norm.dot3(r.dir)<0) ) {
+            // a hit without a contact has a zero normal, it is not reported just like the single ray check
+            if( vhitdistances[i] >= 0 && vhitcontacts[i].norm.lengthsqr3() > 0 ) {
+                const CollisionReport::CONTACT& c = vhitcontacts[i];
+                if( !bFrontFacingOnly ||( c.norm.dot3(vrays[i].dir)<0) ) {
                     pcollision[i] = true;
-                    ppos[0] = report.contacts[0].pos.x;
-                    ppos[1] = report.contacts[0].pos.y;
-                    ppos[2] = report.contacts[0].pos.z;
-                    ppos[3] = report.contacts[0].norm.x;
-                    ppos[4] = report.contacts[0].norm.y;
-                    ppos[5] = report.contacts[0].norm.z;
+                    ppos[0] = c.pos.x;
+                    ppos[1] = c.pos.y;
+                    ppos[2] = c.pos.z;
+                    ppos[3] = c.norm.x;
+                    ppos[4] = c.norm.y;
+                    ppos[5] = c.norm.z;
                 }
             }
         }
@@ -40,6 +40,72 @@ TransformMatrix ExtractTransformMatrix(const object& oraw)
     return ExtractTransformMatrixType<dReal>(oraw);
 }
 
+bool ExtractTransformArray(const object& o, std::vector<Transform>& vtransforms)
+{
+    if( !PyArray_Check(o.ptr()) ) {
+        return false;
+    }
+    PyObject* pyarray = PyArray_FROMANY(o.ptr(), sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT, 2, 3, NPY_CARRAY);
+    if( pyarray == NULL ) {
+        PyErr_Clear();
+        return false;
+    }
+    handle<> harray(pyarray);
+    int ndim = PyArray_NDIM((PyArrayObject*)pyarray);
+    npy_intp* dims = PyArray_DIMS((PyArrayObject*)pyarray);
+    const dReal* pdata = (const dReal*)PyArray_DATA((PyArrayObject*)pyarray);
+    if( ndim == 2 && dims[1] == 7 ) {
+        vtransforms.resize(dims[0]);
+        for(size_t i = 0; i < vtransforms.size(); ++i, pdata += 7) {
+            vtransforms[i].rot = Vector(pdata[0], pdata[1], pdata[2], pdata[3]);
+            vtransforms[i].trans = Vector(pdata[4], pdata[5], pdata[6]);
+        }
+        return true;
+    }
+    if( ndim == 3 && (dims[1] == 3 || dims[1] == 4) && dims[2] == 4 ) {
+        vtransforms.resize(dims[0]);
+        TransformMatrix t;
+        for(size_t i = 0; i < vtransforms.size(); ++i, pdata += dims[1]*4) {
+            for(int j = 0; j < 3; ++j) {
+                t.m[4*j+0] = pdata[4*j+0];
+                t.m[4*j+1] = pdata[4*j+1];
+                t.m[4*j+2] = pdata[4*j+2];
+                t.trans[j] = pdata[4*j+3];
+            }
+            vtransforms[i] = t;
+        }
+        return true;
+    }
+    return false;
+}
+
+object ReturnTransformArray(const std::vector<Transform>& vtransforms)
+{
+    if( s_bReturnTransformQuaternions ) {
+        npy_intp dims[] = { (npy_intp)vtransforms.size(), 7};
+        PyObject *pyvalues = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+        dReal* pdata = (dReal*)PyArray_DATA(pyvalues);
+        FOREACHC(it, vtransforms) {
+            pdata[0] = it->rot.x; pdata[1] = it->rot.y; pdata[2] = it->rot.z; pdata[3] = it->rot.w;
+            pdata[4] = it->trans.x; pdata[5] = it->trans.y; pdata[6] = it->trans.z;
+            pdata += 7;
+        }
+        return static_cast<numeric::array>(handle<>(pyvalues));
+    }
+    npy_intp dims[] = { (npy_intp)vtransforms.size(), 4, 4};
+    PyObject *pyvalues = PyArray_SimpleNew(3,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+    dReal* pdata = (dReal*)PyArray_DATA(pyvalues);
+    FOREACHC(it, vtransforms) {
+        TransformMatrix t(*it);
+        pdata[0] = t.m[0]; pdata[1] = t.m[1]; pdata[2] = t.m[2]; pdata[3] = t.trans.x;
+        pdata[4] = t.m[4]; pdata[5] = t.m[5]; pdata[6] = t.m[6]; pdata[7] = t.trans.y;
+        pdata[8] = t.m[8]; pdata[9] = t.m[9]; pdata[10] = t.m[10]; pdata[11] = t.trans.z;
+        pdata[12] = 0; pdata[13] = 0; pdata[14] = 0; pdata[15] = 1;
+        pdata += 16;
+    }
+    return static_cast<numeric::array>(handle<>(pyvalues));
+}
+
 object toPyArray(const TransformMatrix& t)
 {
     npy_intp dims[] = { 4,4};
@@ -637,41 +703,45 @@ public:
         if( extract<int>(shape[1]) != 6 ) {
             throw openrave_exception("rays object needs to be a Nx6 vector\n");
         }
-        CollisionReport report;
-        CollisionReportPtr preport(&report,null_deleter());
+        std::vector<RAY> vrays(num);
+        for(int i = 0; i < num; ++i) {
+            vector<dReal> ray = ExtractArray<dReal>(rays[i]);
+            vrays[i].pos.x = ray[0];
+            vrays[i].pos.y = ray[1];
+            vrays[i].pos.z = ray[2];
+            vrays[i].dir.x = ray[3];
+            vrays[i].dir.y = ray[4];
+            vrays[i].dir.z = ray[5];
+        }
+
+        std::vector<dReal> vhitdistances;
+        std::vector<KinBody::LinkConstPtr> vhitlinks;
+        std::vector<CollisionReport::CONTACT> vhitcontacts;
+        {
+            openravepy::PythonThreadSaver statesaver;
+            EnvironmentMutex::scoped_lock lock(_penv->GetMutex());
+            _penv->GetCollisionChecker()->CheckCollisionRays(vrays, KinBodyConstPtr(openravepy::GetKinBody(pbody)), vhitdistances, vhitlinks, vhitcontacts);
+        }
 
-        RAY r;
         npy_intp dims[] = { num,6};
         PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
         dReal* ppos = (dReal*)PyArray_DATA(pypos);
         PyObject* pycollision = PyArray_SimpleNew(1,&dims[0], PyArray_BOOL);
         bool* pcollision = (bool*)PyArray_DATA(pycollision);
         for(int i = 0; i < num; ++i, ppos += 6) {
-            vector<dReal> ray = ExtractArray<dReal>(rays[i]);
-            r.pos.x = ray[0];
-            r.pos.y = ray[1];
-            r.pos.z = ray[2];
-            r.dir.x = ray[3];
-            r.dir.y = ray[4];
-            r.dir.z = ray[5];
-            bool bCollision;
-            if( !pbody ) {
-                bCollision = _penv->CheckCollision(r, preport);
-            }
-            else {
-                bCollision = _penv->CheckCollision(r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), preport);
-            }
             pcollision[i] = false;
             ppos[0] = 0; ppos[1] = 0; ppos[2] = 0; ppos[3] = 0; ppos[4] = 0; ppos[5] = 0;
-            if( bCollision &&( report.contacts.size() > 0) ) {
-                if( !bFrontFacingOnly ||( report.contacts[0].norm.dot3(r.dir)<0) ) {
+            // a hit without a contact has a zero normal, it is not reported just like the single ray check
+            if( vhitdistances[i] >= 0 && vhitcontacts[i].norm.lengthsqr3() > 0 ) {
+                const CollisionReport::CONTACT& c = vhitcontacts[i];
+                if( !bFrontFacingOnly ||( c.norm.dot3(vrays[i].dir)<0) ) {
                     pcollision[i] = true;
-                    ppos[0] = report.contacts[0].pos.x;
-                    ppos[1] = report.contacts[0].pos.y;
-                    ppos[2] = report.contacts[0].pos.z;
-                    ppos[3] = report.contacts[0].norm.x;
-                    ppos[4] = report.contacts[0].norm.y;
-                    ppos[5] = report.contacts[0].norm.z;
+                    ppos[0] = c.pos.x;
+                    ppos[1] = c.pos.y;
+                    ppos[2] = c.pos.z;
+                    ppos[3] = c.norm.x;
+                    ppos[4] = c.norm.y;
+                    ppos[5] = c.norm.z;
                 }
             }
         }
@@ -906,10 +976,43 @@ public:
     bool IsSimulationRunning() {
         return _penv->IsSimulationRunning();
     }
+    void SetSimulationSchedulerMode(EnvironmentBase::SimulationSchedulerMode mode) {
+        _penv->SetSimulationSchedulerMode(mode);
+    }
+    EnvironmentBase::SimulationSchedulerMode GetSimulationSchedulerMode() {
+        return _penv->GetSimulationSchedulerMode();
+    }
+    void SetSimulationStepThreads(int numthreads) {
+        _penv->SetSimulationStepThreads(numthreads);
+    }
+    int GetSimulationStepThreads() {
+        return _penv->GetSimulationStepThreads();
+    }
+    object GetSimulationStatistics(bool reset=false)
+    {
+        EnvironmentBase::SimulationStatistics stats;
+        _penv->GetSimulationStatistics(stats,reset);
+        boost::python::dict ostats;
+        ostats["numsteps"] = stats.numsteps;
+        ostats["numoverruns"] = stats.numoverruns;
+        ostats["numskippedsteps"] = stats.numskippedsteps;
+        ostats["numlockfailures"] = stats.numlockfailures;
+        ostats["laststeptime"] = stats.laststeptime;
+        ostats["maxsteptime"] = stats.maxsteptime;
+        ostats["meansteptime"] = stats.meansteptime;
+        ostats["lastjitter"] = stats.lastjitter;
+        ostats["maxjitter"] = stats.maxjitter;
+        ostats["meanjitter"] = stats.meanjitter;
+        ostats["maxlockwaittime"] = stats.maxlockwaittime;
+        ostats["meanlockwaittime"] = stats.meanlockwaittime;
+        return ostats;
+    }
 
     void Lock()
     {
         Py_BEGIN_ALLOW_THREADS;
+        // let a pending fixed step simulation step go first, python threads often lock the environment in a loop
+        _penv->YieldToSimulationStep();
 #if BOOST_VERSION < 103500
         boost::mutex::scoped_lock envlock(_envmutex);
         if( _listfreelocks.size() > 0 ) {
@@ -1243,6 +1346,33 @@ public:
         _penv->UpdatePublishedBodies();
     }
 
+    /// \brief returns (full, version, changedbodies, removedbodyids). Every changed body is a dict with its environmentid, name, dofvalues and linktransforms.
+    object GetPublishedBodiesDelta(object oversion, uint64_t timeout=0)
+    {
+        uint64_t version = extract<uint64_t>(oversion);
+        std::vector<KinBody::BodyState> vchangedbodies;
+        std::vector<int> vremovedbodyids;
+        bool bfull;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bfull = _penv->GetPublishedBodiesDelta(version, vchangedbodies, vremovedbodyids, timeout);
+        }
+        boost::python::list changedbodies;
+        FOREACHC(itstate, vchangedbodies) {
+            boost::python::dict ostate;
+            ostate["environmentid"] = itstate->environmentid;
+            ostate["name"] = itstate->strname;
+            ostate["dofvalues"] = toPyArray(itstate->jointvalues);
+            boost::python::list linktransforms;
+            FOREACHC(ittrans, itstate->vectrans) {
+                linktransforms.append(ReturnTransform(*ittrans));
+            }
+            ostate["linktransforms"] = linktransforms;
+            changedbodies.append(ostate);
+        }
+        return boost::python::make_tuple(bfull, version, changedbodies, toPyArray(vremovedbodyids));
+    }
+
     object Triangulate(PyKinBodyPtr pbody)
     {
         CHECK_POINTER(pbody);
@@ -1399,6 +1529,8 @@ PyInterfaceBasePtr RaveCreateInterface(PyEnvironmentBasePtr pyenv, InterfaceType
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(LoadURI_overloads, LoadURI, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetCamera_overloads, SetCamera, 2, 4)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(StartSimulation_overloads, StartSimulation, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetSimulationStatistics_overloads, GetSimulationStatistics, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetPublishedBodiesDelta_overloads, GetPublishedBodiesDelta, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetViewer_overloads, SetViewer, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckCollisionRays_overloads, CheckCollisionRays, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(plot3_overloads, plot3, 2, 4)
@@ -1634,6 +1766,11 @@ The **releasegil** parameter controls whether the python Global Interpreter Lock
                     .def("StopSimulation",&PyEnvironmentBase::StopSimulation, DOXY_FN(EnvironmentBase,StopSimulation))
                     .def("GetSimulationTime",&PyEnvironmentBase::GetSimulationTime, DOXY_FN(EnvironmentBase,GetSimulationTime))
                     .def("IsSimulationRunning",&PyEnvironmentBase::IsSimulationRunning, DOXY_FN(EnvironmentBase,IsSimulationRunning))
+                    .def("SetSimulationSchedulerMode",&PyEnvironmentBase::SetSimulationSchedulerMode, args("mode"), DOXY_FN(EnvironmentBase,SetSimulationSchedulerMode))
+                    .def("GetSimulationSchedulerMode",&PyEnvironmentBase::GetSimulationSchedulerMode, DOXY_FN(EnvironmentBase,GetSimulationSchedulerMode))
+                    .def("SetSimulationStepThreads",&PyEnvironmentBase::SetSimulationStepThreads, args("numthreads"), DOXY_FN(EnvironmentBase,SetSimulationStepThreads))
+                    .def("GetSimulationStepThreads",&PyEnvironmentBase::GetSimulationStepThreads, DOXY_FN(EnvironmentBase,GetSimulationStepThreads))
+                    .def("GetSimulationStatistics",&PyEnvironmentBase::GetSimulationStatistics, GetSimulationStatistics_overloads(args("reset"), DOXY_FN(EnvironmentBase,GetSimulationStatistics)))
                     .def("Lock",Lock1,"Locks the environment mutex.")
                     .def("Lock",Lock2,args("timeout"), "Locks the environment mutex with a timeout.")
                     .def("Unlock",&PyEnvironmentBase::Unlock,"Unlocks the environment mutex.")
@@ -1654,6 +1791,7 @@ The **releasegil** parameter controls whether the python Global Interpreter Lock
                     .def("GetBodies",&PyEnvironmentBase::GetBodies, DOXY_FN(EnvironmentBase,GetBodies))
                     .def("GetSensors",&PyEnvironmentBase::GetSensors, DOXY_FN(EnvironmentBase,GetSensors))
                     .def("UpdatePublishedBodies",&PyEnvironmentBase::UpdatePublishedBodies, DOXY_FN(EnvironmentBase,UpdatePublishedBodies))
+                    .def("GetPublishedBodiesDelta",&PyEnvironmentBase::GetPublishedBodiesDelta, GetPublishedBodiesDelta_overloads(args("version","timeout"), DOXY_FN(EnvironmentBase,GetPublishedBodiesDelta)))
                     .def("Triangulate",&PyEnvironmentBase::Triangulate,args("body"), DOXY_FN(EnvironmentBase,Triangulate))
                     .def("TriangulateScene",&PyEnvironmentBase::TriangulateScene,args("options","name"), DOXY_FN(EnvironmentBase,TriangulateScene))
                     .def("SetDebugLevel",&PyEnvironmentBase::SetDebugLevel,args("level"), DOXY_FN(EnvironmentBase,SetDebugLevel))
@@ -1679,6 +1817,10 @@ The **releasegil** parameter controls whether the python Global Interpreter Lock
                                   .value("AllExceptBody",EnvironmentBase::SO_AllExceptBody)
         ;
         env.attr("TriangulateOptions") = selectionoptions;
+        enum_<EnvironmentBase::SimulationSchedulerMode>("SimulationSchedulerMode" DOXY_ENUM(SimulationSchedulerMode))
+        .value("Adaptive",EnvironmentBase::SSM_Adaptive)
+        .value("FixedStep",EnvironmentBase::SSM_FixedStep)
+        ;
     }
 
     {
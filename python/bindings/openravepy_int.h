@@ -145,6 +145,14 @@ TransformMatrix ExtractTransformMatrix(const object& oraw);
 object toPyArray(const TransformMatrix& t);
 object toPyArray(const Transform& t);
 
+/// \brief extracts a stacked numpy array of transforms of shape Nx7, Nx3x4, or Nx4x4 directly from its buffer.
+///
+/// \return false if o is not a numpy array of a supported shape, in which case each transform has to be extracted separately.
+bool ExtractTransformArray(const object& o, std::vector<Transform>& vtransforms);
+
+/// \brief returns the transforms as one Nx4x4 numpy array, or Nx7 if returnTransformQuaternion is set.
+object ReturnTransformArray(const std::vector<Transform>& vtransforms);
+
 XMLReadablePtr ExtractXMLReadable(object o);
 object toPyXMLReadable(XMLReadablePtr p);
 bool ExtractIkParameterization(object o, IkParameterization& ikparam);
@@ -604,6 +612,7 @@ void init_openravepy_planner();
 PlannerBasePtr GetPlanner(PyPlannerBasePtr);
 PyInterfaceBasePtr toPyPlanner(PlannerBasePtr, PyEnvironmentBasePtr);
 PlannerBase::PlannerParametersConstPtr GetPlannerParametersConst(object);
+PlannerBase::PlannerParametersPtr GetPlannerParameters(object);
 
 object toPyPlannerParameters(PlannerBase::PlannerParametersPtr params);
 void init_openravepy_robot();
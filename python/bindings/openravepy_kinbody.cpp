@@ -1302,7 +1302,10 @@ int PyKinBody::GetDOF() const
 object PyKinBody::GetDOFValues() const
 {
     vector<dReal> values;
-    _pbody->GetDOFValues(values);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->GetDOFValues(values);
+    }
     return toPyArray(values);
 }
 object PyKinBody::GetDOFValues(object oindices) const
@@ -1315,14 +1318,20 @@ object PyKinBody::GetDOFValues(object oindices) const
         return numeric::array(boost::python::list());
     }
     vector<dReal> values;
-    _pbody->GetDOFValues(values,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->GetDOFValues(values,vindices);
+    }
     return toPyArray(values);
 }
 
 object PyKinBody::GetDOFVelocities() const
 {
     vector<dReal> values;
-    _pbody->GetDOFVelocities(values);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->GetDOFVelocities(values);
+    }
     return toPyArray(values);
 }
 
@@ -1336,7 +1345,10 @@ object PyKinBody::GetDOFVelocities(object oindices) const
         return numeric::array(boost::python::list());
     }
     vector<dReal> values;
-    _pbody->GetDOFVelocities(values,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->GetDOFVelocities(values,vindices);
+    }
     return toPyArray(values);
 }
 
@@ -1662,13 +1674,13 @@ object PyKinBody::GetTransformPose() const {
 
 object PyKinBody::GetLinkTransformations(bool returndofbranches) const
 {
-    boost::python::list otransforms;
     vector<Transform> vtransforms;
     std::vector<int> vdofbranches;
-    _pbody->GetLinkTransformations(vtransforms,vdofbranches);
-    FOREACHC(it, vtransforms) {
-        otransforms.append(ReturnTransform(*it));
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->GetLinkTransformations(vtransforms,vdofbranches);
     }
+    object otransforms = ReturnTransformArray(vtransforms);
     if( returndofbranches ) {
         return boost::python::make_tuple(otransforms, toPyArray(vdofbranches));
     }
@@ -1681,15 +1693,23 @@ void PyKinBody::SetLinkTransformations(object transforms, object odofbranches)
     if( numtransforms != _pbody->GetLinks().size() ) {
         throw openrave_exception("number of input transforms not equal to links");
     }
-    std::vector<Transform> vtransforms(numtransforms);
-    for(size_t i = 0; i < numtransforms; ++i) {
-        vtransforms[i] = ExtractTransform(transforms[i]);
+    std::vector<Transform> vtransforms;
+    if( !ExtractTransformArray(transforms, vtransforms) ) {
+        vtransforms.resize(numtransforms);
+        for(size_t i = 0; i < numtransforms; ++i) {
+            vtransforms[i] = ExtractTransform(transforms[i]);
+        }
+    }
+    std::vector<int> vdofbranches;
+    if( !(odofbranches == object()) ) {
+        vdofbranches = ExtractArray<int>(odofbranches);
     }
+    openravepy::PythonThreadSaver statesaver;
     if( odofbranches == object() ) {
         _pbody->SetLinkTransformations(vtransforms);
     }
     else {
-        _pbody->SetLinkTransformations(vtransforms, ExtractArray<int>(odofbranches));
+        _pbody->SetLinkTransformations(vtransforms, vdofbranches);
     }
 }
 
@@ -1925,6 +1945,7 @@ void PyKinBody::SetDOFValues(object o)
     if( (int)values.size() != GetDOF() ) {
         throw openrave_exception("values do not equal to body degrees of freedom");
     }
+    openravepy::PythonThreadSaver statesaver;
     _pbody->SetDOFValues(values,KinBody::CLA_CheckLimits);
 }
 void PyKinBody::SetTransformWithDOFValues(object otrans,object ojoints)
@@ -1937,7 +1958,9 @@ void PyKinBody::SetTransformWithDOFValues(object otrans,object ojoints)
     if( (int)values.size() != GetDOF() ) {
         throw openrave_exception("values do not equal to body degrees of freedom");
     }
-    _pbody->SetDOFValues(values,ExtractTransform(otrans),KinBody::CLA_CheckLimits);
+    Transform t = ExtractTransform(otrans);
+    openravepy::PythonThreadSaver statesaver;
+    _pbody->SetDOFValues(values,t,KinBody::CLA_CheckLimits);
 }
 
 void PyKinBody::SetDOFValues(object o, object indices, uint32_t checklimits)
@@ -1947,6 +1970,7 @@ void PyKinBody::SetDOFValues(object o, object indices, uint32_t checklimits)
     }
     vector<dReal> vsetvalues = ExtractArray<dReal>(o);
     if( indices == object() ) {
+        openravepy::PythonThreadSaver statesaver;
         _pbody->SetDOFValues(vsetvalues,checklimits);
     }
     else {
@@ -1954,6 +1978,7 @@ void PyKinBody::SetDOFValues(object o, object indices, uint32_t checklimits)
             return;
         }
         vector<int> vindices = ExtractArray<int>(indices);
+        openravepy::PythonThreadSaver statesaver;
         _pbody->SetDOFValues(vsetvalues,checklimits, vindices);
     }
 }
@@ -1995,8 +2020,12 @@ object PyKinBody::ComputeJacobianTranslation(int index, object oposition, object
     if( !(oindices == object()) ) {
         vindices = ExtractArray<int>(oindices);
     }
+    Vector position = ExtractVector3(oposition);
     std::vector<dReal> vjacobian;
-    _pbody->ComputeJacobianTranslation(index,ExtractVector3(oposition),vjacobian,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->ComputeJacobianTranslation(index,position,vjacobian,vindices);
+    }
     std::vector<npy_intp> dims(2); dims[0] = 3; dims[1] = vjacobian.size()/3;
     return toPyArray(vjacobian,dims);
 }
@@ -2008,7 +2037,10 @@ object PyKinBody::ComputeJacobianAxisAngle(int index, object oindices)
         vindices = ExtractArray<int>(oindices);
     }
     std::vector<dReal> vjacobian;
-    _pbody->ComputeJacobianAxisAngle(index,vjacobian,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->ComputeJacobianAxisAngle(index,vjacobian,vindices);
+    }
     std::vector<npy_intp> dims(2); dims[0] = 3; dims[1] = vjacobian.size()/3;
     return toPyArray(vjacobian,dims);
 }
@@ -2044,8 +2076,12 @@ object PyKinBody::ComputeHessianTranslation(int index, object oposition, object
         vindices = ExtractArray<int>(oindices);
     }
     size_t dof = vindices.size() == 0 ? (size_t)_pbody->GetDOF() : vindices.size();
+    Vector position = ExtractVector3(oposition);
     std::vector<dReal> vhessian;
-    _pbody->ComputeHessianTranslation(index,ExtractVector3(oposition),vhessian,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->ComputeHessianTranslation(index,position,vhessian,vindices);
+    }
     std::vector<npy_intp> dims(3); dims[0] = dof; dims[1] = 3; dims[2] = dof;
     return toPyArray(vhessian,dims);
 }
@@ -2058,7 +2094,10 @@ object PyKinBody::ComputeHessianAxisAngle(int index, object oindices)
     }
     size_t dof = vindices.size() == 0 ? (size_t)_pbody->GetDOF() : vindices.size();
     std::vector<dReal> vhessian;
-    _pbody->ComputeHessianAxisAngle(index,vhessian,vindices);
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _pbody->ComputeHessianAxisAngle(index,vhessian,vindices);
+    }
     std::vector<npy_intp> dims(3); dims[0] = dof; dims[1] = 3; dims[2] = dof;
     return toPyArray(vhessian,dims);
 }
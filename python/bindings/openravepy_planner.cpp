@@ -66,6 +66,11 @@ public:
             return _paramsread;
         }
 
+        /// \brief returns an empty pointer if the parameters are const
+        PlannerBase::PlannerParametersPtr GetParametersWrite() const {
+            return _paramswrite;
+        }
+
         void SetRobotActiveJoints(PyRobotBasePtr robot)
         {
             if( !_paramswrite ) {
@@ -241,6 +246,15 @@ PlannerBase::PlannerParametersConstPtr GetPlannerParametersConst(object o)
     return PlannerBase::PlannerParametersPtr();
 }
 
+PlannerBase::PlannerParametersPtr GetPlannerParameters(object o)
+{
+    extract<PyPlannerBase::PyPlannerParametersPtr> pyparams(o);
+    if( pyparams.check() ) {
+        return ((PyPlannerBase::PyPlannerParametersPtr)pyparams)->GetParametersWrite();
+    }
+    return PlannerBase::PlannerParametersPtr();
+}
+
 object toPyPlannerParameters(PlannerBase::PlannerParametersPtr params)
 {
     if( !params ) {
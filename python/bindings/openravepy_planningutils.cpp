@@ -165,6 +165,25 @@ PlannerStatus pyRetimeTrajectory(PyTrajectoryBasePtr pytraj, bool hastimestamps=
     return OpenRAVE::planningutils::RetimeTrajectory(openravepy::GetTrajectory(pytraj),hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
 }
 
+object pyRetimeTrajectories(object pytrajectories, bool hastimestamps=false, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", int numthreads=0)
+{
+    std::vector<TrajectoryBasePtr> vtrajectories(len(pytrajectories));
+    for(size_t i = 0; i < vtrajectories.size(); ++i) {
+        extract<PyTrajectoryBasePtr> epytrajectory(pytrajectories[i]);
+        vtrajectories[i] = openravepy::GetTrajectory((PyTrajectoryBasePtr)epytrajectory);
+    }
+    std::vector<PlannerStatus> vstatuses;
+    {
+        openravepy::PythonThreadSaver statesaver;
+        OpenRAVE::planningutils::RetimeTrajectories(vtrajectories,vstatuses,hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters,numthreads);
+    }
+    boost::python::list ostatuses;
+    FOREACHC(itstatus, vstatuses) {
+        ostatuses.append(*itstatus);
+    }
+    return ostatuses;
+}
+
 void pyExtendWaypoint(int index, object odofvalues, object odofvelocities, PyTrajectoryBasePtr pytraj, PyPlannerBasePtr pyplanner)
 {
     OpenRAVE::planningutils::ExtendWaypoint(index, ExtractArray<dReal>(odofvalues), ExtractArray<dReal>(odofvelocities), openravepy::GetTrajectory(pytraj), openravepy::GetPlanner(pyplanner));
@@ -328,6 +347,124 @@ public:
 
 typedef boost::shared_ptr<PyManipulatorIKGoalSampler> PyManipulatorIKGoalSamplerPtr;
 
+class PyDynamicsCollisionConstraint
+{
+public:
+    PyDynamicsCollisionConstraint(object oparameters, object ocheckbodies, int filtermask=0xffffffff)
+    {
+        // the constraint only keeps a weak pointer to the parameters
+        _parameters = openravepy::GetPlannerParameters(oparameters);
+        if( !_parameters ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("DynamicsCollisionConstraint needs non-const planner parameters",ORE_InvalidArguments);
+        }
+        std::list<KinBodyPtr> listCheckBodies;
+        for(int i = 0; i < len(ocheckbodies); ++i) {
+            KinBodyPtr pbody = openravepy::GetKinBody(ocheckbodies[i]);
+            if( !pbody ) {
+                throw OPENRAVE_EXCEPTION_FORMAT0("DynamicsCollisionConstraint checkbodies need to be KinBody objects",ORE_InvalidArguments);
+            }
+            listCheckBodies.push_back(pbody);
+        }
+        _constraint.reset(new OpenRAVE::planningutils::DynamicsCollisionConstraint(_parameters, listCheckBodies, filtermask));
+    }
+    virtual ~PyDynamicsCollisionConstraint() {
+    }
+
+    void SetIntervalCheckMode(OpenRAVE::planningutils::DynamicsCollisionConstraint::IntervalCheckMode mode, dReal fsafetydistance=0.001)
+    {
+        _constraint->SetIntervalCheckMode(mode, fsafetydistance);
+    }
+
+    /// \brief if returnconfigurations is true, returns (ret, checked configurations, checked times), otherwise ret
+    object Check(object oq0, object oq1, object odq0, object odq1, dReal timeelapsed, IntervalType interval, int options=0xffff, bool returnconfigurations=false)
+    {
+        ConstraintFilterReturnPtr filterreturn;
+        if( returnconfigurations ) {
+            filterreturn.reset(new ConstraintFilterReturn());
+            options |= CFO_FillCheckedConfiguration;
+        }
+        int ret = _constraint->Check(ExtractArray<dReal>(oq0), ExtractArray<dReal>(oq1), ExtractArray<dReal>(odq0), ExtractArray<dReal>(odq1), timeelapsed, interval, options, filterreturn);
+        if( !returnconfigurations ) {
+            return object(ret);
+        }
+        std::vector<npy_intp> dims(2);
+        dims[1] = _parameters->GetDOF();
+        dims[0] = dims[1] > 0 ? filterreturn->_configurations.size()/dims[1] : 0;
+        return boost::python::make_tuple(ret, toPyArray(filterreturn->_configurations, dims), toPyArray(filterreturn->_configurationtimes));
+    }
+
+    int GetNumCheckedSamples() const
+    {
+        return _constraint->GetNumCheckedSamples();
+    }
+
+    PlannerBase::PlannerParametersPtr _parameters;
+    boost::shared_ptr<OpenRAVE::planningutils::DynamicsCollisionConstraint> _constraint;
+};
+
+typedef boost::shared_ptr<PyDynamicsCollisionConstraint> PyDynamicsCollisionConstraintPtr;
+
+class PyAsyncPlanner
+{
+public:
+    PyAsyncPlanner(const std::string& plannername, int cloneoptions=Clone_Bodies) : _planner(plannername, cloneoptions) {
+    }
+    virtual ~PyAsyncPlanner() {
+    }
+
+    bool Start(object orobot, object oparameters, dReal fdeadline=0)
+    {
+        RobotBasePtr probot = openravepy::GetRobot(orobot);
+        if( !probot ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("AsyncPlanner needs a robot",ORE_InvalidArguments);
+        }
+        PlannerBase::PlannerParametersConstPtr parameters = openravepy::GetPlannerParametersConst(oparameters);
+        _pyenv = (PyEnvironmentBasePtr)extract<PyEnvironmentBasePtr>(openravepy::toPyEnvironment(orobot));
+        openravepy::PythonThreadSaver statesaver;
+        return _planner.Start(probot, parameters, fdeadline);
+    }
+
+    void Cancel()
+    {
+        _planner.Cancel();
+    }
+
+    bool Wait(dReal ftimeout=0)
+    {
+        openravepy::PythonThreadSaver statesaver;
+        return _planner.Wait(ftimeout);
+    }
+
+    bool IsDone() const
+    {
+        return _planner.IsDone();
+    }
+
+    PlannerStatus GetStatus() const
+    {
+        return _planner.GetStatus();
+    }
+
+    object GetTrajectory() const
+    {
+        TrajectoryBasePtr ptraj = _planner.GetTrajectory();
+        if( !ptraj ) {
+            return object();
+        }
+        return object(openravepy::toPyTrajectory(ptraj, _pyenv));
+    }
+
+    int GetProgressIteration() const
+    {
+        return _planner.GetProgress()._iteration;
+    }
+
+    OpenRAVE::planningutils::AsyncPlanner _planner;
+    PyEnvironmentBasePtr _pyenv; ///< environment of the robot passed to Start, the trajectory is created in it
+};
+
+typedef boost::shared_ptr<PyAsyncPlanner> PyAsyncPlannerPtr;
+
 } // end namespace planningutils
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Sample_overloads, Sample, 0, 2)
@@ -340,12 +477,17 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothTrajectory_overloads, planningutils::pySmo
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeActiveDOFTrajectory_overloads, planningutils::pyRetimeActiveDOFTrajectory, 2, 7)
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeAffineTrajectory_overloads, planningutils::pyRetimeAffineTrajectory, 3, 6)
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeTrajectory_overloads, planningutils::pyRetimeTrajectory, 1, 6)
+BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeTrajectories_overloads, planningutils::pyRetimeTrajectories, 1, 7)
 BOOST_PYTHON_FUNCTION_OVERLOADS(ExtendActiveDOFWaypoint_overloads, planningutils::pyExtendActiveDOFWaypoint, 5, 8)
 BOOST_PYTHON_FUNCTION_OVERLOADS(InsertActiveDOFWaypointWithRetiming_overloads, planningutils::pyInsertActiveDOFWaypointWithRetiming, 5, 8)
 BOOST_PYTHON_FUNCTION_OVERLOADS(InsertWaypointWithSmoothing_overloads, planningutils::pyInsertWaypointWithSmoothing, 4, 7)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPath_overloads, PlanPath, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPath_overloads2, PlanPath, 3, 5)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPath_overloads3, PlanPath, 1, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetIntervalCheckMode_overloads, SetIntervalCheckMode, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Check_overloads, Check, 6, 8)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Start_overloads, Start, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Wait_overloads, Wait, 0, 1)
 
 void InitPlanningUtils()
 {
@@ -375,6 +517,8 @@ void InitPlanningUtils()
                   .staticmethod("RetimeAffineTrajectory")
                   .def("RetimeTrajectory",planningutils::pyRetimeTrajectory, RetimeTrajectory_overloads(args("trajectory","hastimestamps","maxvelmult","maxaccelmult","plannername","plannerparameters"),DOXY_FN1(RetimeTrajectory)))
                   .staticmethod("RetimeTrajectory")
+                  .def("RetimeTrajectories",planningutils::pyRetimeTrajectories, RetimeTrajectories_overloads(args("trajectories","hastimestamps","maxvelmult","maxaccelmult","plannername","plannerparameters","numthreads"),DOXY_FN1(RetimeTrajectories)))
+                  .staticmethod("RetimeTrajectories")
                   .def("ExtendWaypoint",planningutils::pyExtendWaypoint, args("index","dofvalues", "dofvelocities", "trajectory", "planner"),DOXY_FN1(ExtendWaypoint))
                   .staticmethod("ExtendWaypoint")
                   .def("ExtendActiveDOFWaypoint",planningutils::pyExtendActiveDOFWaypoint, ExtendActiveDOFWaypoint_overloads(args("index","dofvalues", "dofvelocities", "trajectory", "robot", "maxvelmult", "maxaccelmult", "plannername"),DOXY_FN1(ExtendActiveDOFWaypoint)))
@@ -429,6 +573,29 @@ void InitPlanningUtils()
         .def(init<const std::string&, const std::string&>(args("plannername", "plannerparameters")))
         .def("PlanPath",&planningutils::PyAffineTrajectoryRetimer::PlanPath,PlanPath_overloads2(args("traj","maxvelocities", "maxaccelerations", "hastimestamps", "releasegil"), DOXY_FN(planningutils::AffineTrajectoryRetimer,PlanPath)))
         ;
+
+        class_<planningutils::PyAsyncPlanner, planningutils::PyAsyncPlannerPtr, boost::noncopyable >("AsyncPlanner", DOXY_CLASS(planningutils::AsyncPlanner), no_init)
+        .def(init<const std::string&, optional<int> >(args("plannername", "cloneoptions")))
+        .def("Start",&planningutils::PyAsyncPlanner::Start,Start_overloads(args("robot","parameters","deadline"), DOXY_FN(planningutils::AsyncPlanner,Start)))
+        .def("Cancel",&planningutils::PyAsyncPlanner::Cancel, DOXY_FN(planningutils::AsyncPlanner,Cancel))
+        .def("Wait",&planningutils::PyAsyncPlanner::Wait,Wait_overloads(args("timeout"), DOXY_FN(planningutils::AsyncPlanner,Wait)))
+        .def("IsDone",&planningutils::PyAsyncPlanner::IsDone, DOXY_FN(planningutils::AsyncPlanner,IsDone))
+        .def("GetStatus",&planningutils::PyAsyncPlanner::GetStatus, DOXY_FN(planningutils::AsyncPlanner,GetStatus))
+        .def("GetTrajectory",&planningutils::PyAsyncPlanner::GetTrajectory, DOXY_FN(planningutils::AsyncPlanner,GetTrajectory))
+        .def("GetProgressIteration",&planningutils::PyAsyncPlanner::GetProgressIteration, "returns the iteration of the last progress reported by the planner")
+        ;
+
+        scope dynamicscollisionconstraint = class_<planningutils::PyDynamicsCollisionConstraint, planningutils::PyDynamicsCollisionConstraintPtr >("DynamicsCollisionConstraint", DOXY_CLASS(planningutils::DynamicsCollisionConstraint), no_init)
+                                            .def(init<object, object, optional<int> >(args("plannerparameters", "checkbodies", "filtermask")))
+                                            .def("SetIntervalCheckMode",&planningutils::PyDynamicsCollisionConstraint::SetIntervalCheckMode,SetIntervalCheckMode_overloads(args("mode","safetydistance"), DOXY_FN(planningutils::DynamicsCollisionConstraint,SetIntervalCheckMode)))
+                                            .def("Check",&planningutils::PyDynamicsCollisionConstraint::Check,Check_overloads(args("q0","q1","dq0","dq1","timeelapsed","interval","options","returnconfigurations"), DOXY_FN(planningutils::DynamicsCollisionConstraint,Check)))
+                                            .def("GetNumCheckedSamples",&planningutils::PyDynamicsCollisionConstraint::GetNumCheckedSamples, DOXY_FN(planningutils::DynamicsCollisionConstraint,GetNumCheckedSamples))
+        ;
+        enum_<OpenRAVE::planningutils::DynamicsCollisionConstraint::IntervalCheckMode>("IntervalCheckMode" DOXY_ENUM(IntervalCheckMode))
+        .value("Discretized",OpenRAVE::planningutils::DynamicsCollisionConstraint::ICM_Discretized)
+        .value("ContinuousCollision",OpenRAVE::planningutils::DynamicsCollisionConstraint::ICM_ContinuousCollision)
+        .value("VanDerCorput",OpenRAVE::planningutils::DynamicsCollisionConstraint::ICM_VanDerCorput)
+        ;
     }
 }
 
@@ -534,7 +534,10 @@ public:
         object CalculateJacobian()
         {
             std::vector<dReal> vjacobian;
-            _pmanip->CalculateJacobian(vjacobian);
+            {
+                openravepy::PythonThreadSaver statesaver;
+                _pmanip->CalculateJacobian(vjacobian);
+            }
             std::vector<npy_intp> dims(2); dims[0] = 3; dims[1] = _pmanip->GetArmIndices().size();
             return toPyArray(vjacobian,dims);
         }
@@ -542,7 +545,10 @@ public:
         object CalculateRotationJacobian()
         {
             std::vector<dReal> vjacobian;
-            _pmanip->CalculateRotationJacobian(vjacobian);
+            {
+                openravepy::PythonThreadSaver statesaver;
+                _pmanip->CalculateRotationJacobian(vjacobian);
+            }
             std::vector<npy_intp> dims(2); dims[0] = 4; dims[1] = _pmanip->GetArmIndices().size();
             return toPyArray(vjacobian,dims);
         }
@@ -550,7 +556,10 @@ public:
         object CalculateAngularVelocityJacobian()
         {
             std::vector<dReal> vjacobian;
-            _pmanip->CalculateAngularVelocityJacobian(vjacobian);
+            {
+                openravepy::PythonThreadSaver statesaver;
+                _pmanip->CalculateAngularVelocityJacobian(vjacobian);
+            }
             std::vector<npy_intp> dims(2); dims[0] = 3; dims[1] = _pmanip->GetArmIndices().size();
             return toPyArray(vjacobian,dims);
         }
@@ -1050,6 +1059,7 @@ public:
     {
         vector<dReal> vvalues = ExtractArray<dReal>(values);
         if( vvalues.size() > 0 ) {
+            openravepy::PythonThreadSaver statesaver;
             _probot->SetActiveDOFValues(vvalues,checklimits);
         }
         else {
@@ -1062,7 +1072,10 @@ public:
             return numeric::array(boost::python::list());
         }
         vector<dReal> values;
-        _probot->GetActiveDOFValues(values);
+        {
+            openravepy::PythonThreadSaver statesaver;
+            _probot->GetActiveDOFValues(values);
+        }
         return toPyArray(values);
     }
 
@@ -121,6 +121,54 @@ public:
         PyCameraIntrinsics intrinsics;
     };
 
+    class PyDepthSensorData : public PySensorData
+    {
+public:
+        PyDepthSensorData(boost::shared_ptr<SensorBase::CameraGeomData> pgeom, boost::shared_ptr<SensorBase::DepthSensorData> pdata) : PySensorData(pdata), intrinsics(pgeom->KK)
+        {
+            if( (int)pdata->vdepthdata.size() != pgeom->height*pgeom->width || pdata->vpointcloud.size() != 3*pdata->vdepthdata.size() ) {
+                throw openrave_exception("bad depth data");
+            }
+            {
+                npy_intp dims[] = { pgeom->height,pgeom->width};
+                PyObject *pyvalues = PyArray_SimpleNew(2,dims, PyArray_FLOAT);
+                if( pdata->vdepthdata.size() > 0 ) {
+                    memcpy(PyArray_DATA(pyvalues),&pdata->vdepthdata[0],pdata->vdepthdata.size()*sizeof(float));
+                }
+                depthdata = static_cast<numeric::array>(handle<>(pyvalues));
+            }
+            {
+                npy_intp dims[] = { pgeom->height,pgeom->width,3};
+                PyObject *pyvalues = PyArray_SimpleNew(3,dims, PyArray_FLOAT);
+                if( pdata->vpointcloud.size() > 0 ) {
+                    memcpy(PyArray_DATA(pyvalues),&pdata->vpointcloud[0],pdata->vpointcloud.size()*sizeof(float));
+                }
+                pointcloud = static_cast<numeric::array>(handle<>(pyvalues));
+            }
+            KK = intrinsics.K;
+        }
+        PyDepthSensorData(boost::shared_ptr<SensorBase::CameraGeomData> pgeom) : PySensorData(SensorBase::ST_Depth), intrinsics(pgeom->KK)
+        {
+            {
+                npy_intp dims[] = { pgeom->height,pgeom->width};
+                PyObject *pyvalues = PyArray_SimpleNew(2,dims, PyArray_FLOAT);
+                memset(PyArray_DATA(pyvalues),0,pgeom->height*pgeom->width*sizeof(float));
+                depthdata = static_cast<numeric::array>(handle<>(pyvalues));
+            }
+            {
+                npy_intp dims[] = { pgeom->height,pgeom->width,3};
+                PyObject *pyvalues = PyArray_SimpleNew(3,dims, PyArray_FLOAT);
+                memset(PyArray_DATA(pyvalues),0,pgeom->height*pgeom->width*3*sizeof(float));
+                pointcloud = static_cast<numeric::array>(handle<>(pyvalues));
+            }
+            KK = intrinsics.K;
+        }
+        virtual ~PyDepthSensorData() {
+        }
+        object depthdata, pointcloud, KK;
+        PyCameraIntrinsics intrinsics;
+    };
+
     class PyJointEncoderSensorData : public PySensorData
     {
 public:
@@ -306,6 +354,8 @@ public:
             return boost::shared_ptr<PySensorData>(new PyTactileSensorData(boost::static_pointer_cast<SensorBase::TactileGeomData>(_psensor->GetSensorGeometry())));
         case SensorBase::ST_Actuator:
             return boost::shared_ptr<PySensorData>(new PyActuatorSensorData(boost::static_pointer_cast<SensorBase::ActuatorGeomData>(_psensor->GetSensorGeometry())));
+        case SensorBase::ST_Depth:
+            return boost::shared_ptr<PySensorData>(new PyDepthSensorData(boost::static_pointer_cast<SensorBase::CameraGeomData>(_psensor->GetSensorGeometry(SensorBase::ST_Depth))));
         case SensorBase::ST_Invalid:
             break;
         }
@@ -359,6 +409,8 @@ public:
             return boost::shared_ptr<PySensorData>(new PyTactileSensorData(boost::static_pointer_cast<SensorBase::TactileGeomData>(_psensor->GetSensorGeometry()), boost::static_pointer_cast<SensorBase::TactileSensorData>(psensordata)));
         case SensorBase::ST_Actuator:
             return boost::shared_ptr<PySensorData>(new PyActuatorSensorData(boost::static_pointer_cast<SensorBase::ActuatorGeomData>(_psensor->GetSensorGeometry()), boost::static_pointer_cast<SensorBase::ActuatorSensorData>(psensordata)));
+        case SensorBase::ST_Depth:
+            return boost::shared_ptr<PySensorData>(new PyDepthSensorData(boost::static_pointer_cast<SensorBase::CameraGeomData>(_psensor->GetSensorGeometry(SensorBase::ST_Depth)), boost::static_pointer_cast<SensorBase::DepthSensorData>(psensordata)));
         case SensorBase::ST_Invalid:
             break;
         }
@@ -468,6 +520,12 @@ void init_openravepy_sensor()
         .def_readonly("imagedata",&PySensorBase::PyCameraSensorData::imagedata)
         .def_readonly("KK",&PySensorBase::PyCameraSensorData::KK)
         ;
+        class_<PySensorBase::PyDepthSensorData, boost::shared_ptr<PySensorBase::PyDepthSensorData>, bases<PySensorBase::PySensorData> >("DepthSensorData", DOXY_CLASS(SensorBase::DepthSensorData),no_init)
+        .def_readonly("transform",&PySensorBase::PyDepthSensorData::transform)
+        .def_readonly("depthdata",&PySensorBase::PyDepthSensorData::depthdata)
+        .def_readonly("pointcloud",&PySensorBase::PyDepthSensorData::pointcloud)
+        .def_readonly("KK",&PySensorBase::PyDepthSensorData::KK)
+        ;
         class_<PySensorBase::PyJointEncoderSensorData, boost::shared_ptr<PySensorBase::PyJointEncoderSensorData>, bases<PySensorBase::PySensorData> >("JointEncoderSensorData", DOXY_CLASS(SensorBase::JointEncoderSensorData),no_init)
         .def_readonly("encoderValues",&PySensorBase::PyJointEncoderSensorData::encoderValues)
         .def_readonly("encoderVelocity",&PySensorBase::PyJointEncoderSensorData::encoderVelocity)
@@ -533,6 +591,7 @@ void init_openravepy_sensor()
         .value("Odometry",SensorBase::ST_Odometry)
         .value("Tactile",SensorBase::ST_Tactile)
         .value("Actuator",SensorBase::ST_Actuator)
+        .value("Depth",SensorBase::ST_Depth)
         ;
         enum_<SensorBase::ConfigureCommand>("ConfigureCommand" DOXY_ENUM(ConfigureCommand))
         .value("PowerOn",SensorBase::CC_PowerOn)
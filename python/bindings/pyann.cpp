@@ -13,6 +13,10 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PY_ARRAY_UNIQUE_SYMBOL PyArrayHandle
+#define OPENRAVE_DISABLE_ASSERT_HANDLER // use the pyann_exception assertion handler
+#include <openrave/openrave.h>
+#include <openrave/planningutils.h>
+
 #include <boost/python.hpp>
 #include <boost/python/exception_translator.hpp>
 #include <boost/python/stl_iterator.hpp>
@@ -23,15 +27,16 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/format.hpp>
 #include <boost/assert.hpp>
+#include <limits>
 
 #define OPENRAVE_BININGS_PYARRAY
 #include "bindings.h"
 
-#include <ANN/ANN.h>
-
 using namespace boost::python;
 using namespace std;
 using namespace openravepy;
+using OpenRAVE::dReal;
+using OpenRAVE::planningutils::NearestNeighborTree;
 
 struct pyann_exception : std::exception
 {
@@ -60,221 +65,223 @@ inline void assertion_failed(char const * expr, char const * function, char cons
 }
 }
 
-class ANNpointManaged
+/// \brief euclidean kd-tree compatible with the ANN kd-tree interface, all distances are squared.
+class PyKDTree
 {
 public:
-    ANNpointManaged(int n) {
-        pt = annAllocPt(n);
+    PyKDTree(int dim, object oweights, object ocircular) {
+        std::vector<dReal> vweights(dim,1.0);
+        std::vector<uint8_t> vcircular;
+        if( oweights != object() ) {
+            vweights = ExtractArray<dReal>(oweights);
+            BOOST_ASSERT((int)vweights.size()==dim);
+        }
+        if( ocircular != object() ) {
+            std::vector<int> vcircularint = ExtractArray<int>(ocircular);
+            BOOST_ASSERT((int)vcircularint.size()==dim);
+            vcircular.insert(vcircular.end(),vcircularint.begin(),vcircularint.end());
+        }
+        _tree.reset(new NearestNeighborTree(vweights,vcircular));
     }
-    virtual ~ANNpointManaged() {
-        annDeallocPt(pt);
+
+    int Insert(object q) {
+        _ExtractPoint(q);
+        return _tree->Insert(_q);
     }
-    ANNpoint pt;
-};
 
-// Constructor from list        TODO: change to iterator
-boost::shared_ptr<ANNkd_tree>       init_from_list(object lst)
-{
-    BOOST_ASSERT(sizeof(ANNdist)==8 || sizeof(ANNdist)==4);
-    BOOST_ASSERT(sizeof(ANNidx)==4);
+    /// \brief adds all the points of the list and builds a balanced tree once
+    void InsertPoints(object lst) {
+        int numpoints = len(lst);
+        std::vector<dReal> vpoints;
+        vpoints.reserve(numpoints*_tree->GetDOF());
+        for(int i = 0; i < numpoints; ++i) {
+            _ExtractPoint(lst[i]);
+            vpoints.insert(vpoints.end(),_q.begin(),_q.end());
+        }
+        _tree->InsertPoints(vpoints);
+    }
 
-    int dimension   = len(lst[0]);
-    int npts        = len(lst);
-    ANNpointArray dataPts     = annAllocPts(npts, dimension);
-
-    // Convert points from Python list to ANNpointArray
-    for (int p = 0; p < len(lst); ++p) {
-        ANNpoint& pt = dataPts[p];
-        for (int c = 0; c < dimension; ++c)
-            pt[c] = extract<ANNcoord>(lst[p][c]);
+    object Search(object q, int k, double eps) {
+        BOOST_ASSERT(k <= _tree->GetSize());
+        _ExtractPoint(q);
+        npy_intp dims[] = { k};
+        PyObject *pydists = PyArray_SimpleNew(1,dims, PyArray_DOUBLE);
+        BOOST_ASSERT(!!pydists);
+        PyObject *pyidx = PyArray_SimpleNew(1,dims, PyArray_INT);
+        if( !pyidx ) {
+            Py_DECREF(pydists);
+        }
+        BOOST_ASSERT(!!pyidx);
+        _SearchK(k, eps, (int*)PyArray_DATA(pyidx), (double*)PyArray_DATA(pydists));
+        return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)));
     }
 
-    boost::shared_ptr<ANNkd_tree>   p(new ANNkd_tree(dataPts, npts, dimension));
-    return p;
-}
+    object SearchArray(object qarray, int k, double eps) {
+        BOOST_ASSERT(k <= _tree->GetSize());
+        int N = len(qarray);
+        if( N == 0 ) {
+            return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()));
+        }
+        npy_intp dims[] = { N,k};
+        PyObject *pydists = PyArray_SimpleNew(2,dims, PyArray_DOUBLE);
+        BOOST_ASSERT(!!pydists);
+        PyObject *pyidx = PyArray_SimpleNew(2,dims, PyArray_INT);
+        if( !pyidx ) {
+            Py_DECREF(pydists);
+        }
+        BOOST_ASSERT(!!pyidx);
+        double* pdists = (double*)PyArray_DATA(pydists);
+        int* pidx = (int*)PyArray_DATA(pyidx);
+        for(int i = 0; i < N; ++i) {
+            _ExtractPoint(qarray[i]);
+            _SearchK(k, eps, pidx, pdists);
+            pidx += k;
+            pdists += k;
+        }
+        return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)));
+    }
 
-void destroy_points(ANNkd_tree& kdtree)
-{
-    ANNpointArray dataPts     = kdtree.thePoints();
-    annDeallocPts(dataPts);
-}
+    object FixedRadiusSearch(object q, double sqRad, int k, double eps) {
+        BOOST_ASSERT(k <= _tree->GetSize());
+        _ExtractPoint(q);
+        int kball = _tree->FindRadius(_q, sqrt(sqRad), _vindices, _vdists);
+        if( k <= 0 || kball <= 0 ) {
+            return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),kball);
+        }
+        npy_intp dims[] = { min(k,kball)};
+        PyObject *pydists = PyArray_SimpleNew(1,dims, PyArray_DOUBLE);
+        BOOST_ASSERT(!!pydists);
+        PyObject *pyidx = PyArray_SimpleNew(1,dims, PyArray_INT);
+        if( !pyidx ) {
+            Py_DECREF(pydists);
+        }
+        BOOST_ASSERT(!!pyidx);
+        _CopyNeighbors(dims[0], (int*)PyArray_DATA(pyidx), (double*)PyArray_DATA(pydists));
+        return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)),kball);
+    }
 
-object search(ANNkd_tree& kdtree, object q, int k, double eps, bool priority = false)
-{
-    BOOST_ASSERT(k <= kdtree.nPoints() && kdtree.theDim() == len(q));
-    ANNpointManaged annq(kdtree.theDim());
-    for (int c = 0; c < kdtree.theDim(); ++c)
-        annq.pt[c] = extract<ANNcoord>(q[c]);
-
-    npy_intp dims[] = { k};
-    PyObject *pydists = PyArray_SimpleNew(1,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    BOOST_ASSERT(!!pydists);
-    PyObject *pyidx = PyArray_SimpleNew(1,dims, PyArray_INT);
-    if( !pyidx )
-        Py_DECREF(pydists);
-    BOOST_ASSERT(!!pyidx);
-    ANNdist* pdists = (ANNdist*)PyArray_DATA(pydists);
-    ANNidx* pidx = (ANNidx*)PyArray_DATA(pyidx);
-
-    std::vector<ANNidx> nn_idx(k);
-    std::vector<ANNdist> dists(k);
-
-    if (priority)
-        kdtree.annkPriSearch(annq.pt, k, pidx, pdists, eps);
-    else
-        kdtree.annkSearch(annq.pt, k, pidx, pdists, eps);
-    return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)));
-}
+    object FixedRadiusSearchArray(object qarray, double sqRad, int k, double eps) {
+        BOOST_ASSERT(k <= _tree->GetSize());
+        int N = len(qarray);
+        if( N == 0 ) {
+            return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),numeric::array(boost::python::list()));
+        }
+        npy_intp dimsball[] = { N};
+        PyObject *pykball = PyArray_SimpleNew(1,dimsball, PyArray_INT);
+        BOOST_ASSERT(!!pykball);
+        int* pkball = (int*)PyArray_DATA(pykball);
+        if( k <= 0 ) {
+            for(int i = 0; i < N; ++i) {
+                _ExtractPoint(qarray[i]);
+                pkball[i] = _tree->FindRadius(_q, sqrt(sqRad), _vindices, _vdists);
+            }
+            return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),static_cast<numeric::array>(handle<>(pykball)));
+        }
 
-object search_array(ANNkd_tree& kdtree, object qarray, int k, double eps, bool priority = false)
-{
-    BOOST_ASSERT(k <= kdtree.nPoints());
-    int N = len(qarray);
-    if( N == 0 )
-        return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()));
-
-    BOOST_ASSERT(len(qarray[0])==kdtree.theDim());
-    ANNpointManaged annq(kdtree.theDim());
-    npy_intp dims[] = { N,k};
-    PyObject *pydists = PyArray_SimpleNew(2,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    BOOST_ASSERT(!!pydists);
-    PyObject *pyidx = PyArray_SimpleNew(2,dims, PyArray_INT);
-    if( !pyidx ) {
-        Py_DECREF(pydists);
+        npy_intp dims[] = { N,k};
+        PyObject *pydists = PyArray_SimpleNew(2,dims, PyArray_DOUBLE);
+        if( !pydists ) {
+            Py_DECREF(pykball);
+        }
+        BOOST_ASSERT(!!pydists);
+        PyObject *pyidx = PyArray_SimpleNew(2,dims, PyArray_INT);
+        if( !pyidx ) {
+            Py_DECREF(pykball);
+            Py_DECREF(pydists);
+        }
+        BOOST_ASSERT(!!pyidx);
+        double* pdists = (double*)PyArray_DATA(pydists);
+        int* pidx = (int*)PyArray_DATA(pyidx);
+        for(int i = 0; i < N; ++i) {
+            _ExtractPoint(qarray[i]);
+            pkball[i] = _tree->FindRadius(_q, sqrt(sqRad), _vindices, _vdists);
+            _CopyNeighbors(k, pidx, pdists);
+            pidx += k;
+            pdists += k;
+        }
+        return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)),static_cast<numeric::array>(handle<>(pykball)));
     }
-    BOOST_ASSERT(!!pyidx);
-    ANNdist* pdists = (ANNdist*)PyArray_DATA(pydists);
-    ANNidx* pidx = (ANNidx*)PyArray_DATA(pyidx);
-
-    std::vector<ANNdist> dists(k);
-    std::vector<ANNidx> nn_idx(k);
-    for(int i = 0; i < N; ++i) {
-        object q = qarray[i];
-        for (int c = 0; c < kdtree.theDim(); ++c)
-            annq.pt[c] = extract<ANNcoord>(q[c]);
-        if (priority)
-            kdtree.annkPriSearch(annq.pt, k, &nn_idx[0], &dists[0], eps);
-        else
-            kdtree.annkSearch(annq.pt, k, &nn_idx[0], &dists[0], eps);
-
-        std::copy(nn_idx.begin(),nn_idx.end(),pidx); pidx += k;
-        std::copy(dists.begin(),dists.end(),pdists); pdists += k;
+
+    /// \brief the point is not returned by any further search, the indices of the other points do not change
+    void Remove(int index) {
+        BOOST_ASSERT(index >= 0 && index < _tree->GetSize());
+        _tree->Remove(index);
     }
 
-    return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)));
-}
+    void Rebuild() {
+        _tree->Rebuild();
+    }
 
-object k_fixed_radius_search(ANNkd_tree& kdtree, object q, double sqRad, int k, double eps)
-{
-    BOOST_ASSERT(k <= kdtree.nPoints() && kdtree.theDim() == len(q));
-    ANNpointManaged annq(kdtree.theDim());
-    for (int c = 0; c < kdtree.theDim(); ++c)
-        annq.pt[c] = extract<ANNcoord>(q[c]);
-
-    if( k <= 0 ) {
-        int kball = kdtree.annkFRSearch(annq.pt, sqRad, k, NULL, NULL, eps);
-        return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),kball);
+    /// \brief returns the point at index with the circular dimensions normalized
+    object GetPoint(int index) {
+        BOOST_ASSERT(index >= 0 && index < _tree->GetSize());
+        _tree->GetPoint(index, _q);
+        npy_intp dims[] = { (npy_intp)_q.size()};
+        PyObject *pypoint = PyArray_SimpleNew(1,dims, PyArray_DOUBLE);
+        BOOST_ASSERT(!!pypoint);
+        std::copy(_q.begin(),_q.end(),(double*)PyArray_DATA(pypoint));
+        return static_cast<numeric::array>(handle<>(pypoint));
     }
 
-    std::vector<ANNdist> dists(k);
-    std::vector<ANNidx> nn_idx(k);
-    int kball = kdtree.annkFRSearch(annq.pt, sqRad, k, &nn_idx[0], &dists[0], eps);
-    if( kball <= 0 )
-        return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),kball);
-
-    npy_intp dims[] = { min(k,kball)};
-    PyObject *pydists = PyArray_SimpleNew(1,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    BOOST_ASSERT(!!pydists);
-    PyObject *pyidx = PyArray_SimpleNew(1,dims, PyArray_INT);
-    if( !pyidx )
-        Py_DECREF(pydists);
-    BOOST_ASSERT(!!pyidx);
-    ANNdist* pdists = (ANNdist*)PyArray_DATA(pydists);
-    ANNidx* pidx = (ANNidx*)PyArray_DATA(pyidx);
-    int addindex=0;
-    for (int i = 0; i < k; ++i) {
-        if (nn_idx[i] != ANN_NULL_IDX) {
-            pdists[addindex] = dists[i];
-            pidx[addindex] = nn_idx[i];
-            addindex++;
-        }
+    int __len__() const {
+        return _tree->GetSize();
     }
 
-    BOOST_ASSERT(kball > k || addindex==kball);
-    return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)),kball);
-}
+    int GetDim() const {
+        return _tree->GetDOF();
+    }
 
-object k_fixed_radius_search_array(ANNkd_tree& kdtree, object qarray, double sqRad, int k, double eps)
-{
-    BOOST_ASSERT(k <= kdtree.nPoints());
-    int N = len(qarray);
-    if( N == 0 )
-        return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),numeric::array(boost::python::list()));
-
-    BOOST_ASSERT(len(qarray[0])==kdtree.theDim());
-    ANNpointManaged annq(kdtree.theDim());
-    npy_intp dimsball[] = { N};
-    PyObject *pykball = PyArray_SimpleNew(1,dimsball, PyArray_INT);
-    BOOST_ASSERT(!!pykball);
-    int* pkball = (int*)PyArray_DATA(pykball);
-
-    if( k <= 0 ) {
-        for(int i = 0; i < N; ++i) {
-            object q = qarray[i];
-            for (int c = 0; c < kdtree.theDim(); ++c)
-                annq.pt[c] = extract<ANNcoord>(q[c]);
-            pkball[i] = kdtree.annkFRSearch(annq.pt, sqRad, k, NULL, NULL, eps);
+protected:
+    void _ExtractPoint(object q) {
+        BOOST_ASSERT(len(q) == _tree->GetDOF());
+        _q.resize(_tree->GetDOF());
+        for (int c = 0; c < _tree->GetDOF(); ++c) {
+            _q[c] = extract<dReal>(q[c]);
         }
-        return boost::python::make_tuple(numeric::array(boost::python::list()).astype("i4"),numeric::array(boost::python::list()),static_cast<numeric::array>(handle<>(pykball)));
     }
 
-    npy_intp dims[] = { N,k};
-    PyObject *pydists = PyArray_SimpleNew(2,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !pydists )
-        Py_DECREF(pykball);
-    BOOST_ASSERT(!!pydists);
-    PyObject *pyidx = PyArray_SimpleNew(2,dims, PyArray_INT);
-    if( !pyidx ) {
-        Py_DECREF(pykball);
-        Py_DECREF(pydists);
-    }
-    BOOST_ASSERT(!!pyidx);
-    ANNdist* pdists = (ANNdist*)PyArray_DATA(pydists);
-    ANNidx* pidx = (ANNidx*)PyArray_DATA(pyidx);
-
-    std::vector<ANNdist> dists(k);
-    std::vector<ANNidx> nn_idx(k);
-    for(int i = 0; i < N; ++i) {
-        object q = qarray[i];
-        for (int c = 0; c < kdtree.theDim(); ++c)
-            annq.pt[c] = extract<ANNcoord>(q[c]);
-        pkball[i] = kdtree.annkFRSearch(annq.pt, sqRad, k, &nn_idx[0], &dists[0], eps);
-
-        std::copy(nn_idx.begin(),nn_idx.end(),pidx); pidx += k;
-        std::copy(dists.begin(),dists.end(),pdists); pdists += k;
+    void _SearchK(int k, double eps, int* pidx, double* pdists) {
+        _tree->FindNearestK(_q, k, _vindices, _vdists, eps);
+        _CopyNeighbors(k, pidx, pdists);
     }
 
-    return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)),static_cast<numeric::array>(handle<>(pykball)));
-}
+    /// \brief copies the first k neighbors, fills the rest with -1 indices and infinite distances like ANN
+    void _CopyNeighbors(int k, int* pidx, double* pdists) {
+        for(int i = 0; i < k; ++i) {
+            if( i < (int)_vindices.size() ) {
+                pidx[i] = _vindices[i];
+                pdists[i] = _vdists[i]*_vdists[i];
+            }
+            else {
+                pidx[i] = -1;
+                pdists[i] = std::numeric_limits<double>::max();
+            }
+        }
+    }
 
-object ksearch(ANNkd_tree& kdtree, object q, int k, double eps)
-{
-    return search(kdtree, q, k, eps, false);
-}
+    boost::shared_ptr<NearestNeighborTree> _tree;
+    std::vector<dReal> _q, _vdists;
+    std::vector<int> _vindices;
+};
 
-object ksearch_array(ANNkd_tree& kdtree, object q, int k, double eps)
+boost::shared_ptr<PyKDTree> init_from_list(object lst, object oweights, object ocircular)
 {
-    return search_array(kdtree, q, k, eps, false);
+    BOOST_ASSERT(len(lst) > 0);
+    int dimension   = len(lst[0]);
+    boost::shared_ptr<PyKDTree> p(new PyKDTree(dimension, oweights, ocircular));
+    p->InsertPoints(lst);
+    return p;
 }
 
-object k_priority_search(ANNkd_tree& kdtree, object q, int k, double eps)
+boost::shared_ptr<PyKDTree> init_from_list1(object lst)
 {
-    return search(kdtree, q, k, eps, true);
+    return init_from_list(lst, object(), object());
 }
 
-object k_priority_search_array(ANNkd_tree& kdtree, object q, int k, double eps)
+int max_pts_visit(int maxpts)
 {
-    return search_array(kdtree, q, k, eps, true);
+    // exact searches are always performed
+    return 0;
 }
 
 BOOST_PYTHON_MODULE(pyANN_int)
@@ -294,20 +301,25 @@ BOOST_PYTHON_MODULE(pyANN_int)
     ;
     exception_translator<pyann_exception>();
 
-    class_<ANNkd_tree, boost::shared_ptr<ANNkd_tree> >("KDTree")
-    .def("__init__", make_constructor(&init_from_list))
-    .def("__del__", &destroy_points)
-
-    .def("kSearch", &ksearch,args("q","k","eps"))
-    .def("kSearchArray", &ksearch_array,args("q","k","eps"))
-    .def("kPriSearch", &k_priority_search,args("q","k","eps"))
-    .def("kPriSearchArray", &k_priority_search_array,args("q","k","eps"))
-    .def("kFRSearch", &k_fixed_radius_search,args("q","sqrad","k","eps"))
-    .def("kFRSearchArray", &k_fixed_radius_search_array,args("qarray","sqrad","k","eps"))
-
-    .def("__len__",             &ANNkd_tree::nPoints)
-    .def("dim",                 &ANNkd_tree::theDim)
+    class_<PyKDTree, boost::shared_ptr<PyKDTree> >("KDTree", no_init)
+    .def("__init__", make_constructor(&init_from_list1))
+    .def("__init__", make_constructor(&init_from_list, default_call_policies(), args("points","weights","circular")))
+
+    .def("insert", &PyKDTree::Insert,args("q"))
+    .def("insertPoints", &PyKDTree::InsertPoints,args("points"))
+    .def("kSearch", &PyKDTree::Search,args("q","k","eps"))
+    .def("kSearchArray", &PyKDTree::SearchArray,args("q","k","eps"))
+    .def("kPriSearch", &PyKDTree::Search,args("q","k","eps"))
+    .def("kPriSearchArray", &PyKDTree::SearchArray,args("q","k","eps"))
+    .def("kFRSearch", &PyKDTree::FixedRadiusSearch,args("q","sqrad","k","eps"))
+    .def("kFRSearchArray", &PyKDTree::FixedRadiusSearchArray,args("qarray","sqrad","k","eps"))
+    .def("remove", &PyKDTree::Remove,args("index"))
+    .def("rebuild", &PyKDTree::Rebuild)
+    .def("getPoint", &PyKDTree::GetPoint,args("index"))
+
+    .def("__len__",             &PyKDTree::__len__)
+    .def("dim",                 &PyKDTree::GetDim)
     ;
 
-    def("max_pts_visit",        &annMaxPtsVisit);
+    def("max_pts_visit",        &max_pts_visit);
 }
@@ -57,7 +57,7 @@ if not __openravepy_build_doc__:
 else:
     from numpy import array
 
-from ..openravepy_int import RaveFindDatabaseFile, IkParameterization, rotationMatrixFromQArray, poseFromMatrix
+from ..openravepy_int import RaveFindDatabaseFile, IkParameterization, rotationMatrixFromQArray, poseFromMatrix, openrave_exception
 from ..openravepy_ext import transformPoints, quatArrayTDist
 from .. import metaclass, pyANN
 from ..misc import SpaceSamplerExtra
@@ -68,6 +68,7 @@ import numpy
 import time
 import os.path
 from os import makedirs
+from tempfile import mkstemp
 from heapq import nsmallest # for nth smallest element
 from optparse import OptionParser
 
@@ -126,6 +127,7 @@ class ReachabilityModel(DatabaseGenerator):
         self.quatdelta = None
         self.kdtree6d = None
         self.kdtree3d = None
+        self.numthreads = None
     def clone(self,envother):
         clone = DatabaseGenerator.clone(self,envother)
         return clone
@@ -234,6 +236,8 @@ class ReachabilityModel(DatabaseGenerator):
             if options.quatdelta is not None:
                 quatdelta=options.quatdelta
             usefreespace=options.usefreespace
+            if hasattr(options,'numthreads') and options.numthreads is not None:
+                self.numthreads = options.numthreads
         if self.robot.GetKinematicsGeometryHash() == 'e829feb384e6417bbf5bd015f1c6b49a' or self.robot.GetKinematicsGeometryHash() == '22548f4f2ecf83e88ae7e2f3b2a0bd08': # wam 7dof
             if maxradius is None:
                 maxradius = 1.1
@@ -268,11 +272,53 @@ class ReachabilityModel(DatabaseGenerator):
                     links.append(newlink)
         return links
 
-    def generatepcg(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
-        """Generate producer, consumer, and gatherer functions allowing parallelization
+    def generate(self,*args,**kwargs):
+        """Generates the reachability with the native ikfast module ComputeReachability command, which solves the IK of all the poses across :attr:`numthreads` cloned environments. If the command is not available, falls back to the python producer/consumer loops of :meth:`.generatepcg`.
         """
         if not self.ikmodel.load():
             self.ikmodel.autogenerate()
+        if self.ikmodel.ikfastproblem is not None:
+            try:
+                return self._generateNative(*args,**kwargs)
+            except openrave_exception, e:
+                log.warn('native reachability generation failed, using python: %s',e)
+        return DatabaseGenerator.generate(self,*args,**kwargs)
+
+    def _generateNative(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
+        starttime = time.time()
+        Trobot,baseanchor,maxradius,xyzdelta,qarray,rotations = self._initgeneration(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
+        qrotations = array([[1.0,0,0,0]]) if translationonly else qarray
+        fd,filename = mkstemp(suffix='.reachability')
+        os.close(fd)
+        try:
+            cmd = 'ComputeReachability robot %s manipname %s maxradius %.15e xyzdelta %.15e baseanchor %.15e %.15e %.15e usefreespace %d numthreads %d filename %s rotations %d '%(self.robot.GetName(),self.manip.GetName(),maxradius,xyzdelta,baseanchor[0],baseanchor[1],baseanchor[2],usefreespace,1 if self.numthreads is None else self.numthreads,filename,len(qrotations))
+            cmd += ' '.join('%.15e'%f for f in qrotations.flat)
+            with self.env:
+                with self.robot:
+                    self.robot.SetTransform(Trobot)
+                    if self.ikmodel.ikfastproblem.SendCommand(cmd) is None:
+                        raise openrave_exception('ComputeReachability failed')
+            f = open(filename,'rb')
+            try:
+                version = numpy.fromfile(f,int32,1)[0]
+                if version != 1:
+                    raise openrave_exception('unknown native reachability version %d'%version)
+                shape = tuple(numpy.fromfile(f,int32,3))
+                self.pointscale = numpy.fromfile(f,float64,2)
+                self.xyzdelta = numpy.fromfile(f,float64,1)[0]
+                self.reachabilitydensity3d = reshape(numpy.fromfile(f,float64,prod(shape)),shape)
+                self.reachability3d = reshape(numpy.fromfile(f,float64,prod(shape)),shape)
+                numstats = numpy.fromfile(f,int32,1)[0]
+                self.reachabilitystats = reshape(numpy.fromfile(f,float64,numstats*8),(numstats,8))
+            finally:
+                f.close()
+        finally:
+            os.remove(filename)
+        log.info('database %s finished in %fs',self.__class__.__name__,time.time()-starttime)
+
+    def _initgeneration(self,maxradius,translationonly,xyzdelta,quatdelta,usefreespace):
+        """Sets the sampling parameters, returns (Trobot,baseanchor,maxradius,xyzdelta,qarray,rotations)
+        """
         # disable every body but the target and robot\
         if xyzdelta is None:
             xyzdelta=0.04
@@ -299,7 +345,6 @@ class ReachabilityModel(DatabaseGenerator):
             if maxradius is None:
                 maxradius = armlength+xyzdelta*sqrt(3.0)*1.05
 
-            allpoints,insideinds,shape,self.pointscale = self.UniformlySampleSpace(maxradius,delta=xyzdelta)
             qarray = SpaceSamplerExtra().sampleSO3(quatdelta=quatdelta)
             rotations = [eye(3)] if translationonly else rotationMatrixFromQArray(qarray)
             self.xyzdelta = xyzdelta
@@ -310,8 +355,17 @@ class ReachabilityModel(DatabaseGenerator):
                 for q in qarray:
                     neighdists.append(nsmallest(2,quatArrayTDist(q,qarray))[1])
                 self.quatdelta = mean(neighdists)
-            log.info('radius: %f, xyzsamples: %d, quatdelta: %f, rot samples: %d, freespace: %d',maxradius,len(insideinds),self.quatdelta,len(rotations),usefreespace)
-            
+        return Trobot,baseanchor,maxradius,xyzdelta,qarray,rotations
+
+    def generatepcg(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
+        """Generate producer, consumer, and gatherer functions allowing parallelization
+        """
+        if not self.ikmodel.load():
+            self.ikmodel.autogenerate()
+        Trobot,baseanchor,maxradius,xyzdelta,qarray,rotations = self._initgeneration(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
+        allpoints,insideinds,shape,self.pointscale = self.UniformlySampleSpace(maxradius,delta=xyzdelta)
+        log.info('radius: %f, xyzsamples: %d, quatdelta: %f, rot samples: %d, freespace: %d',maxradius,len(insideinds),self.quatdelta,len(rotations),usefreespace)
+
         self.reachabilitydensity3d = zeros(prod(shape))
         self.reachability3d = zeros(prod(shape))
         self.reachabilitystats = []
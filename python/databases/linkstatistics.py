@@ -67,7 +67,7 @@ else:
 
 import numpy
 from ..openravepy_ext import transformPoints, openrave_exception
-from ..openravepy_int import RaveFindDatabaseFile, RaveDestroy, Environment, KinBody, rotationMatrixFromQuat, quatRotateDirection, rotationMatrixFromAxisAngle
+from ..openravepy_int import RaveFindDatabaseFile, RaveDestroy, Environment, KinBody, rotationMatrixFromQuat, quatRotateDirection, rotationMatrixFromAxisAngle, RaveCreateModule
 from . import DatabaseGenerator
 from .. import pyANN
 import convexdecomposition
@@ -77,6 +77,7 @@ import os.path
 from optparse import OptionParser
 from itertools import izip
 from os import makedirs
+from tempfile import mkstemp
 
 import logging
 log = logging.getLogger('openravepy.'+__name__.split('.',2)[-1])
@@ -93,6 +94,7 @@ class LinkStatisticsModel(DatabaseGenerator):
         self.jointvolumes = None
         self.affinevolumes = None # affine volumes for x,y,z translation and rotation around x-,y-,z-axes
         self.samplingdelta = None
+        self.numthreads = None
 
     def has(self):
         return self.linkstats is not None and len(self.linkstats)==len(self.robot.GetLinks())
@@ -291,6 +293,8 @@ class LinkStatisticsModel(DatabaseGenerator):
         if options is not None:
             if options.samplingdelta is not None:
                 samplingdelta=options.samplingdelta
+            if hasattr(options,'numthreads') and options.numthreads is not None:
+                self.numthreads = options.numthreads
         # compare hashes here
         if self.robot.GetKinematicsGeometryHash() == 'ba2ac00ac66812b08d5c61678d306dcc'or self.robot.GetKinematicsGeometryHash() == '22548f4f2ecf83e88ae7e2f3b2a0bd08': # wam 7dof
             if samplingdelta is None:
@@ -328,8 +332,55 @@ class LinkStatisticsModel(DatabaseGenerator):
                 
             log.info('Generating swept volumes...')
             self.jointvolumes = [None]*len(self.robot.GetJoints())
-            jointvolumes_points = [None]*len(self.robot.GetJoints())
             density = 0.2*self.samplingdelta
+            volumes = None
+            module = RaveCreateModule(self.env,'LinkStatistics')
+            if module is not None:
+                try:
+                    volumes = self._computeSweptVolumesNative(module)
+                except openrave_exception, e:
+                    log.warn('native swept volume computation failed, using python: %s',e)
+            if volumes is not None:
+                sweptvolumes,jointvolumes,robotvolume = volumes
+                for joint in self.robot.GetJoints():
+                    self.jointvolumes[joint.GetJointIndex()] = self._computeJointVolumeStatistics(sweptvolumes[joint.GetJointIndex()],jointvolumes[joint.GetJointIndex()],density)
+            else:
+                robotvolume = self._computeSweptVolumesPython(density)
+            self._computeAffineVolumeStatistics(robotvolume,density)
+
+    def _computeSweptVolumesNative(self,module):
+        """Computes the joint swept volumes and robot volume with the LinkStatistics module across :attr:`numthreads` threads. Returns (sweptvolumes,jointvolumes,robotvolume).
+        """
+        fd,filename = mkstemp(suffix='.linkstatistics')
+        os.close(fd)
+        try:
+            cmd = 'ComputeSweptVolumes robot %s samplingdelta %.15e numthreads %d filename %s '%(self.robot.GetName(),self.samplingdelta,1 if self.numthreads is None else self.numthreads,filename)
+            for ilink,linkstat in enumerate(self.linkstats):
+                if len(linkstat['volumepoints']) > 0:
+                    cmd += 'linkpoints %d %d '%(ilink,len(linkstat['volumepoints'])) + ' '.join('%.15e'%f for f in linkstat['volumepoints'].flat) + ' '
+            if module.SendCommand(cmd) is None:
+                raise openrave_exception('ComputeSweptVolumes failed')
+            f = open(filename,'rb')
+            try:
+                readpoints = lambda: reshape(numpy.fromfile(f,float64,3*numpy.fromfile(f,int32,1)[0]),(-1,3))
+                sweptvolumes = []
+                jointvolumes = []
+                for joint in self.robot.GetJoints():
+                    sweptvolumes.append(readpoints())
+                    jointvolumes.append(readpoints())
+                robotvolume = readpoints()
+            finally:
+                f.close()
+        finally:
+            os.remove(filename)
+        return sweptvolumes,jointvolumes,robotvolume
+
+    def _computeSweptVolumesPython(self,density):
+        """Computes the joint statistics and returns the robot volume
+        """
+        with self.robot:
+            self.robot.SetTransform(eye(4))
+            jointvolumes_points = [None]*len(self.robot.GetJoints())
             for joint in self.robot.GetDependencyOrderedJoints()[::-1]: # go through all the joints in reverse hierarchical order
                 log.info('joint %d',joint.GetJointIndex())
                 if joint.GetDOF() > 1:
@@ -359,24 +410,7 @@ class LinkStatisticsModel(DatabaseGenerator):
                 R = rotationMatrixFromQuat(quatRotateDirection(-joint.GetAxis(0),[0,0,1]))
                 sweptvolume = dot(sweptvolume,transpose(R))
                 jointvolume = dot(jointvolume,transpose(R))
-                # compute simple statistics and compress the joint volume
-                volumecom = mean(sweptvolume,0)
-                volume = len(sweptvolume)*self.samplingdelta**3
-                log.debug('volume points: %r',sweptvolume.shape)
-                if sweptvolume.size > 1:
-                    volumeinertia = cov(sweptvolume,rowvar=0,bias=1)*volume
-                    # get the cross sections and a dV/dAngle measure
-                    crossarea = c_[sqrt(sum(jointvolume[:,0:2]**2,1)),jointvolume[:,2:]]
-                else:
-                    volumeinertia = zeros((3,3))
-                    crossarea = zeros((0,2))
-                if len(crossarea) > 0:
-                    crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
-                    volumedelta = sum(crossarea[:,0])*density**2
-                else:
-                    volumedelta = 0
-                # don't save sweptvolume until we can do it more efficiently
-                self.jointvolumes[joint.GetJointIndex()] = {'sweptvolume':sweptvolume, 'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volumeinertia':volumeinertia,'volume':volume}
+                self.jointvolumes[joint.GetJointIndex()] = self._computeJointVolumeStatistics(sweptvolume,jointvolume,density)
                 jointvolumes_points[joint.GetJointIndex()] = sweptvolume
                 del sweptvolume
 
@@ -402,33 +436,56 @@ class LinkStatisticsModel(DatabaseGenerator):
                         robotvolume = r_[robotvolume, points[kball==0]]
                         del kdtree
             del jointvolumes_points # not used anymore, so free memory
-            self.affinevolumes = [None]*6
-            # compute for rotation around axes
-            for i in [2]:
-                log.info('rotation %s',('x','y','z')[i])
-                axis = array((0,0,0))
-                axis[i] = 1.0
-                R = rotationMatrixFromQuat(quatRotateDirection(axis,[0,0,1]))
-                volume = dot(robotvolume,transpose(R))
-                # get the cross sections and a dV/dAngle measure
-                crossarea = c_[sqrt(sum(volume[:,0:2]**2,1)),volume[:,2:]]
-                crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
-                # compute simple statistics and compress the joint volume
-                volumedelta = sum(crossarea[:,0])*density**2
-                volumecom = r_[tile(mean(crossarea[:,0]),2),mean(crossarea[:,1])]
-                volume = sum(crossarea[:,0]**2*pi)*density**2
-                self.affinevolumes[3+i] = {'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volume':volume}
-            for i in range(3):
-                log.info('translation %s',('x','y','z')[i])
-                indices = range(3)
-                indices.remove(i)
-                crossarea = robotvolume[:,indices]
-                crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
-                volumedelta = len(crossarea)*density**2
-                volumecom = mean(robotvolume,0)
-                volume = len(robotvolume)*self.samplingdelta**3
-                volumeinertia = cov(robotvolume,rowvar=0,bias=1)*volume
-                self.affinevolumes[i] = {'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volumeinertia':volumeinertia,'volume':volume}
+        return robotvolume
+
+    def _computeJointVolumeStatistics(self,sweptvolume,jointvolume,density):
+        # compute simple statistics and compress the joint volume
+        volumecom = mean(sweptvolume,0)
+        volume = len(sweptvolume)*self.samplingdelta**3
+        log.debug('volume points: %r',sweptvolume.shape)
+        if sweptvolume.size > 1:
+            volumeinertia = cov(sweptvolume,rowvar=0,bias=1)*volume
+            # get the cross sections and a dV/dAngle measure
+            crossarea = c_[sqrt(sum(jointvolume[:,0:2]**2,1)),jointvolume[:,2:]]
+        else:
+            volumeinertia = zeros((3,3))
+            crossarea = zeros((0,2))
+        if len(crossarea) > 0:
+            crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
+            volumedelta = sum(crossarea[:,0])*density**2
+        else:
+            volumedelta = 0
+        # don't save sweptvolume until we can do it more efficiently
+        return {'sweptvolume':sweptvolume, 'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volumeinertia':volumeinertia,'volume':volume}
+
+    def _computeAffineVolumeStatistics(self,robotvolume,density):
+        self.affinevolumes = [None]*6
+        # compute for rotation around axes
+        for i in [2]:
+            log.info('rotation %s',('x','y','z')[i])
+            axis = array((0,0,0))
+            axis[i] = 1.0
+            R = rotationMatrixFromQuat(quatRotateDirection(axis,[0,0,1]))
+            volume = dot(robotvolume,transpose(R))
+            # get the cross sections and a dV/dAngle measure
+            crossarea = c_[sqrt(sum(volume[:,0:2]**2,1)),volume[:,2:]]
+            crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
+            # compute simple statistics and compress the joint volume
+            volumedelta = sum(crossarea[:,0])*density**2
+            volumecom = r_[tile(mean(crossarea[:,0]),2),mean(crossarea[:,1])]
+            volume = sum(crossarea[:,0]**2*pi)*density**2
+            self.affinevolumes[3+i] = {'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volume':volume}
+        for i in range(3):
+            log.info('translation %s',('x','y','z')[i])
+            indices = range(3)
+            indices.remove(i)
+            crossarea = robotvolume[:,indices]
+            crossarea = crossarea[self.PrunePointsKDTree(crossarea, density**2, 1,k=50),:]
+            volumedelta = len(crossarea)*density**2
+            volumecom = mean(robotvolume,0)
+            volume = len(robotvolume)*self.samplingdelta**3
+            volumeinertia = cov(robotvolume,rowvar=0,bias=1)*volume
+            self.affinevolumes[i] = {'crossarea':crossarea,'volumedelta':volumedelta,'volumecom':volumecom,'volumeinertia':volumeinertia,'volume':volume}
 
     @staticmethod
     def ComputeSweptVolume(volumepoints,axis,minangle,maxangle,samplingdelta):
@@ -499,19 +556,15 @@ class LinkStatisticsModel(DatabaseGenerator):
             return {'com':zeros(3),'inertia':zeros((3,3)),'volume':0,'volumepoints':zeros((0,3))}
         minpoint = numpy.min([numpy.min(hull[0],axis=0) for hull in hulls],axis=0)
         maxpoint = numpy.max([numpy.max(hull[0],axis=0) for hull in hulls],axis=0)
-        X,Y,Z = mgrid[minpoint[0]:maxpoint[0]:self.samplingdelta,minpoint[1]:maxpoint[1]:self.samplingdelta,minpoint[2]:maxpoint[2]:self.samplingdelta]
         volumepoints = SpaceSamplerExtra().sampleR3(self.samplingdelta,boxdims=maxpoint-minpoint)
         volumepoints[:,0] += minpoint[0]
         volumepoints[:,1] += minpoint[1]
         volumepoints[:,2] += minpoint[2]
         insidepoints = zeros(len(volumepoints),bool)
-        for i,point in enumerate(volumepoints):
-            if mod(i,10000) == 0:
-                log.debug('%d/%d'%(i,len(volumepoints)))
-            for hull in hulls:
-                if all(dot(hull[2][:,0:3],point)+hull[2][:,3] <= 0):
-                    insidepoints[i] = True
-                    break
+        for hull in hulls:
+            # test the points not inside yet against all the hull planes at once
+            indices = flatnonzero(~insidepoints)
+            insidepoints[indices[numpy.all(dot(volumepoints[indices],transpose(hull[2][:,0:3]))+hull[2][:,3] <= 0,axis=1)]] = True
         volumepoints = volumepoints[insidepoints,:]
         volume = len(volumepoints)*self.samplingdelta**3
         com = mean(volumepoints,0)
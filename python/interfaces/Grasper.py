@@ -17,7 +17,10 @@ from ..openravepy_int import RaveCreateModule, RaveCreateTrajectory, matrixSeria
 from ..openravepy_ext import planning_error
 
 from numpy import *
+import numpy
 from copy import copy as shallowcopy
+from tempfile import mkstemp
+import os
 
 import logging
 log = logging.getLogger('openravepy.interfaces.Grasper')
@@ -107,8 +110,10 @@ class Grasper:
         contacts = reshape(array([float64(s) for s in resvalues],float64),(len(resvalues)/6,6))
         return contacts,finalconfig,mindist,volume
 
-    def GraspThreaded(self,approachrays,standoffs,preshapes,rolls,manipulatordirections=None,target=None,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,forceclosurethreshold=None,collisionchecker=None,translationstepmult=None,numthreads=None,startindex=None,maxgrasps=None,finestep=None):
+    def GraspThreaded(self,approachrays,standoffs,preshapes,rolls,manipulatordirections=None,target=None,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,forceclosurethreshold=None,collisionchecker=None,translationstepmult=None,numthreads=None,startindex=None,maxgrasps=None,finestep=None,startasync=False):
         """See :ref:`module-grasper-graspthreaded`
+
+        :param startasync: if True, returns immediately and the grasps are retrieved with :meth:`GetGraspThreadedResults`
         """
         cmd = 'GraspThreaded '
         if target is not None:
@@ -130,6 +135,8 @@ class Grasper:
             cmd += 'finestep %.15e '%finestep
         if numthreads is not None:
             cmd += 'numthreads %d '%numthreads
+        if startasync:
+            cmd += 'async 1 '
         cmd += 'approachrays %d '%len(approachrays)
         for f in approachrays.flat:
             cmd += str(f) + ' '
@@ -148,9 +155,31 @@ class Grasper:
         res = self.prob.SendCommand(cmd)
         if res is None:
             raise planning_error('Grasp failed')
+        if startasync:
+            return None
+        resultgrasps = res.split()
+        nextid = int(resultgrasps.pop(0))
+        return nextid, self._ParseGraspResults(resultgrasps)
+
+    def GetGraspThreadedResults(self,timeout=None):
+        """Returns the grasps of the last :meth:`GraspThreaded` call that were computed since the last time this was called.
+
+        :param timeout: if not None, waits at most timeout seconds for new grasps
+        :return: (nextid, finished, grasps)
+        """
+        cmd = 'GetGraspThreadedResults '
+        if timeout is not None:
+            cmd += 'timeout %.15e '%timeout
+        res = self.prob.SendCommand(cmd)
+        if res is None:
+            raise planning_error('GetGraspThreadedResults failed')
         resultgrasps = res.split()
-        resvalues=[]
         nextid = int(resultgrasps.pop(0))
+        finished = int(resultgrasps.pop(0))!=0
+        return nextid, finished, self._ParseGraspResults(resultgrasps)
+
+    def _ParseGraspResults(self,resultgrasps):
+        resvalues=[]
         preshapelen = len(self.robot.GetActiveManipulator().GetGripperIndices())
         for i in range(int(resultgrasps.pop(0))):
             position = array([float64(resultgrasps.pop(0)) for i in range(3)])
@@ -167,7 +196,36 @@ class Grasper:
             contacts=[float64(resultgrasps.pop(0)) for i in range(contacts_num*6)]
             contacts = reshape(contacts,(contacts_num,6))
             resvalues.append([position, direction, roll, standoff, manipulatordirection, mindist, volume, preshape,Tfinal,finalshape,contacts])
-        return nextid, resvalues
+        return resvalues
+
+    def ComputeDistanceMap(self,target,center=None,conewidth=None,mapsamples=None,numthreads=None):
+        """See :ref:`module-grasper-computedistancemap`
+
+        Returns a Nx7 array of (distance, normal, position relative to center) for every sampled surface point of the target.
+        """
+        fd,filename = mkstemp(suffix='.distancemap')
+        os.close(fd)
+        try:
+            cmd = 'ComputeDistanceMap target %s filename %s '%(target.GetName(),filename)
+            if center is not None:
+                cmd += 'center %.15e %.15e %.15e '%(center[0],center[1],center[2])
+            if conewidth is not None:
+                cmd += 'conewidth %.15e '%conewidth
+            if mapsamples is not None:
+                cmd += 'mapsamples %d '%mapsamples
+            if numthreads is not None:
+                cmd += 'numthreads %d '%numthreads
+            res = self.prob.SendCommand(cmd)
+            if res is None:
+                raise planning_error('ComputeDistanceMap')
+            f = open(filename,'rb')
+            try:
+                numpoints = numpy.fromfile(f,int32,1)[0]
+                return reshape(numpy.fromfile(f,float64,7*numpoints),(numpoints,7))
+            finally:
+                f.close()
+        finally:
+            os.remove(filename)
 
     def ConvexHull(self,points,returnplanes=True,returnfaces=True,returntriangles=True):
         """See :ref:`module-grasper-convexhull`
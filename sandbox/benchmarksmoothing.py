@@ -0,0 +1,83 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Smooths stored trajectories with the constraint parabolic smoother and reports the time spent merging ramps and the final durations.
+
+Usage::
+
+  python benchmarksmoothing.py --scene=data/lab1.env.xml traj0.xml traj1.xml ...
+
+The trajectories have to be saved from the same scene, for example with TrajectoryBase.serialize.
+"""
+from __future__ import with_statement # for python 2.5
+__copyright__ = 'Copyright (C) 2013'
+__license__ = 'Apache License, Version 2.0'
+
+from openravepy import *
+from numpy import *
+import time
+
+def smoothtrajectory(env,planner,traj,options):
+    """smooths traj in place and returns (status, total time, merge time, number of ramp checks, number of cached ramp checks)
+    """
+    params = Planner.PlannerParameters()
+    with env:
+        params.SetConfigurationSpecification(env,traj.GetConfigurationSpecification().GetTimeDerivativeSpecification(0))
+        params.SetExtraParameters('<_fsteplength>%.15e</_fsteplength><minswitchtime>%.15e</minswitchtime><_nmaxiterations>%d</_nmaxiterations>'%(options.steplength,options.minswitchtime,options.maxiterations))
+        planner.SendCommand('SetMergeCache %d'%(not options.nomergecache))
+        planner.InitPlan(None,params)
+    starttime = time.time()
+    status = planner.PlanPath(traj)
+    totaltime = time.time()-starttime
+    mergetime,numchecks,numcachehits = planner.SendCommand('GetMergeStatistics').split()
+    return status,totaltime,float(mergetime),int(numchecks),int(numcachehits)
+
+def main(env,options,trajfiles):
+    env.Load(options.scene)
+    planner = RaveCreatePlanner(env,'ConstraintParabolicSmoother')
+    print '%-40s %8s %10s %10s %8s %8s %10s %10s'%('trajectory','status','total(s)','merge(s)','checks','cached','before(s)','after(s)')
+    results = []
+    for trajfile in trajfiles:
+        traj = RaveCreateTrajectory(env,'')
+        traj.deserialize(open(trajfile,'r').read())
+        durationbefore = traj.GetDuration()
+        status,totaltime,mergetime,numchecks,numcachehits = smoothtrajectory(env,planner,traj,options)
+        durationafter = traj.GetDuration() if status == PlannerStatus.HasSolution else 0
+        print '%-40s %8s %10.4f %10.4f %8d %8d %10.4f %10.4f'%(trajfile[-40:],status,totaltime,mergetime,numchecks,numcachehits,durationbefore,durationafter)
+        results.append((status == PlannerStatus.HasSolution,totaltime,mergetime,durationafter))
+    solved = [r for r in results if r[0]]
+    if len(solved) > 0:
+        print 'solved %d/%d, mean total time=%fs, mean merge time=%fs, mean final duration=%fs'%(len(solved),len(results),mean([r[1] for r in solved]),mean([r[2] for r in solved]),mean([r[3] for r in solved]))
+
+from optparse import OptionParser
+from openravepy.misc import OpenRAVEGlobalArguments
+
+@openravepy.with_destroy
+def run(args=None):
+    parser = OptionParser(description="Benchmarks the ramp merging of the constraint parabolic smoother over stored trajectories", usage='usage: %prog [options] trajectory.xml ...')
+    OpenRAVEGlobalArguments.addOptions(parser)
+    parser.add_option('--scene',action="store",type='string',dest='scene',default='data/lab1.env.xml',
+                      help='Scene file the trajectories were saved in (default=%default)')
+    parser.add_option('--steplength',action="store",type='float',dest='steplength',default=0.004,
+                      help='Controller time step the ramp switch times are rounded to (default=%default)')
+    parser.add_option('--minswitchtime',action="store",type='float',dest='minswitchtime',default=0.2,
+                      help='Minimum time between two ramp switches (default=%default)')
+    parser.add_option('--maxiterations',action="store",type='int',dest='maxiterations',default=100,
+                      help='Number of shortcut iterations (default=%default)')
+    parser.add_option('--nomergecache',action="store_true",dest='nomergecache',default=False,
+                      help='Check every ramp of the merges instead of reusing the feasibility of ramps that were already checked')
+    (options, leftargs) = parser.parse_args(args=args)
+    env = OpenRAVEGlobalArguments.parseAndCreate(options,defaultviewer=False)
+    main(env,options,leftargs)
+
+if __name__=='__main__':
+    run()
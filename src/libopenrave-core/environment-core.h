@@ -94,11 +94,20 @@ public:
 
         _nBodiesModifiedStamp = 0;
         _nEnvironmentIndex = 1;
+        _nPublishedBodiesVersion = 0;
+        _nPublishedBodiesRemovedHorizon = 0;
 
         _fDeltaSimTime = 0.01f;
         _nCurSimTime = 0;
         _nSimStartTime = utils::GetMicroTime();
         _bRealTime = true;
+        _eSimulationSchedulerMode = SSM_Adaptive;
+        _nSimulationScheduleStamp = 0;
+        _bSimulationStepPending = false;
+        _nSimulationStepThreads = 1;
+        _nNextSimulationStepTask = 0;
+        _nSimulationStepTasksLeft = 0;
+        _bStopSimulationStepThreads = false;
         _bInit = false;
         _bEnableSimulation = true;     // need to start by default
 
@@ -177,6 +186,7 @@ public:
             _threadSimulation->join();
         }
 
+        _StartSimulationStepThreads();
         _threadSimulation.reset(new boost::thread(boost::bind(&Environment::_SimulationThread,this)));
     }
 
@@ -196,6 +206,7 @@ public:
             _threadSimulation->join();     // might not return?
         }
         _threadSimulation.reset();
+        _StopSimulationStepThreads();
 
         // destroy the modules (their destructors could attempt to lock environment, so have to do it before global lock)
         // however, do not clear the _listModules yet
@@ -246,7 +257,7 @@ public:
                     (*itrobot)->Destroy();
                 }
                 _vecrobots.clear();
-                _vPublishedBodies.clear();
+                _ClearPublishedBodies();
                 _nBodiesModifiedStamp++;
                 FOREACH(itsensor,_listSensors) {
                     (*itsensor)->Configure(SensorBase::CC_PowerOff);
@@ -297,7 +308,7 @@ public:
                 (*itrobot)->Destroy();
             }
             _vecrobots.clear();
-            _vPublishedBodies.clear();
+            _ClearPublishedBodies();
             _nBodiesModifiedStamp++;
 
             _mapBodies.clear();
@@ -899,6 +910,12 @@ public:
             listModules = _listModules;
         }
 
+        if( _vSimulationStepThreads.size() > 0 ) {
+            _StepSimulationParallel(fTimeStep, vecbodies, vecrobots, listSensors, listModules);
+            _nCurSimTime += step;
+            return;
+        }
+
         FOREACH(it, vecbodies) {
             if( (*it)->GetEnvironmentId() ) {     // have to check if valid
                 (*it)->SimulationStep(fTimeStep);
@@ -922,6 +939,24 @@ public:
         _nCurSimTime += step;
     }
 
+    virtual void SetSimulationStepThreads(int numthreads)
+    {
+        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        numthreads = max(1, numthreads);
+        if( numthreads == _nSimulationStepThreads ) {
+            return;
+        }
+        _StopSimulationStepThreads();
+        _nSimulationStepThreads = numthreads;
+        if( _bInit ) {
+            _StartSimulationStepThreads();
+        }
+    }
+
+    virtual int GetSimulationStepThreads() const {
+        return _nSimulationStepThreads;
+    }
+
     virtual EnvironmentMutex& GetMutex() const {
         return _mutexEnvironment;
     }
@@ -1642,6 +1677,8 @@ public:
         _bRealTime = bRealTime;
         //_nCurSimTime = 0; // don't reset since it is important to keep time monotonic
         _nSimStartTime = utils::GetMicroTime()-_nCurSimTime;
+        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        _nSimulationScheduleStamp++;
     }
 
     virtual bool IsSimulationRunning() const {
@@ -1658,6 +1695,40 @@ public:
         return _nCurSimTime;
     }
 
+    virtual void SetSimulationSchedulerMode(SimulationSchedulerMode mode)
+    {
+        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        _nSimStartTime = utils::GetMicroTime()-_nCurSimTime;
+        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        _eSimulationSchedulerMode = mode;
+        _nSimulationScheduleStamp++;
+    }
+
+    virtual SimulationSchedulerMode GetSimulationSchedulerMode() const {
+        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        return _eSimulationSchedulerMode;
+    }
+
+    virtual void YieldToSimulationStep(uint64_t timeout)
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStepPending);
+        boost::system_time endtime = boost::get_system_time() + boost::posix_time::microseconds(timeout);
+        while( _bSimulationStepPending ) {
+            if( !_condSimulationStepPending.timed_wait(lock, endtime) ) {
+                break;
+            }
+        }
+    }
+
+    virtual void GetSimulationStatistics(SimulationStatistics& stats, bool reset)
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        stats = _simulationstatistics;
+        if( reset ) {
+            _simulationstatistics = SimulationStatistics();
+        }
+    }
+
     virtual void SetDebugLevel(int level) {
         RaveSetDebugLevel(level);
     }
@@ -1667,57 +1738,141 @@ public:
 
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout)
     {
-        if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-            vbodies = _vPublishedBodies;
+        boost::timed_mutex::scoped_lock lock(_mutexPublishedBodies, boost::defer_lock_t());
+        _LockWithTimeout(lock, timeout);
+        vbodies.resize(_vPublishedBodies.size());
+        for(size_t i = 0; i < _vPublishedBodies.size(); ++i) {
+            vbodies[i] = *_vPublishedBodies[i].pstate;
         }
-        else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
-            if (!lock.owns_lock()) {
-                throw OPENRAVE_EXCEPTION_FORMAT("timeout of %f s failed",(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+    }
+
+    virtual bool GetPublishedBodiesDelta(uint64_t& version, std::vector<KinBody::BodyState>& vchangedbodies, std::vector<int>& vremovedbodyids, uint64_t timeout)
+    {
+        boost::timed_mutex::scoped_lock lock(_mutexPublishedBodies, boost::defer_lock_t());
+        _LockWithTimeout(lock, timeout);
+        // the removed bodies older than the horizon were discarded, so send everything
+        bool bfull = version == 0 || version < _nPublishedBodiesRemovedHorizon || version > _nPublishedBodiesVersion;
+        vchangedbodies.resize(0);
+        vremovedbodyids.resize(0);
+        FOREACHC(itpublished, _vPublishedBodies) {
+            if( bfull || itpublished->version > version ) {
+                vchangedbodies.push_back(*itpublished->pstate);
+            }
+        }
+        if( !bfull ) {
+            FOREACHC(itremoved, _listPublishedBodiesRemoved) {
+                if( itremoved->first > version ) {
+                    vremovedbodyids.push_back(itremoved->second);
+                }
             }
-            vbodies = _vPublishedBodies;
         }
+        version = _nPublishedBodiesVersion;
+        return bfull;
     }
 
     virtual void UpdatePublishedBodies(uint64_t timeout=0)
     {
         EnvironmentMutex::scoped_lock lockenv(GetMutex());
-        if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-            _UpdatePublishedBodies();
+        _UpdatePublishedBodies(timeout);
+    }
+
+    /// \brief publishes the state of the bodies whose update stamp changed. The environment has to be locked.
+    ///
+    /// The new states are computed before locking _mutexPublishedBodies so that readers are only blocked while the states are swapped.
+    virtual void _UpdatePublishedBodies(uint64_t timeout=0)
+    {
+        // bodies are added and removed under _mutexInterfaces, so copy the list instead of holding the lock while computing the states
+        std::vector<KinBodyPtr> vecbodies;
+        {
+            boost::timed_mutex::scoped_lock lockinterfaces(_mutexInterfaces, boost::defer_lock_t());
+            _LockWithTimeout(lockinterfaces, timeout);
+            vecbodies = _vecbodies;
         }
-        else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
-            if (!lock.owns_lock()) {
-                throw OPENRAVE_EXCEPTION_FORMAT("timeout of %f s failed",(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        // _vPublishedBodies is only modified with the environment locked, so it can be read here without _mutexPublishedBodies
+        std::map<int, size_t> mapoldindices;
+        for(size_t i = 0; i < _vPublishedBodies.size(); ++i) {
+            mapoldindices[_vPublishedBodies[i].pstate->environmentid] = i;
+        }
+        std::vector<uint8_t> vused(_vPublishedBodies.size(), 0);
+        uint64_t newversion = _nPublishedBodiesVersion+1;
+        bool bchanged = false;
+        std::vector<PublishedBody> vpublished(vecbodies.size());
+        std::vector<int> vdofbranches;
+        for(size_t ibody = 0; ibody < vecbodies.size(); ++ibody) {
+            const KinBodyPtr& pbody = vecbodies[ibody];
+            PublishedBody& published = vpublished[ibody];
+            std::map<int, size_t>::iterator itold = mapoldindices.find(pbody->GetEnvironmentId());
+            if( itold != mapoldindices.end() ) {
+                const PublishedBody& oldpublished = _vPublishedBodies[itold->second];
+                if( oldpublished.pstate->pbody == pbody && oldpublished.updatestamp == pbody->GetUpdateStamp() && oldpublished.pstate->strname == pbody->GetName() ) {
+                    published = oldpublished;
+                    vused[itold->second] = 1;
+                    continue;
+                }
+                vused[itold->second] = 1;
             }
-            _UpdatePublishedBodies();
+            KinBody::BodyStatePtr pstate(new KinBody::BodyState());
+            pstate->pbody = pbody;
+            pbody->GetLinkTransformations(pstate->vectrans, vdofbranches);
+            pbody->GetDOFValues(pstate->jointvalues);
+            pstate->strname = pbody->GetName();
+            pstate->environmentid = pbody->GetEnvironmentId();
+            published.pstate = pstate;
+            published.updatestamp = pbody->GetUpdateStamp();
+            published.version = newversion;
+            bchanged = true;
+        }
+
+        std::vector<int> vremovedbodyids;
+        for(size_t i = 0; i < vused.size(); ++i) {
+            if( !vused[i] ) {
+                vremovedbodyids.push_back(_vPublishedBodies[i].pstate->environmentid);
+            }
+        }
+        if( !bchanged && vremovedbodyids.size() == 0 && vpublished.size() == _vPublishedBodies.size() ) {
+            // the order could have changed
+            for(size_t i = 0; i < vpublished.size() && !bchanged; ++i) {
+                bchanged = vpublished[i].pstate != _vPublishedBodies[i].pstate;
+            }
+            if( !bchanged ) {
+                return;
+            }
+        }
+
+        boost::timed_mutex::scoped_lock lock(_mutexPublishedBodies, boost::defer_lock_t());
+        _LockWithTimeout(lock, timeout);
+        _vPublishedBodies.swap(vpublished);
+        _nPublishedBodiesVersion = newversion;
+        FOREACH(itid, vremovedbodyids) {
+            _listPublishedBodiesRemoved.push_back(std::make_pair(newversion, *itid));
+        }
+        while(_listPublishedBodiesRemoved.size() > s_nMaxPublishedBodiesRemoved) {
+            _nPublishedBodiesRemovedHorizon = _listPublishedBodiesRemoved.front().first;
+            _listPublishedBodiesRemoved.pop_front();
         }
     }
 
-    virtual void _UpdatePublishedBodies()
+    /// \brief locks a deferred lock like the one of _mutexPublishedBodies, if timeout is 0 will block indefinitely
+    virtual void _LockWithTimeout(boost::timed_mutex::scoped_lock& lock, uint64_t timeout)
     {
-        // updated the published bodies, resize dynamically in case an exception occurs
-        // when creating an item and bad data is left inside _vPublishedBodies
-        _vPublishedBodies.resize(0);
-        if( _vPublishedBodies.capacity() < _vecbodies.size() ) {
-            _vPublishedBodies.reserve(_vecbodies.size());
+        if( timeout == 0 ) {
+            lock.lock();
         }
-
-        std::vector<int> vdofbranches;
-        FOREACH(itbody, _vecbodies) {
-            _vPublishedBodies.push_back(KinBody::BodyState());
-            KinBody::BodyState& state = _vPublishedBodies.back();
-            state.pbody = *itbody;
-            (*itbody)->GetLinkTransformations(state.vectrans, vdofbranches);
-            (*itbody)->GetDOFValues(state.jointvalues);
-            state.strname =(*itbody)->GetName();
-            state.environmentid = (*itbody)->GetEnvironmentId();
-            _vPublishedBodies.push_back(state);
+        else if( !lock.timed_lock(boost::get_system_time() + boost::posix_time::microseconds(timeout)) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("timeout of %f s failed",(1e-6*static_cast<double>(timeout)),ORE_Timeout);
         }
     }
 
+    /// \brief removes all the published bodies, consumers of GetPublishedBodiesDelta will get a full update
+    virtual void _ClearPublishedBodies()
+    {
+        boost::timed_mutex::scoped_lock lock(_mutexPublishedBodies);
+        _vPublishedBodies.clear();
+        _listPublishedBodiesRemoved.clear();
+        _nPublishedBodiesVersion++;
+        _nPublishedBodiesRemovedHorizon = _nPublishedBodiesVersion;
+    }
+
 protected:
 
     void _SetDefaultGravity()
@@ -1762,6 +1917,7 @@ protected:
         _nSimStartTime = utils::GetMicroTime();
         _nEnvironmentIndex = r->_nEnvironmentIndex;
         _bRealTime = r->_bRealTime;
+        _eSimulationSchedulerMode = r->GetSimulationSchedulerMode();
 
         _bInit = true;
         _bEnableSimulation = r->_bEnableSimulation;
@@ -1784,7 +1940,7 @@ protected:
                     (*itrobot)->Destroy();
                 }
                 _vecrobots.clear();
-                _vPublishedBodies.clear();
+                _ClearPublishedBodies();
             }
             // a little tricky due to a deadlocking situation
             std::map<int, KinBodyWeakPtr> mapBodies;
@@ -2125,21 +2281,36 @@ protected:
     {
         uint64_t nLastUpdateTime = utils::GetMicroTime();
         uint64_t nLastSleptTime = utils::GetMicroTime();
+        uint64_t nNextDeadline = 0;
+        int nScheduleStamp = -1;
         while( _bInit ) {
+            if( _bEnableSimulation && _bRealTime && GetSimulationSchedulerMode() == SSM_FixedStep ) {
+                _StepFixedSchedule(nNextDeadline, nScheduleStamp, nLastUpdateTime);
+                nLastSleptTime = utils::GetMicroTime();
+                continue;
+            }
             bool bNeedSleep = true;
             boost::shared_ptr<EnvironmentMutex::scoped_try_lock> lockenv;
             if( _bEnableSimulation ) {
                 bNeedSleep = false;
+                uint64_t lockstarttime = utils::GetNanoPerformanceTime();
                 lockenv = _LockEnvironmentWithTimeout(100000);
-                if( !!lockenv ) {
+                if( !lockenv ) {
+                    _RecordSimulationLockFailure();
+                }
+                else {
                     //Get deltasimtime in microseconds
                     int64_t deltasimtime = (int64_t)(_fDeltaSimTime*1000000.0f);
+                    uint64_t stepstarttime = utils::GetNanoPerformanceTime();
+                    int64_t jitter = _bRealTime ? (int64_t)utils::GetMicroTime()-(int64_t)(_nSimStartTime+_nCurSimTime) : 0;
                     try {
                         StepSimulation(_fDeltaSimTime);
                     }
                     catch(const std::exception &ex) {
                         RAVELOG_ERROR("simulation thread exception: %s\n",ex.what());
                     }
+                    uint64_t stependtime = utils::GetNanoPerformanceTime();
+                    bool boverrun = false;
                     uint64_t passedtime = utils::GetMicroTime()-_nSimStartTime;
                     int64_t sleeptime = _nCurSimTime-passedtime;
                     //Hardcoded tolerance for now
@@ -2159,11 +2330,13 @@ protected:
                             // simulation is getting late, so catch up (doesn't happen often in light loads)
                             //RAVELOG_INFO("sim catching up: %d\n",-(int)sleeptime);
                             _nSimStartTime += -sleeptime;     //deltasimtime;
+                            boverrun = true;
                         }
                     }
                     else {
                         nLastSleptTime = utils::GetMicroTime();
                     }
+                    _RecordSimulationStep((stepstarttime-lockstarttime)/1000, (stependtime-stepstarttime)/1000, jitter, boverrun, 0);
 
                     //RAVELOG_INFOA("sim: %f, real: %f\n",_nCurSimTime*1e-6f,(utils::GetMicroTime()-_nSimStartTime)*1e-6f);
                 }
@@ -2200,6 +2373,271 @@ protected:
         }
     }
 
+    /// \brief steps the bodies and sensors in phases, see \ref EnvironmentBase::SetSimulationStepThreads. The physics engine has already been stepped.
+    void _StepSimulationParallel(dReal fTimeStep, const std::vector<KinBodyPtr>& vecbodies, const std::vector<RobotBasePtr>& vecrobots, const std::list<SensorBasePtr>& listSensors, const std::list<ModuleBasePtr>& listModules)
+    {
+        std::vector< boost::function<void()> > vtasks;
+        std::vector<KinBodyPtr> vserialbodies;
+        FOREACHC(it, vecbodies) {
+            if( (*it)->GetEnvironmentId() ) {     // have to check if valid
+                if( (*it)->SupportsParallelSimulationStep() ) {
+                    vtasks.push_back(boost::bind(&KinBody::SimulationStep, *it, fTimeStep));
+                }
+                else {
+                    vserialbodies.push_back(*it);
+                }
+            }
+        }
+        _RunSimulationStepTasks(vtasks);
+
+        FOREACH(it, vserialbodies) {
+            (*it)->SimulationStep(fTimeStep);
+        }
+        FOREACHC(itmodule, listModules) {
+            (*itmodule)->SimulationStep(fTimeStep);
+        }
+
+        // simulate the sensors last (ie, they always reflect the most recent bodies
+        vtasks.resize(0);
+        FOREACHC(itsensor, listSensors) {
+            if( (*itsensor)->SimulationStepPrepare(fTimeStep) ) {
+                vtasks.push_back(boost::bind(&SensorBase::SimulationStepParallel, *itsensor, fTimeStep));
+            }
+        }
+        FOREACHC(itrobot, vecrobots) {
+            FOREACH(itsensor, (*itrobot)->GetAttachedSensors()) {
+                SensorBasePtr psensor = (*itsensor)->GetSensor();
+                if( !!psensor && psensor->SimulationStepPrepare(fTimeStep) ) {
+                    vtasks.push_back(boost::bind(&SensorBase::SimulationStepParallel, psensor, fTimeStep));
+                }
+            }
+        }
+        _RunSimulationStepTasks(vtasks);
+    }
+
+    /// \brief runs the tasks on the simulation step threads and the calling thread, returns when all tasks are done
+    ///
+    /// \throw openrave_exception if any of the tasks threw an exception
+    void _RunSimulationStepTasks(const std::vector< boost::function<void()> >& vtasks)
+    {
+        if( vtasks.size() == 0 ) {
+            return;
+        }
+        if( vtasks.size() == 1 ) {
+            vtasks[0]();
+            return;
+        }
+        boost::mutex::scoped_lock lock(_mutexSimulationStepTasks);
+        _vSimulationStepTasks = vtasks;
+        _nNextSimulationStepTask = 0;
+        _nSimulationStepTasksLeft = vtasks.size();
+        _vSimulationStepErrors.resize(0);
+        _condSimulationStepTasks.notify_all();
+        while( _nNextSimulationStepTask < _vSimulationStepTasks.size() ) {
+            _RunNextSimulationStepTask(lock);
+        }
+        while( _nSimulationStepTasksLeft > 0 ) {
+            _condSimulationStepTasksDone.wait(lock);
+        }
+        _vSimulationStepTasks.resize(0);
+        _nNextSimulationStepTask = 0;
+        if( _vSimulationStepErrors.size() > 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("%d parallel simulation step tasks failed, first error: %s", _vSimulationStepErrors.size()%_vSimulationStepErrors.at(0), ORE_Failed);
+        }
+    }
+
+    /// \brief runs the next task in _vSimulationStepTasks, lock has to own _mutexSimulationStepTasks and there has to be a task left
+    void _RunNextSimulationStepTask(boost::mutex::scoped_lock& lock)
+    {
+        boost::function<void()> task = _vSimulationStepTasks[_nNextSimulationStepTask++];
+        lock.unlock();
+        std::string error;
+        try {
+            task();
+        }
+        catch(const std::exception& ex) {
+            error = ex.what();
+        }
+        lock.lock();
+        if( error.size() > 0 ) {
+            _vSimulationStepErrors.push_back(error);
+        }
+        if( --_nSimulationStepTasksLeft == 0 ) {
+            _condSimulationStepTasksDone.notify_all();
+        }
+    }
+
+    void _SimulationStepThread()
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStepTasks);
+        while( !_bStopSimulationStepThreads ) {
+            if( _nNextSimulationStepTask < _vSimulationStepTasks.size() ) {
+                _RunNextSimulationStepTask(lock);
+            }
+            else {
+                _condSimulationStepTasks.wait(lock);
+            }
+        }
+    }
+
+    void _StartSimulationStepThreads()
+    {
+        _bStopSimulationStepThreads = false;
+        for(int i = 1; i < _nSimulationStepThreads; ++i) {
+            _vSimulationStepThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&Environment::_SimulationStepThread,this))));
+        }
+    }
+
+    void _StopSimulationStepThreads()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutexSimulationStepTasks);
+            _bStopSimulationStepThreads = true;
+            _condSimulationStepTasks.notify_all();
+        }
+        FOREACH(itthread, _vSimulationStepThreads) {
+            (*itthread)->join();
+        }
+        _vSimulationStepThreads.clear();
+    }
+
+    /// \brief takes one step with the SSM_FixedStep scheduler, called from the simulation thread
+    ///
+    /// \param[in,out] nNextDeadline the monotonic time in nanoseconds that the next step should start at
+    /// \param[in,out] nScheduleStamp the value of _nSimulationScheduleStamp that nNextDeadline was computed for
+    /// \param[in,out] nLastUpdateTime the last time the published bodies were updated
+    void _StepFixedSchedule(uint64_t& nNextDeadline, int& nScheduleStamp, uint64_t& nLastUpdateTime)
+    {
+        uint64_t period = max((uint64_t)1000, (uint64_t)(_fDeltaSimTime*1000000000.0));
+        int nCurrentScheduleStamp;
+        {
+            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            nCurrentScheduleStamp = _nSimulationScheduleStamp;
+        }
+        if( nScheduleStamp != nCurrentScheduleStamp ) {
+            nScheduleStamp = nCurrentScheduleStamp;
+            nNextDeadline = utils::GetNanoPerformanceTime();
+        }
+
+        // never hold the environment lock while waiting. Instead, announce the step a little before the deadline
+        // so that threads calling YieldToSimulationStep stop taking the lock and it is free at the deadline.
+        if( !_SleepSimulationUntil(nNextDeadline > s_nSimulationPendingLeadTime ? nNextDeadline-s_nSimulationPendingLeadTime : 0) ) {
+            return;
+        }
+        _SetSimulationStepPending(true);
+        if( !_SleepSimulationUntil(nNextDeadline) ) {
+            _SetSimulationStepPending(false);
+            return;
+        }
+        uint64_t lockstarttime = utils::GetNanoPerformanceTime();
+        boost::shared_ptr<EnvironmentMutex::scoped_try_lock> lockenv = _LockEnvironmentWithTimeout(100000);
+        _SetSimulationStepPending(false);
+        if( !lockenv ) {
+            _RecordSimulationLockFailure();
+            return;
+        }
+        uint64_t lockwaittime = utils::GetNanoPerformanceTime()-lockstarttime;
+        if( !_bEnableSimulation ) {
+            // stopped while acquiring the lock
+            return;
+        }
+
+        uint64_t stepstarttime = utils::GetNanoPerformanceTime();
+        try {
+            StepSimulation(_fDeltaSimTime);
+        }
+        catch(const std::exception &ex) {
+            RAVELOG_ERROR("simulation thread exception: %s\n",ex.what());
+        }
+        uint64_t stependtime = utils::GetNanoPerformanceTime();
+        if( utils::GetMicroTime()-nLastUpdateTime > 10000 ) {
+            nLastUpdateTime = utils::GetMicroTime();
+            try {
+                _UpdatePublishedBodies(1000000); // 1.0s
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN("timeout of UpdatePublishedBodies\n");
+            }
+        }
+
+        int64_t jitter = ((int64_t)stepstarttime-(int64_t)nNextDeadline)/1000;
+        nNextDeadline += period;
+        uint64_t curtime = utils::GetNanoPerformanceTime();
+        bool boverrun = curtime > nNextDeadline;
+        uint64_t numskipped = 0;
+        if( boverrun ) {
+            // start the next step right away and drop the deadlines that already passed
+            numskipped = (curtime-nNextDeadline)/period;
+            nNextDeadline += numskipped*period;
+        }
+        // record before releasing the lock so that the statistics agree with the simulation time once StopSimulation returns
+        _RecordSimulationStep(lockwaittime/1000, (stependtime-stepstarttime)/1000, jitter, boverrun, numskipped);
+    }
+
+    void _SetSimulationStepPending(bool bPending)
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStepPending);
+        _bSimulationStepPending = bPending;
+        if( !bPending ) {
+            _condSimulationStepPending.notify_all();
+        }
+    }
+
+    /// \brief sleeps until deadline (monotonic time in nanoseconds). The last s_nSimulationSpinTime is spent spinning since the os sleep is not accurate enough.
+    ///
+    /// \return false if the simulation was stopped before the deadline
+    bool _SleepSimulationUntil(uint64_t deadline)
+    {
+        while( _bInit && _bEnableSimulation ) {
+            uint64_t curtime = utils::GetNanoPerformanceTime();
+            if( curtime >= deadline ) {
+                return true;
+            }
+            if( deadline-curtime <= s_nSimulationSpinTime ) {
+                continue;
+            }
+            // wake up at least every 0.1s to check if the simulation was stopped
+            uint64_t waketime = min(deadline-s_nSimulationSpinTime, curtime+100000000);
+#if defined(CLOCK_GETTIME_FOUND) && (POSIX_TIMERS > 0 || _POSIX_TIMERS > 0) && defined(_POSIX_MONOTONIC_CLOCK) && !defined(__APPLE__)
+            // absolute deadline on the same clock as GetNanoPerformanceTime, returns early when interrupted
+            struct timespec ts;
+            ts.tv_sec = waketime/1000000000;
+            ts.tv_nsec = waketime%1000000000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#else
+            boost::this_thread::sleep(boost::posix_time::microseconds((waketime-curtime)/1000));
+#endif
+        }
+        return false;
+    }
+
+    void _RecordSimulationStep(uint64_t lockwaittime, uint64_t steptime, int64_t jitter, bool boverrun, uint64_t numskipped)
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        SimulationStatistics& stats = _simulationstatistics;
+        stats.numsteps++;
+        if( boverrun ) {
+            stats.numoverruns++;
+        }
+        stats.numskippedsteps += numskipped;
+        double fweight = 1.0/(double)stats.numsteps;
+        stats.laststeptime = steptime;
+        stats.maxsteptime = max(stats.maxsteptime, steptime);
+        stats.meansteptime += ((double)steptime-stats.meansteptime)*fweight;
+        uint64_t absjitter = jitter >= 0 ? jitter : -jitter;
+        stats.lastjitter = jitter;
+        stats.maxjitter = max(stats.maxjitter, absjitter);
+        stats.meanjitter += ((double)absjitter-stats.meanjitter)*fweight;
+        stats.maxlockwaittime = max(stats.maxlockwaittime, lockwaittime);
+        stats.meanlockwaittime += ((double)lockwaittime-stats.meanlockwaittime)*fweight;
+    }
+
+    void _RecordSimulationLockFailure()
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        _simulationstatistics.numlockfailures++;
+    }
+
     boost::shared_ptr<EnvironmentMutex::scoped_try_lock> _LockEnvironmentWithTimeout(uint64_t timeout)
     {
         // try to acquire the lock
@@ -2310,6 +2748,25 @@ protected:
     uint64_t _nSimStartTime;
     int _nBodiesModifiedStamp;     ///< incremented every tiem bodies vector is modified
     bool _bRealTime;
+    SimulationSchedulerMode _eSimulationSchedulerMode; ///< protected by _mutexInterfaces since the simulation thread reads it without the environment lock
+    int _nSimulationScheduleStamp; ///< incremented every time the simulation thread has to restart its schedule, protected by _mutexInterfaces
+    SimulationStatistics _simulationstatistics;
+    boost::mutex _mutexSimulationStatistics; ///< protects _simulationstatistics
+    static const uint64_t s_nSimulationSpinTime = 100000; ///< nanoseconds before a deadline that the simulation thread stops sleeping and spins
+    static const uint64_t s_nSimulationPendingLeadTime = 500000; ///< nanoseconds before a deadline that a SSM_FixedStep step is announced to YieldToSimulationStep
+    bool _bSimulationStepPending; ///< true from shortly before a SSM_FixedStep deadline until the simulation thread has the environment lock, protected by _mutexSimulationStepPending
+    boost::mutex _mutexSimulationStepPending;
+    boost::condition _condSimulationStepPending; ///< notified when _bSimulationStepPending is cleared
+
+    int _nSimulationStepThreads; ///< number of threads StepSimulation uses including the stepping thread, see SetSimulationStepThreads
+    std::vector< boost::shared_ptr<boost::thread> > _vSimulationStepThreads; ///< the workers stepping bodies and sensors in parallel
+    boost::mutex _mutexSimulationStepTasks; ///< protects the simulation step tasks
+    boost::condition _condSimulationStepTasks; ///< notified when there are new tasks or the workers have to stop
+    boost::condition _condSimulationStepTasksDone; ///< notified when all tasks finished
+    std::vector< boost::function<void()> > _vSimulationStepTasks; ///< the tasks of the current phase
+    size_t _nNextSimulationStepTask, _nSimulationStepTasksLeft;
+    std::vector<std::string> _vSimulationStepErrors; ///< the exceptions thrown by the tasks of the current phase
+    bool _bStopSimulationStepThreads;
 
     CollisionCheckerBasePtr _pCurrentChecker;
     PhysicsEngineBasePtr _pPhysicsEngine;
@@ -2324,7 +2781,22 @@ protected:
     mutable boost::timed_mutex _mutexInterfaces;     ///< lock when managing interfaces like _listOwnedInterfaces, _listModules, _mapBodies
     mutable boost::mutex _mutexInit;     ///< lock for destroying the environment
 
-    vector<KinBody::BodyState> _vPublishedBodies;
+    /// \brief the published state of a body, the state is shared between updates while the body does not change
+    struct PublishedBody
+    {
+        PublishedBody() : updatestamp(0), version(0) {
+        }
+        KinBody::BodyStateConstPtr pstate;
+        int updatestamp; ///< the update stamp of the body when pstate was computed
+        uint64_t version; ///< the value of _nPublishedBodiesVersion when pstate was computed
+    };
+
+    mutable boost::timed_mutex _mutexPublishedBodies; ///< protects the published bodies from readers, only locked while swapping the states
+    std::vector<PublishedBody> _vPublishedBodies; ///< only modified with the environment locked
+    uint64_t _nPublishedBodiesVersion; ///< incremented every time the published bodies change
+    std::list< std::pair<uint64_t, int> > _listPublishedBodiesRemoved; ///< (version, environment id) of the bodies removed from the published bodies
+    uint64_t _nPublishedBodiesRemovedHorizon; ///< the removed bodies before this version were discarded from _listPublishedBodiesRemoved
+    static const size_t s_nMaxPublishedBodiesRemoved = 1024;
     string _homedirectory;
     UserDataPtr _handlegenericrobot, _handlegenerictrajectory, _handlemulticontroller, _handlegenericphysicsengine, _handlegenericcollisionchecker;
 
@@ -154,6 +154,17 @@ public:
         }
     }
 
+    virtual bool SupportsParallelSimulationStep() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        FOREACHC(it,_listcontrollers) {
+            if( !(*it)->SupportsParallelSimulationStep() ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     virtual bool IsDone()
     {
         boost::mutex::scoped_lock lock(_mutex);
@@ -805,6 +805,11 @@ void KinBody::SimulationStep(dReal fElapsedTime)
 {
 }
 
+bool KinBody::SupportsParallelSimulationStep() const
+{
+    return false;
+}
+
 void KinBody::SubtractDOFValues(std::vector<dReal>& q1, const std::vector<dReal>& q2, const std::vector<int>& dofindices) const
 {
     if( dofindices.size() == 0 ) {
@@ -1967,6 +1967,34 @@ void SensorBase::Serialize(BaseXMLWriterPtr writer, int options) const
     RAVELOG_WARN(str(boost::format("sensor %s does not implement Serialize")%GetXMLId()));
 }
 
+int CollisionCheckerBase::CheckCollisionRays(const std::vector<RAY>& vrays, KinBodyConstPtr pbody, std::vector<dReal>& vhitdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks, std::vector<CollisionReport::CONTACT>& vhitcontacts)
+{
+    vhitdistances.resize(vrays.size());
+    vhitlinks.resize(vrays.size());
+    vhitcontacts.resize(vrays.size());
+    if( vrays.size() == 0 ) {
+        return 0;
+    }
+    CollisionOptionsStateSaver optionstate(shared_collisionchecker(),GetCollisionOptions()|CO_Distance,false);
+    CollisionReportPtr report(new CollisionReport());
+    int nhits = 0;
+    for(size_t i = 0; i < vrays.size(); ++i) {
+        bool bCollision = !pbody ? CheckCollision(vrays[i],report) : CheckCollision(vrays[i],pbody,report);
+        if( bCollision ) {
+            vhitdistances[i] = report->minDistance;
+            vhitlinks[i] = !!report->plink1 ? report->plink1 : report->plink2;
+            vhitcontacts[i] = report->contacts.size() > 0 ? report->contacts[0] : CollisionReport::CONTACT();
+            ++nhits;
+        }
+        else {
+            vhitdistances[i] = -1;
+            vhitlinks[i].reset();
+            vhitcontacts[i] = CollisionReport::CONTACT();
+        }
+    }
+    return nhits;
+}
+
 CollisionOptionsStateSaver::CollisionOptionsStateSaver(CollisionCheckerBasePtr p, int newoptions, bool required)
 {
     _oldoptions = p->GetCollisionOptions();
@@ -1159,6 +1159,125 @@ PlannerStatus RetimeTrajectory(TrajectoryBasePtr traj, bool hastimestamps, dReal
     return _PlanTrajectory(traj,hastimestamps,fmaxvelmult,fmaxaccelmult,GetPlannerFromInterpolation(traj,plannername), false,plannerparameters);
 }
 
+/// \brief retimes a batch of trajectories, every thread picks up the next trajectory index until none are left
+class BatchTrajectoryRetimer
+{
+public:
+    BatchTrajectoryRetimer(const std::vector<TrajectoryBasePtr>& vtrajectories, std::vector<PlannerStatus>& vstatuses, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, const std::string& plannerparameters) : _vtrajectories(vtrajectories), _vstatuses(vstatuses), _hastimestamps(hastimestamps), _fmaxvelmult(fmaxvelmult), _fmaxaccelmult(fmaxaccelmult), _plannername(plannername), _plannerparameters(plannerparameters), _nexttrajectory(0) {
+    }
+
+    int Retime(int numthreads)
+    {
+        _vstatuses.resize(_vtrajectories.size());
+        std::fill(_vstatuses.begin(), _vstatuses.end(), PS_Failed);
+        _nexttrajectory = 0;
+        if( numthreads <= 0 ) {
+            numthreads = max(1,(int)boost::thread::hardware_concurrency());
+        }
+        numthreads = min(numthreads,(int)_vtrajectories.size());
+        boost::thread_group threads;
+        for(int i = 1; i < numthreads; ++i) {
+            threads.create_thread(boost::bind(&BatchTrajectoryRetimer::_RetimeTrajectories, this));
+        }
+        _RetimeTrajectories();
+        threads.join_all();
+
+        int numsuccessful = 0;
+        FOREACHC(itstatus, _vstatuses) {
+            if( *itstatus == PS_HasSolution ) {
+                ++numsuccessful;
+            }
+        }
+        return numsuccessful;
+    }
+
+protected:
+    /// \brief the retiming planner owned by one thread
+    struct ThreadPlanner
+    {
+        PlannerBasePtr planner;
+        std::string plannername;
+        ConfigurationSpecification spec;
+    };
+
+    void _RetimeTrajectories()
+    {
+        ThreadPlanner threadplanner;
+        while(1) {
+            size_t index;
+            {
+                boost::mutex::scoped_lock lock(_mutexindex);
+                index = _nexttrajectory++;
+            }
+            if( index >= _vtrajectories.size() ) {
+                break;
+            }
+            try {
+                _vstatuses[index] = _RetimeTrajectory(_vtrajectories[index], threadplanner);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN(str(boost::format("failed to retime trajectory %d: %s")%index%ex.what()));
+                threadplanner.planner.reset();
+            }
+        }
+    }
+
+    PlannerStatus _RetimeTrajectory(TrajectoryBasePtr traj, ThreadPlanner& threadplanner)
+    {
+        if( traj->GetNumWaypoints() <= 1 ) {
+            return _PlanTrajectory(traj,_hastimestamps,_fmaxvelmult,_fmaxaccelmult,_plannername,false,_plannerparameters);
+        }
+
+        std::string plannername = GetPlannerFromInterpolation(traj,_plannername);
+        ConfigurationSpecification spec = traj->GetConfigurationSpecification().GetTimeDerivativeSpecification(0);
+        if( !threadplanner.planner || threadplanner.planner->GetEnv() != traj->GetEnv() || threadplanner.plannername != plannername || threadplanner.spec != spec ) {
+            // only the initialization needs the environment, the retiming itself is done without the lock
+            threadplanner.planner.reset();
+            EnvironmentMutex::scoped_lock lockenv(traj->GetEnv()->GetMutex());
+            PlannerBasePtr planner = RaveCreatePlanner(traj->GetEnv(),plannername);
+            if( !planner ) {
+                return PS_Failed;
+            }
+            TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
+            params->SetConfigurationSpecification(traj->GetEnv(),spec);
+            FOREACH(it,params->_vConfigVelocityLimit) {
+                *it *= _fmaxvelmult;
+            }
+            FOREACH(it,params->_vConfigAccelerationLimit) {
+                *it *= _fmaxaccelmult;
+            }
+            params->_setstatevaluesfn.clear();
+            params->_setstatefn.clear();
+            params->_checkpathconstraintsfn.clear();
+            params->_checkpathvelocityconstraintsfn.clear();
+            params->_sPostProcessingPlanner = "";
+            params->_hastimestamps = _hastimestamps;
+            params->_sExtraParameters += _plannerparameters;
+            if( !planner->InitPlan(RobotBasePtr(),params) ) {
+                return PS_Failed;
+            }
+            threadplanner.planner = planner;
+            threadplanner.plannername = plannername;
+            threadplanner.spec = spec;
+        }
+        return threadplanner.planner->PlanPath(traj) == PS_HasSolution ? PS_HasSolution : PS_Failed;
+    }
+
+    const std::vector<TrajectoryBasePtr>& _vtrajectories;
+    std::vector<PlannerStatus>& _vstatuses;
+    bool _hastimestamps;
+    dReal _fmaxvelmult, _fmaxaccelmult;
+    std::string _plannername, _plannerparameters;
+    size_t _nexttrajectory;
+    boost::mutex _mutexindex;
+};
+
+int RetimeTrajectories(const std::vector<TrajectoryBasePtr>& vtrajectories, std::vector<PlannerStatus>& vstatuses, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, const std::string& plannerparameters, int numthreads)
+{
+    BatchTrajectoryRetimer retimer(vtrajectories, vstatuses, hastimestamps, fmaxvelmult, fmaxaccelmult, plannername, plannerparameters);
+    return retimer.Retime(numthreads);
+}
+
 void ExtendActiveDOFWaypoint(int waypointindex, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, RobotBasePtr robot, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername)
 {
     if( traj->GetNumWaypoints()<1) {
@@ -1201,6 +1320,50 @@ void ExtendActiveDOFWaypoint(int waypointindex, const std::vector<dReal>& dofval
     InsertActiveDOFWaypointWithRetiming(waypointindex,dofvalues,dofvelocities,traj,robot,fmaxvelmult,fmaxaccelmult,plannername);
 }
 
+/// \brief inserts a waypoint between waypointindex-1 and waypointindex of a timed trajectory so that only the window around it has to be retimed
+///
+/// The extra data of the new waypoint is copied from the previous waypoint, its velocity is 0 if dofvelocities is empty.
+static void _InsertMiddleWaypoint(int waypointindex, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, const ConfigurationSpecification& posspec)
+{
+    const ConfigurationSpecification& trajspec = traj->GetConfigurationSpecification();
+    ConfigurationSpecification velspec = posspec.ConvertToVelocitySpecification();
+    std::vector<ConfigurationSpecification::Group>::const_iterator itgrouptime = trajspec.FindCompatibleGroup("deltatime",true);
+    bool bHasVelocities = itgrouptime != trajspec._vgroups.end();
+    FOREACHC(itgroup, velspec._vgroups) {
+        if( trajspec.FindCompatibleGroup(*itgroup,true) == trajspec._vgroups.end() ) {
+            bHasVelocities = false;
+        }
+    }
+    if( !bHasVelocities ) {
+        throw OPENRAVE_EXCEPTION_FORMAT("trajectory needs to be retimed with velocities before inserting waypoint %d in the middle", waypointindex, ORE_InvalidArguments);
+    }
+
+    vector<dReal> vnewpoint, vvelocities = dofvelocities;
+    traj->GetWaypoint(waypointindex-1,vnewpoint);
+    ConfigurationSpecification::ConvertData(vnewpoint.begin(), trajspec, dofvalues.begin(), posspec, 1, traj->GetEnv(), false);
+    if( vvelocities.size() != dofvalues.size() ) {
+        vvelocities.resize(0);
+        vvelocities.resize(dofvalues.size(),0);
+    }
+    ConfigurationSpecification::ConvertData(vnewpoint.begin(), trajspec, vvelocities.begin(), velspec, 1, traj->GetEnv(), false);
+    vnewpoint.at(itgrouptime->offset) = 0;
+    traj->Insert(waypointindex,vnewpoint);
+}
+
+static std::string _GetActiveDOFRetimerName(const std::string& interpolation, const std::string& plannername)
+{
+    if( plannername.size() > 0 ) {
+        return plannername;
+    }
+    if( interpolation == "linear" ) {
+        return "lineartrajectoryretimer";
+    }
+    else if( interpolation.size() == 0 || interpolation == "quadratic" ) {
+        return "parabolictrajectoryretimer";
+    }
+    throw OPENRAVE_EXCEPTION_FORMAT("currently do not support retiming for %s interpolations",interpolation,ORE_InvalidArguments);
+}
+
 void InsertActiveDOFWaypointWithRetiming(int waypointindex, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, RobotBasePtr robot, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername)
 {
     BOOST_ASSERT((int)dofvalues.size()==robot->GetActiveDOF());
@@ -1241,8 +1404,18 @@ void InsertActiveDOFWaypointWithRetiming(int waypointindex, const std::vector<dR
             ConfigurationSpecification::ConvertData(vwaypointend.begin(), newspec, dofvelocities.begin(), robot->GetActiveConfigurationSpecification().ConvertToVelocitySpecification(), 1, traj->GetEnv(), false);
         }
     }
+    else if( waypointindex > 0 && waypointindex < (int)traj->GetNumWaypoints() ) {
+        _InsertMiddleWaypoint(waypointindex, dofvalues, dofvelocities, traj, robot->GetActiveConfigurationSpecification());
+        // only the segments around the new waypoint are retimed, the velocities of its neighbors are kept so the rest of the timing stays valid
+        std::string windowparameters = str(boost::format("<hasvelocities>1</hasvelocities><retimewindow>%d %d</retimewindow>")%(waypointindex-1)%(waypointindex+1));
+        if( !(RetimeActiveDOFTrajectory(traj,robot,false,fmaxvelmult,fmaxaccelmult,_GetActiveDOFRetimerName(interpolation, plannername),windowparameters) & PS_HasSolution) ) {
+            traj->Remove(waypointindex,waypointindex+1);
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to retime the waypoints around waypoint %d", waypointindex, ORE_Assert);
+        }
+        return;
+    }
     else {
-        throw OPENRAVE_EXCEPTION_FORMAT("do no support inserting waypoint at %d in middle of trajectory (size=%d)", waypointindex%traj->GetNumWaypoints(), ORE_InvalidArguments);
+        throw OPENRAVE_EXCEPTION_FORMAT("cannot insert waypoint at %d in trajectory (size=%d)", waypointindex%traj->GetNumWaypoints(), ORE_InvalidArguments);
     }
 
     TrajectoryBasePtr trajinitial = RaveCreateTrajectory(traj->GetEnv(),traj->GetXMLId());
@@ -1251,19 +1424,7 @@ void InsertActiveDOFWaypointWithRetiming(int waypointindex, const std::vector<dR
     trajinitial->Insert(1,vwaypointend);
 
 
-    std::string newplannername = plannername;
-
-    if( newplannername.size() == 0 ) {
-        if( interpolation == "linear" ) {
-            newplannername = "lineartrajectoryretimer";
-        }
-        else if( interpolation.size() == 0 || interpolation == "quadratic" ) {
-            newplannername = "parabolictrajectoryretimer";
-        }
-        else {
-            throw OPENRAVE_EXCEPTION_FORMAT("currently do not support retiming for %s interpolations",interpolation,ORE_InvalidArguments);
-        }
-    }
+    std::string newplannername = _GetActiveDOFRetimerName(interpolation, plannername);
 
     if( IS_DEBUGLEVEL(Level_Verbose) ) {
         int ran = RaveRandomInt()%10000;
@@ -1354,8 +1515,29 @@ void InsertWaypointWithRetiming(int waypointindex, const std::vector<dReal>& dof
             ConfigurationSpecification::ConvertData(vwaypointend.begin(), newspec, dofvelocities.begin(), parameters->_configurationspecification.ConvertToVelocitySpecification(), 1, traj->GetEnv(), false);
         }
     }
+    else if( waypointindex > 0 && waypointindex < (int)traj->GetNumWaypoints() ) {
+        TrajectoryTimingParametersConstPtr timingparameters = boost::dynamic_pointer_cast<TrajectoryTimingParameters const>(parameters);
+        if( !timingparameters ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("planner %s needs TrajectoryTimingParameters to retime waypoints in the middle of trajectories", planner->GetXMLId(), ORE_InvalidArguments);
+        }
+        _InsertMiddleWaypoint(waypointindex, dofvalues, dofvelocities, traj, parameters->_configurationspecification);
+        // only the segments around the new waypoint are retimed, the velocities of its neighbors are kept so the rest of the timing stays valid
+        TrajectoryTimingParametersPtr windowparameters(new TrajectoryTimingParameters());
+        windowparameters->copy(timingparameters);
+        windowparameters->_hasvelocities = true;
+        windowparameters->_windowstart = waypointindex-1;
+        windowparameters->_windowend = waypointindex+1;
+        bool bSuccess = planner->InitPlan(RobotBasePtr(),windowparameters) && (planner->PlanPath(traj) & PS_HasSolution);
+        // restore the parameters the planner was initialized with
+        planner->InitPlan(RobotBasePtr(),parameters);
+        if( !bSuccess ) {
+            traj->Remove(waypointindex,waypointindex+1);
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to retime the waypoints around waypoint %d", waypointindex, ORE_Assert);
+        }
+        return;
+    }
     else {
-        throw OPENRAVE_EXCEPTION_FORMAT0("do no support inserting waypoints in middle of trajectories yet",ORE_InvalidArguments);
+        throw OPENRAVE_EXCEPTION_FORMAT("cannot insert waypoint at %d in trajectory (size=%d)", waypointindex%traj->GetNumWaypoints(), ORE_InvalidArguments);
     }
 
     TrajectoryBasePtr trajinitial = RaveCreateTrajectory(traj->GetEnv(),traj->GetXMLId());
@@ -1893,7 +2075,7 @@ void GetDHParameters(std::vector<DHParameter>& vparameters, KinBodyConstPtr pbod
     }
 }
 
-DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _perturbation(0.1)
+DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _perturbation(0.1), _nCheckedSamples(0), _intervalcheckmode(ICM_Discretized), _fsafetydistance(0.001)
 {
     BOOST_ASSERT(listCheckBodies.size()>0);
     _report.reset(new CollisionReport());
@@ -1928,8 +2110,16 @@ void DynamicsCollisionConstraint::SetPerturbation(dReal perturbation)
     _perturbation = perturbation;
 }
 
+void DynamicsCollisionConstraint::SetIntervalCheckMode(IntervalCheckMode mode, dReal fsafetydistance)
+{
+    OPENRAVE_ASSERT_OP(fsafetydistance,>,0);
+    _intervalcheckmode = mode;
+    _fsafetydistance = fsafetydistance;
+}
+
 int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
 {
+    ++_nCheckedSamples;
     if( params->SetStateValues(vdofvalues, 0) != 0 ) {
         return CFO_StateSettingError;
     }
@@ -2052,9 +2242,270 @@ void DynamicsCollisionConstraint::_PrintOnFailure(const std::string& prefix)
     }
 }
 
+int DynamicsCollisionConstraint::_ComputeMinDistance(int options, dReal& fmindist, int& nclosestconstraint)
+{
+    fmindist = 1e20;
+    nclosestconstraint = 0;
+    FOREACHC(itbody, _listCheckBodies) {
+        if( options&CFO_CheckEnvCollisions ) {
+            if( (*itbody)->GetEnv()->CheckCollision(KinBodyConstPtr(*itbody),_report) ) {
+                _PrintOnFailure(std::string("collision failed ")+_report->__str__());
+                return CFO_CheckEnvCollisions;
+            }
+            if( _report->minDistance < fmindist ) {
+                fmindist = _report->minDistance;
+                nclosestconstraint = CFO_CheckEnvCollisions;
+            }
+        }
+        if( options&CFO_CheckSelfCollisions ) {
+            _report->Reset(); // single link bodies do not reset the report
+            if( (*itbody)->CheckSelfCollision(_report) ) {
+                _PrintOnFailure(std::string("self-collision failed ")+_report->__str__());
+                return CFO_CheckSelfCollisions;
+            }
+            if( _report->minDistance < fmindist ) {
+                fmindist = _report->minDistance;
+                nclosestconstraint = CFO_CheckSelfCollisions;
+            }
+        }
+    }
+    return 0;
+}
+
+void DynamicsCollisionConstraint::_ComputeContinuousMotionBound(dReal& fA, dReal& fS)
+{
+    // A point p of a link moves at most |dq_j|*dist(p,anchor_j) for every revolute DOF j affecting the link and |dq_j| for every prismatic DOF.
+    // The distances to the anchors are computed at the current state and can grow by at most the motion m itself, so
+    // m <= sum_rev |dq_j|*(r_j + m) + sum_pris |dq_j|, which gives m <= fstep*fA/(1-fstep*fS).
+    fA = 0;
+    fS = 0;
+    std::vector<ContinuousBodyMotion>::const_iterator itmotion = _vcontinuousmotion.begin();
+    FOREACHC(itbody, _listCheckBodies) {
+        const KinBodyPtr& pbody = *itbody;
+        const ContinuousBodyMotion& motion = *itmotion++;
+        size_t numlinks = pbody->GetLinks().size();
+        _vlinkaabbs.resize(numlinks);
+        for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+            _vlinkaabbs[ilink].resize(0);
+            _vlinkaabbs[ilink].push_back(pbody->GetLinks()[ilink]->ComputeAABB());
+        }
+        if( pbody->IsRobot() ) {
+            RobotBasePtr probot = RaveInterfaceCast<RobotBase>(pbody);
+            std::vector<KinBodyPtr> vgrabbed;
+            probot->GetGrabbed(vgrabbed);
+            FOREACHC(itgrabbed, vgrabbed) {
+                KinBody::LinkPtr pgrabbinglink = probot->IsGrabbing(*itgrabbed);
+                if( !!pgrabbinglink ) {
+                    _vlinkaabbs.at(pgrabbinglink->GetIndex()).push_back((*itgrabbed)->ComputeAABB());
+                }
+            }
+        }
+
+        dReal fbodyA = motion.ftransdelta, fbodyS = motion.frotdelta;
+        Vector vbase = pbody->GetTransform().trans;
+        _vlinkmotionbound.resize(numlinks);
+        for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+            dReal fradius = 0;
+            FOREACHC(itab, _vlinkaabbs[ilink]) {
+                fradius = max(fradius, RaveSqrt((itab->pos-vbase).lengthsqr3()) + RaveSqrt(itab->extents.lengthsqr3()));
+            }
+            _vlinkmotionbound[ilink] = motion.frotdelta*fradius;
+        }
+        for(size_t idof = 0; idof < motion.vdofdelta.size(); ++idof) {
+            dReal fdelta = RaveFabs(motion.vdofdelta[idof]);
+            if( fdelta <= 0 ) {
+                continue;
+            }
+            KinBody::JointPtr pjoint = pbody->GetJointFromDOFIndex(idof);
+            if( pjoint->IsPrismatic(idof-pjoint->GetDOFIndex()) ) {
+                fbodyA += fdelta;
+                continue;
+            }
+            fbodyS += fdelta;
+            Vector vanchor = pjoint->GetAnchor();
+            for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+                if( pbody->DoesAffect(pjoint->GetJointIndex(), ilink) ) {
+                    dReal fradius = 0;
+                    FOREACHC(itab, _vlinkaabbs[ilink]) {
+                        fradius = max(fradius, RaveSqrt((itab->pos-vanchor).lengthsqr3()) + RaveSqrt(itab->extents.lengthsqr3()));
+                    }
+                    _vlinkmotionbound[ilink] += fdelta*fradius;
+                }
+            }
+        }
+        dReal fmaxlinkbound = 0;
+        FOREACHC(itbound, _vlinkmotionbound) {
+            fmaxlinkbound = max(fmaxlinkbound, *itbound);
+        }
+        fA += fbodyA + fmaxlinkbound;
+        fS = max(fS, fbodyS);
+    }
+}
+
+bool DynamicsCollisionConstraint::_IsNeighStateFnLinear(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq)
+{
+    // test the middle and the end of the interval
+    _vtempstepdelta.resize(dq.size());
+    for(int itest = 1; itest <= 2; ++itest) {
+        dReal fstep = 0.5*itest;
+        _vtempconfig = q0;
+        for(size_t i = 0; i < dq.size(); ++i) {
+            _vtempstepdelta[i] = fstep*dq[i];
+        }
+        if( !params->_neighstatefn(_vtempconfig, _vtempstepdelta, 0) ) {
+            return false;
+        }
+        for(size_t i = 0; i < dq.size(); ++i) {
+            if( RaveFabs(_vtempconfig[i] - q0[i] - fstep*dq[i]) > g_fEpsilonLinear ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int DynamicsCollisionConstraint::_CheckContinuousCollision(PlannerBase::PlannerParametersPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq, dReal timeelapsed, bool bCheckStart, int options, int maskoptions, ConstraintFilterReturnPtr filterreturn)
+{
+    if( !(maskoptions & (CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        return -1;
+    }
+    // constraints that can only be evaluated at discrete configurations
+    if( (maskoptions & CFO_CheckTimeBasedConstraints) || ((maskoptions & CFO_CheckUserConstraints) && (!!_usercheckfns[0] || !!_usercheckfns[1])) ) {
+        return -1;
+    }
+    // the angle of interpolated 3D rotations is not bounded by the angle between the end points
+    FOREACHC(itgroup, params->_configurationspecification._vgroups) {
+        if( itgroup->name.size() >= 16 && itgroup->name.substr(0,16) == "affine_transform" ) {
+            stringstream ss(itgroup->name.substr(16));
+            string bodyname;
+            int affinedofs=0;
+            ss >> bodyname >> affinedofs;
+            if( affinedofs & (DOF_RotationAxis|DOF_Rotation3D|DOF_RotationQuat) ) {
+                return -1;
+            }
+        }
+    }
+    // the motion bounds assume the configurations q0 + t*dq, so custom neighbor functions (projections, wrapping of circular values) have to be discretized
+    if( !_IsNeighStateFnLinear(params, q0, dq) ) {
+        return -1;
+    }
+
+    CollisionCheckerBasePtr pchecker = _listCheckBodies.front()->GetEnv()->GetCollisionChecker();
+    if( !pchecker ) {
+        return -1;
+    }
+    int oldoptions = pchecker->GetCollisionOptions();
+    CollisionOptionsStateSaver optionsaver(pchecker, oldoptions, false); // restores the options
+    if( !pchecker->SetCollisionOptions(oldoptions|CO_Distance) ) {
+        RAVELOG_VERBOSE(str(boost::format("checker %s does not compute distances, discretizing interval\n")%pchecker->GetXMLId()));
+        return -1;
+    }
+
+    // record the motion of the bodies over the interval
+    _vcontinuousmotion.resize(_listCheckBodies.size());
+    _vtempconfig.resize(q0.size());
+    std::vector<dReal> vdofvalues;
+    for(int iend = 0; iend < 2; ++iend) {
+        for(size_t i = 0; i < q0.size(); ++i) {
+            _vtempconfig[i] = q0[i] + iend*dq.at(i);
+        }
+        if( params->SetStateValues(_vtempconfig, 0) != 0 ) {
+            return CFO_StateSettingError;
+        }
+        std::vector<ContinuousBodyMotion>::iterator itmotion = _vcontinuousmotion.begin();
+        FOREACHC(itbody, _listCheckBodies) {
+            ContinuousBodyMotion& motion = *itmotion++;
+            if( iend == 0 ) {
+                (*itbody)->GetDOFValues(motion.vdofvalues);
+                motion.tstart = (*itbody)->GetTransform();
+                continue;
+            }
+            (*itbody)->GetDOFValues(vdofvalues);
+            motion.vdofdelta = vdofvalues;
+            (*itbody)->SubtractDOFValues(motion.vdofdelta, motion.vdofvalues);
+            Transform tend = (*itbody)->GetTransform();
+            motion.ftransdelta = RaveSqrt((tend.trans-motion.tstart.trans).lengthsqr3());
+            motion.frotdelta = 2*RaveAcos(min(dReal(1),RaveFabs(tend.rot.dot(motion.tstart.rot))));
+            for(size_t idof = 0; idof < motion.vdofdelta.size(); ++idof) {
+                if( motion.vdofdelta[idof] == 0 ) {
+                    continue;
+                }
+                KinBody::JointPtr pjoint = (*itbody)->GetJointFromDOFIndex(idof);
+                int iaxis = idof-pjoint->GetDOFIndex();
+                if( (!pjoint->IsRevolute(iaxis) && !pjoint->IsPrismatic(iaxis)) || pjoint->IsCircular(iaxis) ) {
+                    return -1;
+                }
+            }
+            // passive joints can move links with a velocity that is not bounded by the DOF motion
+            FOREACHC(itjoint, (*itbody)->GetPassiveJoints()) {
+                for(int iaxis = 0; iaxis < (*itjoint)->GetDOF(); ++iaxis) {
+                    if( (*itjoint)->IsMimic(iaxis) ) {
+                        std::vector<int> vmimicdofs;
+                        (*itjoint)->GetMimicDOFIndices(vmimicdofs, iaxis);
+                        FOREACHC(itdof, vmimicdofs) {
+                            if( motion.vdofdelta.at(*itdof) != 0 ) {
+                                return -1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // conservative advancement
+    dReal t = 0, fmindist = 0, fA = 0, fS = 0;
+    int nclosestconstraint = 0;
+    while(1) {
+        for(size_t i = 0; i < q0.size(); ++i) {
+            _vtempconfig[i] = q0[i] + t*dq[i];
+        }
+        if( params->SetStateValues(_vtempconfig, 0) != 0 ) {
+            return CFO_StateSettingError;
+        }
+        ++_nCheckedSamples;
+        int nstateret = _ComputeMinDistance(maskoptions, fmindist, nclosestconstraint);
+        if( nstateret == 0 && fmindist <= _fsafetydistance ) {
+            _PrintOnFailure(str(boost::format("distance %e is below the safety distance")%fmindist));
+            nstateret = nclosestconstraint;
+        }
+        if( t == 0 && !bCheckStart ) {
+            if( nstateret != 0 ) {
+                // the start is not part of the interval, so let the discretization decide
+                return -1;
+            }
+        }
+        else if( !!filterreturn && (options & CFO_FillCheckedConfiguration) ) {
+            filterreturn->_configurations.insert(filterreturn->_configurations.end(), _vtempconfig.begin(), _vtempconfig.end());
+            filterreturn->_configurationtimes.push_back(t*timeelapsed);
+        }
+        if( nstateret != 0 ) {
+            if( !!filterreturn ) {
+                filterreturn->_returncode = nstateret;
+                filterreturn->_invalidvalues = _vtempconfig;
+                filterreturn->_fTimeWhenInvalid = t*timeelapsed;
+            }
+            return nstateret;
+        }
+
+        _ComputeContinuousMotionBound(fA, fS);
+        // two points of the bodies can approach each other by twice the motion bound
+        dReal fdenom = 2*fA + fmindist*fS;
+        if( fdenom <= 0 ) {
+            break;
+        }
+        t += fmindist/fdenom;
+        if( t >= 1 ) {
+            break;
+        }
+    }
+    return 0;
+}
+
 int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::vector<dReal>& q1, const std::vector<dReal>& dq0, const std::vector<dReal>& dq1, dReal timeelapsed, IntervalType interval, int options, ConstraintFilterReturnPtr filterreturn)
 {
     int maskoptions = options&_filtermask;
+    _nCheckedSamples = 0;
     if( !!filterreturn ) {
         filterreturn->Clear();
     }
@@ -2168,6 +2619,18 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
         return 0;
     }
 
+    if( _intervalcheckmode == ICM_ContinuousCollision && !(timeelapsed > 0 && dq0.size() == _vtempconfig.size() && dq1.size() == _vtempconfig.size()) ) {
+        int nstateret = _CheckContinuousCollision(params, q0, dQ, timeelapsed, start == 0, options, maskoptions, filterreturn);
+        if( nstateret >= 0 ) {
+            if( nstateret == 0 && bCheckEnd && !!filterreturn && (options & CFO_FillCheckedConfiguration) ) {
+                filterreturn->_configurations.insert(filterreturn->_configurations.end(), q1.begin(), q1.end());
+                filterreturn->_configurationtimes.push_back(timeelapsed);
+            }
+            return nstateret;
+        }
+        // could not certify, so discretize
+    }
+
     if( !!filterreturn && (options & CFO_FillCheckedConfiguration) ) {
         if( (int)filterreturn->_configurations.capacity() < (1+numSteps)*params->GetDOF() ) {
             filterreturn->_configurations.reserve((1+numSteps)*params->GetDOF());
@@ -2194,6 +2657,10 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
         start = 1;
     }
 
+    bool bQuadratic = timeelapsed > 0 && dq0.size() == _vtempconfig.size() && dq1.size() == _vtempconfig.size();
+    // the van der Corput samples are computed directly from q0, so they are only the sequential samples if the neighbor function adds the delta linearly
+    bool bVanDerCorput = _intervalcheckmode == ICM_VanDerCorput && !bQuadratic && !(options & CFO_FillCheckedConfiguration) && _IsNeighStateFnLinear(params, q0, dQ);
+
     for (i = 0; i < params->GetDOF(); i++) {
         _vtempconfig.at(i) = q0.at(i);
     }
@@ -2201,7 +2668,7 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
         _vtempvelconfig = dq0;
     }
 
-    if( timeelapsed > 0 && dq0.size() == _vtempconfig.size() && dq1.size() == _vtempconfig.size() ) {
+    if( bQuadratic ) {
         // quadratic interpolation
         // given the nLargestStepIndex, determine the timestep for all joints
         dReal fLargestStepDelta = dQ.at(nLargestStepIndex)/dReal(numSteps);
@@ -2258,6 +2725,51 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
             }
         }
     }
+    else if( bVanDerCorput ) {
+        // check the same steps as below, but in bit-reversed order so that the samples spread over the whole segment as early as possible
+        int numbits = 0;
+        while( (1<<numbits) < numSteps ) {
+            ++numbits;
+        }
+        _vtempstepdelta.resize(dQ.size());
+        for(int i = 0; i < (1<<numbits); ++i) {
+            int f = 0;
+            for(int ibit = 0; ibit < numbits; ++ibit) {
+                if( i & (1<<ibit) ) {
+                    f |= 1<<(numbits-1-ibit);
+                }
+            }
+            if( f < start || f >= numSteps ) {
+                continue;
+            }
+            dReal fstep = dReal(f)/numSteps;
+            for(size_t j = 0; j < dQ.size(); ++j) {
+                _vtempconfig[j] = q0[j];
+                _vtempstepdelta[j] = dQ[j]*fstep;
+            }
+            if( !params->_neighstatefn(_vtempconfig, _vtempstepdelta, 0) ) {
+                return CFO_StateSettingError;
+            }
+            if( dq0.size() == q0.size() && _vtempveldelta.size() == q1.size() ) {
+                for(size_t j = 0; j < _vtempveldelta.size(); ++j) {
+                    _vtempvelconfig.at(j) = dq0[j] + _vtempveldelta[j]*fstep;
+                }
+            }
+            int nstateret = _SetAndCheckState(params, _vtempconfig, _vtempvelconfig, _vtempaccelconfig, maskoptions, filterreturn);
+            if( !!params->_getstatefn ) {
+                params->_getstatefn(_vtempconfig);     // query again in order to get normalizations/joint limits
+            }
+            if( nstateret != 0 ) {
+                if( !!filterreturn ) {
+                    filterreturn->_returncode = nstateret;
+                    filterreturn->_invalidvalues = _vtempconfig;
+                    filterreturn->_invalidvelocities = _vtempvelconfig;
+                    filterreturn->_fTimeWhenInvalid = 0;
+                }
+                return nstateret;
+            }
+        }
+    }
     else {
         // check for collision along the straight-line path
         // NOTE: this does not check the end config, and may or may
@@ -2612,5 +3124,590 @@ void ManipulatorIKGoalSampler::SetJitter(dReal maxdist)
     _fjittermaxdist = maxdist;
 }
 
+struct NearestNeighborTree::SearchState
+{
+    SearchState(int k, dReal fmaxdist2, dReal eps) : _k(k), _fmaxdist2(fmaxdist2), _feps2mult((1+eps)*(1+eps)) {
+    }
+
+    /// \brief adds a point that is within _fmaxdist2
+    inline void Add(dReal fdist2, int index) {
+        if( _k <= 0 ) {
+            if( fdist2 <= _fmaxdist2 ) {
+                _vneighbors.push_back(std::make_pair(fdist2,index));
+            }
+        }
+        else if( (int)_vneighbors.size() < _k ) {
+            _vneighbors.push_back(std::make_pair(fdist2,index));
+            std::push_heap(_vneighbors.begin(),_vneighbors.end());
+            if( (int)_vneighbors.size() == _k ) {
+                _fmaxdist2 = _vneighbors.front().first;
+            }
+        }
+        else if( fdist2 < _fmaxdist2 ) {
+            std::pop_heap(_vneighbors.begin(),_vneighbors.end());
+            _vneighbors.back() = std::make_pair(fdist2,index);
+            std::push_heap(_vneighbors.begin(),_vneighbors.end());
+            _fmaxdist2 = _vneighbors.front().first;
+        }
+    }
+
+    int _k; ///< if > 0, the max number of neighbors to keep, otherwise keep all neighbors within _fmaxdist2
+    dReal _fmaxdist2, _feps2mult;
+    std::vector< std::pair<dReal, int> > _vneighbors; ///< max-heap of the neighbors when _k > 0
+};
+
+NearestNeighborTree::NearestNeighborTree(const std::vector<dReal>& vweights, const std::vector<uint8_t>& vcircular) : _vweights(vweights), _vcircular(vcircular)
+{
+    _vcircular.resize(_vweights.size(),0);
+    _Init();
+}
+
+NearestNeighborTree::NearestNeighborTree(RobotBaseConstPtr probot)
+{
+    probot->GetActiveDOFWeights(_vweights);
+    _vcircular.resize(_vweights.size(),0);
+    const std::vector<int>& vdofindices = probot->GetActiveDOFIndices();
+    for(size_t i = 0; i < vdofindices.size(); ++i) {
+        KinBody::JointPtr pjoint = probot->GetJointFromDOFIndex(vdofindices[i]);
+        _vcircular.at(i) = pjoint->IsCircular(vdofindices[i]-pjoint->GetDOFIndex());
+    }
+    if( probot->GetAffineDOF() & DOF_RotationAxis ) {
+        _vcircular.at(vdofindices.size()+RaveGetIndexFromAffineDOF(probot->GetAffineDOF(),DOF_RotationAxis)) = 1;
+    }
+    _Init();
+}
+
+void NearestNeighborTree::_Init()
+{
+    OPENRAVE_ASSERT_OP(_vweights.size(),>,0);
+    _vweights2.resize(_vweights.size());
+    for(size_t i = 0; i < _vweights.size(); ++i) {
+        _vweights2[i] = _vweights[i]*_vweights[i];
+    }
+    Reset();
+}
+
+void NearestNeighborTree::Reset()
+{
+    _vpoints.resize(0);
+    _vnodes.resize(0);
+    _root = -1;
+    _ntreesize = 0;
+    _nremoved = 0;
+}
+
+int NearestNeighborTree::Insert(const std::vector<dReal>& q)
+{
+    OPENRAVE_ASSERT_OP((int)q.size(),==,GetDOF());
+    int dof = GetDOF(), index = (int)_vnodes.size();
+    _vpoints.resize(_vpoints.size()+dof);
+    _NormalizePoint(&q[0], &_vpoints[index*dof]);
+    _vnodes.push_back(Node());
+    ++_ntreesize;
+    if( _root < 0 ) {
+        _root = index;
+        return index;
+    }
+
+    const dReal* p = &_vpoints[index*dof];
+    _vinsertpath.resize(0);
+    int inode = _root;
+    while(1) {
+        _vinsertpath.push_back(inode);
+        Node& node = _vnodes[inode];
+        node.size++;
+        int& child = p[node.splitdim] < _vpoints[inode*dof+node.splitdim] ? node.left : node.right;
+        if( child < 0 ) {
+            child = index;
+            _vnodes[index].splitdim = (node.splitdim+1)%dof;
+            break;
+        }
+        inode = child;
+    }
+
+    // if the tree became too deep, rebuild the subtree of the deepest ancestor that is unbalanced (scapegoat tree)
+    if( (dReal)_vinsertpath.size() > RaveLog((dReal)_ntreesize)/RaveLog(dReal(1)/dReal(0.75)) ) {
+        int ichild = index;
+        for(int i = (int)_vinsertpath.size()-1; i >= 0; --i) {
+            int iparent = _vinsertpath[i];
+            if( _vnodes[ichild].size > dReal(0.75)*_vnodes[iparent].size ) {
+                std::vector<int> vindices, vstack(1,iparent);
+                vindices.reserve(_vnodes[iparent].size);
+                while(vstack.size() > 0) {
+                    int isubnode = vstack.back();
+                    vstack.pop_back();
+                    vindices.push_back(isubnode);
+                    if( _vnodes[isubnode].left >= 0 ) {
+                        vstack.push_back(_vnodes[isubnode].left);
+                    }
+                    if( _vnodes[isubnode].right >= 0 ) {
+                        vstack.push_back(_vnodes[isubnode].right);
+                    }
+                }
+                int inewnode = _Build(vindices.begin(),vindices.end());
+                if( i == 0 ) {
+                    _root = inewnode;
+                }
+                else {
+                    Node& grandparent = _vnodes[_vinsertpath[i-1]];
+                    if( grandparent.left == iparent ) {
+                        grandparent.left = inewnode;
+                    }
+                    else {
+                        grandparent.right = inewnode;
+                    }
+                }
+                break;
+            }
+            ichild = iparent;
+        }
+    }
+    return index;
+}
+
+void NearestNeighborTree::InsertPoints(const std::vector<dReal>& vpoints)
+{
+    int dof = GetDOF();
+    OPENRAVE_ASSERT_OP((int)vpoints.size()%dof,==,0);
+    if( vpoints.size() == 0 ) {
+        return;
+    }
+    size_t numpoints = vpoints.size()/dof, index = _vnodes.size();
+    _vpoints.resize(_vpoints.size()+vpoints.size());
+    for(size_t i = 0; i < numpoints; ++i) {
+        _NormalizePoint(&vpoints[i*dof], &_vpoints[(index+i)*dof]);
+    }
+    _vnodes.resize(_vnodes.size()+numpoints);
+    Rebuild();
+}
+
+void NearestNeighborTree::Remove(int index)
+{
+    Node& node = _vnodes.at(index);
+    if( !node.removed ) {
+        node.removed = true;
+        _nremoved++;
+        if( 2*_nremoved > _ntreesize ) {
+            Rebuild();
+        }
+    }
+}
+
+void NearestNeighborTree::Rebuild()
+{
+    std::vector<int> vindices;
+    vindices.reserve(_vnodes.size());
+    for(size_t i = 0; i < _vnodes.size(); ++i) {
+        if( !_vnodes[i].removed ) {
+            vindices.push_back(i);
+        }
+        // removed nodes are not part of the tree anymore
+        _vnodes[i].left = _vnodes[i].right = -1;
+        _vnodes[i].size = 1;
+    }
+    _root = _Build(vindices.begin(),vindices.end());
+    _ntreesize = (int)vindices.size();
+    _nremoved = 0;
+}
+
+class NearestNeighborTreeCompare
+{
+public:
+    NearestNeighborTreeCompare(const std::vector<dReal>& vpoints, int dof, int idim) : _vpoints(vpoints), _dof(dof), _idim(idim) {
+    }
+    bool operator()(int i0, int i1) const {
+        return _vpoints[i0*_dof+_idim] < _vpoints[i1*_dof+_idim];
+    }
+    const std::vector<dReal>& _vpoints;
+    int _dof, _idim;
+};
+
+int NearestNeighborTree::_Build(std::vector<int>::iterator itbegin, std::vector<int>::iterator itend)
+{
+    if( itbegin == itend ) {
+        return -1;
+    }
+    int dof = GetDOF();
+    // split along the dimension with the largest weighted spread
+    int splitdim = 0;
+    dReal fmaxspread = -1;
+    for(int idim = 0; idim < dof; ++idim) {
+        dReal flower = _vpoints[*itbegin*dof+idim], fupper = flower;
+        for(std::vector<int>::iterator it = itbegin+1; it != itend; ++it) {
+            dReal f = _vpoints[*it*dof+idim];
+            flower = min(flower,f);
+            fupper = max(fupper,f);
+        }
+        dReal fspread = _vweights[idim]*(fupper-flower);
+        if( fspread > fmaxspread ) {
+            fmaxspread = fspread;
+            splitdim = idim;
+        }
+    }
+    std::vector<int>::iterator itmedian = itbegin + (itend-itbegin)/2;
+    std::nth_element(itbegin, itmedian, itend, NearestNeighborTreeCompare(_vpoints, dof, splitdim));
+    int inode = *itmedian;
+    Node& node = _vnodes[inode];
+    node.splitdim = splitdim;
+    node.size = (int)(itend-itbegin);
+    node.left = _Build(itbegin, itmedian);
+    node.right = _Build(itmedian+1, itend);
+    return inode;
+}
+
+void NearestNeighborTree::GetPoint(int index, std::vector<dReal>& q) const
+{
+    OPENRAVE_ASSERT_OP(index,<,(int)_vnodes.size());
+    q.resize(GetDOF());
+    std::copy(_vpoints.begin()+index*GetDOF(), _vpoints.begin()+(index+1)*GetDOF(), q.begin());
+}
+
+dReal NearestNeighborTree::ComputeDistance(const std::vector<dReal>& q0, const std::vector<dReal>& q1) const
+{
+    OPENRAVE_ASSERT_OP((int)q0.size(),==,GetDOF());
+    OPENRAVE_ASSERT_OP((int)q1.size(),==,GetDOF());
+    dReal fdist2 = 0;
+    for(size_t i = 0; i < _vweights2.size(); ++i) {
+        dReal f = _vcircular[i] ? utils::SubtractCircularAngle(q0[i],q1[i]) : q0[i]-q1[i];
+        fdist2 += _vweights2[i]*f*f;
+    }
+    return RaveSqrt(fdist2);
+}
+
+int NearestNeighborTree::FindNearest(const std::vector<dReal>& q, dReal& fdist) const
+{
+    std::vector<int> vindices;
+    std::vector<dReal> vdists;
+    if( FindNearestK(q, 1, vindices, vdists) == 0 ) {
+        return -1;
+    }
+    fdist = vdists.at(0);
+    return vindices.at(0);
+}
+
+int NearestNeighborTree::FindNearestK(const std::vector<dReal>& q, int k, std::vector<int>& vindices, std::vector<dReal>& vdists, dReal eps) const
+{
+    OPENRAVE_ASSERT_OP((int)q.size(),==,GetDOF());
+    vindices.resize(0);
+    vdists.resize(0);
+    if( _root < 0 || k <= 0 ) {
+        return 0;
+    }
+    SearchState state(k, std::numeric_limits<dReal>::infinity(), eps);
+    state._vneighbors.reserve(k);
+    std::vector<dReal> qnorm(GetDOF()), vlower(GetDOF()), vupper(GetDOF());
+    _NormalizePoint(&q[0], &qnorm[0]);
+    for(int i = 0; i < GetDOF(); ++i) {
+        vlower[i] = _vcircular[i] ? -PI : -std::numeric_limits<dReal>::infinity();
+        vupper[i] = _vcircular[i] ? PI : std::numeric_limits<dReal>::infinity();
+    }
+    _Search(_root, &qnorm[0], 0, vlower, vupper, state);
+    std::sort_heap(state._vneighbors.begin(), state._vneighbors.end());
+    vindices.reserve(state._vneighbors.size());
+    vdists.reserve(state._vneighbors.size());
+    FOREACH(it, state._vneighbors) {
+        vdists.push_back(RaveSqrt(it->first));
+        vindices.push_back(it->second);
+    }
+    return (int)vindices.size();
+}
+
+int NearestNeighborTree::FindRadius(const std::vector<dReal>& q, dReal fradius, std::vector<int>& vindices, std::vector<dReal>& vdists) const
+{
+    OPENRAVE_ASSERT_OP((int)q.size(),==,GetDOF());
+    vindices.resize(0);
+    vdists.resize(0);
+    if( _root < 0 || fradius < 0 ) {
+        return 0;
+    }
+    SearchState state(0, fradius*fradius, 0);
+    std::vector<dReal> qnorm(GetDOF()), vlower(GetDOF()), vupper(GetDOF());
+    _NormalizePoint(&q[0], &qnorm[0]);
+    for(int i = 0; i < GetDOF(); ++i) {
+        vlower[i] = _vcircular[i] ? -PI : -std::numeric_limits<dReal>::infinity();
+        vupper[i] = _vcircular[i] ? PI : std::numeric_limits<dReal>::infinity();
+    }
+    _Search(_root, &qnorm[0], 0, vlower, vupper, state);
+    std::sort(state._vneighbors.begin(), state._vneighbors.end());
+    vindices.reserve(state._vneighbors.size());
+    vdists.reserve(state._vneighbors.size());
+    FOREACH(it, state._vneighbors) {
+        vdists.push_back(RaveSqrt(it->first));
+        vindices.push_back(it->second);
+    }
+    return (int)vindices.size();
+}
+
+void NearestNeighborTree::_NormalizePoint(const dReal* pin, dReal* pout) const
+{
+    for(size_t i = 0; i < _vcircular.size(); ++i) {
+        pout[i] = _vcircular[i] ? utils::NormalizeCircularAngle(pin[i],-PI,PI) : pin[i];
+    }
+}
+
+dReal NearestNeighborTree::_ComputeDistance2(const dReal* q0, const dReal* q1) const
+{
+    dReal fdist2 = 0;
+    for(size_t i = 0; i < _vweights2.size(); ++i) {
+        dReal f = RaveFabs(q0[i]-q1[i]);
+        if( _vcircular[i] && f > PI ) {
+            f = 2*PI-f;
+        }
+        fdist2 += _vweights2[i]*f*f;
+    }
+    return fdist2;
+}
+
+dReal NearestNeighborTree::_ComputeOffset2(int idim, dReal q, dReal flower, dReal fupper) const
+{
+    if( q >= flower && q <= fupper ) {
+        return 0;
+    }
+    dReal f;
+    if( _vcircular[idim] ) {
+        // shortest angle to either end of the arc
+        dReal f0 = RaveFabs(q-flower), f1 = RaveFabs(q-fupper);
+        if( f0 > PI ) {
+            f0 = 2*PI-f0;
+        }
+        if( f1 > PI ) {
+            f1 = 2*PI-f1;
+        }
+        f = min(f0,f1);
+    }
+    else {
+        f = q < flower ? flower-q : q-fupper;
+    }
+    return _vweights2[idim]*f*f;
+}
+
+void NearestNeighborTree::_Search(int inode, const dReal* q, dReal rd, std::vector<dReal>& vlower, std::vector<dReal>& vupper, SearchState& state) const
+{
+    const Node& node = _vnodes[inode];
+    const dReal* p = &_vpoints[inode*GetDOF()];
+    if( !node.removed ) {
+        state.Add(_ComputeDistance2(q,p), inode);
+    }
+    int idim = node.splitdim;
+    dReal fsplit = p[idim], forglower = vlower[idim], forgupper = vupper[idim];
+    // rd is the squared distance to the region of the node, update it with the offset of each child's region
+    dReal forgoffset = _ComputeOffset2(idim, q[idim], forglower, forgupper);
+    dReal frdleft = rd - forgoffset + _ComputeOffset2(idim, q[idim], forglower, fsplit);
+    dReal frdright = rd - forgoffset + _ComputeOffset2(idim, q[idim], fsplit, forgupper);
+    bool bleftfirst = frdleft <= frdright;
+    for(int ichild = 0; ichild < 2; ++ichild) {
+        bool bleft = (ichild == 0) == bleftfirst;
+        int ichildnode = bleft ? node.left : node.right;
+        dReal frd = bleft ? frdleft : frdright;
+        if( ichildnode >= 0 && frd*state._feps2mult <= state._fmaxdist2 ) {
+            if( bleft ) {
+                vupper[idim] = fsplit;
+            }
+            else {
+                vlower[idim] = fsplit;
+            }
+            _Search(ichildnode, q, frd, vlower, vupper, state);
+            vlower[idim] = forglower;
+            vupper[idim] = forgupper;
+        }
+    }
+}
+
+AsyncPlanner::AsyncPlanner(const std::string& plannername, int cloneoptions) : _plannername(plannername), _cloneoptions(cloneoptions), _status(PS_Failed), _deadline(0), _bCancel(false), _bDone(true)
+{
+}
+
+AsyncPlanner::~AsyncPlanner()
+{
+    Cancel();
+    boost::mutex::scoped_lock lockthread(_mutexthread);
+    if( !!_thread ) {
+        _thread->join();
+    }
+}
+
+bool AsyncPlanner::Start(RobotBasePtr robot, PlannerBase::PlannerParametersConstPtr parameters, dReal fdeadline)
+{
+    // serializes concurrent Start calls
+    boost::mutex::scoped_lock lockthread(_mutexthread);
+    if( !IsDone() ) {
+        RAVELOG_WARN("previous planning has not finished\n");
+        return false;
+    }
+    if( !!_thread ) {
+        _thread->join();
+        _thread.reset();
+    }
+
+    EnvironmentBasePtr penv;
+    TrajectoryBasePtr ptrajout;
+    {
+        EnvironmentMutex::scoped_lock lock(robot->GetEnv()->GetMutex());
+        penv = robot->GetEnv()->CloneSelf(_cloneoptions);
+        ptrajout = RaveCreateTrajectory(robot->GetEnv(), "");
+    }
+
+    RobotBasePtr probot;
+    PlannerBasePtr planner;
+    PlannerBase::PlannerParametersPtr params(new PlannerBase::PlannerParameters());
+    try {
+        EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+        probot = penv->GetRobot(robot->GetName());
+        if( !probot ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("robot %s is not in the cloned environment", robot->GetName(), ORE_InvalidArguments);
+        }
+        planner = RaveCreatePlanner(penv, _plannername);
+        if( !planner ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to create planner %s", _plannername, ORE_InvalidArguments);
+        }
+        // only copy the serialized data since the functions of the parameters point to the original environment
+        std::stringstream ss;
+        ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        ss << *parameters;
+        ss >> *params;
+        std::vector<dReal> vinitialconfig = params->vinitialconfig, vlower = params->_vConfigLowerLimit, vupper = params->_vConfigUpperLimit, vvelocity = params->_vConfigVelocityLimit, vaccel = params->_vConfigAccelerationLimit, vresolution = params->_vConfigResolution;
+        params->SetConfigurationSpecification(penv, params->_configurationspecification);
+        params->vinitialconfig.swap(vinitialconfig);
+        params->_vConfigLowerLimit.swap(vlower);
+        params->_vConfigUpperLimit.swap(vupper);
+        params->_vConfigVelocityLimit.swap(vvelocity);
+        params->_vConfigAccelerationLimit.swap(vaccel);
+        params->_vConfigResolution.swap(vresolution);
+    }
+    catch(...) {
+        penv->Destroy();
+        throw;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _status = PS_Failed;
+        _traj.reset();
+        _progress = PlannerBase::PlannerProgress();
+        _deadline = fdeadline > 0 ? utils::GetMicroTime() + (uint64_t)(fdeadline*1000000) : 0;
+        _bCancel = false;
+        _bDone = false;
+    }
+    _thread.reset(new boost::thread(boost::bind(&AsyncPlanner::_PlanThread, this, penv, probot, planner, params, ptrajout)));
+    return true;
+}
+
+void AsyncPlanner::Cancel()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _bCancel = true;
+}
+
+bool AsyncPlanner::Wait(dReal ftimeout)
+{
+    // wait on the done flag rather than joining, so that several threads can wait while Start and the destructor join
+    boost::mutex::scoped_lock lock(_mutex);
+    if( ftimeout > 0 ) {
+        boost::system_time endtime = boost::get_system_time() + boost::posix_time::microseconds((uint64_t)(ftimeout*1000000));
+        while( !_bDone ) {
+            if( !_condDone.timed_wait(lock, endtime) ) {
+                return _bDone;
+            }
+        }
+        return true;
+    }
+    while( !_bDone ) {
+        _condDone.wait(lock);
+    }
+    return true;
+}
+
+bool AsyncPlanner::IsDone() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _bDone;
+}
+
+PlannerStatus AsyncPlanner::GetStatus() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _status;
+}
+
+TrajectoryBasePtr AsyncPlanner::GetTrajectory() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _traj;
+}
+
+PlannerBase::PlannerProgress AsyncPlanner::GetProgress() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _progress;
+}
+
+void AsyncPlanner::SetProgressCallback(const PlannerBase::PlanCallbackFn& progressfn)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _progressfn = progressfn;
+}
+
+void AsyncPlanner::_PlanThread(EnvironmentBasePtr penv, RobotBasePtr probot, PlannerBasePtr planner, PlannerBase::PlannerParametersPtr params, TrajectoryBasePtr ptrajout)
+{
+    PlannerStatus status = PS_Failed;
+    bool bhassolution = false;
+    try {
+        EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+        UserDataPtr callbackhandle = planner->RegisterPlanCallback(boost::bind(&AsyncPlanner::_PlanCallback,this,_1));
+        if( planner->InitPlan(probot, params) ) {
+            if( _PlanCallback(PlannerBase::PlannerProgress()) == PA_Interrupt ) {
+                status = PS_Interrupted;
+            }
+            else {
+                TrajectoryBasePtr ptraj = RaveCreateTrajectory(penv, ptrajout->GetXMLId());
+                status = planner->PlanPath(ptraj);
+                if( status & PS_HasSolution ) {
+                    ptrajout->Clone(ptraj, 0);
+                    bhassolution = true;
+                }
+            }
+        }
+        else {
+            RAVELOG_WARN(str(boost::format("failed to init planner %s\n")%_plannername));
+        }
+    }
+    catch(const std::exception& ex) {
+        RAVELOG_WARN(str(boost::format("planner %s threw an exception: %s\n")%_plannername%ex.what()));
+        status = PS_Failed;
+    }
+    planner.reset();
+    probot.reset();
+    penv->Destroy();
+
+    boost::mutex::scoped_lock lock(_mutex);
+    _status = status;
+    if( bhassolution ) {
+        _traj = ptrajout;
+    }
+    _bDone = true;
+    _condDone.notify_all();
+}
+
+PlannerAction AsyncPlanner::_PlanCallback(const PlannerBase::PlannerProgress& progress)
+{
+    PlannerBase::PlanCallbackFn progressfn;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _progress = progress;
+        if( _bCancel ) {
+            return PA_Interrupt;
+        }
+        if( _deadline > 0 && utils::GetMicroTime() >= _deadline ) {
+            RAVELOG_DEBUG(str(boost::format("planner %s reached the deadline\n")%_plannername));
+            return PA_Interrupt;
+        }
+        progressfn = _progressfn;
+    }
+    if( !!progressfn ) {
+        return progressfn(progress);
+    }
+    return PA_None;
+}
+
 } // planningutils
 } // OpenRAVE
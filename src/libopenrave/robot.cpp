@@ -1909,6 +1909,17 @@ void RobotBase::SimulationStep(dReal fElapsedTime)
     _UpdateAttachedSensors();
 }
 
+bool RobotBase::SupportsParallelSimulationStep() const
+{
+    // SimulationStep sets the transforms of the grabbed bodies, which other robots could be grabbing or checking at the same time
+    if( _vGrabbedBodies.size() > 0 ) {
+        return false;
+    }
+    // the attached sensors updated in SimulationStep belong to this robot
+    ControllerBasePtr pcontroller = GetController();
+    return !pcontroller || pcontroller->SupportsParallelSimulationStep();
+}
+
 void RobotBase::_ComputeInternalInformation()
 {
     KinBody::_ComputeInternalInformation();
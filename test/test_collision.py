@@ -194,6 +194,63 @@ class RunCollision(EnvironmentSetup):
         assert(env.CheckCollision(env.GetKinBody('mug1')))
         assert(len(reports)==1)
 
+    def test_selfcollisioncache(self):
+        self.log.info('self-collision results have to be the same with and without the ode self-collision cache')
+        env=self.env
+        if env.GetCollisionChecker().GetXMLId() != 'ode':
+            return
+        checker = env.GetCollisionChecker()
+        with env:
+            robot=env.ReadRobotURI('robots/barrettwam.robot.xml')
+            env.Add(robot)
+            lower,upper = robot.GetDOFLimits()
+            values = []
+            for i in range(50):
+                v = random.rand(len(lower))*(upper-lower)+lower
+                values.append(v)
+                # only move the last joints so that the upstream pairs can be skipped
+                for j in range(3):
+                    v = array(v)
+                    v[3:] = random.rand(len(lower)-3)*(upper[3:]-lower[3:])+lower[3:]
+                    values.append(v)
+            checker.SendCommand('SetSelfCollisionCache 0')
+            results = []
+            for v in values:
+                robot.SetDOFValues(v)
+                results.append(robot.CheckSelfCollision())
+            checker.SendCommand('SetSelfCollisionCache 1')
+            for v,result in zip(values,results):
+                robot.SetDOFValues(v)
+                assert(robot.CheckSelfCollision() == result)
+            numchecked,numskipped,numcached = [int(s) for s in checker.SendCommand('GetSelfCollisionCacheStatistics %s 1'%robot.GetName()).split()]
+            assert(numchecked > 0 and numskipped > 0)
+            checker.SendCommand('SetSelfCollisionCache 0')
+
+    def test_collisionrays(self):
+        self.log.info('check that batched rays agree with single ray checks and only report hits with contacts')
+        env=self.env
+        with env:
+            box=RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[0,0,0,1,1,1]]),True)
+            box.SetName('box')
+            env.Add(box,True)
+            rays = array([[0,0,3,0,0,-5],[3,3,3,0,0,-5],[0,0,3,0,0,-1],[0.5,-0.2,-3,0,0,5],[0,0,3,0,0,5]])
+            collision,info = env.CheckCollisionRays(rays,None)
+            assert(collision.tolist() == [True,False,False,True,False])
+            assert(transdist(info[0],[0,0,1,0,0,1]) <= 1e-5)
+            assert(transdist(info[3],[0.5,-0.2,-1,0,0,-1]) <= 1e-5)
+            assert(all(info[[1,2,4]]==0))
+            report = CollisionReport()
+            for i,ray in enumerate(rays):
+                assert(env.CheckCollision(Ray(ray[0:3],ray[3:6]),report) == collision[i])
+                if collision[i]:
+                    assert(transdist(report.contacts[0].pos,info[i][0:3]) <= 1e-5)
+
+            collision,info = env.CheckCollisionRays(rays,box,True)
+            assert(collision.tolist() == [True,False,False,True,False])
+            collision,info = env.CheckCollisionRays(zeros((0,6)),None)
+            assert(len(collision) == 0)
+
     def test_activedofdistance(self):
         self.log.debug('test distance computation with active dofs')
         env=self.env
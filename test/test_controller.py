@@ -59,7 +59,120 @@ class RunController(EnvironmentSetup):
             # should move
             self.RunTrajectory(robot1,traj)
             assert(transdist(robot1.GetActiveDOFValues(),waypoint) <= g_epsilon)
-        
+
+    def test_parallelstep(self):
+        self.log.debug('steps the controllers of two robots in parallel')
+        robot1=self.LoadRobot('robots/schunk-lwa3.zae')
+        robot1.SetName('_R1_')
+        robot2=self.LoadRobot('robots/schunk-lwa3.zae')
+        robot2.SetName('_R2_')
+        env=self.env
+        env.SetSimulationStepThreads(4)
+        assert(env.GetSimulationStepThreads() == 4)
+        with env:
+            T=eye(4)
+            T[0,3] = 0.5
+            robot1.SetTransform(T)
+            T[0,3] = -0.5
+            robot2.SetTransform(T)
+            # robots grabbing bodies are stepped serially
+            box=RaveCreateKinBody(env,'')
+            box.SetName('box')
+            box.InitFromBoxes(array([[0,0,0,0.02,0.02,0.02]]),True)
+            env.Add(box,True)
+            box.SetTransform(robot2.GetActiveManipulator().GetTransform())
+            robot2.Grab(box)
+            Tboxlocal = dot(linalg.inv(robot2.GetActiveManipulator().GetTransform()),box.GetTransform())
+            waypoints = []
+            for robot,value in [(robot1,0.5),(robot2,-0.5)]:
+                waypoint=zeros(robot.GetActiveDOF())
+                waypoint[0] = value
+                waypoint[1] = value
+                traj=RaveCreateTrajectory(env, '')
+                traj.Init(robot.GetActiveConfigurationSpecification('quadratic'))
+                traj.Insert(0,r_[robot.GetActiveDOFValues(),waypoint])
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                robot.GetController().SetPath(traj)
+                waypoints.append(waypoint)
+            while not robot1.GetController().IsDone() or not robot2.GetController().IsDone():
+                env.StepSimulation(0.01)
+            assert(transdist(robot1.GetActiveDOFValues(),waypoints[0]) <= g_epsilon)
+            assert(transdist(robot2.GetActiveDOFValues(),waypoints[1]) <= g_epsilon)
+            assert(transdist(box.GetTransform(),dot(robot2.GetActiveManipulator().GetTransform(),Tboxlocal)) <= g_epsilon)
+            robot2.ReleaseAllGrabbed()
+        env.SetSimulationStepThreads(1)
+
+    def test_streamchunks(self):
+        self.log.debug('streams two trajectory chunks and checks that they are blended')
+        robot=self.LoadRobot('robots/schunk-lwa3.zae')
+        env=self.env
+        with env:
+            controller=RaveCreateController(env,'TrajectoryStreamController')
+            robot.SetController(controller,range(robot.GetDOF()),0)
+            controller.SendCommand('SetBlendTime 0.05')
+            initvalues = robot.GetActiveDOFValues()
+            waypoint1=array(initvalues)
+            waypoint1[0] += 0.3
+            waypoint2=array(waypoint1)
+            waypoint2[1] += 0.3
+            trajs = []
+            for start,goal in [(initvalues,waypoint1),(waypoint1,waypoint2)]:
+                traj=RaveCreateTrajectory(env, '')
+                traj.Init(robot.GetActiveConfigurationSpecification('quadratic'))
+                traj.Insert(0,r_[start,goal])
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                trajs.append(traj)
+            spec = robot.GetActiveConfigurationSpecification()
+            def sampleexpected(traj,t):
+                return traj.Sample(min(t,traj.GetDuration()),spec)
+            
+            assert(controller.SetPath(trajs[0]))
+            assert(controller.SendCommand('AppendPath '+trajs[1].serialize(0)) is not None)
+            assert(not controller.IsDone())
+            # the chunks connect, so the robot follows the first trajectory and then the second one
+            duration0 = trajs[0].GetDuration()
+            numsteps = int((duration0+trajs[1].GetDuration())/0.01)+3
+            for istep in range(numsteps):
+                env.StepSimulation(0.01)
+                t = istep*0.01
+                expected = sampleexpected(trajs[0],t) if t <= duration0 else sampleexpected(trajs[1],t-duration0)
+                assert(transdist(robot.GetActiveDOFValues(),expected) <= 1e-5)
+                if controller.IsDone():
+                    break
+            assert(controller.IsDone())
+            assert(transdist(robot.GetActiveDOFValues(),waypoint2) <= g_epsilon)
+            
+            # a chunk starting away from the commanded values blends out the difference with a smoothstep
+            blendtime = 0.05
+            waypoint3=array(waypoint2)
+            waypoint3[0] += 0.05
+            traj=RaveCreateTrajectory(env, '')
+            traj.Init(robot.GetActiveConfigurationSpecification('quadratic'))
+            traj.Insert(0,r_[waypoint3,initvalues])
+            ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+            assert(ret==PlannerStatus.HasSolution)
+            assert(controller.SetPath(traj))
+            offset = waypoint2-waypoint3
+            numsteps = int(traj.GetDuration()/0.01)+3
+            for istep in range(numsteps):
+                env.StepSimulation(0.01)
+                t = istep*0.01
+                s = min(t/blendtime,1.0)
+                expected = sampleexpected(traj,t) + (1-s*s*(3-2*s))*offset
+                assert(transdist(robot.GetActiveDOFValues(),expected) <= 1e-5)
+                if controller.IsDone():
+                    break
+            assert(controller.IsDone())
+            assert(transdist(robot.GetActiveDOFValues(),initvalues) <= g_epsilon)
+            
+            # paused controllers reject new chunks
+            assert(controller.SendCommand('Pause 1') is not None)
+            assert(not controller.SetPath(trajs[0]))
+            assert(controller.SendCommand('AppendPath '+trajs[1].serialize(0)) is None)
+            assert(controller.SendCommand('Pause 0') is not None)
+
 #generate_classes(RunController, globals(), [('ode','ode'),('bullet','bullet')])
 
 class test_ideal(RunController):
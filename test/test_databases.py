@@ -40,3 +40,84 @@ class TestDatabases(EnvironmentSetup):
             
 #     def test_database_paths(self):
 #         pass
+
+    def test_linkstatisticsnative(self):
+        env=self.env
+        xml = """<robot name="twolink">
+  <kinbody>
+    <body name="base" type="dynamic">
+      <geom type="box"><extents>0.1 0.1 0.05</extents></geom>
+    </body>
+    <body name="link1" type="dynamic">
+      <offsetfrom>base</offsetfrom>
+      <translation>0 0 0.2</translation>
+      <geom type="box"><extents>0.04 0.04 0.15</extents></geom>
+    </body>
+    <body name="link2" type="dynamic">
+      <offsetfrom>link1</offsetfrom>
+      <translation>0 0 0.25</translation>
+      <geom type="box"><extents>0.03 0.03 0.1</extents></geom>
+    </body>
+    <joint name="j1" type="hinge">
+      <body>base</body><body>link1</body>
+      <offsetfrom>link1</offsetfrom>
+      <anchor>0 0 -0.15</anchor><axis>0 1 0</axis><limitsdeg>-90 90</limitsdeg>
+    </joint>
+    <joint name="j2" type="hinge">
+      <body>link1</body><body>link2</body>
+      <offsetfrom>link2</offsetfrom>
+      <anchor>0 0 -0.1</anchor><axis>1 0 0</axis><limitsdeg>-60 60</limitsdeg>
+    </joint>
+  </kinbody>
+</robot>
+"""
+        env.LoadData(xml)
+        robot=env.GetRobots()[0]
+        assert(RaveCreateModule(env,'LinkStatistics') is not None)
+        lmodel=databases.linkstatistics.LinkStatisticsModel(robot)
+        lmodel.generate(samplingdelta=0.04)
+        nativejointvolumes = list(lmodel.jointvolumes)
+        nativeaffinevolumes = list(lmodel.affinevolumes)
+
+        # the python implementation has to give the same volumes up to points on the samplingdelta boundary
+        density = 0.2*lmodel.samplingdelta
+        robotvolume = lmodel._computeSweptVolumesPython(density)
+        lmodel._computeAffineVolumeStatistics(robotvolume,density)
+        for native,python in izip(nativejointvolumes+nativeaffinevolumes,lmodel.jointvolumes+lmodel.affinevolumes):
+            if native is None:
+                assert(python is None)
+                continue
+            assert(abs(native['volume']-python['volume']) <= 0.02*python['volume'])
+            assert(numpy.max(abs(native['volumecom']-python['volumecom'])) <= 0.1*lmodel.samplingdelta)
+            if 'sweptvolume' in native:
+                assert(abs(len(native['sweptvolume'])-len(python['sweptvolume'])) <= 0.02*len(python['sweptvolume']))
+
+    def test_reachabilitynative(self):
+        env=self.env
+        self.LoadEnv('robots/barrettwam.robot.xml')
+        robot=env.GetRobots()[0]
+        rmodel = databases.kinematicreachability.ReachabilityModel(robot)
+        if not rmodel.ikmodel.load():
+            rmodel.ikmodel.autogenerate()
+        assert(rmodel.ikmodel.ikfastproblem is not None)
+        params = {'maxradius':0.4, 'xyzdelta':0.1, 'quatdelta':1.0}
+        rmodel.numthreads = 3
+        rmodel._generateNative(**params)
+        native = (rmodel.pointscale, rmodel.reachabilitydensity3d, rmodel.reachability3d, rmodel.reachabilitystats)
+        assert(len(native[3]) > 0)
+
+        producer,consumer,gatherer,numjobs = rmodel.generatepcg(**params)
+        for ind,T in producer():
+            gatherer(*consumer(ind,T))
+        gatherer()
+        assert(transdist(native[0],rmodel.pointscale) <= g_epsilon)
+        assert(native[1].shape == rmodel.reachabilitydensity3d.shape)
+        assert(transdist(native[1].flat,rmodel.reachabilitydensity3d.flat) <= g_epsilon)
+        assert(transdist(native[2].flat,rmodel.reachability3d.flat) <= g_epsilon)
+        # the native stats are in voxel order, the python stats in sampling order
+        nativestats = sorted(tuple(row) for row in around(native[3],6))
+        pythonstats = sorted(tuple(row) for row in around(rmodel.reachabilitystats,6))
+        assert(nativestats == pythonstats)
+
+        # a manipulator that does not exist is an error instead of a crash
+        assert(rmodel.ikmodel.ikfastproblem.SendCommand('ComputeReachability robot %s manipname nosuchmanip maxradius 0.2 xyzdelta 0.1 filename /tmp/nosuchreachability rotations 1 1 0 0 0'%robot.GetName()) is None)
@@ -15,6 +15,8 @@ from common_test_openrave import *
 from subprocess import Popen, PIPE
 import shutil
 import threading
+import socket
+import struct
 
 class TestEnvironment(EnvironmentSetup):
     def test_load(self):
@@ -262,3 +264,166 @@ class TestEnvironment(EnvironmentSetup):
         # thread is done, so should be able to lock
         assert(env.Lock(1.0))
         env.Unlock()
+
+    def test_publishedbodiesdelta(self):
+        env=self.env
+        with env:
+            boxes = []
+            for i in range(3):
+                box=RaveCreateKinBody(env,'')
+                box.SetName('box%d'%i)
+                box.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+                env.Add(box,True)
+                boxes.append(box)
+            env.UpdatePublishedBodies()
+        full,version,changedbodies,removedbodyids = env.GetPublishedBodiesDelta(0)
+        assert(full)
+        assert(sorted([state['environmentid'] for state in changedbodies]) == sorted([box.GetEnvironmentId() for box in boxes]))
+        assert(len(removedbodyids)==0)
+        
+        # nothing changed
+        with env:
+            env.UpdatePublishedBodies()
+        full,version2,changedbodies,removedbodyids = env.GetPublishedBodiesDelta(version)
+        assert(not full and version2 == version and len(changedbodies) == 0 and len(removedbodyids) == 0)
+        
+        with env:
+            T = eye(4)
+            T[0,3] = 1.0
+            boxes[1].SetTransform(T)
+            removedid = boxes[2].GetEnvironmentId()
+            env.Remove(boxes[2])
+            env.UpdatePublishedBodies()
+        full,version3,changedbodies,removedbodyids = env.GetPublishedBodiesDelta(version)
+        assert(not full and version3 > version)
+        assert(len(changedbodies) == 1 and changedbodies[0]['name'] == 'box1')
+        assert(transdist(changedbodies[0]['linktransforms'][0],T) <= g_epsilon)
+        assert(list(removedbodyids) == [removedid])
+        
+        # unknown versions return everything
+        full,version4,changedbodies,removedbodyids = env.GetPublishedBodiesDelta(version3+100)
+        assert(full and version4 == version3 and len(changedbodies) == 2)
+
+    def test_textserverpipeline(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        robotid = robot.GetEnvironmentId()
+        port = 4766
+        server=RaveCreateModule(env,'textserver')
+        assert(env.AddModule(server,'%d 2'%port)==0)
+        sock = socket.create_connection(('127.0.0.1',port),timeout=10.0)
+        def ReadData(size):
+            data = ''
+            while len(data) < size:
+                chunk = sock.recv(size-len(data))
+                assert(len(chunk) > 0)
+                data += chunk
+            return data
+        def ReadReply():
+            size, = struct.unpack('=I',ReadData(4))
+            return ReadData(size)
+        def BinaryFrame(requestid, line):
+            return struct.pack('=II',4+len(line),requestid)+line
+        
+        try:
+            # text lines, the hello and binary frames are all pipelined without waiting for any reply
+            textcommands = ['robot_getdofvalues %d'%robotid, 'body_getlinks %d'%robotid, 'body_getjoints %d 1 3'%robotid]
+            binarycommands = textcommands + ['robot_getdofvalues %d'%(robotid+1000), 'server_getstatistics']
+            requestids = [7,3,100,5,42]
+            sock.sendall(''.join([line+'\n' for line in textcommands]) + 'binary_hello\n' + ''.join([BinaryFrame(requestid,line) for requestid,line in izip(requestids,binarycommands)]))
+            
+            textvalues = [array([float(x) for x in ReadReply().split()]) for line in textcommands]
+            assert(transdist(textvalues[0],robot.GetDOFValues()) <= 1e-4)
+            assert(len(textvalues[1]) == 12*len(robot.GetLinks()))
+            assert(transdist(textvalues[2],robot.GetDOFValues([1,3])) <= 1e-4)
+            assert(ReadReply().strip() == '1')
+            
+            binaryreplies = []
+            for requestid in requestids:
+                reply = ReadReply()
+                replyid, status = struct.unpack('=II',reply[0:8])
+                # the replies of a connection come in the order of the requests
+                assert(replyid == requestid)
+                binaryreplies.append((status,reply[8:]))
+            for ireply in range(3):
+                status, data = binaryreplies[ireply]
+                assert(status == 0)
+                binaryvalues = numpy.fromstring(data,dtype=numpy.float64)
+                assert(len(binaryvalues) == len(textvalues[ireply]))
+                assert(all(abs(binaryvalues-textvalues[ireply]) <= 1e-5*maximum(1.0,abs(textvalues[ireply]))))
+            assert(transdist(numpy.fromstring(binaryreplies[0][1],dtype=numpy.float64),robot.GetDOFValues()) <= g_epsilon)
+            # the binary reply of an invalid robot has a non-zero status and no data
+            assert(binaryreplies[3][0] != 0 and len(binaryreplies[3][1]) == 0)
+            
+            # binary requests of commands without raw doubles return the text
+            status, data = binaryreplies[4]
+            assert(status == 0)
+            words = data.split()
+            numcommands = int(words[0])
+            assert(len(words) == 1+4*numcommands)
+            stats = dict([(words[1+4*i],(int(words[2+4*i]),float(words[3+4*i]),float(words[4+4*i]))) for i in range(numcommands)])
+            assert(stats['robot_getdofvalues'][0] == 3)
+            assert(stats['body_getlinks'][0] == 2)
+            assert(stats['body_getjoints'][0] == 2)
+            assert(stats['binary_hello'][0] == 1)
+            for count,averagetime,maxtime in stats.itervalues():
+                assert(0 <= averagetime and averagetime <= maxtime+1e-3)
+            
+            sock.sendall(BinaryFrame(1,'server_getstatistics reset') + BinaryFrame(2,'server_getstatistics'))
+            for requestid in [1,2]:
+                reply = ReadReply()
+                assert(struct.unpack('=II',reply[0:8]) == (requestid,0))
+            # only the reset request itself was recorded after the reset
+            words = reply[8:].split()
+            assert(int(words[0]) == 1 and words[1] == 'server_getstatistics' and int(words[2]) == 1)
+        finally:
+            sock.close()
+            env.Remove(server)
+
+    def test_softwarecamera(self):
+        env=self.env
+        with env:
+            boxes = RaveCreateKinBody(env,'')
+            boxes.InitFromBoxes(array([[0,0,1,0.2,0.2,0.1],[0.1,0,0.5,0.05,0.05,0.05]]),True)
+            boxes.SetName('boxes')
+            env.Add(boxes,True)
+        width, height = 64, 48
+        fx, fy, cx, cy = 64.0, 64.0, 32.0, 24.0
+        camera=RaveCreateSensor(env,'BaseCamera')
+        camera.SendCommand('setintrinsic %f %f %f %f'%(fx,fy,cx,cy))
+        camera.SendCommand('setdims %d %d'%(width,height))
+        camera.SetTransform(eye(4))
+        camera.Configure(Sensor.ConfigureCommand.PowerOn)
+        
+        # the rays of the pixel centers hit the front faces of the boxes at z=0.45 and z=0.9
+        xs,ys = meshgrid(arange(width),arange(height))
+        dx = (xs-cx)/fx
+        dy = (ys-cy)/fy
+        margin = 0.01
+        smallbox = (abs(dx*0.45-0.1) < 0.05-margin) & (abs(dy*0.45) < 0.05-margin)
+        nearsmallbox = (dx*0.55 > 0.05-margin) & (dx*0.45 < 0.15+margin) & (abs(dy*0.45) < 0.05+margin)
+        bigbox = (abs(dx*0.9) < 0.2-margin) & (abs(dy*0.9) < 0.2-margin) & ~nearsmallbox
+        nothing = ((abs(dx*0.9) > 0.2+margin) | (abs(dy*0.9) > 0.2+margin)) & ~nearsmallbox
+        assert(sum(smallbox) > 50 and sum(bigbox) > 200 and sum(nothing) > 1000)
+        
+        alldepthdata = []
+        for numthreads in [1,4,2,4]:
+            camera.SendCommand('SetSoftwareRender 1 %d'%numthreads)
+            camera.SimulationStep(1.0)
+            data = camera.GetSensorData(Sensor.Type.Depth)
+            depth = data.depthdata
+            assert(depth.shape == (height,width))
+            assert(all(abs(depth[smallbox]-0.45) <= 1e-5))
+            assert(all(abs(depth[bigbox]-0.9) <= 1e-5))
+            assert(all(depth[nothing] == 0))
+            expectedcloud = dstack([dx*depth,dy*depth,depth])
+            assert(data.pointcloud.shape == (height,width,3))
+            assert(all(abs(data.pointcloud-expectedcloud) <= 1e-5))
+            image = camera.GetSensorData(Sensor.Type.Camera).imagedata
+            assert(all(sum(image[smallbox|bigbox],axis=1) > 0))
+            assert(all(image[nothing] == 0))
+            alldepthdata.append(depth)
+        # the image does not depend on the number of threads
+        for depth in alldepthdata[1:]:
+            assert(all(depth == alldepthdata[0]))
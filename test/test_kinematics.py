@@ -12,6 +12,7 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 from common_test_openrave import *
+import threading
 
 class TestKinematics(EnvironmentSetup):
     def test_bodybasic(self):
@@ -1122,3 +1123,117 @@ class TestKinematics(EnvironmentSetup):
         assert(robot.CheckSelfCollision())
         robot.SetNonCollidingConfiguration()
         assert(not robot.CheckSelfCollision())
+
+    def test_numpyarguments(self):
+        env=self.env
+        robot=self.LoadRobot('robots/barrettwam.robot.xml')
+        with env:
+            numlinks = len(robot.GetLinks())
+            dof = robot.GetDOF()
+            lower,upper = robot.GetDOFLimits()
+            values = randlimits(lower,upper)
+            
+            # dof values of different dtypes and memory layouts are copied from the buffer
+            strided = zeros(2*dof)
+            strided[::2] = values
+            for ovalues,epsilon in [(values,g_epsilon),(list(values),g_epsilon),(strided[::2],g_epsilon),(values.astype(float32),1e-6),(tile(values,(3,1)).transpose()[:,1],g_epsilon)]:
+                robot.SetDOFValues(zeros(dof))
+                robot.SetDOFValues(ovalues)
+                assert(transdist(robot.GetDOFValues(),values) <= dof*epsilon)
+            for dtype in [int32,int64]:
+                robot.SetDOFValues(values)
+                robot.SetDOFValues(zeros(dof,dtype))
+                assert(transdist(robot.GetDOFValues(),zeros(dof)) <= g_epsilon)
+            
+            # dof indices of different integer types
+            stridedindices = zeros(2*dof,int32)
+            stridedindices[::2] = arange(dof)[::-1]
+            for oindices in [arange(dof,dtype=int32)[::-1],arange(dof,dtype=int64)[::-1],stridedindices[::2],range(dof)[::-1]]:
+                robot.SetDOFValues(zeros(dof))
+                robot.SetDOFValues(values[::-1],oindices)
+                assert(transdist(robot.GetDOFValues(),values) <= g_epsilon)
+                assert(transdist(robot.GetDOFValues(oindices),values[::-1]) <= g_epsilon)
+            
+            # the link transformations are returned as one array
+            robot.SetDOFValues(values)
+            Tlinks,dofbranches = robot.GetLinkTransformations(True)
+            assert(isinstance(Tlinks,numpy.ndarray) and Tlinks.shape == (numlinks,4,4))
+            assert(transdist(Tlinks,[link.GetTransform() for link in robot.GetLinks()]) <= g_epsilon)
+            with TransformQuaternionsSaver():
+                openravepy_int.options.returnTransformQuaternion = True
+                poses = robot.GetLinkTransformations()
+                assert(isinstance(poses,numpy.ndarray) and poses.shape == (numlinks,7))
+            for pose,T in izip(poses,Tlinks):
+                assert(ComputePoseDistance(pose,poseFromMatrix(T)) <= g_epsilon)
+            
+            # stacked transforms as Nx7, Nx3x4 and Nx4x4 arrays of different dtypes and layouts
+            Tnew = array([randtrans() for link in robot.GetLinks()])
+            stridedT = zeros((numlinks,4,8))
+            stridedT[:,:,::2] = Tnew
+            identities = array([eye(4,dtype=int32)]*numlinks)
+            identities[:,0:3,3] = arange(3*numlinks).reshape((numlinks,3))
+            for oT,Texpected,epsilon in [(Tnew,Tnew,g_epsilon),
+                                         (Tnew[:,0:3,:],Tnew,g_epsilon),
+                                         (array(Tnew[:,0:3,:]),Tnew,g_epsilon),
+                                         (poseFromMatrices(Tnew),Tnew,g_epsilon),
+                                         (stridedT[:,:,::2],Tnew,g_epsilon),
+                                         (asfortranarray(Tnew),Tnew,g_epsilon),
+                                         (Tnew.astype(float32),Tnew,1e-5),
+                                         (identities,identities,g_epsilon),
+                                         (list(Tnew),Tnew,g_epsilon)]:
+                robot.SetLinkTransformations(Tlinks,dofbranches)
+                robot.SetLinkTransformations(oT,dofbranches)
+                assert(all(abs(robot.GetLinkTransformations()-Texpected) <= epsilon))
+            assert_raises(openrave_exception,robot.SetLinkTransformations,Tnew[1:],dofbranches)
+            robot.SetLinkTransformations(Tlinks,dofbranches)
+            assert(transdist(robot.GetDOFValues(),values) <= g_epsilon)
+
+    def test_threadedkinematics(self):
+        env=self.env
+        robot=self.LoadRobot('robots/barrettwam.robot.xml')
+        with env:
+            manip = robot.GetActiveManipulator()
+            lower,upper = robot.GetDOFLimits()
+            configs = [randlimits(lower,upper) for i in range(50)]
+            expected = []
+            for values in configs:
+                robot.SetDOFValues(values)
+                expected.append((robot.GetLinkTransformations(),manip.CalculateJacobian(),robot.ComputeJacobianAxisAngle(manip.GetEndEffector().GetIndex())))
+        
+        # the kinematics calls release the GIL, so the threads compute at the same time on their own environments
+        errors = []
+        def KinematicsThread(threadenv):
+            try:
+                threadrobot = threadenv.GetRobot(robot.GetName())
+                threadmanip = threadrobot.GetManipulator(manip.GetName())
+                for repeat in range(4):
+                    for values,(Tlinks,Jtrans,Jrot) in izip(configs,expected):
+                        with threadenv:
+                            threadrobot.SetDOFValues(values)
+                            if transdist(threadrobot.GetDOFValues(),values) > g_epsilon:
+                                errors.append('dof values')
+                            if transdist(threadrobot.GetLinkTransformations(),Tlinks) > g_epsilon:
+                                errors.append('link transformations')
+                            if transdist(threadmanip.CalculateJacobian(),Jtrans) > g_epsilon:
+                                errors.append('translation jacobian')
+                            if transdist(threadrobot.ComputeJacobianAxisAngle(threadmanip.GetEndEffector().GetIndex()),Jrot) > g_epsilon:
+                                errors.append('rotation jacobian')
+            except Exception,e:
+                errors.append(str(e))
+        
+        threadenvs = [env.CloneSelf(CloningOptions.Bodies) for i in range(4)]
+        try:
+            threads = [threading.Thread(target=KinematicsThread,args=(threadenv,)) for threadenv in threadenvs]
+            for t in threads:
+                t.start()
+            # the main thread keeps reading the original robot
+            with env:
+                for values,(Tlinks,Jtrans,Jrot) in izip(configs,expected):
+                    robot.SetDOFValues(values)
+                    assert(transdist(robot.GetLinkTransformations(),Tlinks) <= g_epsilon)
+            for t in threads:
+                t.join()
+        finally:
+            for threadenv in threadenvs:
+                threadenv.Destroy()
+        assert(len(errors) == 0)
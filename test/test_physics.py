@@ -112,6 +112,60 @@ class RunPhysics(EnvironmentSetup):
                 break
         env.StopSimulation()
 
+    def test_fixedstepscheduler(self):
+        env=self.env
+        with env:
+            body = env.ReadKinBodyURI('data/lego2.kinbody.xml')
+            body.SetName('body')
+            env.Add(body)
+            env.StopSimulation()
+            env.SetSimulationSchedulerMode(Environment.SimulationSchedulerMode.FixedStep)
+            assert(env.GetSimulationSchedulerMode() == Environment.SimulationSchedulerMode.FixedStep)
+            env.GetSimulationStatistics(reset=True)
+            starttime = 1e-6*env.GetSimulationTime()
+        
+        realtime0 = time.time()
+        env.StartSimulation(timestep=0.01,realtime=True)
+        time.sleep(1)
+        env.StopSimulation()
+        realtime1 = time.time()
+        stats = env.GetSimulationStatistics()
+        self.log.info('fixed step statistics: %r', stats)
+        assert(stats['numsteps'] > 0)
+        assert(stats['numoverruns'] <= stats['numsteps'])
+        # every recorded step advanced the simulation time by exactly one time step
+        simelapsed = 1e-6*env.GetSimulationTime()-starttime
+        assert( abs(simelapsed-0.01*stats['numsteps']) <= 1e-6*stats['numsteps'] )
+        # steps and skipped deadlines are never ahead of their deadlines, so they cannot exceed the elapsed real time
+        assert( 0.01*(stats['numsteps']+stats['numskippedsteps']) <= realtime1-realtime0+0.011 )
+        env.SetSimulationSchedulerMode(Environment.SimulationSchedulerMode.Adaptive)
+
+    def test_fixedstepschedulercontention(self):
+        self.log.info('a python thread locking the environment in a loop does not starve the fixed step simulation')
+        env=self.env
+        with env:
+            body = env.ReadKinBodyURI('data/lego2.kinbody.xml')
+            body.SetName('body')
+            env.Add(body)
+            env.StopSimulation()
+            env.SetSimulationSchedulerMode(Environment.SimulationSchedulerMode.FixedStep)
+            env.GetSimulationStatistics(reset=True)
+        
+        env.StartSimulation(timestep=0.01,realtime=True)
+        numlocks = 0
+        endtime = time.time()+1
+        while time.time() < endtime:
+            # Lock yields to a pending step before taking the environment lock
+            with env:
+                numlocks += 1
+        env.StopSimulation()
+        stats = env.GetSimulationStatistics()
+        self.log.info('fixed step statistics with %d locks: %r', numlocks, stats)
+        assert(numlocks > 0)
+        assert(stats['numsteps'] > 10)
+        assert(stats['numlockfailures'] == 0)
+        env.SetSimulationSchedulerMode(Environment.SimulationSchedulerMode.Adaptive)
+
     def test_kinematics(self):
         log.info("test that physics kinematics are consistent")
         env=self.env
@@ -254,6 +308,65 @@ class RunPhysics(EnvironmentSetup):
             T1 = nonmovingbody.GetTransform()
             assert(transdist(T0,T1)<=0.5)
 
+    def test_odestepoptions(self):
+        if self.physicsenginename != 'ode':
+            return
+        log.info('test the ode contact cache and island threads')
+        self.LoadEnv('data/hanoi.env.xml')
+        env=self.env
+        with env:
+            physics = env.GetPhysicsEngine()
+            physics.SetGravity([0,0,-9.81])
+            physics.SendCommand('SetIslandThreads 2')
+            physics.SendCommand('SetContactCache 1 1e-6 1e-6')
+            physics.SendCommand('GetStepStatistics 1')
+            for i in range(50):
+                env.StepSimulation(0.01)
+            stats = [float(f) for f in physics.SendCommand('GetStepStatistics').split()]
+            assert(stats[0] == 50)
+            assert(stats[2] >= stats[1])
+            assert(stats[6]+stats[7] > 0)
+            # synchronizing, colliding and solving are disjoint parts of a step
+            assert(stats[8]+stats[3]+stats[4] <= stats[1]+g_epsilon)
+            physics.SendCommand('SetContactCache 0')
+            physics.SendCommand('SetIslandThreads 1')
+
+    def test_odecontactcache(self):
+        if self.physicsenginename != 'ode':
+            return
+        log.info('test that the ode contact cache does not change the simulation')
+        self.LoadEnv('data/hanoi.env.xml')
+        env=self.env
+        with env:
+            physics = env.GetPhysicsEngine()
+            physics.SetGravity([0,0,-9.81])
+            bodies = env.GetBodies()
+            initialstates = [(body.GetLinkTransformations(),body.GetDOFValues()) for body in bodies]
+            def simulate(cachecommand):
+                for body,(transforms,values) in zip(bodies,initialstates):
+                    body.SetDOFValues(values)
+                    body.SetLinkTransformations(transforms)
+                    body.SetLinkVelocities(zeros((len(body.GetLinks()),6)))
+                physics.SendCommand(cachecommand)
+                physics.SendCommand('GetStepStatistics 1')
+                for i in range(50):
+                    env.StepSimulation(0.01)
+                stats = [float(f) for f in physics.SendCommand('GetStepStatistics').split()]
+                physics.SendCommand('SetContactCache 0')
+                return [body.GetLinkTransformations() for body in bodies],stats
+            
+            nocachetransforms,nocachestats = simulate('SetContactCache 0')
+            assert(nocachestats[6] == 0 and nocachestats[7] == 0)
+            # with no tolerance, contacts are only reused for the exact same poses
+            exacttransforms,exactstats = simulate('SetContactCache 1 0 0')
+            for transforms0,transforms1 in zip(nocachetransforms,exacttransforms):
+                assert(transdist(transforms0,transforms1) <= g_epsilon*len(transforms0))
+            # resting bodies reuse their contacts when they are allowed to move slightly
+            loosetransforms,loosestats = simulate('SetContactCache 1 1e-4 1e-4')
+            assert(loosestats[6] > 0)
+            for transforms0,transforms1 in zip(nocachetransforms,loosetransforms):
+                assert(transdist(transforms0,transforms1) <= 0.01*len(transforms0))
+
     def test_applytorque(self):
         log.info('test if torque can be applied')
         self.LoadEnv('data/lab1.env.xml')
@@ -50,6 +50,131 @@ class RunPlanning(EnvironmentSetup):
             useddofindices, usedconfigindices = spec.ExtractUsedIndices(robot)
             assert(sorted(useddofindices) == sorted(manip.GetArmIndices()))
             
+    def test_lazyprm(self):
+        env = self.env
+        with env:
+            self.LoadEnv('data/hironxtable.env.xml')
+            robot = env.GetRobots()[0]
+            manip = robot.SetActiveManipulator('leftarm_torso')
+            robot.SetActiveDOFs(manip.GetArmIndices())
+            goal = robot.GetActiveDOFValues()
+            goal[0] = -0.556
+            goal[3] = -1.86
+            # roadmap files have to handle names with spaces
+            box = RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[2,2,0.1,0.1,0.1,0.1]]),True)
+            box.SetName('box with spaces')
+            env.Add(box,True)
+            planner = RaveCreatePlanner(env,'lazyprm')
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetGoalConfig(goal)
+            params.SetExtraParameters('<neighbors>8</neighbors><batchsize>200</batchsize>')
+            trajs = []
+            stats = []
+            for iquery in range(2):
+                with robot:
+                    assert(planner.InitPlan(robot,params))
+                    traj = RaveCreateTrajectory(env,'')
+                    assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                stats.append([int(x) for x in planner.SendCommand('GetStatistics').split()])
+                trajs.append(traj)
+            # the second query reuses the validated roadmap
+            assert(stats[1][0] == stats[0][0])
+            assert(stats[1][5] <= stats[0][5])
+            assert(stats[1][6] == 0)
+            # moving a body that is far away from the roadmap does not invalidate anything
+            blocker = RaveCreateKinBody(env,'')
+            blocker.InitFromBoxes(array([[0,0,0,0.03,0.03,0.03]]),True)
+            blocker.SetName('blocker')
+            blocker.SetTransform(matrixFromPose([1,0,0,0,3,3,0]))
+            env.Add(blocker,True)
+            for pose in [[1,0,0,0,3,3,0],[1,0,0,0,3.5,3,0]]:
+                blocker.SetTransform(matrixFromPose(pose))
+                with robot:
+                    assert(planner.InitPlan(robot,params))
+                    traj = RaveCreateTrajectory(env,'')
+                    assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                farstats = [int(x) for x in planner.SendCommand('GetStatistics').split()]
+                assert(farstats[6] == 0)
+            # moving a box onto the middle of the cached path invalidates the nodes and edges around it
+            waypoints = trajs[0].GetWaypoints(0,trajs[0].GetNumWaypoints(),robot.GetActiveConfigurationSpecification()).reshape((trajs[0].GetNumWaypoints(),robot.GetActiveDOF()))
+            imiddle = (len(waypoints)-1)/2
+            with robot:
+                robot.SetActiveDOFValues(0.5*(waypoints[imiddle]+waypoints[imiddle+1]))
+                Tee = manip.GetEndEffectorTransform()
+            blocker.SetTransform(matrixFromPose(r_[[1,0,0,0],Tee[0:3,3]]))
+            with robot:
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            blockedstats = [int(x) for x in planner.SendCommand('GetStatistics').split()]
+            assert(blockedstats[6] > 0)
+            assert(blockedstats[5] > 0)
+            ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+            assert(ret==PlannerStatus.HasSolution)
+            with robot:
+                planningutils.VerifyTrajectory(params,traj,samplingstep=0.002)
+            env.Remove(blocker)
+            # a loaded roadmap is reused by another planner
+            import tempfile, os
+            fd, filename = tempfile.mkstemp('.txt')
+            os.close(fd)
+            try:
+                assert(planner.SendCommand('SaveRoadmap %s'%filename) is not None)
+                planner2 = RaveCreatePlanner(env,'lazyprm')
+                assert(planner2.SendCommand('LoadRoadmap %s'%filename) is not None)
+            finally:
+                os.remove(filename)
+            with robot:
+                assert(planner2.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner2.PlanPath(traj) == PlannerStatus.HasSolution)
+            stats.append([int(x) for x in planner2.SendCommand('GetStatistics').split()])
+            trajs.append(traj)
+            assert(stats[2][0] == stats[0][0])
+            assert(stats[2][5] <= stats[0][5])
+            # disabling the box changes the environment even though the box does not move
+            box.Enable(False)
+            with robot:
+                assert(planner2.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner2.PlanPath(traj) == PlannerStatus.HasSolution)
+            trajs.append(traj)
+            for traj in trajs:
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                with robot:
+                    planningutils.VerifyTrajectory(params,traj,samplingstep=0.002)
+
+    def test_birrtplancache(self):
+        env = self.env
+        with env:
+            self.LoadEnv('data/hironxtable.env.xml')
+            robot = env.GetRobots()[0]
+            manip = robot.SetActiveManipulator('leftarm_torso')
+            robot.SetActiveDOFs(manip.GetArmIndices())
+            goal = robot.GetActiveDOFValues()
+            goal[0] = -0.556
+            goal[3] = -1.86
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.SendCommand('SetPlanCache 10 0.1') is not None)
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetGoalConfig(goal)
+            for iquery in range(2):
+                with robot:
+                    assert(planner.InitPlan(robot,params))
+                    traj = RaveCreateTrajectory(env,'')
+                    assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                with robot:
+                    planningutils.VerifyTrajectory(params,traj,samplingstep=0.002)
+            # the second query is solved with the path of the first
+            hits, misses, numpaths = [int(x) for x in planner.SendCommand('GetPlanCacheStatistics').split()]
+            assert(hits == 1 and misses == 1 and numpaths == 1)
+
     def test_ikplanning(self):
         env = self.env
         self.LoadEnv('data/lab1.env.xml')
@@ -615,6 +740,297 @@ class RunPlanning(EnvironmentSetup):
             assert(success)
             assert(not env.CheckCollision(collisionbody))
 
+    def test_asyncplanner(self):
+        self.log.info('plan on a cloned environment in a separate thread')
+        env = self.env
+        with env:
+            self.LoadEnv('data/hironxtable.env.xml')
+            robot = env.GetRobots()[0]
+            manip = robot.SetActiveManipulator('leftarm_torso')
+            robot.SetActiveDOFs(manip.GetArmIndices())
+            goal = robot.GetActiveDOFValues()
+            goal[0] = -0.556
+            goal[3] = -1.86
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetGoalConfig(goal)
+        asyncplanner = planningutils.AsyncPlanner('birrt')
+        assert(asyncplanner.IsDone())
+        assert(asyncplanner.Start(robot,params))
+        # the original environment is not locked while planning
+        with env:
+            robot.SetActiveDOFValues(robot.GetActiveDOFValues())
+        assert(asyncplanner.Wait(60))
+        assert(asyncplanner.IsDone())
+        assert(asyncplanner.GetStatus() == PlannerStatus.HasSolution)
+        traj = asyncplanner.GetTrajectory()
+        assert(traj is not None and traj.GetNumWaypoints() >= 2)
+        assert(traj.GetEnv() == env)
+        with env:
+            assert(transdist(traj.GetWaypoint(-1,robot.GetActiveConfigurationSpecification()),goal) <= g_epsilon)
+
+        # cancelling right after starting either interrupts the planner or lets it finish
+        assert(asyncplanner.Start(robot,params))
+        asyncplanner.Cancel()
+        assert(asyncplanner.Wait(60))
+        assert(asyncplanner.GetStatus() in [PlannerStatus.Interrupted, PlannerStatus.HasSolution])
+        del asyncplanner
+
+    def test_continuouscollision(self):
+        self.log.info('certify segments with conservative advancement and compare with the discretized checks')
+        env=self.env
+        with env:
+            env.SetCollisionChecker(RaveCreateCollisionChecker(env,'pqp'))
+            robot = self.LoadRobot('robots/barrettwam.robot.xml')
+            manip = robot.GetActiveManipulator()
+            robot.SetActiveDOFs(manip.GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            # only check environment collisions (CFO_CheckEnvCollisions)
+            constraint = planningutils.DynamicsCollisionConstraint(params,[robot],1)
+            constraint.SetIntervalCheckMode(planningutils.DynamicsCollisionConstraint.IntervalCheckMode.ContinuousCollision,0.001)
+            # swing the extended arm around the base
+            q0 = zeros(robot.GetActiveDOF())
+            q0[1] = 1
+            q1 = array(q0)
+            q0[0] = -1
+            q1[0] = 1
+            ret,configurations,times = constraint.Check(q0,q1,[],[],2.0,Interval.Closed,returnconfigurations=True)
+            assert(ret == 0)
+            assert(len(times) == len(configurations) and len(times) >= 2)
+            assert(times[0] == 0 and abs(times[-1]-2.0) <= g_epsilon)
+            assert(all(diff(times) >= 0))
+            for config,t in zip(configurations,times):
+                assert(transdist(config,q0+(t/2.0)*(q1-q0)) <= 1e-6)
+
+            # an obstacle in the middle of the segment
+            with robot:
+                robot.SetActiveDOFValues(0.5*(q0+q1))
+                Tee = manip.GetEndEffectorTransform()
+            box = RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[Tee[0,3],Tee[1,3],Tee[2,3],0.05,0.05,0.05]]),True)
+            box.SetName('obstacle')
+            env.Add(box,True)
+            ret,configurations,times = constraint.Check(q0,q1,[],[],2.0,Interval.Closed,returnconfigurations=True)
+            assert(ret != 0)
+            assert(len(times) == len(configurations))
+            constraint.SetIntervalCheckMode(planningutils.DynamicsCollisionConstraint.IntervalCheckMode.Discretized)
+            assert(constraint.Check(q0,q1,[],[],2.0,Interval.Closed) != 0)
+
+    def test_vandercorputcheck(self):
+        self.log.info('van der Corput order has to give the same results as the sequential discretized checks')
+        env=self.env
+        with env:
+            robot = self.LoadRobot('robots/barrettwam.robot.xml')
+            manip = robot.GetActiveManipulator()
+            robot.SetActiveDOFs(manip.GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            # only check environment collisions (CFO_CheckEnvCollisions)
+            constraint = planningutils.DynamicsCollisionConstraint(params,[robot],1)
+            q0 = zeros(robot.GetActiveDOF())
+            q0[1] = 1
+            q1 = array(q0)
+            q0[0] = -1
+            q1[0] = 1
+            modes = [planningutils.DynamicsCollisionConstraint.IntervalCheckMode.Discretized, planningutils.DynamicsCollisionConstraint.IntervalCheckMode.VanDerCorput]
+            numchecked = []
+            for mode in modes:
+                constraint.SetIntervalCheckMode(mode)
+                assert(constraint.Check(q0,q1,[],[],0,Interval.Closed) == 0)
+                numchecked.append(constraint.GetNumCheckedSamples())
+            assert(numchecked[0] == numchecked[1])
+
+            # an obstacle three quarters along the segment
+            with robot:
+                robot.SetActiveDOFValues(0.25*q0+0.75*q1)
+                Tee = manip.GetEndEffectorTransform()
+            box = RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[Tee[0,3],Tee[1,3],Tee[2,3],0.05,0.05,0.05]]),True)
+            box.SetName('obstacle')
+            env.Add(box,True)
+            results = []
+            numchecked = []
+            for mode in modes:
+                constraint.SetIntervalCheckMode(mode)
+                results.append(constraint.Check(q0,q1,[],[],0,Interval.Closed))
+                numchecked.append(constraint.GetNumCheckedSamples())
+            assert(results[0] != 0 and results[0] == results[1])
+            assert(numchecked[1] < numchecked[0])
+            # filling the checked configurations keeps the sequential order
+            ret,configurations,times = constraint.Check(q0,q1,[],[],0,Interval.Closed,returnconfigurations=True)
+            assert(ret == results[0])
+            assert(all(diff(configurations[:,0]) > 0))
+
+    def test_vandercorputnonlinear(self):
+        self.log.info('van der Corput order falls back to sequential checks when the neighbor function wraps circular joints')
+        env=self.env
+        xmldata = """<Robot name="circularbot">
+  <KinBody>
+    <Body name="base" type="static">
+      <Geom type="box">
+        <extents>0.1 0.1 0.1</extents>
+      </Geom>
+    </Body>
+    <Body name="arm">
+      <offsetfrom>base</offsetfrom>
+      <Translation>0 0 0.3</Translation>
+      <Geom type="box">
+        <translation>0.5 0 0</translation>
+        <extents>0.5 0.05 0.05</extents>
+      </Geom>
+    </Body>
+    <Joint name="j0" type="hinge" circular="true">
+      <Body>base</Body>
+      <Body>arm</Body>
+      <offsetfrom>arm</offsetfrom>
+      <axis>0 0 1</axis>
+      <resolution>0.001</resolution>
+    </Joint>
+  </KinBody>
+</Robot>
+"""
+        with env:
+            robot = self.LoadRobotData(xmldata)
+            robot.SetActiveDOFs([0])
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            constraint = planningutils.DynamicsCollisionConstraint(params,[robot],1)
+            # crosses pi, so the neighbor function wraps the values
+            q0 = array([2.9])
+            q1 = array([-2.9])
+            # an obstacle a quarter along the segment, the arm points along the angle
+            angle = 2.9+0.25*(2*pi-5.8)
+            box = RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[0.8*cos(angle),0.8*sin(angle),0.3,0.02,0.02,0.1]]),True)
+            box.SetName('obstacle')
+            env.Add(box,True)
+            results = []
+            numchecked = []
+            for mode in [planningutils.DynamicsCollisionConstraint.IntervalCheckMode.Discretized, planningutils.DynamicsCollisionConstraint.IntervalCheckMode.VanDerCorput]:
+                constraint.SetIntervalCheckMode(mode)
+                results.append(constraint.Check(q0,q1,[],[],0,Interval.Closed))
+                numchecked.append(constraint.GetNumCheckedSamples())
+            assert(results[0] != 0 and results[0] == results[1])
+            # bisection order would have found the obstacle after a few samples
+            assert(numchecked[0] == numchecked[1])
+
+    def test_continuouscollisionfallback(self):
+        self.log.info('segments moving circular joints are discretized by the continuous collision mode')
+        env=self.env
+        xmldata = """<Robot name="circularbot">
+  <KinBody>
+    <Body name="base" type="static">
+      <Geom type="box">
+        <extents>0.1 0.1 0.1</extents>
+      </Geom>
+    </Body>
+    <Body name="arm">
+      <offsetfrom>base</offsetfrom>
+      <Translation>0 0 0.3</Translation>
+      <Geom type="box">
+        <translation>0.5 0 0</translation>
+        <extents>0.5 0.05 0.05</extents>
+      </Geom>
+    </Body>
+    <Joint name="j0" type="hinge" circular="true">
+      <Body>base</Body>
+      <Body>arm</Body>
+      <offsetfrom>arm</offsetfrom>
+      <axis>0 0 1</axis>
+    </Joint>
+  </KinBody>
+</Robot>
+"""
+        with env:
+            env.SetCollisionChecker(RaveCreateCollisionChecker(env,'pqp'))
+            robot = self.LoadRobotData(xmldata)
+            robot.SetActiveDOFs([0])
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            constraint = planningutils.DynamicsCollisionConstraint(params,[robot])
+            # crosses pi
+            q0 = array([3.0])
+            q1 = array([-3.0])
+            results = []
+            for mode in [planningutils.DynamicsCollisionConstraint.IntervalCheckMode.ContinuousCollision, planningutils.DynamicsCollisionConstraint.IntervalCheckMode.Discretized]:
+                constraint.SetIntervalCheckMode(mode)
+                results.append(constraint.Check(q0,q1,[],[],1.0,Interval.Closed,returnconfigurations=True))
+            assert(results[0][0] == 0 and results[1][0] == 0)
+            assert(results[0][1].shape == results[1][1].shape)
+            assert(transdist(results[0][1],results[1][1]) <= g_epsilon)
+            assert(transdist(results[0][2],results[1][2]) <= g_epsilon)
+
+    def test_grasperdistancemap(self):
+        self.log.info('distance map is computed in chunks in one or several threads')
+        env=self.env
+        self.LoadEnv('robots/barrettwam.robot.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            target=RaveCreateKinBody(env,'')
+            target.InitFromBoxes(array([[0,0,0,0.4,0.4,0.4]]),True)
+            target.SetName('target')
+            env.Add(target,True)
+            wall=RaveCreateKinBody(env,'')
+            wall.InitFromBoxes(array([[0.6,0,0,0.05,2,2]]),True)
+            wall.SetName('wall')
+            env.Add(wall,True)
+            grasper = interfaces.Grasper(robot)
+            conewidth = 0.2
+            for numthreads in [1,3]:
+                distmap = grasper.ComputeDistanceMap(target,center=[0,0,0],conewidth=conewidth,mapsamples=4000,numthreads=numthreads)
+                # more points than one chunk of the grasper module
+                assert(len(distmap) > 1024)
+                front = distmap[distmap[:,4] > 0.399]
+                back = distmap[distmap[:,4] < -0.399]
+                assert(len(front) > 0 and len(back) > 0)
+                assert(all(front[:,1] > 0.99))
+                # the face is 0.15 away from the wall, and the cone rays can be at most conewidth off the normal
+                assert(all(front[:,0] >= 0.15-1e-4) and all(front[:,0] <= 0.15/cos(conewidth)+1e-4))
+                # nothing is behind the target
+                assert(all(back[:,0] == 2))
+
+    def test_graspthreaded(self):
+        self.log.info('threaded and asynchronous grasping give the same grasps as one thread')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        target=env.GetKinBody('mug1')
+        gmodel = databases.grasping.GraspingModel(robot=robot,target=target)
+        gmodel.init(friction=0.4,avoidlinks=[])
+        def graspkeys(grasps):
+            return sorted(tuple(round(f,4) for f in r_[grasp[0],grasp[1],grasp[2],grasp[3],grasp[4],grasp[5],grasp[6]]) for grasp in grasps)
+        
+        with robot:
+            robot.SetActiveManipulator(gmodel.manip)
+            robot.SetTransform(eye(4))
+            robot.SetActiveDOFs(gmodel.manip.GetGripperIndices(),DOFAffine.X+DOFAffine.Y+DOFAffine.Z)
+            approachrays = gmodel.computeBoxApproachRays(delta=0.04)[:24]
+            approachrays[:,3:6] = -approachrays[:,3:6]
+            rolls = array([0,pi/2])
+            standoffs = array([0,0.025])
+            kwargs = {'approachrays':approachrays, 'rolls':rolls, 'standoffs':standoffs, 'preshapes':array([robot.GetDOFValues(gmodel.manip.GetGripperIndices())]), 'manipulatordirections':array([gmodel.manip.GetDirection()]), 'target':target, 'forceclosurethreshold':1e-9}
+            numgrasps = len(approachrays)*len(rolls)*len(standoffs)
+            
+            nextid, serialgrasps = gmodel.grasper.GraspThreaded(numthreads=1,**kwargs)
+            assert(nextid == numgrasps)
+            assert(len(serialgrasps) > 0)
+            
+            nextid, threadedgrasps = gmodel.grasper.GraspThreaded(numthreads=3,**kwargs)
+            assert(nextid == numgrasps)
+            assert(graspkeys(threadedgrasps) == graspkeys(serialgrasps))
+            
+            assert(gmodel.grasper.GraspThreaded(numthreads=3,startasync=True,**kwargs) is None)
+            asyncgrasps = []
+            finished = False
+            starttime = time.time()
+            while not finished:
+                nextid, finished, grasps = gmodel.grasper.GetGraspThreadedResults(timeout=1.0)
+                asyncgrasps += grasps
+                assert(time.time()-starttime < 600)
+            assert(nextid == numgrasps)
+            assert(graspkeys(asyncgrasps) == graspkeys(serialgrasps))
+
 #generate_classes(RunPlanning, globals(), [('ode','ode'),('bullet','bullet')])
 
 class test_ode(RunPlanning):
@@ -56,3 +56,80 @@ class TestSampling(EnvironmentSetup):
         robot.SetActiveDOFs(range(robot.GetDOF()-4),Robot.DOFAffine.X|Robot.DOFAffine.Y|Robot.DOFAffine.RotationAxis,[0,0,1])
         values = sp.SampleSequence(SampleDataType.Real,1)
         assert(len(values[0]) == robot.GetActiveDOF())
+
+    def test_nearestneighbortree(self):
+        self.log.info('the pyANN kd-tree returns the same neighbors as a brute force search')
+        from openravepy import pyANN
+        rng = numpy.random.RandomState(0)
+        weights = array([1.0,0.5,2.0,1.0])
+        circular = array([0,1,0,1])
+        circularinds = flatnonzero(circular)
+        def normalize(points):
+            points = array(points)
+            points[...,circularinds] = mod(points[...,circularinds]+pi,2*pi)-pi
+            return points
+        
+        # the circular coordinates go beyond [-pi,pi] so they wrap around
+        points = rng.uniform(-4,4,(600,4))
+        alive = zeros(len(points),bool)
+        def bruteforce(q):
+            diff = points-q
+            diff[:,circularinds] = mod(diff[:,circularinds]+pi,2*pi)-pi
+            dists2 = sum((diff*weights)**2,1)
+            dists2[~alive] = inf
+            return dists2
+        
+        def check(tree):
+            queries = rng.uniform(-4,4,(40,4))
+            # queries right at the wrap around point of the circular dimensions
+            queries[:10,circularinds] = pi-0.01
+            queries[10:20,circularinds] = -pi+0.01
+            sqrad = 0.8
+            for q in queries:
+                dists2 = bruteforce(q)
+                k = min(8,sum(alive))
+                inds,dists = tree.kSearch(q,k,0)
+                assert(all(alive[inds]))
+                assert(numpy.max(abs(dists-sort(dists2)[:k])) <= 1e-7)
+                assert(numpy.max(abs(dists2[inds]-dists)) <= 1e-7)
+                
+                inds,dists,kball = tree.kFRSearch(q,sqrad,len(tree),0)
+                expectedinds = flatnonzero(dists2<=sqrad)
+                assert(kball == len(expectedinds))
+                assert(sorted(inds[:kball]) == sorted(expectedinds))
+                assert(all(dists[1:]>=dists[:-1]))
+            
+            # the array versions give the same results, missing neighbors are filled like ANN
+            inds,dists = tree.kSearchArray(queries,3,0)
+            for i,q in enumerate(queries):
+                inds2,dists2 = tree.kSearch(q,3,0)
+                assert(all(inds[i]==inds2))
+            inds,dists,kball = tree.kFRSearchArray(queries,sqrad,2,0)
+            for i,q in enumerate(queries):
+                numinside = sum(bruteforce(q)<=sqrad)
+                assert(kball[i] == numinside)
+                assert(all(inds[i,numinside:]==-1))
+        
+        tree = pyANN.KDTree(points[:200],weights,circular)
+        alive[:200] = True
+        check(tree)
+        
+        # inserting one point at a time rebuilds unbalanced subtrees
+        for i in range(200,600):
+            assert(tree.insert(points[i]) == i)
+        alive[200:] = True
+        assert(len(tree) == len(points))
+        check(tree)
+        for i in [0,250,599]:
+            assert(numpy.max(abs(tree.getPoint(i)-normalize(points[i]))) <= 1e-7)
+        
+        # removing less than half the points keeps the tree, removing more rebuilds it
+        for numremove in [200,150]:
+            removeinds = rng.permutation(flatnonzero(alive))[:numremove]
+            for i in removeinds:
+                tree.remove(int(i))
+            alive[removeinds] = False
+            check(tree)
+        tree.rebuild()
+        check(tree)
+        assert(len(tree) == len(points))
@@ -726,6 +726,105 @@ class TestTrajectory(EnvironmentSetup):
             # path should be a little faster
             assert(trajclone.GetDuration()<traj.GetDuration())
 
+    def test_insertmiddlewaypoint(self):
+        log.info('insert a waypoint in the middle of a timed trajectory and check that only the segments around it change')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            spec = robot.GetActiveConfigurationSpecification()
+            initvalues = robot.GetActiveDOFValues()
+            traj = RaveCreateTrajectory(env,'')
+            traj.Init(spec)
+            for i in range(6):
+                traj.Insert(traj.GetNumWaypoints(), initvalues+0.05*i)
+            ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+            assert(ret==PlannerStatus.HasSolution)
+            numpoints = traj.GetNumWaypoints()
+            index = numpoints/2
+            newvalues = 0.5*(traj.GetWaypoint(index-1,spec)+traj.GetWaypoint(index,spec)) + 0.01
+            oldhead = traj.GetWaypoints(0,index)
+            oldtail = traj.GetWaypoints(index+1,numpoints)
+            planningutils.InsertActiveDOFWaypointWithRetiming(index,newvalues,[],traj,robot)
+            newnumpoints = traj.GetNumWaypoints()
+            assert(newnumpoints > numpoints)
+            # the waypoints outside of the window are not touched
+            assert(transdist(traj.GetWaypoints(0,index),oldhead) <= g_epsilon)
+            assert(transdist(traj.GetWaypoints(newnumpoints-(numpoints-index-1),newnumpoints),oldtail) <= g_epsilon)
+            assert(min([sum(abs(traj.GetWaypoint(i,spec)-newvalues)) for i in range(index,newnumpoints)]) <= g_epsilon)
+            parameters=Planner.PlannerParameters()
+            parameters.SetRobotActiveJoints(robot)
+            planningutils.VerifyTrajectory(parameters,traj,0.01)
+
+    def test_retimetrajectories(self):
+        log.info('retime many trajectories in parallel and check they match retiming them one by one')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            spec = robot.GetActiveConfigurationSpecification()
+            initvalues = robot.GetActiveDOFValues()
+            trajs = []
+            for itraj in range(12):
+                traj = RaveCreateTrajectory(env,'')
+                traj.Init(spec)
+                for i in range(4+itraj%3):
+                    traj.Insert(traj.GetNumWaypoints(), initvalues+0.008*(i+1)*(itraj%5+1))
+                trajs.append(traj)
+            serialtrajs = [RaveCreateTrajectory(env,'') for traj in trajs]
+            for traj,serialtraj in izip(trajs,serialtrajs):
+                serialtraj.Clone(traj,0)
+                assert(planningutils.RetimeTrajectory(serialtraj,False)==PlannerStatus.HasSolution)
+
+        # the workers initialize their planners with the environment lock
+        statuses = planningutils.RetimeTrajectories(trajs,False,1.0,1.0,'','',4)
+        assert(len(statuses)==len(trajs))
+        for traj,serialtraj,status in izip(trajs,serialtrajs,statuses):
+            assert(status==PlannerStatus.HasSolution)
+            assert(traj.GetNumWaypoints()==serialtraj.GetNumWaypoints())
+            assert(abs(traj.GetDuration()-serialtraj.GetDuration()) <= g_epsilon)
+            assert(transdist(traj.GetWaypoints(0,traj.GetNumWaypoints()),serialtraj.GetWaypoints(0,serialtraj.GetNumWaypoints())) <= g_epsilon)
+
+    def test_constraintsmoothingmerge(self):
+        log.info('smooth with the constraint smoother and check the merge statistics')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            traj = RaveCreateTrajectory(env,'')
+            traj.Init(robot.GetActiveConfigurationSpecification('linear'))
+            for i in range(5):
+                traj.Insert(traj.GetNumWaypoints(), initvalues+0.04*array([i if j%2 == 0 else i%2 for j in range(robot.GetActiveDOF())]))
+            planner = RaveCreatePlanner(env,'ConstraintParabolicSmoother')
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetExtraParameters('<_fsteplength>0.004</_fsteplength><minswitchtime>0.05</minswitchtime><_nmaxiterations>20</_nmaxiterations>')
+            def smooth(usecache):
+                newtraj = RaveClone(traj,0)
+                assert(planner.SendCommand('SetMergeCache %d'%usecache) is not None)
+                assert(planner.InitPlan(robot,params))
+                assert(planner.PlanPath(newtraj)==PlannerStatus.HasSolution)
+                mergetime,numchecks,numcachehits = planner.SendCommand('GetMergeStatistics').split()
+                return newtraj,float(mergetime),int(numchecks),int(numcachehits)
+            
+            cachedtraj,mergetime,numchecks,numcachehits = smooth(1)
+            assert(mergetime >= 0 and numchecks > 0)
+            assert(numcachehits > 0)
+            # the cache only skips checks of ramps that were already checked, so the result does not change
+            uncachedtraj,uncachedmergetime,uncachednumchecks,uncachednumcachehits = smooth(0)
+            assert(uncachednumcachehits == 0)
+            assert(uncachednumchecks == numchecks+numcachehits)
+            assert(cachedtraj.GetNumWaypoints()==uncachedtraj.GetNumWaypoints())
+            assert(abs(cachedtraj.GetDuration()-uncachedtraj.GetDuration()) <= g_epsilon)
+            assert(transdist(cachedtraj.GetWaypoints(0,cachedtraj.GetNumWaypoints()),uncachedtraj.GetWaypoints(0,uncachedtraj.GetNumWaypoints())) <= g_epsilon)
+            parameters=Planner.PlannerParameters()
+            parameters.SetRobotActiveJoints(robot)
+            planningutils.VerifyTrajectory(parameters,cachedtraj,0.01)
+
     def test_computederiv(self):
         env = self.env
         self.LoadEnv('data/katanatable.env.xml')